@@ -39,6 +39,7 @@ typedef struct _mp_obj_framebuf_t {
     void *buf;
     uint16_t width, height, stride;
     uint8_t format;
+    uint8_t readonly; // set for views over read-only buffers, which can only be blitted from
 } mp_obj_framebuf_t;
 
 typedef void (*setpixel_t)(const mp_obj_framebuf_t*, int, int, uint32_t);
@@ -259,16 +260,13 @@ STATIC void fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, u
     formats[fb->format].fill_rect(fb, x, y, xend - x, yend - y, col);
 }
 
-STATIC mp_obj_t framebuf_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
-    mp_arg_check_num(n_args, n_kw, 4, 5, false);
-
-    mp_obj_framebuf_t *o = m_new_obj(mp_obj_framebuf_t);
-    o->base.type = type;
+STATIC void framebuf_init(mp_obj_framebuf_t *o, size_t n_args, const mp_obj_t *args, mp_uint_t buf_flags) {
     o->buf_obj = args[0];
 
     mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(args[0], &bufinfo, MP_BUFFER_WRITE);
+    mp_get_buffer_raise(args[0], &bufinfo, buf_flags);
     o->buf = bufinfo.buf;
+    o->readonly = !(buf_flags & MP_BUFFER_WRITE);
 
     o->width = mp_obj_get_int(args[1]);
     o->height = mp_obj_get_int(args[2]);
@@ -298,13 +296,29 @@ STATIC mp_obj_t framebuf_make_new(const mp_obj_type_t *type, size_t n_args, size
         default:
             mp_raise_ValueError("invalid format");
     }
+}
+
+STATIC mp_obj_t framebuf_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 4, 5, false);
+
+    mp_obj_framebuf_t *o = m_new_obj(mp_obj_framebuf_t);
+    o->base.type = type;
+    framebuf_init(o, n_args, args, MP_BUFFER_WRITE);
 
     return MP_OBJ_FROM_PTR(o);
 }
 
+STATIC void framebuf_check_writable(const mp_obj_framebuf_t *self) {
+    if (self->readonly) {
+        mp_raise_ValueError("FrameBuffer is read-only");
+    }
+}
+
 STATIC mp_int_t framebuf_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
-    (void)flags;
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->readonly && (flags & MP_BUFFER_WRITE)) {
+        return 1;
+    }
     bufinfo->buf = self->buf;
     bufinfo->len = self->stride * self->height * (self->format == FRAMEBUF_RGB565 ? 2 : 1);
     bufinfo->typecode = 'B'; // view framebuf as bytes
@@ -313,6 +327,7 @@ STATIC mp_int_t framebuf_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo,
 
 STATIC mp_obj_t framebuf_fill(mp_obj_t self_in, mp_obj_t col_in) {
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(self_in);
+    framebuf_check_writable(self);
     mp_int_t col = mp_obj_get_int(col_in);
     formats[self->format].fill_rect(self, 0, 0, self->width, self->height, col);
     return mp_const_none;
@@ -323,6 +338,7 @@ STATIC mp_obj_t framebuf_fill_rect(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
 
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_int_t x = mp_obj_get_int(args[1]);
     mp_int_t y = mp_obj_get_int(args[2]);
     mp_int_t width = mp_obj_get_int(args[3]);
@@ -345,6 +361,7 @@ STATIC mp_obj_t framebuf_pixel(size_t n_args, const mp_obj_t *args) {
             return MP_OBJ_NEW_SMALL_INT(getpixel(self, x, y));
         } else {
             // set
+            framebuf_check_writable(self);
             setpixel(self, x, y, mp_obj_get_int(args[3]));
         }
     }
@@ -356,6 +373,7 @@ STATIC mp_obj_t framebuf_hline(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
 
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_int_t x = mp_obj_get_int(args[1]);
     mp_int_t y = mp_obj_get_int(args[2]);
     mp_int_t w = mp_obj_get_int(args[3]);
@@ -371,6 +389,7 @@ STATIC mp_obj_t framebuf_vline(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
 
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_int_t x = mp_obj_get_int(args[1]);
     mp_int_t y = mp_obj_get_int(args[2]);
     mp_int_t h = mp_obj_get_int(args[3]);
@@ -386,6 +405,7 @@ STATIC mp_obj_t framebuf_rect(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
 
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_int_t x = mp_obj_get_int(args[1]);
     mp_int_t y = mp_obj_get_int(args[2]);
     mp_int_t w = mp_obj_get_int(args[3]);
@@ -405,6 +425,7 @@ STATIC mp_obj_t framebuf_line(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
 
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_int_t x1 = mp_obj_get_int(args[1]);
     mp_int_t y1 = mp_obj_get_int(args[2]);
     mp_int_t x2 = mp_obj_get_int(args[3]);
@@ -467,8 +488,49 @@ STATIC mp_obj_t framebuf_line(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_line_obj, 6, 6, framebuf_line);
 
+// Blit between mono horizontal framebuffers of the same format a byte at a time, for when the
+// destination and source columns both start on a byte boundary (images and icons drawn at x = 0
+// or a multiple of 8).
+STATIC void mono_horiz_blit_aligned(const mp_obj_framebuf_t *dst, const mp_obj_framebuf_t *src,
+    int x0, int y0, int x1, int y1, int w, int h, mp_int_t key) {
+    int nbytes = w >> 3;
+    int tail = w & 7;
+    uint8_t tail_mask = 0;
+    if (tail) {
+        tail_mask = dst->format == FRAMEBUF_MHMSB ? (1 << tail) - 1 : (uint8_t)(0xff << (8 - tail));
+    }
+
+    for (; h > 0; --h, ++y0, ++y1) {
+        uint8_t *d = (uint8_t*)dst->buf + ((x0 + y0 * dst->stride) >> 3);
+        const uint8_t *s = (const uint8_t*)src->buf + ((x1 + y1 * src->stride) >> 3);
+        if (key == 0) {
+            // 0 is transparent, so only set pixels are drawn
+            for (int i = 0; i < nbytes; ++i) {
+                d[i] |= s[i];
+            }
+            if (tail) {
+                d[nbytes] |= s[nbytes] & tail_mask;
+            }
+        } else if (key == 1) {
+            // 1 is transparent, so only clear pixels are drawn
+            for (int i = 0; i < nbytes; ++i) {
+                d[i] &= s[i];
+            }
+            if (tail) {
+                d[nbytes] &= s[nbytes] | ~tail_mask;
+            }
+        } else {
+            memmove(d, s, nbytes);
+            if (tail) {
+                d[nbytes] = (d[nbytes] & ~tail_mask) | (s[nbytes] & tail_mask);
+            }
+        }
+    }
+}
+
 STATIC mp_obj_t framebuf_blit(size_t n_args, const mp_obj_t *args) {
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     mp_obj_framebuf_t *source = MP_OBJ_TO_PTR(args[1]);
     mp_int_t x = mp_obj_get_int(args[2]);
     mp_int_t y = mp_obj_get_int(args[3]);
@@ -495,6 +557,13 @@ STATIC mp_obj_t framebuf_blit(size_t n_args, const mp_obj_t *args) {
     int x0end = MIN(self->width, x + source->width);
     int y0end = MIN(self->height, y + source->height);
 
+    if (source->format == self->format &&
+        (self->format == FRAMEBUF_MHLSB || self->format == FRAMEBUF_MHMSB) &&
+        (x0 & 7) == 0 && (x1 & 7) == 0) {
+        mono_horiz_blit_aligned(self, source, x0, y0, x1, y1, x0end - x0, y0end - y0, key);
+        return mp_const_none;
+    }
+
     for (; y0 < y0end; ++y0) {
         int cx1 = x1;
         for (int cx0 = x0; cx0 < x0end; ++cx0) {
@@ -512,6 +581,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_blit_obj, 4, 5, framebuf_bli
 
 STATIC mp_obj_t framebuf_scroll(mp_obj_t self_in, mp_obj_t xstep_in, mp_obj_t ystep_in) {
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(self_in);
+    framebuf_check_writable(self);
     mp_int_t xstep = mp_obj_get_int(xstep_in);
     mp_int_t ystep = mp_obj_get_int(ystep_in);
     int sx, y, xend, yend, dx, dy;
@@ -545,6 +615,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(framebuf_scroll_obj, framebuf_scroll);
 STATIC mp_obj_t framebuf_text(size_t n_args, const mp_obj_t *args) {
     // extract arguments
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    framebuf_check_writable(self);
     const char *str = mp_obj_str_get_str(args[1]);
     mp_int_t x0 = mp_obj_get_int(args[2]);
     mp_int_t y0 = mp_obj_get_int(args[3]);
@@ -604,6 +675,17 @@ STATIC const mp_obj_type_t mp_type_framebuf = {
 };
 #endif
 
+// A FrameBuffer over an existing buffer that may be read-only, e.g. bytes frozen into flash.
+// Nothing is copied; the view can be used as the source of blit() but can't be drawn into.
+STATIC mp_obj_t framebuf_view(size_t n_args, const mp_obj_t *args) {
+    mp_obj_framebuf_t *o = m_new_obj(mp_obj_framebuf_t);
+    o->base.type = &mp_type_framebuf;
+    framebuf_init(o, n_args, args, MP_BUFFER_READ);
+
+    return MP_OBJ_FROM_PTR(o);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_view_obj, 4, 5, framebuf_view);
+
 // this factory function is provided for backwards compatibility with old FrameBuffer1 class
 STATIC mp_obj_t legacy_framebuffer1(size_t n_args, const mp_obj_t *args) {
     mp_obj_framebuf_t *o = m_new_obj(mp_obj_framebuf_t);
@@ -616,6 +698,7 @@ STATIC mp_obj_t legacy_framebuffer1(size_t n_args, const mp_obj_t *args) {
     o->width = mp_obj_get_int(args[1]);
     o->height = mp_obj_get_int(args[2]);
     o->format = FRAMEBUF_MVLSB;
+    o->readonly = 0;
     if (n_args >= 4) {
         o->stride = mp_obj_get_int(args[3]);
     } else {
@@ -631,6 +714,7 @@ STATIC const mp_rom_map_elem_t framebuf_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_framebuf) },
     { MP_ROM_QSTR(MP_QSTR_FrameBuffer), MP_ROM_PTR(&mp_type_framebuf) },
     { MP_ROM_QSTR(MP_QSTR_FrameBuffer1), MP_ROM_PTR(&legacy_framebuffer1_obj) },
+    { MP_ROM_QSTR(MP_QSTR_view), MP_ROM_PTR(&framebuf_view_obj) },
     { MP_ROM_QSTR(MP_QSTR_MVLSB), MP_ROM_INT(FRAMEBUF_MVLSB) },
     { MP_ROM_QSTR(MP_QSTR_MONO_VLSB), MP_ROM_INT(FRAMEBUF_MVLSB) },
     { MP_ROM_QSTR(MP_QSTR_RGB565), MP_ROM_INT(FRAMEBUF_RGB565) },
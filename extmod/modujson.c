@@ -25,6 +25,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "py/objlist.h"
 #include "py/objstringio.h"
@@ -87,27 +88,74 @@ STATIC byte ujson_stream_next(ujson_stream_t *s) {
     return s->cur;
 }
 
-STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
-    const mp_stream_p_t *stream_p = mp_get_stream_raise(stream_obj, MP_STREAM_OP_READ);
-    ujson_stream_t s = {stream_obj, stream_p->read, 0, 0};
-    vstr_t vstr;
-    vstr_init(&vstr, 8);
+NORETURN STATIC void ujson_syntax_error(void) {
+    mp_raise_ValueError("syntax error in JSON");
+}
+
+// Reads the rest of a string whose opening quote has been consumed, leaving the stream at the
+// character after the closing quote.  The contents go in vstr, or are dropped if vstr is NULL.
+// Returns false if the stream ends first.
+STATIC bool ujson_read_string(ujson_stream_t *s, vstr_t *vstr) {
+    if (vstr != NULL) {
+        vstr_reset(vstr);
+    }
+    for (; !S_END(*s) && S_CUR(*s) != '"';) {
+        byte c = S_CUR(*s);
+        if (c == '\\') {
+            c = S_NEXT(*s);
+            switch (c) {
+                case 'b': c = 0x08; break;
+                case 'f': c = 0x0c; break;
+                case 'n': c = 0x0a; break;
+                case 'r': c = 0x0d; break;
+                case 't': c = 0x09; break;
+                case 'u': {
+                    mp_uint_t num = 0;
+                    for (int i = 0; i < 4; i++) {
+                        c = (S_NEXT(*s) | 0x20) - '0';
+                        if (c > 9) {
+                            c -= ('a' - ('9' + 1));
+                        }
+                        num = (num << 4) | c;
+                    }
+                    if (vstr != NULL) {
+                        vstr_add_char(vstr, num);
+                    }
+                    goto str_cont;
+                }
+            }
+        }
+        if (vstr != NULL) {
+            vstr_add_byte(vstr, c);
+        }
+    str_cont:
+        S_NEXT(*s);
+    }
+    if (S_END(*s)) {
+        return false;
+    }
+    S_NEXT(*s);
+    return true;
+}
+
+// Parses one value starting at the current character, leaving the stream at the character
+// after it.  vstr is scratch space for strings and numbers.
+STATIC mp_obj_t ujson_parse_value(ujson_stream_t *s, vstr_t *vstr) {
     mp_obj_list_t stack; // we use a list as a simple stack for nested JSON
     stack.len = 0;
     stack.items = NULL;
     mp_obj_t stack_top = MP_OBJ_NULL;
     mp_obj_type_t *stack_top_type = NULL;
     mp_obj_t stack_key = MP_OBJ_NULL;
-    S_NEXT(s);
     for (;;) {
         cont:
-        if (S_END(s)) {
+        if (S_END(*s)) {
             break;
         }
         mp_obj_t next = MP_OBJ_NULL;
         bool enter = false;
-        byte cur = S_CUR(s);
-        S_NEXT(s);
+        byte cur = S_CUR(*s);
+        S_NEXT(*s);
         switch (cur) {
             case ',':
             case ':':
@@ -117,72 +165,42 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
             case '\r':
                 goto cont;
             case 'n':
-                if (S_CUR(s) == 'u' && S_NEXT(s) == 'l' && S_NEXT(s) == 'l') {
-                    S_NEXT(s);
+                if (S_CUR(*s) == 'u' && S_NEXT(*s) == 'l' && S_NEXT(*s) == 'l') {
+                    S_NEXT(*s);
                     next = mp_const_none;
                 } else {
                     goto fail;
                 }
                 break;
             case 'f':
-                if (S_CUR(s) == 'a' && S_NEXT(s) == 'l' && S_NEXT(s) == 's' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
+                if (S_CUR(*s) == 'a' && S_NEXT(*s) == 'l' && S_NEXT(*s) == 's' && S_NEXT(*s) == 'e') {
+                    S_NEXT(*s);
                     next = mp_const_false;
                 } else {
                     goto fail;
                 }
                 break;
             case 't':
-                if (S_CUR(s) == 'r' && S_NEXT(s) == 'u' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
+                if (S_CUR(*s) == 'r' && S_NEXT(*s) == 'u' && S_NEXT(*s) == 'e') {
+                    S_NEXT(*s);
                     next = mp_const_true;
                 } else {
                     goto fail;
                 }
                 break;
             case '"':
-                vstr_reset(&vstr);
-                for (; !S_END(s) && S_CUR(s) != '"';) {
-                    byte c = S_CUR(s);
-                    if (c == '\\') {
-                        c = S_NEXT(s);
-                        switch (c) {
-                            case 'b': c = 0x08; break;
-                            case 'f': c = 0x0c; break;
-                            case 'n': c = 0x0a; break;
-                            case 'r': c = 0x0d; break;
-                            case 't': c = 0x09; break;
-                            case 'u': {
-                                mp_uint_t num = 0;
-                                for (int i = 0; i < 4; i++) {
-                                    c = (S_NEXT(s) | 0x20) - '0';
-                                    if (c > 9) {
-                                        c -= ('a' - ('9' + 1));
-                                    }
-                                    num = (num << 4) | c;
-                                }
-                                vstr_add_char(&vstr, num);
-                                goto str_cont;
-                            }
-                        }
-                    }
-                    vstr_add_byte(&vstr, c);
-                str_cont:
-                    S_NEXT(s);
-                }
-                if (S_END(s)) {
+                if (!ujson_read_string(s, vstr)) {
                     goto fail;
                 }
-                S_NEXT(s);
-                next = mp_obj_new_str(vstr.buf, vstr.len);
+                next = mp_obj_new_str(vstr->buf, vstr->len);
                 break;
             case '-':
             case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
                 bool flt = false;
-                vstr_reset(&vstr);
+                vstr_reset(vstr);
                 for (;;) {
-                    vstr_add_byte(&vstr, cur);
-                    cur = S_CUR(s);
+                    vstr_add_byte(vstr, cur);
+                    cur = S_CUR(*s);
                     if (cur == '.' || cur == 'E' || cur == 'e') {
                         flt = true;
                     } else if (cur == '+' || cur == '-' || unichar_isdigit(cur)) {
@@ -190,12 +208,12 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                     } else {
                         break;
                     }
-                    S_NEXT(s);
+                    S_NEXT(*s);
                 }
                 if (flt) {
-                    next = mp_parse_num_decimal(vstr.buf, vstr.len, false, false, NULL);
+                    next = mp_parse_num_decimal(vstr->buf, vstr->len, false, false, NULL);
                 } else {
-                    next = mp_parse_num_integer(vstr.buf, vstr.len, 10, NULL);
+                    next = mp_parse_num_integer(vstr->buf, vstr->len, 10, NULL);
                 }
                 break;
             }
@@ -260,23 +278,33 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
         }
     }
     success:
+    if (stack_top == MP_OBJ_NULL || stack.len != 0) {
+        // not exactly 1 object
+        goto fail;
+    }
+    return stack_top;
+
+    fail:
+    ujson_syntax_error();
+}
+
+STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
+    const mp_stream_p_t *stream_p = mp_get_stream_raise(stream_obj, MP_STREAM_OP_READ);
+    ujson_stream_t s = {stream_obj, stream_p->read, 0, 0};
+    vstr_t vstr;
+    vstr_init(&vstr, 8);
+    S_NEXT(s);
+    mp_obj_t obj = ujson_parse_value(&s, &vstr);
     // eat trailing whitespace
     while (unichar_isspace(S_CUR(s))) {
         S_NEXT(s);
     }
     if (!S_END(s)) {
         // unexpected chars
-        goto fail;
-    }
-    if (stack_top == MP_OBJ_NULL || stack.len != 0) {
-        // not exactly 1 object
-        goto fail;
+        ujson_syntax_error();
     }
     vstr_clear(&vstr);
-    return stack_top;
-
-    fail:
-    mp_raise_ValueError("syntax error in JSON");
+    return obj;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_load_obj, mod_ujson_load);
 
@@ -289,12 +317,321 @@ STATIC mp_obj_t mod_ujson_loads(mp_obj_t obj) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_loads_obj, mod_ujson_loads);
 
+// Pull-style reader.  Rather than building the whole document, the reader steps through it one
+// event at a time and only creates objects for the values the caller asks for, so memory use is
+// bounded by the nesting depth and the longest key, not by the size of the document.
+
+#define UJSON_READER_MAX_DEPTH (32)
+
+enum {
+    UJSON_EV_NONE,
+    UJSON_EV_START_OBJECT,
+    UJSON_EV_END_OBJECT,
+    UJSON_EV_START_ARRAY,
+    UJSON_EV_END_ARRAY,
+    UJSON_EV_KEY,
+    UJSON_EV_VALUE,
+};
+
+typedef struct _ujson_reader_t {
+    mp_obj_base_t base;
+    ujson_stream_t s;
+    vstr_t vstr; // the last key, and scratch space for values
+    uint8_t depth;
+    bool expect_key; // the next string is a key in the current object
+    bool done; // the top-level value is complete
+    uint8_t is_object[UJSON_READER_MAX_DEPTH];
+} ujson_reader_t;
+
+STATIC void ujson_reader_init(ujson_reader_t *r, mp_obj_t stream_obj) {
+    const mp_stream_p_t *stream_p = mp_get_stream_raise(stream_obj, MP_STREAM_OP_READ);
+    r->s.stream_obj = stream_obj;
+    r->s.read = stream_p->read;
+    r->s.errcode = 0;
+    r->s.cur = 0;
+    vstr_init(&r->vstr, 8);
+    r->depth = 0;
+    r->expect_key = false;
+    r->done = false;
+    S_NEXT(r->s);
+}
+
+STATIC void ujson_skip_separators(ujson_stream_t *s) {
+    for (;;) {
+        switch (S_CUR(*s)) {
+            case ',':
+            case ':':
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                S_NEXT(*s);
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+STATIC void ujson_reader_value_done(ujson_reader_t *r) {
+    if (r->depth == 0) {
+        r->done = true;
+    } else {
+        r->expect_key = r->is_object[r->depth - 1];
+    }
+}
+
+// Steps to the next event.  For UJSON_EV_VALUE the scalar is stored in *value if value is not
+// NULL, otherwise it is skipped without allocating.  Keys are left in r->vstr.
+STATIC int ujson_reader_next(ujson_reader_t *r, mp_obj_t *value) {
+    ujson_stream_t *s = &r->s;
+
+    if (r->done) {
+        while (unichar_isspace(S_CUR(*s))) {
+            S_NEXT(*s);
+        }
+        if (!S_END(*s)) {
+            ujson_syntax_error();
+        }
+        return UJSON_EV_NONE;
+    }
+
+    ujson_skip_separators(s);
+    byte c = S_CUR(*s);
+    if (S_END(*s)) {
+        ujson_syntax_error();
+    }
+
+    if (c == '}' || c == ']') {
+        if (r->depth == 0 || r->is_object[r->depth - 1] != (c == '}')) {
+            ujson_syntax_error();
+        }
+        S_NEXT(*s);
+        r->depth -= 1;
+        ujson_reader_value_done(r);
+        return c == '}' ? UJSON_EV_END_OBJECT : UJSON_EV_END_ARRAY;
+    }
+
+    if (r->expect_key) {
+        if (c != '"') {
+            ujson_syntax_error();
+        }
+        S_NEXT(*s);
+        if (!ujson_read_string(s, &r->vstr)) {
+            ujson_syntax_error();
+        }
+        r->expect_key = false;
+        return UJSON_EV_KEY;
+    }
+
+    if (c == '{' || c == '[') {
+        if (r->depth == UJSON_READER_MAX_DEPTH) {
+            mp_raise_ValueError("JSON nested too deeply");
+        }
+        S_NEXT(*s);
+        r->is_object[r->depth++] = (c == '{');
+        r->expect_key = (c == '{');
+        return c == '{' ? UJSON_EV_START_OBJECT : UJSON_EV_START_ARRAY;
+    }
+
+    if (value != NULL) {
+        *value = ujson_parse_value(s, &r->vstr);
+    } else if (c == '"') {
+        S_NEXT(*s);
+        if (!ujson_read_string(s, NULL)) {
+            ujson_syntax_error();
+        }
+    } else if (c == '-' || unichar_isdigit(c)) {
+        do {
+            c = S_NEXT(*s);
+        } while (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-' || unichar_isdigit(c));
+    } else {
+        // null, true or false, which don't allocate
+        ujson_parse_value(s, &r->vstr);
+    }
+    ujson_reader_value_done(r);
+    return UJSON_EV_VALUE;
+}
+
+// Skips the next value, including everything nested in it, without allocating.
+STATIC void ujson_reader_skip(ujson_reader_t *r) {
+    uint8_t depth = r->depth;
+    do {
+        int ev = ujson_reader_next(r, NULL);
+        if (ev == UJSON_EV_NONE || r->depth < depth || (ev == UJSON_EV_KEY && r->depth == depth)) {
+            ujson_syntax_error();
+        }
+    } while (r->depth > depth);
+}
+
+// Builds the next value, including everything nested in it.
+STATIC mp_obj_t ujson_reader_value(ujson_reader_t *r) {
+    if (r->done || r->expect_key) {
+        ujson_syntax_error();
+    }
+    ujson_skip_separators(&r->s);
+    byte c = S_CUR(r->s);
+    if (c == '}' || c == ']') {
+        ujson_syntax_error();
+    }
+    mp_obj_t value = ujson_parse_value(&r->s, &r->vstr);
+    ujson_reader_value_done(r);
+    return value;
+}
+
+STATIC const mp_obj_type_t ujson_reader_type;
+
+STATIC mp_obj_t ujson_reader_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+    ujson_reader_t *r = m_new_obj(ujson_reader_t);
+    r->base.type = type;
+    ujson_reader_init(r, args[0]);
+    return MP_OBJ_FROM_PTR(r);
+}
+
+STATIC mp_obj_t ujson_reader_iternext(mp_obj_t self_in) {
+    ujson_reader_t *r = MP_OBJ_TO_PTR(self_in);
+    mp_obj_t value = mp_const_none;
+    int ev = ujson_reader_next(r, &value);
+    if (ev == UJSON_EV_NONE) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    if (ev == UJSON_EV_KEY) {
+        value = mp_obj_new_str(r->vstr.buf, r->vstr.len);
+    }
+    mp_obj_t items[2] = {MP_OBJ_NEW_SMALL_INT(ev), value};
+    return mp_obj_new_tuple(2, items);
+}
+
+STATIC mp_obj_t ujson_reader_skip_meth(mp_obj_t self_in) {
+    ujson_reader_skip(MP_OBJ_TO_PTR(self_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ujson_reader_skip_obj, ujson_reader_skip_meth);
+
+STATIC mp_obj_t ujson_reader_value_meth(mp_obj_t self_in) {
+    return ujson_reader_value(MP_OBJ_TO_PTR(self_in));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ujson_reader_value_obj, ujson_reader_value_meth);
+
+STATIC const mp_rom_map_elem_t ujson_reader_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_skip), MP_ROM_PTR(&ujson_reader_skip_obj) },
+    { MP_ROM_QSTR(MP_QSTR_value), MP_ROM_PTR(&ujson_reader_value_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(ujson_reader_locals_dict, ujson_reader_locals_dict_table);
+
+STATIC const mp_obj_type_t ujson_reader_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Reader,
+    .make_new = ujson_reader_make_new,
+    .getiter = mp_identity_getiter,
+    .iternext = ujson_reader_iternext,
+    .locals_dict = (mp_obj_dict_t*)&ujson_reader_locals_dict,
+};
+
+// Returns the entry in keys that equals the path plus the current key, or MP_OBJ_NULL.  If
+// prefix is set, also reports whether any entry continues below that path.
+STATIC mp_obj_t ujson_select_match(size_t n_keys, const mp_obj_t *keys, const vstr_t *path, bool *prefix) {
+    *prefix = false;
+    for (size_t i = 0; i < n_keys; i++) {
+        size_t len;
+        const char *key = mp_obj_str_get_data(keys[i], &len);
+        if (len < path->len || memcmp(key, path->buf, path->len) != 0) {
+            continue;
+        }
+        if (len == path->len) {
+            return keys[i];
+        }
+        if (key[path->len] == '.') {
+            *prefix = true;
+        }
+    }
+    return MP_OBJ_NULL;
+}
+
+STATIC mp_obj_t mod_ujson_select(mp_obj_t stream_obj, mp_obj_t keys_in) {
+    size_t n_keys;
+    mp_obj_t *keys;
+    mp_obj_get_array(keys_in, &n_keys, &keys);
+
+    ujson_reader_t r;
+    ujson_reader_init(&r, stream_obj);
+
+    // The dotted path of object keys down to the current value, and its length at each depth
+    vstr_t path;
+    vstr_init(&path, 16);
+    uint16_t path_len[UJSON_READER_MAX_DEPTH + 1];
+    path_len[0] = 0;
+
+    mp_obj_t result = mp_obj_new_dict(0);
+    size_t remaining = n_keys;
+
+    if (ujson_reader_next(&r, NULL) != UJSON_EV_START_OBJECT) {
+        // Only objects have keys to select
+        return result;
+    }
+
+    while (remaining > 0) {
+        int ev = ujson_reader_next(&r, NULL);
+        if (ev == UJSON_EV_END_OBJECT) {
+            if (r.done) {
+                break;
+            }
+            path.len = path_len[r.depth];
+            continue;
+        }
+        if (ev != UJSON_EV_KEY) {
+            ujson_syntax_error();
+        }
+
+        size_t len = path.len;
+        if (len > 0) {
+            vstr_add_byte(&path, '.');
+        }
+        vstr_add_strn(&path, r.vstr.buf, r.vstr.len);
+
+        bool prefix;
+        mp_obj_t key = ujson_select_match(n_keys, keys, &path, &prefix);
+        if (key != MP_OBJ_NULL) {
+            if (mp_map_lookup(mp_obj_dict_get_map(result), key, MP_MAP_LOOKUP) == NULL) {
+                remaining -= 1;
+            }
+            mp_obj_dict_store(result, key, ujson_reader_value(&r));
+        } else if (prefix) {
+            ujson_skip_separators(&r.s);
+            if (S_CUR(r.s) == '{') {
+                // Descend, and put the path back when this object ends
+                path_len[r.depth] = len;
+                ujson_reader_next(&r, NULL);
+                continue;
+            }
+            ujson_reader_skip(&r);
+        } else {
+            ujson_reader_skip(&r);
+        }
+        path.len = len;
+    }
+
+    vstr_clear(&path);
+    vstr_clear(&r.vstr);
+    return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_ujson_select_obj, mod_ujson_select);
+
 STATIC const mp_rom_map_elem_t mp_module_ujson_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ujson) },
     { MP_ROM_QSTR(MP_QSTR_dump), MP_ROM_PTR(&mod_ujson_dump_obj) },
     { MP_ROM_QSTR(MP_QSTR_dumps), MP_ROM_PTR(&mod_ujson_dumps_obj) },
     { MP_ROM_QSTR(MP_QSTR_load), MP_ROM_PTR(&mod_ujson_load_obj) },
     { MP_ROM_QSTR(MP_QSTR_loads), MP_ROM_PTR(&mod_ujson_loads_obj) },
+    { MP_ROM_QSTR(MP_QSTR_select), MP_ROM_PTR(&mod_ujson_select_obj) },
+    { MP_ROM_QSTR(MP_QSTR_Reader), MP_ROM_PTR(&ujson_reader_type) },
+    { MP_ROM_QSTR(MP_QSTR_START_OBJECT), MP_ROM_INT(UJSON_EV_START_OBJECT) },
+    { MP_ROM_QSTR(MP_QSTR_END_OBJECT), MP_ROM_INT(UJSON_EV_END_OBJECT) },
+    { MP_ROM_QSTR(MP_QSTR_START_ARRAY), MP_ROM_INT(UJSON_EV_START_ARRAY) },
+    { MP_ROM_QSTR(MP_QSTR_END_ARRAY), MP_ROM_INT(UJSON_EV_END_ARRAY) },
+    { MP_ROM_QSTR(MP_QSTR_KEY), MP_ROM_INT(UJSON_EV_KEY) },
+    { MP_ROM_QSTR(MP_QSTR_VALUE), MP_ROM_INT(UJSON_EV_VALUE) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_ujson_globals, mp_module_ujson_globals_table);
@@ -0,0 +1,372 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Foundation Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/bc.h"
+#include "py/mphal.h"
+#include "py/stream.h"
+#include "extmod/moduprofile.h"
+
+#if MICROPY_PY_UPROFILE
+
+// Sampling profiler.  A periodic interrupt calls mp_uprofile_sample(), which walks the chain of
+// running bytecode frames and appends the function, file and line of each to a ring of 16-bit
+// words.  Everything is decoded at sample time, without allocating, so the buffer only holds
+// qstr ids and line numbers and stays valid even if the sampled code is freed later.
+//
+// Each sample is one word holding the number of frames, then three words per frame (name qstr,
+// file qstr, line), outermost first.  Active spans come first, with no file; a frame with no
+// name marks stacks cut short at the maximum depth.
+//
+// dump() prints the samples in the "folded" format that flamegraph.pl and speedscope read:
+//
+//     span;func (file:line);func (file:line) count
+
+#define UPROFILE_MAX_DEPTH (32)
+#define UPROFILE_MAX_SPAN_DEPTH (8)
+#define UPROFILE_MAX_SPANS (16)
+#define UPROFILE_DEFAULT_BUF_SIZE (8192)
+#define UPROFILE_DEFAULT_DEPTH (16)
+
+typedef struct _uprofile_span_stat_t {
+    qstr name;
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} uprofile_span_stat_t;
+
+STATIC struct {
+    volatile bool running;
+    uint8_t max_depth;
+    size_t buf_len; // in words
+    volatile size_t used; // in words
+    uint32_t samples;
+    uint32_t dropped;
+
+    // Spans currently open; depth can exceed the stack size, the extra ones aren't tracked
+    size_t span_depth;
+    struct {
+        uint16_t name;
+        uint32_t start_us;
+    } span_stack[UPROFILE_MAX_SPAN_DEPTH];
+
+    size_t n_span_stats;
+    uprofile_span_stat_t span_stats[UPROFILE_MAX_SPANS];
+} uprofile;
+
+STATIC void uprofile_decode_frame(const mp_code_state_t *code_state, uint16_t *out) {
+    const byte *ip = code_state->fun_bc->bytecode;
+    MP_BC_PRELUDE_SIG_DECODE(ip);
+    MP_BC_PRELUDE_SIZE_DECODE(ip);
+    const byte *bytecode_start = ip + n_info + n_cell;
+    #if !MICROPY_PERSISTENT_CODE
+    bytecode_start = MP_ALIGN(bytecode_start, sizeof(mp_uint_t));
+    #endif
+    size_t bc = code_state->ip > bytecode_start ? code_state->ip - bytecode_start : 0;
+    #if MICROPY_PERSISTENT_CODE
+    qstr block_name = ip[0] | (ip[1] << 8);
+    qstr source_file = ip[2] | (ip[3] << 8);
+    ip += 4;
+    #else
+    qstr block_name = mp_decode_uint_value(ip);
+    ip = mp_decode_uint_skip(ip);
+    qstr source_file = mp_decode_uint_value(ip);
+    ip = mp_decode_uint_skip(ip);
+    #endif
+    size_t line = mp_bytecode_get_source_line(ip, bc);
+    out[0] = block_name;
+    out[1] = source_file;
+    out[2] = line > 0xffff ? 0xffff : line;
+}
+
+STATIC void uprofile_record(void) {
+    uint16_t *buf = MP_STATE_VM(uprofile_buf);
+    if (buf == NULL) {
+        return;
+    }
+
+    const mp_code_state_t *frames[UPROFILE_MAX_DEPTH];
+    size_t n_frames = 0;
+    bool truncated = false;
+    for (const mp_code_state_t *code_state = MP_STATE_THREAD(current_code_state);
+         code_state != NULL; code_state = code_state->prev_state) {
+        if (n_frames == uprofile.max_depth) {
+            truncated = true;
+            break;
+        }
+        frames[n_frames++] = code_state;
+    }
+
+    size_t n_spans = MIN(uprofile.span_depth, UPROFILE_MAX_SPAN_DEPTH);
+    size_t n = n_spans + truncated + n_frames;
+    size_t words = 1 + 3 * n;
+    if (uprofile.used + words > uprofile.buf_len) {
+        uprofile.dropped += 1;
+        return;
+    }
+
+    uint16_t *p = buf + uprofile.used;
+    *p++ = n;
+    for (size_t i = 0; i < n_spans; ++i) {
+        *p++ = uprofile.span_stack[i].name;
+        *p++ = MP_QSTRnull;
+        *p++ = 0;
+    }
+    if (truncated) {
+        *p++ = MP_QSTRnull;
+        *p++ = MP_QSTRnull;
+        *p++ = 0;
+    }
+    while (n_frames > 0) {
+        uprofile_decode_frame(frames[--n_frames], p);
+        p += 3;
+    }
+    uprofile.used += words;
+    uprofile.samples += 1;
+}
+
+void mp_uprofile_sample(void) {
+    if (uprofile.running) {
+        uprofile_record();
+    }
+}
+
+void mp_uprofile_span_begin(qstr name) {
+    if (uprofile.span_depth < UPROFILE_MAX_SPAN_DEPTH) {
+        uprofile.span_stack[uprofile.span_depth].name = name;
+        uprofile.span_stack[uprofile.span_depth].start_us = mp_hal_ticks_us();
+    }
+    uprofile.span_depth += 1;
+}
+
+void mp_uprofile_span_end(void) {
+    if (uprofile.span_depth == 0) {
+        // Unbalanced end - ignore it
+        return;
+    }
+    uprofile.span_depth -= 1;
+    if (uprofile.span_depth >= UPROFILE_MAX_SPAN_DEPTH) {
+        return;
+    }
+
+    qstr name = uprofile.span_stack[uprofile.span_depth].name;
+    uint32_t us = mp_hal_ticks_us() - uprofile.span_stack[uprofile.span_depth].start_us;
+    uprofile_span_stat_t *stat = NULL;
+    for (size_t i = 0; i < uprofile.n_span_stats; ++i) {
+        if (uprofile.span_stats[i].name == name) {
+            stat = &uprofile.span_stats[i];
+            break;
+        }
+    }
+    if (stat == NULL) {
+        if (uprofile.n_span_stats == UPROFILE_MAX_SPANS) {
+            return;
+        }
+        stat = &uprofile.span_stats[uprofile.n_span_stats++];
+        stat->name = name;
+        stat->count = 0;
+        stat->total_us = 0;
+        stat->max_us = 0;
+    }
+    stat->count += 1;
+    stat->total_us += us;
+    if (us > stat->max_us) {
+        stat->max_us = us;
+    }
+}
+
+STATIC void uprofile_clear(void) {
+    uprofile.used = 0;
+    uprofile.samples = 0;
+    uprofile.dropped = 0;
+    uprofile.n_span_stats = 0;
+}
+
+STATIC mp_obj_t mod_uprofile_start(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_buf_size, ARG_depth };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf_size, MP_ARG_INT, {.u_int = UPROFILE_DEFAULT_BUF_SIZE} },
+        { MP_QSTR_depth, MP_ARG_INT, {.u_int = UPROFILE_DEFAULT_DEPTH} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_int_t depth = args[ARG_depth].u_int;
+    if (depth < 1 || depth > UPROFILE_MAX_DEPTH) {
+        mp_raise_ValueError("depth");
+    }
+
+    uprofile.running = false;
+    size_t buf_len = args[ARG_buf_size].u_int / sizeof(uint16_t);
+    if (MP_STATE_VM(uprofile_buf) == NULL || buf_len != uprofile.buf_len) {
+        MP_STATE_VM(uprofile_buf) = NULL;
+        MP_STATE_VM(uprofile_buf) = m_new(uint16_t, buf_len);
+        uprofile.buf_len = buf_len;
+    }
+    uprofile.max_depth = depth;
+    uprofile_clear();
+    uprofile.running = true;
+    mp_uprofile_port_start();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uprofile_start_obj, 0, mod_uprofile_start);
+
+STATIC mp_obj_t mod_uprofile_stop(void) {
+    mp_uprofile_port_stop();
+    uprofile.running = false;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_uprofile_stop_obj, mod_uprofile_stop);
+
+STATIC mp_obj_t mod_uprofile_clear(void) {
+    bool running = uprofile.running;
+    uprofile.running = false;
+    uprofile_clear();
+    uprofile.running = running;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_uprofile_clear_obj, mod_uprofile_clear);
+
+// Take a sample now, whether or not the timer is running
+STATIC mp_obj_t mod_uprofile_sample(void) {
+    uprofile_record();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_uprofile_sample_obj, mod_uprofile_sample);
+
+STATIC mp_obj_t mod_uprofile_span_begin(mp_obj_t name_in) {
+    mp_uprofile_span_begin(mp_obj_str_get_qstr(name_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_uprofile_span_begin_obj, mod_uprofile_span_begin);
+
+STATIC mp_obj_t mod_uprofile_span_end(void) {
+    mp_uprofile_span_end();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_uprofile_span_end_obj, mod_uprofile_span_end);
+
+STATIC void uprofile_print_stack(const mp_print_t *print, const uint16_t *p) {
+    size_t n = *p++;
+    if (n == 0) {
+        // Nothing but native code was running
+        mp_print_str(print, "[native]");
+    }
+    for (size_t i = 0; i < n; ++i, p += 3) {
+        if (i > 0) {
+            mp_print_str(print, ";");
+        }
+        if (p[0] == MP_QSTRnull) {
+            mp_print_str(print, "...");
+        } else if (p[1] == MP_QSTRnull) {
+            mp_print_str(print, qstr_str(p[0]));
+        } else {
+            mp_printf(print, "%q (%q:%u)", p[0], p[1], p[2]);
+        }
+    }
+}
+
+STATIC mp_obj_t mod_uprofile_dump(size_t n_args, const mp_obj_t *args) {
+    mp_print_t print = mp_plat_print;
+    if (n_args > 0 && args[0] != mp_const_none) {
+        mp_get_stream_raise(args[0], MP_STREAM_OP_WRITE);
+        print.data = MP_OBJ_TO_PTR(args[0]);
+        print.print_strn = mp_stream_write_adaptor;
+    }
+
+    const uint16_t *buf = MP_STATE_VM(uprofile_buf);
+    if (buf == NULL) {
+        return mp_const_none;
+    }
+
+    // Hold off the sampler while reading the buffer
+    bool running = uprofile.running;
+    uprofile.running = false;
+
+    // Runs of identical stacks are printed once with their count
+    size_t i = 0;
+    while (i < uprofile.used) {
+        size_t words = 1 + 3 * buf[i];
+        size_t count = 1;
+        size_t next = i + words;
+        while (next < uprofile.used && buf[next] == buf[i]
+               && memcmp(buf + next, buf + i, words * sizeof(uint16_t)) == 0) {
+            count += 1;
+            next += words;
+        }
+        uprofile_print_stack(&print, buf + i);
+        mp_printf(&print, " %u\n", (uint)count);
+        i = next;
+    }
+
+    uprofile.running = running;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_uprofile_dump_obj, 0, 1, mod_uprofile_dump);
+
+STATIC mp_obj_t mod_uprofile_stats(void) {
+    mp_obj_t spans = mp_obj_new_dict(uprofile.n_span_stats);
+    for (size_t i = 0; i < uprofile.n_span_stats; ++i) {
+        const uprofile_span_stat_t *stat = &uprofile.span_stats[i];
+        mp_obj_t items[3] = {
+            mp_obj_new_int_from_uint(stat->count),
+            mp_obj_new_int_from_uint(stat->total_us),
+            mp_obj_new_int_from_uint(stat->max_us),
+        };
+        mp_obj_dict_store(spans, MP_OBJ_NEW_QSTR(stat->name), mp_obj_new_tuple(3, items));
+    }
+
+    mp_obj_t stats = mp_obj_new_dict(4);
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_running), mp_obj_new_bool(uprofile.running));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_samples), mp_obj_new_int_from_uint(uprofile.samples));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_dropped), mp_obj_new_int_from_uint(uprofile.dropped));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_spans), spans);
+    return stats;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_uprofile_stats_obj, mod_uprofile_stats);
+
+STATIC const mp_rom_map_elem_t mp_module_uprofile_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uprofile) },
+    { MP_ROM_QSTR(MP_QSTR_start), MP_ROM_PTR(&mod_uprofile_start_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&mod_uprofile_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_clear), MP_ROM_PTR(&mod_uprofile_clear_obj) },
+    { MP_ROM_QSTR(MP_QSTR_sample), MP_ROM_PTR(&mod_uprofile_sample_obj) },
+    { MP_ROM_QSTR(MP_QSTR_span_begin), MP_ROM_PTR(&mod_uprofile_span_begin_obj) },
+    { MP_ROM_QSTR(MP_QSTR_span_end), MP_ROM_PTR(&mod_uprofile_span_end_obj) },
+    { MP_ROM_QSTR(MP_QSTR_dump), MP_ROM_PTR(&mod_uprofile_dump_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&mod_uprofile_stats_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mp_module_uprofile_globals, mp_module_uprofile_globals_table);
+
+const mp_obj_module_t mp_module_uprofile = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_uprofile_globals,
+};
+
+#endif // MICROPY_PY_UPROFILE
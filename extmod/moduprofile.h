@@ -0,0 +1,43 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Foundation Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef MICROPY_INCLUDED_EXTMOD_MODUPROFILE_H
+#define MICROPY_INCLUDED_EXTMOD_MODUPROFILE_H
+
+#include "py/qstr.h"
+
+// Record the running bytecode frames.  Safe to call from an interrupt.
+void mp_uprofile_sample(void);
+
+// Mark the start and end of a named region, from C.  Spans nest, show up as
+// the outermost frames of the samples taken inside them, and are timed.
+void mp_uprofile_span_begin(qstr name);
+void mp_uprofile_span_end(void);
+
+// Implemented by the port: call mp_uprofile_sample() periodically
+void mp_uprofile_port_start(void);
+void mp_uprofile_port_stop(void);
+
+#endif // MICROPY_INCLUDED_EXTMOD_MODUPROFILE_H
@@ -43,6 +43,13 @@
 
 typedef struct _mp_obj_re_t {
     mp_obj_base_t base;
+    #if MICROPY_PY_URE_CACHE
+    mp_obj_t pattern;
+    #endif
+    #if MICROPY_PY_URE_DFA
+    DFA *dfa; // built on first use
+    bool no_dfa; // too big for a DFA, or not enough memory for one
+    #endif
     ByteProg re;
 } mp_obj_re_t;
 
@@ -173,6 +180,36 @@ STATIC void re_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t
     mp_printf(print, "<re %p>", self);
 }
 
+// Run the program. With a DFA, input that can't match is turned away in linear time, and the
+// backtracking VM only runs to find the submatches of input that does.
+STATIC int ure_run(mp_obj_re_t *self, Subject *subj, const char **caps, int caps_num, bool is_anchored) {
+    #if MICROPY_PY_URE_DFA
+    if (self->dfa == NULL && !self->no_dfa) {
+        int size = re1_5_dfa_size(&self->re);
+        if (size >= 0) {
+            self->dfa = m_malloc_maybe(size);
+        }
+        if (self->dfa == NULL) {
+            self->no_dfa = true;
+        } else {
+            re1_5_dfa_init(&self->re, self->dfa);
+        }
+    }
+    if (self->dfa != NULL) {
+        int res = re1_5_dfa_match(&self->re, self->dfa, subj, is_anchored);
+        if (res == 0) {
+            return 0;
+        }
+        if (res < 0) {
+            // Needs more states than the DFA can hold; don't keep trying, and let the GC have it
+            self->dfa = NULL;
+            self->no_dfa = true;
+        }
+    }
+    #endif
+    return re1_5_recursiveloopprog(&self->re, subj, caps, caps_num, is_anchored);
+}
+
 STATIC mp_obj_t ure_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     (void)n_args;
     mp_obj_re_t *self = MP_OBJ_TO_PTR(args[0]);
@@ -184,7 +221,7 @@ STATIC mp_obj_t ure_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     mp_obj_match_t *match = m_new_obj_var(mp_obj_match_t, char*, caps_num);
     // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
     memset((char*)match->caps, 0, caps_num * sizeof(char*));
-    int res = re1_5_recursiveloopprog(&self->re, &subj, match->caps, caps_num, is_anchored);
+    int res = ure_run(self, &subj, match->caps, caps_num, is_anchored);
     if (res == 0) {
         m_del_var(mp_obj_match_t, char*, caps_num, match);
         return mp_const_none;
@@ -225,7 +262,7 @@ STATIC mp_obj_t re_split(size_t n_args, const mp_obj_t *args) {
     while (true) {
         // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
         memset((char**)caps, 0, caps_num * sizeof(char*));
-        int res = re1_5_recursiveloopprog(&self->re, &subj, caps, caps_num, false);
+        int res = ure_run(self, &subj, caps, caps_num, false);
 
         // if we didn't have a match, or had an empty match, it's time to stop
         if (!res || caps[0] == caps[1]) {
@@ -280,7 +317,7 @@ STATIC mp_obj_t re_sub_helper(mp_obj_t self_in, size_t n_args, const mp_obj_t *a
     for (;;) {
         // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
         memset((char*)match->caps, 0, caps_num * sizeof(char*));
-        int res = re1_5_recursiveloopprog(&self->re, &subj, match->caps, caps_num, false);
+        int res = ure_run(self, &subj, match->caps, caps_num, false);
 
         // If we didn't have a match, or had an empty match, it's time to stop
         if (!res || match->caps[0] == match->caps[1]) {
@@ -385,20 +422,20 @@ STATIC const mp_obj_type_t re_type = {
 };
 #endif
 
-STATIC mp_obj_t mod_re_compile(size_t n_args, const mp_obj_t *args) {
-    (void)n_args;
-    const char *re_str = mp_obj_str_get_str(args[0]);
+STATIC mp_obj_t ure_compile(mp_obj_t pattern, int flags) {
+    const char *re_str = mp_obj_str_get_str(pattern);
     int size = re1_5_sizecode(re_str);
     if (size == -1) {
         goto error;
     }
     mp_obj_re_t *o = m_new_obj_var(mp_obj_re_t, char, size);
     o->base.type = &re_type;
-    #if MICROPY_PY_URE_DEBUG
-    int flags = 0;
-    if (n_args > 1) {
-        flags = mp_obj_get_int(args[1]);
-    }
+    #if MICROPY_PY_URE_CACHE
+    o->pattern = pattern;
+    #endif
+    #if MICROPY_PY_URE_DFA
+    o->dfa = NULL;
+    o->no_dfa = false;
     #endif
     int error = re1_5_compilecode(&o->re, re_str);
     if (error != 0) {
@@ -409,14 +446,65 @@ error:
     if (flags & FLAG_DEBUG) {
         re1_5_dumpcode(&o->re);
     }
+    #else
+    (void)flags;
     #endif
     return MP_OBJ_FROM_PTR(o);
 }
+
+#if MICROPY_PY_URE_CACHE
+// Compiled programs are immutable, so the most recently used ones are kept, keyed by pattern
+// string, and handed out again. This saves recompiling on every call to the module-level
+// functions, and keeps the DFA built for a pattern that's used over and over.
+STATIC mp_obj_t ure_compile_cached(mp_obj_t pattern) {
+    mp_obj_t *cache = MP_STATE_VM(ure_cache);
+    size_t i;
+    for (i = 0; i < MICROPY_PY_URE_CACHE && cache[i] != MP_OBJ_NULL; i++) {
+        mp_obj_re_t *re = MP_OBJ_TO_PTR(cache[i]);
+        if (mp_obj_get_type(re->pattern) == mp_obj_get_type(pattern) && mp_obj_equal(re->pattern, pattern)) {
+            break;
+        }
+    }
+
+    mp_obj_t re;
+    if (i < MICROPY_PY_URE_CACHE && cache[i] != MP_OBJ_NULL) {
+        re = cache[i];
+    } else {
+        re = ure_compile(pattern, 0);
+        if (i == MICROPY_PY_URE_CACHE) {
+            // Drop the least recently used
+            i--;
+        }
+    }
+
+    // Move to the front
+    memmove(&cache[1], &cache[0], i * sizeof(mp_obj_t));
+    cache[0] = re;
+    return re;
+}
+#else
+#define ure_compile_cached(pattern) ure_compile(pattern, 0)
+#endif
+
+STATIC mp_obj_t mod_re_compile(size_t n_args, const mp_obj_t *args) {
+    int flags = 0;
+    if (n_args > 1) {
+        flags = mp_obj_get_int(args[1]);
+    }
+    #if MICROPY_PY_URE_DEBUG
+    if (flags & FLAG_DEBUG) {
+        return ure_compile(args[0], flags);
+    }
+    #else
+    (void)flags;
+    #endif
+    return ure_compile_cached(args[0]);
+}
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_compile_obj, 1, 2, mod_re_compile);
 
 STATIC mp_obj_t mod_re_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     (void)n_args;
-    mp_obj_t self = mod_re_compile(1, args);
+    mp_obj_t self = ure_compile_cached(args[0]);
 
     const mp_obj_t args2[] = {self, args[1]};
     mp_obj_t match = ure_exec(is_anchored, 2, args2);
@@ -435,7 +523,7 @@ MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_search_obj, 2, 4, mod_re_search);
 
 #if MICROPY_PY_URE_SUB
 STATIC mp_obj_t mod_re_sub(size_t n_args, const mp_obj_t *args) {
-    mp_obj_t self = mod_re_compile(1, args);
+    mp_obj_t self = ure_compile_cached(args[0]);
     return re_sub_helper(self, n_args, args);
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_sub_obj, 3, 5, mod_re_sub);
@@ -473,5 +561,8 @@ const mp_obj_module_t mp_module_ure = {
 #endif
 #include "re1.5/recursiveloop.c"
 #include "re1.5/charclass.c"
+#if MICROPY_PY_URE_DFA
+#include "re1.5/lazydfa.c"
+#endif
 
 #endif //MICROPY_PY_URE
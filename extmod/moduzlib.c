@@ -205,11 +205,232 @@ error:
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_uzlib_decompress_obj, 1, 3, mod_uzlib_decompress);
 
+#if MICROPY_PY_UZLIB_COMPRESS
+
+#define UZLIB_COMPRESS_DEFAULT_WBITS (10)
+
+// The compressor needs 2**wbits bytes each for hash_head (2**(wbits - 1)
+// entries) and hash_prev, and 2 * 2**wbits bytes for the window.
+#define UZLIB_COMPRESS_WORKSPACE(dict_size) (5 * (dict_size))
+
+// Sets up the compressor for the given wbits, either in the caller's buffer
+// or a fresh allocation, and returns the allocation to free (or NULL).
+STATIC byte *compress_init(struct uzlib_comp *comp, mp_int_t wbits, mp_obj_t buf_in) {
+    if (wbits < 0) {
+        wbits = -wbits;
+    }
+    if (wbits < 9 || wbits > 15) {
+        mp_raise_ValueError("wbits");
+    }
+    size_t dict_size = 1 << wbits;
+    size_t need = UZLIB_COMPRESS_WORKSPACE(dict_size);
+
+    byte *ws;
+    byte *alloc = NULL;
+    if (buf_in != mp_const_none) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_WRITE);
+        if (bufinfo.len < need) {
+            mp_raise_ValueError("buffer too small");
+        }
+        ws = bufinfo.buf;
+    } else {
+        ws = alloc = m_new(byte, need);
+    }
+
+    uint16_t *hash_head = (uint16_t*)ws;
+    uint16_t *hash_prev = hash_head + dict_size / 2;
+    uzlib_compress_init(comp, dict_size, wbits - 1, ws + 3 * dict_size, hash_head, hash_prev);
+    return alloc;
+}
+
+typedef struct _mp_obj_compio_t {
+    mp_obj_base_t base;
+    mp_obj_t dest_stream;
+    struct uzlib_comp comp;
+    byte *alloc;
+    bool is_zlib;
+    bool closed;
+    byte outbuf[64];
+} mp_obj_compio_t;
+
+STATIC void compio_flush(struct Outbuf *out) {
+    byte *p = (void*)out;
+    p -= offsetof(mp_obj_compio_t, comp.out);
+    mp_obj_compio_t *self = (mp_obj_compio_t*)p;
+
+    int err;
+    mp_stream_write_exactly(self->dest_stream, out->outbuf, out->outlen, &err);
+    if (err != 0) {
+        mp_raise_OSError(err);
+    }
+    out->outlen = 0;
+}
+
+STATIC mp_obj_t compio_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 3, false);
+    mp_get_stream_raise(args[0], MP_STREAM_OP_WRITE);
+    mp_obj_compio_t *o = m_new_obj(mp_obj_compio_t);
+    o->base.type = type;
+    o->dest_stream = args[0];
+    o->closed = false;
+
+    mp_int_t wbits = UZLIB_COMPRESS_DEFAULT_WBITS;
+    if (n_args > 1) {
+        wbits = mp_obj_get_int(args[1]);
+    }
+    o->is_zlib = wbits > 0;
+
+    memset(&o->comp.out, 0, sizeof(o->comp.out));
+    o->comp.out.outbuf = o->outbuf;
+    o->comp.out.outsize = sizeof(o->outbuf);
+    o->comp.out.flush = compio_flush;
+    o->alloc = compress_init(&o->comp, wbits, n_args > 2 ? args[2] : mp_const_none);
+    if (o->is_zlib) {
+        uzlib_zlib_write_header(&o->comp);
+    }
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC mp_uint_t compio_write(mp_obj_t o_in, const void *buf, mp_uint_t size, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    if (o->closed) {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    uzlib_compress(&o->comp, buf, size);
+    return size;
+}
+
+STATIC mp_uint_t compio_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    (void)arg;
+    if (request != MP_STREAM_CLOSE) {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    if (!o->closed) {
+        // The destination stream is left open so the caller can still use it
+        o->closed = true;
+        uzlib_compress_finish(&o->comp);
+        if (o->is_zlib) {
+            uzlib_zlib_write_trailer(&o->comp);
+        }
+        compio_flush(&o->comp.out);
+        if (o->alloc != NULL) {
+            m_del(byte, o->alloc, UZLIB_COMPRESS_WORKSPACE(o->comp.dict_size));
+            o->alloc = NULL;
+        }
+    }
+    return 0;
+}
+
+#if !MICROPY_ENABLE_DYNRUNTIME
+STATIC const mp_rom_map_elem_t compio_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mp_stream_close_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(compio_locals_dict, compio_locals_dict_table);
+#endif
+
+STATIC const mp_stream_p_t compio_stream_p = {
+    .write = compio_write,
+    .ioctl = compio_ioctl,
+};
+
+#if !MICROPY_ENABLE_DYNRUNTIME
+STATIC const mp_obj_type_t compio_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_CompIO,
+    .make_new = compio_make_new,
+    .protocol = &compio_stream_p,
+    .locals_dict = (void*)&compio_locals_dict,
+};
+#endif
+
+typedef struct _compress_state_t {
+    struct uzlib_comp comp;
+    vstr_t vstr; // used when compressing into a new bytes object
+} compress_state_t;
+
+STATIC void compress_grow(struct Outbuf *out) {
+    compress_state_t *st = (compress_state_t*)((byte*)out - offsetof(compress_state_t, comp.out));
+    st->vstr.len = out->outlen;
+    vstr_hint_size(&st->vstr, out->outsize / 2 + 16);
+    out->outbuf = (unsigned char*)st->vstr.buf;
+    out->outsize = st->vstr.alloc;
+}
+
+STATIC void compress_overflow(struct Outbuf *out) {
+    (void)out;
+    mp_raise_ValueError("buffer too small");
+}
+
+STATIC mp_obj_t mod_uzlib_compress(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_data, ARG_wbits, ARG_out, ARG_buf };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+        { MP_QSTR_, MP_ARG_INT, {.u_int = UZLIB_COMPRESS_DEFAULT_WBITS} },
+        { MP_QSTR_out, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+        { MP_QSTR_buf, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_data].u_obj, &bufinfo, MP_BUFFER_READ);
+
+    compress_state_t st;
+    memset(&st.comp.out, 0, sizeof(st.comp.out));
+    bool to_bytes = args[ARG_out].u_obj == mp_const_none;
+    if (to_bytes) {
+        // Text exports typically shrink to a third or so
+        vstr_init(&st.vstr, bufinfo.len / 2 + 16);
+        st.comp.out.outbuf = (unsigned char*)st.vstr.buf;
+        st.comp.out.outsize = st.vstr.alloc;
+        st.comp.out.flush = compress_grow;
+    } else {
+        mp_buffer_info_t outinfo;
+        mp_get_buffer_raise(args[ARG_out].u_obj, &outinfo, MP_BUFFER_WRITE);
+        st.comp.out.outbuf = outinfo.buf;
+        st.comp.out.outsize = outinfo.len;
+        st.comp.out.flush = compress_overflow;
+    }
+
+    mp_int_t wbits = args[ARG_wbits].u_int;
+    byte *alloc = compress_init(&st.comp, wbits, args[ARG_buf].u_obj);
+    if (wbits > 0) {
+        uzlib_zlib_write_header(&st.comp);
+    }
+    uzlib_compress(&st.comp, bufinfo.buf, bufinfo.len);
+    uzlib_compress_finish(&st.comp);
+    if (wbits > 0) {
+        uzlib_zlib_write_trailer(&st.comp);
+    }
+    if (alloc != NULL) {
+        m_del(byte, alloc, UZLIB_COMPRESS_WORKSPACE(st.comp.dict_size));
+    }
+
+    if (to_bytes) {
+        st.vstr.len = st.comp.out.outlen;
+        return mp_obj_new_str_from_vstr(&mp_type_bytes, &st.vstr);
+    }
+    return MP_OBJ_NEW_SMALL_INT(st.comp.out.outlen);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uzlib_compress_obj, 1, mod_uzlib_compress);
+
+#endif // MICROPY_PY_UZLIB_COMPRESS
+
 #if !MICROPY_ENABLE_DYNRUNTIME
 STATIC const mp_rom_map_elem_t mp_module_uzlib_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uzlib) },
     { MP_ROM_QSTR(MP_QSTR_decompress), MP_ROM_PTR(&mod_uzlib_decompress_obj) },
     { MP_ROM_QSTR(MP_QSTR_DecompIO), MP_ROM_PTR(&decompio_type) },
+    #if MICROPY_PY_UZLIB_COMPRESS
+    { MP_ROM_QSTR(MP_QSTR_compress), MP_ROM_PTR(&mod_uzlib_compress_obj) },
+    { MP_ROM_QSTR(MP_QSTR_CompIO), MP_ROM_PTR(&compio_type) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_uzlib_globals, mp_module_uzlib_globals_table);
@@ -228,5 +449,9 @@ const mp_obj_module_t mp_module_uzlib = {
 #include "uzlib/tinfgzip.c"
 #include "uzlib/adler32.c"
 #include "uzlib/crc32.c"
+#if MICROPY_PY_UZLIB_COMPRESS
+#include "uzlib/defl_static.c"
+#include "uzlib/lz77.c"
+#endif
 
 #endif // MICROPY_PY_UZLIB
@@ -0,0 +1,322 @@
+// Copyright 2021 Foundation Devices, Inc.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Lazily built DFA, used to decide in linear time whether a program
+// matches at all. It can't report submatches, so callers still run the
+// backtracking VM when it says yes, but a "no" (the common answer when
+// validating input) costs one table lookup per input byte, and patterns
+// that make the backtracker go exponential are rejected just as fast.
+//
+// A DFA state is the set of consumer instructions the VM could be at,
+// plus whether Match is reachable right now or only at end of input
+// (through Eol). States are created the first time a transition needs
+// them, and bytes that no instruction tells apart share a transition.
+
+#include "re1.5.h"
+
+enum {
+	MATCH_NOW = 1,
+	MATCH_AT_END = 2,
+};
+
+#define UNKNOWN (-1)
+
+static int
+instlen(const char *pc)
+{
+	switch(*pc) {
+	case Class:
+	case ClassNot:
+		return 2 + *(unsigned char*)(pc + 1) * 2;
+	case Char:
+	case NamedClass:
+	case Jmp:
+	case Split:
+	case RSplit:
+	case Save:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+static int
+accepts(const char *pc, char c)
+{
+	switch(*pc) {
+	case Char:
+		return pc[1] == c;
+	case Any:
+		return 1;
+	case Class:
+	case ClassNot:
+		return _re1_5_classmatch(pc + 1, &c);
+	case NamedClass:
+		return _re1_5_namedclassmatch(pc + 1, &c);
+	}
+	return 0;
+}
+
+static void
+addboundary(unsigned char *isbound, int b)
+{
+	isbound[b & 0xff] = 1;
+}
+
+// Group bytes that every instruction treats the same into one class.
+// All tests are on ranges, so it's enough to cut at every range edge.
+// Class ranges compare signed chars, hence the cut at 0x80.
+static void
+makeclasses(ByteProg *prog, DFA *dfa)
+{
+	unsigned char isbound[256];
+	const char *pc = prog->insts;
+	const char *end = prog->insts + prog->bytelen;
+	int b, i, cnt;
+
+	memset(isbound, 0, sizeof(isbound));
+	isbound[0] = 1;
+	isbound[0x80] = 1;
+	for(; pc < end; pc += instlen(pc)) {
+		switch(*pc) {
+		case Char:
+			addboundary(isbound, pc[1]);
+			addboundary(isbound, pc[1] + 1);
+			break;
+		case Class:
+		case ClassNot:
+			cnt = *(unsigned char*)(pc + 1);
+			for(i = 0; i < cnt; i++) {
+				addboundary(isbound, pc[2 + i * 2]);
+				addboundary(isbound, pc[3 + i * 2] + 1);
+			}
+			break;
+		case NamedClass:
+			addboundary(isbound, '\t');
+			addboundary(isbound, '\r' + 1);
+			addboundary(isbound, ' ');
+			addboundary(isbound, ' ' + 1);
+			addboundary(isbound, '0');
+			addboundary(isbound, '9' + 1);
+			addboundary(isbound, 'A');
+			addboundary(isbound, 'Z' + 1);
+			addboundary(isbound, '_');
+			addboundary(isbound, '_' + 1);
+			addboundary(isbound, 'a');
+			addboundary(isbound, 'z' + 1);
+			break;
+		}
+	}
+
+	dfa->nclasses = 0;
+	for(b = 0; b < 256; b++) {
+		if(isbound[b])
+			dfa->classrep[dfa->nclasses++] = b;
+		dfa->classmap[b] = dfa->nclasses - 1;
+	}
+}
+
+int
+re1_5_dfa_size(ByteProg *prog)
+{
+	const char *pc = prog->insts;
+	const char *end = prog->insts + prog->bytelen;
+	int nconsumers = 0;
+	DFA tmp;
+
+	if(prog->bytelen > RE1_5_DFA_MAX_CODE)
+		return -1;
+	for(; pc < end; pc += instlen(pc))
+		if(inst_is_consumer(*pc))
+			nconsumers++;
+	if(nconsumers > RE1_5_DFA_MAX_PCS)
+		return -1;
+
+	makeclasses(prog, &tmp);
+
+	return sizeof(DFA)
+		+ RE1_5_DFA_MAX_STATES * tmp.nclasses * sizeof(short)	// trans
+		+ RE1_5_DFA_MAX_STATES * (nconsumers + 1) * sizeof(short)	// npcs, pcs
+		+ (nconsumers + 1 + 2 * prog->bytelen) * sizeof(short)	// next, stack
+		+ RE1_5_DFA_MAX_STATES	// flags
+		+ prog->bytelen;	// mark
+}
+
+void
+re1_5_dfa_init(ByteProg *prog, DFA *dfa)
+{
+	const char *pc = prog->insts;
+	const char *end = prog->insts + prog->bytelen;
+	char *p;
+
+	dfa->maxpcs = 0;
+	for(; pc < end; pc += instlen(pc))
+		if(inst_is_consumer(*pc))
+			dfa->maxpcs++;
+	makeclasses(prog, dfa);
+	dfa->nstates = 0;
+	dfa->start[0] = UNKNOWN;
+	dfa->start[1] = UNKNOWN;
+
+	// Lay the tables out after the header, shorts first to keep them aligned
+	p = (char*)(dfa + 1);
+	dfa->trans = (short*)p;
+	p += RE1_5_DFA_MAX_STATES * dfa->nclasses * sizeof(short);
+	dfa->npcs = (short*)p;
+	p += RE1_5_DFA_MAX_STATES * sizeof(short);
+	dfa->pcs = (short*)p;
+	p += RE1_5_DFA_MAX_STATES * dfa->maxpcs * sizeof(short);
+	dfa->next = (short*)p;
+	p += (dfa->maxpcs + 1) * sizeof(short);
+	dfa->stack = (short*)p;
+	p += 2 * prog->bytelen * sizeof(short);
+	dfa->flags = (unsigned char*)p;
+	p += RE1_5_DFA_MAX_STATES;
+	dfa->mark = (unsigned char*)p;
+	memset(dfa->mark, 0, prog->bytelen);
+}
+
+// Follow the non-consuming instructions from the pcs in dfa->next and
+// return the resulting state, adding it if it's new. Returns UNKNOWN if
+// there's no room for another state.
+static int
+closure(ByteProg *prog, DFA *dfa, int nnext, int atbegin)
+{
+	const char *code = prog->insts;
+	int sp = 0;
+	int flags = 0;
+	int n, s, i, pc, mode, off;
+	short *pcs;
+
+	// mark bit 0: reached, bit 1: reached past an Eol, bit 2: in the set
+	for(i = 0; i < nnext; i++) {
+		pc = dfa->next[i];
+		if(!(dfa->mark[pc] & 1)) {
+			dfa->mark[pc] |= 1;
+			dfa->stack[sp++] = pc << 1;
+		}
+	}
+
+	while(sp > 0) {
+		pc = dfa->stack[--sp];
+		mode = pc & 1;
+		pc >>= 1;
+
+		int to[2];
+		int nto = 0;
+		switch(code[pc]) {
+		case Match:
+			flags |= mode ? MATCH_AT_END : MATCH_NOW;
+			break;
+		case Jmp:
+			off = (signed char)code[pc + 1];
+			to[nto++] = pc + 2 + off;
+			break;
+		case Split:
+		case RSplit:
+			off = (signed char)code[pc + 1];
+			to[nto++] = pc + 2;
+			to[nto++] = pc + 2 + off;
+			break;
+		case Save:
+			to[nto++] = pc + 2;
+			break;
+		case Bol:
+			if(atbegin)
+				to[nto++] = pc + 1;
+			break;
+		case Eol:
+			mode = 1;
+			to[nto++] = pc + 1;
+			break;
+		default:
+			// A consumer; past an Eol there's no input left for it
+			if(!mode)
+				dfa->mark[pc] |= 4;
+			break;
+		}
+		for(i = 0; i < nto; i++) {
+			if(!(dfa->mark[to[i]] & (1 << mode))) {
+				dfa->mark[to[i]] |= 1 << mode;
+				dfa->stack[sp++] = (to[i] << 1) | mode;
+			}
+		}
+	}
+
+	// Collect the set in pc order, so equal sets compare equal
+	n = 0;
+	for(pc = 0; pc < prog->bytelen; pc++) {
+		if(dfa->mark[pc] & 4)
+			dfa->next[n++] = pc;
+		dfa->mark[pc] = 0;
+	}
+
+	for(s = 0; s < dfa->nstates; s++) {
+		if(dfa->npcs[s] == n && dfa->flags[s] == flags
+		   && memcmp(dfa->pcs + s * dfa->maxpcs, dfa->next, n * sizeof(short)) == 0)
+			return s;
+	}
+	if(dfa->nstates == RE1_5_DFA_MAX_STATES)
+		return UNKNOWN;
+
+	s = dfa->nstates++;
+	pcs = dfa->pcs + s * dfa->maxpcs;
+	memcpy(pcs, dfa->next, n * sizeof(short));
+	dfa->npcs[s] = n;
+	dfa->flags[s] = flags;
+	for(i = 0; i < dfa->nclasses; i++)
+		dfa->trans[s * dfa->nclasses + i] = UNKNOWN;
+	return s;
+}
+
+static int
+step(ByteProg *prog, DFA *dfa, int s, int cls)
+{
+	const char *code = prog->insts;
+	short *pcs = dfa->pcs + s * dfa->maxpcs;
+	char c = dfa->classrep[cls];
+	int n = 0;
+	int i;
+
+	for(i = 0; i < dfa->npcs[s]; i++) {
+		if(accepts(code + pcs[i], c))
+			dfa->next[n++] = pcs[i] + instlen(code + pcs[i]);
+	}
+	return closure(prog, dfa, n, 0);
+}
+
+// Returns 1 if the program matches the input, 0 if it doesn't, and -1 if
+// the DFA needed more than RE1_5_DFA_MAX_STATES states to find out.
+int
+re1_5_dfa_match(ByteProg *prog, DFA *dfa, Subject *input, int is_anchored)
+{
+	const char *sp = input->begin;
+	int s, t, cls;
+
+	s = dfa->start[is_anchored != 0];
+	if(s == UNKNOWN) {
+		dfa->next[0] = HANDLE_ANCHORED(prog->insts, is_anchored) - prog->insts;
+		s = closure(prog, dfa, 1, 1);
+		if(s == UNKNOWN)
+			return -1;
+		dfa->start[is_anchored != 0] = s;
+	}
+
+	for(; sp < input->end; sp++) {
+		if(dfa->flags[s] & MATCH_NOW)
+			return 1;
+		if(dfa->npcs[s] == 0)
+			return 0;
+		cls = dfa->classmap[*(unsigned char*)sp];
+		t = dfa->trans[s * dfa->nclasses + cls];
+		if(t == UNKNOWN) {
+			t = step(prog, dfa, s, cls);
+			if(t == UNKNOWN)
+				return -1;
+			dfa->trans[s * dfa->nclasses + cls] = t;
+		}
+		s = t;
+	}
+	return (dfa->flags[s] & (MATCH_NOW | MATCH_AT_END)) != 0;
+}
@@ -144,6 +144,39 @@ int re1_5_recursiveloopprog(ByteProg*, Subject*, const char**, int, int);
 int re1_5_recursiveprog(ByteProg*, Subject*, const char**, int, int);
 int re1_5_thompsonvm(ByteProg*, Subject*, const char**, int, int);
 
+typedef struct DFA DFA;
+
+// Limits for the lazy DFA; programs over the code or pc limits don't get one
+#ifndef RE1_5_DFA_MAX_STATES
+#define RE1_5_DFA_MAX_STATES 32
+#endif
+#ifndef RE1_5_DFA_MAX_CODE
+#define RE1_5_DFA_MAX_CODE 1024
+#endif
+#ifndef RE1_5_DFA_MAX_PCS
+#define RE1_5_DFA_MAX_PCS 64
+#endif
+
+struct DFA {
+	int nclasses;
+	int nstates;
+	int maxpcs;
+	short start[2];	// start state, by is_anchored
+	unsigned char classmap[256];	// byte -> class
+	unsigned char classrep[256];	// class -> a byte in it
+	short *trans;	// [state][class] -> state
+	short *npcs;	// [state]
+	short *pcs;	// [state][maxpcs], consumer instructions in the state
+	short *next;	// scratch
+	short *stack;	// scratch
+	unsigned char *flags;	// [state]
+	unsigned char *mark;	// scratch, one per code byte
+};
+
+int re1_5_dfa_size(ByteProg*);
+void re1_5_dfa_init(ByteProg*, DFA*);
+int re1_5_dfa_match(ByteProg*, DFA*, Subject*, int);
+
 int re1_5_sizecode(const char *re);
 int re1_5_compilecode(ByteProg *prog, const char *re);
 void re1_5_dumpcode(ByteProg *prog);
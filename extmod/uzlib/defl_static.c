@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) uzlib authors
+ *
+ * This software is provided 'as-is', without any express
+ * or implied warranty.  In no event will the authors be
+ * held liable for any damages arising from the use of
+ * this software.
+ *
+ * Permission is granted to anyone to use this software
+ * for any purpose, including commercial applications,
+ * and to alter it and redistribute it freely, subject to
+ * the following restrictions:
+ *
+ * 1. The origin of this software must not be
+ *    misrepresented; you must not claim that you
+ *    wrote the original software. If you use this
+ *    software in a product, an acknowledgment in
+ *    the product documentation would be appreciated
+ *    but is not required.
+ *
+ * 2. Altered source versions must be plainly marked
+ *    as such, and must not be misrepresented as
+ *    being the original software.
+ *
+ * 3. This notice may not be removed or altered from
+ *    any source distribution.
+ */
+
+
+/* Static Huffman (fixed code) DEFLATE encoder, after the one in PuTTY and
+   upstream uzlib. Bits are collected LSB first and written to out->outbuf,
+   which is handed to out->flush() whenever it fills up. */
+
+#include "uzlib.h"
+
+/* Length codes 257..285: base length and number of extra bits */
+static const uint16_t defl_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t defl_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/* Distance codes 0..29: base distance and number of extra bits */
+static const uint16_t defl_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t defl_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Huffman codes are sent MSB first, everything else LSB first */
+static unsigned long defl_mirror(unsigned long code, int nbits)
+{
+    unsigned long r = 0;
+    while (nbits--) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+void outbits(struct Outbuf *out, unsigned long bits, int nbits)
+{
+    out->outbits |= bits << out->noutbits;
+    out->noutbits += nbits;
+    while (out->noutbits >= 8) {
+        if (out->outlen >= out->outsize) {
+            out->flush(out);
+        }
+        out->outbuf[out->outlen++] = (unsigned char)(out->outbits & 0xff);
+        out->outbits >>= 8;
+        out->noutbits -= 8;
+    }
+}
+
+static void defl_outcode(struct Outbuf *out, unsigned int sym)
+{
+    if (sym <= 143) {
+        outbits(out, defl_mirror(0x30 + sym, 8), 8);
+    } else if (sym <= 255) {
+        outbits(out, defl_mirror(0x190 + sym - 144, 9), 9);
+    } else if (sym <= 279) {
+        outbits(out, defl_mirror(sym - 256, 7), 7);
+    } else {
+        outbits(out, defl_mirror(0xc0 + sym - 280, 8), 8);
+    }
+}
+
+void zlib_start_block(struct Outbuf *out)
+{
+    outbits(out, 1, 1); /* Final block */
+    outbits(out, 1, 2); /* Static huffman block */
+}
+
+void zlib_finish_block(struct Outbuf *out)
+{
+    defl_outcode(out, 256); /* End of block */
+    /* Pad to a byte boundary */
+    if (out->noutbits > 0) {
+        outbits(out, 0, 8 - out->noutbits);
+    }
+}
+
+void zlib_literal(struct Outbuf *out, unsigned char c)
+{
+    defl_outcode(out, c);
+}
+
+/* distance is 1..32768, len is 3..258 */
+void zlib_match(struct Outbuf *out, int distance, int len)
+{
+    int i = 28;
+    while (defl_length_base[i] > len) {
+        i--;
+    }
+    defl_outcode(out, 257 + i);
+    outbits(out, len - defl_length_base[i], defl_length_extra[i]);
+
+    i = 29;
+    while (defl_dist_base[i] > distance) {
+        i--;
+    }
+    outbits(out, defl_mirror(i, 5), 5);
+    outbits(out, distance - defl_dist_base[i], defl_dist_extra[i]);
+}
@@ -36,6 +36,9 @@ struct Outbuf {
     unsigned long outbits;
     int noutbits;
     int comp_disabled;
+    /* Called when outbuf is full. It must consume the data (e.g. write it
+       out or grow the buffer) and leave room for at least one more byte. */
+    void (*flush)(struct Outbuf *out);
 };
 
 void outbits(struct Outbuf *out, unsigned long bits, int nbits);
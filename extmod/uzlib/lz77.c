@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) uzlib authors
+ *
+ * This software is provided 'as-is', without any express
+ * or implied warranty.  In no event will the authors be
+ * held liable for any damages arising from the use of
+ * this software.
+ *
+ * Permission is granted to anyone to use this software
+ * for any purpose, including commercial applications,
+ * and to alter it and redistribute it freely, subject to
+ * the following restrictions:
+ *
+ * 1. The origin of this software must not be
+ *    misrepresented; you must not claim that you
+ *    wrote the original software. If you use this
+ *    software in a product, an acknowledgment in
+ *    the product documentation would be appreciated
+ *    but is not required.
+ *
+ * 2. Altered source versions must be plainly marked
+ *    as such, and must not be misrepresented as
+ *    being the original software.
+ *
+ * 3. This notice may not be removed or altered from
+ *    any source distribution.
+ */
+
+
+/* LZ77 compressor with hash chains over a bounded sliding window. Input
+   can be fed in pieces of any size; memory use is fixed by dict_size and
+   hash_bits and all buffers are supplied by the caller. Matches are found
+   greedily and sent through the static Huffman encoder in defl_static.c. */
+
+#include <string.h>
+#include "uzlib.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+static unsigned int lz77_hash(const struct uzlib_comp *c, const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - c->hash_bits);
+}
+
+static void lz77_insert(struct uzlib_comp *c, unsigned int pos)
+{
+    unsigned int h = lz77_hash(c, c->window + pos);
+    c->hash_prev[pos & (c->dict_size - 1)] = c->hash_head[h];
+    c->hash_head[h] = pos;
+}
+
+/* Drop the oldest dict_size bytes of the window. Only called once win_pos
+   has moved past them, so no history that can still be matched is lost. */
+static void lz77_slide(struct uzlib_comp *c)
+{
+    unsigned int d = c->dict_size;
+    unsigned int i;
+
+    memmove(c->window, c->window + d, c->win_end - d);
+    c->win_pos -= d;
+    c->win_end -= d;
+    for (i = 0; i < (1u << c->hash_bits); i++) {
+        uint16_t v = c->hash_head[i];
+        c->hash_head[i] = (v != UZLIB_HASH_NIL && v >= d) ? v - d : UZLIB_HASH_NIL;
+    }
+    for (i = 0; i < d; i++) {
+        uint16_t v = c->hash_prev[i];
+        c->hash_prev[i] = (v != UZLIB_HASH_NIL && v >= d) ? v - d : UZLIB_HASH_NIL;
+    }
+}
+
+/* Encode the lookahead. Unless final, stop while a full-length match could
+   still run past the data that has arrived so far. */
+static void lz77_encode(struct uzlib_comp *c, int final)
+{
+    for (;;) {
+        unsigned int pos = c->win_pos;
+        unsigned int avail = c->win_end - pos;
+        unsigned int best_len = 0, best_dist = 0;
+
+        if (avail == 0 || (!final && avail < MAX_MATCH)) {
+            break;
+        }
+
+        if (avail >= MIN_MATCH) {
+            const uint8_t *cur = c->window + pos;
+            unsigned int max_len = avail < MAX_MATCH ? avail : MAX_MATCH;
+            unsigned int limit = pos > c->dict_size ? pos - c->dict_size : 0;
+            unsigned int chain = c->max_chain;
+            unsigned int cand = c->hash_head[lz77_hash(c, cur)];
+
+            while (cand < pos && cand >= limit && chain-- > 0) {
+                const uint8_t *p = c->window + cand;
+                /* Cheap reject: a longer match must differ from the best so
+                   far no earlier than at best_len */
+                if (p[best_len] == cur[best_len]) {
+                    unsigned int len = 0;
+                    while (len < max_len && p[len] == cur[len]) {
+                        len++;
+                    }
+                    if (len > best_len) {
+                        best_len = len;
+                        best_dist = pos - cand;
+                        if (len == max_len) {
+                            break;
+                        }
+                    }
+                }
+                unsigned int next = c->hash_prev[cand & (c->dict_size - 1)];
+                /* A slot reused by a newer position ends the chain */
+                if (next >= cand) {
+                    break;
+                }
+                cand = next;
+            }
+            lz77_insert(c, pos);
+        }
+
+        if (best_len >= MIN_MATCH) {
+            unsigned int i;
+            zlib_match(&c->out, best_dist, best_len);
+            for (i = 1; i < best_len; i++) {
+                if (c->win_end - (pos + i) >= MIN_MATCH) {
+                    lz77_insert(c, pos + i);
+                }
+            }
+            c->win_pos = pos + best_len;
+        } else {
+            zlib_literal(&c->out, c->window[pos]);
+            c->win_pos = pos + 1;
+        }
+    }
+}
+
+void uzlib_compress_init(struct uzlib_comp *c, unsigned int dict_size, unsigned int hash_bits,
+    uint8_t *window, uint16_t *hash_head, uint16_t *hash_prev)
+{
+    c->window = window;
+    c->win_pos = 0;
+    c->win_end = 0;
+    c->hash_head = hash_head;
+    c->hash_prev = hash_prev;
+    c->hash_bits = hash_bits;
+    c->dict_size = dict_size;
+    c->max_chain = UZLIB_CONF_MAX_CHAIN;
+    c->checksum = 1;
+    c->checksum_type = TINF_CHKSUM_NONE;
+    memset(hash_head, 0xff, sizeof(uint16_t) << hash_bits);
+    memset(hash_prev, 0xff, sizeof(uint16_t) * dict_size);
+    c->started = 0;
+}
+
+/* The block header goes out with the first data, after any zlib header */
+static void lz77_start(struct uzlib_comp *c)
+{
+    if (!c->started) {
+        zlib_start_block(&c->out);
+        c->started = 1;
+    }
+}
+
+void uzlib_compress(struct uzlib_comp *c, const uint8_t *src, unsigned slen)
+{
+    if (c->checksum_type == TINF_CHKSUM_ADLER) {
+        c->checksum = uzlib_adler32(src, slen, c->checksum);
+    }
+    lz77_start(c);
+    while (slen > 0) {
+        unsigned int n;
+        if (c->win_end == 2 * c->dict_size) {
+            lz77_slide(c);
+        }
+        n = 2 * c->dict_size - c->win_end;
+        if (n > slen) {
+            n = slen;
+        }
+        memcpy(c->window + c->win_end, src, n);
+        c->win_end += n;
+        src += n;
+        slen -= n;
+        lz77_encode(c, 0);
+    }
+}
+
+void uzlib_compress_finish(struct uzlib_comp *c)
+{
+    lz77_start(c);
+    lz77_encode(c, 1);
+    zlib_finish_block(&c->out);
+}
+
+void uzlib_zlib_write_header(struct uzlib_comp *c)
+{
+    unsigned int wbits = 8;
+    unsigned int cmf, flg;
+    while ((1u << wbits) < c->dict_size) {
+        wbits++;
+    }
+    /* Deflate with the window size, no preset dictionary, check bits
+       making the header a multiple of 31 */
+    cmf = ((wbits - 8) << 4) | 8;
+    flg = 31 - ((cmf << 8) % 31);
+    outbits(&c->out, cmf, 8);
+    outbits(&c->out, flg, 8);
+    c->checksum_type = TINF_CHKSUM_ADLER;
+    c->checksum = 1;
+}
+
+void uzlib_zlib_write_trailer(struct uzlib_comp *c)
+{
+    int i;
+    for (i = 24; i >= 0; i -= 8) {
+        outbits(&c->out, (c->checksum >> i) & 0xff, 8);
+    }
+}
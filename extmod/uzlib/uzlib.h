@@ -143,17 +143,48 @@ int TINFCC uzlib_gzip_parse_header(TINF_DATA *d);
 
 /* Compression API */
 
-typedef const uint8_t *uzlib_hash_entry_t;
+/* Marks an empty slot in the hash tables */
+#define UZLIB_HASH_NIL 0xffff
 
 struct uzlib_comp {
     struct Outbuf out;
 
-    uzlib_hash_entry_t *hash_table;
+    /* Sliding window of 2 * dict_size bytes: up to dict_size bytes of
+       history before win_pos, and the lookahead from win_pos to win_end */
+    uint8_t *window;
+    unsigned int win_pos;
+    unsigned int win_end;
+
+    /* Hash chains: hash_head maps a hash of 3 bytes to the latest window
+       position with that hash, hash_prev maps a position (modulo dict_size)
+       to the previous one */
+    uint16_t *hash_head;
+    uint16_t *hash_prev;
     unsigned int hash_bits;
     unsigned int dict_size;
+    /* How many chain entries to try per match */
+    unsigned int max_chain;
+
+    /* Accumulating checksum of the input */
+    uint32_t checksum;
+    char checksum_type;
+    char started;
 };
 
+/* dict_size must be a power of 2 between 512 and 32768. window must hold
+   2 * dict_size bytes, hash_head 1 << hash_bits entries and hash_prev
+   dict_size entries. c->out must be set up by the caller. A zlib header
+   may be written after this and before any data. */
+void TINFCC uzlib_compress_init(struct uzlib_comp *c, unsigned int dict_size, unsigned int hash_bits,
+    uint8_t *window, uint16_t *hash_head, uint16_t *hash_prev);
+/* Feed more input. Output is produced as the lookahead fills up. */
 void TINFCC uzlib_compress(struct uzlib_comp *c, const uint8_t *src, unsigned slen);
+/* Compress the remaining lookahead and end the block */
+void TINFCC uzlib_compress_finish(struct uzlib_comp *c);
+
+/* Write a zlib header/trailer around the deflate stream */
+void TINFCC uzlib_zlib_write_header(struct uzlib_comp *c);
+void TINFCC uzlib_zlib_write_trailer(struct uzlib_comp *c);
 
 /* Checksum API */
 
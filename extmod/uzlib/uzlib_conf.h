@@ -19,4 +19,10 @@
 #define UZLIB_CONF_PARANOID_CHECKS 0
 #endif
 
+#ifndef UZLIB_CONF_MAX_CHAIN
+/* Default number of hash chain entries the compressor tries when looking
+   for a match. Higher values compress better but slower. */
+#define UZLIB_CONF_MAX_CHAIN 32
+#endif
+
 #endif /* UZLIB_CONF_H_INCLUDED */
@@ -41,6 +41,7 @@
 
 // Command line options, with their defaults
 STATIC uint emit_opt = MP_EMIT_OPT_NONE;
+STATIC bool opt_bytecode = false;
 mp_uint_t mp_verbose_flag = 0;
 
 // Heap size of GC heap (if enabled)
@@ -126,6 +127,12 @@ STATIC int usage(char **argv) {
 "  heapsize=<n> -- set the heap size for the GC (default %ld)\n"
 , heap_size);
     impl_opts_cnt++;
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+    printf(
+"  opt-bytecode -- run the bytecode optimiser\n"
+);
+    impl_opts_cnt++;
+#endif
 
     if (impl_opts_cnt == 0) {
         printf("  (none)\n");
@@ -150,6 +157,10 @@ STATIC void pre_process_options(int argc, char **argv) {
                 } else if (strcmp(argv[a + 1], "emit=viper") == 0) {
                     emit_opt = MP_EMIT_OPT_VIPER;
                 #endif
+                #if MICROPY_COMP_OPTIMISE_BYTECODE
+                } else if (strcmp(argv[a + 1], "opt-bytecode") == 0) {
+                    opt_bytecode = true;
+                #endif
                 } else if (strncmp(argv[a + 1], "heapsize=", sizeof("heapsize=") - 1) == 0) {
                     char *end;
                     heap_size = strtol(argv[a + 1] + sizeof("heapsize=") - 1, &end, 0);
@@ -203,6 +214,12 @@ MP_NOINLINE int main_(int argc, char **argv) {
     (void)emit_opt;
     #endif
 
+    #if MICROPY_COMP_OPTIMISE_BYTECODE
+    MP_STATE_VM(mp_optimise_bytecode) = opt_bytecode;
+    #else
+    (void)opt_bytecode;
+    #endif
+
     // set default compiler configuration
     mp_dynamic_compiler.small_int_bits = 31;
     mp_dynamic_compiler.opt_cache_map_lookup_in_bytecode = 0;
@@ -3,6 +3,12 @@
 //
 // Copyright 2020 - Foundation Devices Inc.
 //
+// ADC2 scans the noise and power monitor inputs in the background: TIM15 triggers each scan, DMA
+// writes them to a circular buffer, and adc_service.c filters each half of the buffer as it
+// completes and queues the noise samples. ADC3 converts the ALS when the service asks for it, with
+// 32x oversampling, and completes in its interrupt. The readers below return the latest values
+// without waiting for a conversion.
+//
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,37 +16,97 @@
 
 #include "stm32h7xx_hal.h"
 
-#include "adc.h"
+#include "dma.h"
 
-#define MAX_ADC_16BIT 65535
-#define REF_VOLTAGE_MV 3000
-#define MAX_SAMPLES_CNT 0xFFFF
+#include "adc.h"
+#include "adc_service.h"
 
 #define MILLIVOLTS_PER_REVISION 500
 #define PWRMON_I_SENSE_RESISTOR 5
 
 /*
- * When doing single samples you cannot rely on
- * the value being exact, so adding a small offset
- * to the computed milli-volts resolves that issue.
+ * How long a reader waits for the first samples after
+ * boot, or for noise samples once the ring is empty.
  */
-#define BOARD_REV_MV_OFFSET 20
+#define ADC_WAIT_MS 500
 
-/*
- * The number of samples to collect for the average
- * Current bounces around a lot so take more samples
- * and use an average.
- * Voltage may not be as bad so take fewer samples
- */
-#define MAX_I_SAMPLES 20
-#define MAX_V_SAMPLES 4
+#define SCAN_HALF_LEN (ADC_SCANS_PER_HALF * ADC_SCAN_CHANNELS)
 
 static ADC_HandleTypeDef hadc3;
 static ADC_HandleTypeDef hadc2;
+static DMA_HandleTypeDef hdma_adc2;
+static TIM_HandleTypeDef htim15;
+
+static adc_service_t service;
+
+/*
+ * Written by DMA, so it's in AXI SRAM rather than the TCMs, and each half
+ * fills whole cache lines so it can be invalidated on its own.
+ */
+static uint16_t scan_buf[2 * SCAN_HALF_LEN] __attribute__((aligned(32)));
+_Static_assert((SCAN_HALF_LEN * sizeof(uint16_t)) % 32 == 0, "Half of scan_buf must be whole cache lines");
+
+/* ADC2 channel for each position in a scan */
+static const uint32_t scan_channels[ADC_SCAN_CHANNELS] = {
+    [ADC_SCAN_NOISE1] = ADC_CHANNEL_11,
+    [ADC_SCAN_NOISE2] = ADC_CHANNEL_10,
+    [ADC_SCAN_PWRMON_I] = ADC_CHANNEL_8,
+    [ADC_SCAN_PWRMON_V] = ADC_CHANNEL_4,
+};
+
+static const uint32_t scan_ranks[ADC_SCAN_CHANNELS] = {
+    ADC_REGULAR_RANK_1, ADC_REGULAR_RANK_2, ADC_REGULAR_RANK_3, ADC_REGULAR_RANK_4,
+};
+
+/* Set while adc_read_boardrev() has ADC3 on the board revision channel */
+static volatile bool als_paused;
+
+static uint32_t scan_timer_prescaler(void)
+{
+    /* TIM15 is on APB2, and runs at twice PCLK2 when APB2 is divided down */
+    uint32_t freq = HAL_RCC_GetPCLK2Freq();
+    if (RCC->D2CFGR & RCC_D2CFGR_D2PPRE2)
+        freq *= 2;
+
+    /* Count at 1 MHz */
+    return freq / 1000000 - 1;
+}
+
+static uint32_t scan_timer_period(bool fast)
+{
+    return 1000000 / (fast ? ADC_FAST_HZ : ADC_SLOW_HZ) - 1;
+}
+
+static void scan_timer_init(void)
+{
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+    __HAL_RCC_TIM15_CLK_ENABLE();
+
+    htim15.Instance = TIM15;
+    htim15.Init.Prescaler = scan_timer_prescaler();
+    htim15.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim15.Init.Period = scan_timer_period(false);
+    htim15.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim15.Init.RepetitionCounter = 0;
+    /* The rate is changed from the DMA interrupt, so let the current period finish first */
+    htim15.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    HAL_TIM_Base_Init(&htim15);
+
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    HAL_TIM_ConfigClockSource(&htim15, &sClockSourceConfig);
+
+    /* Each update starts an ADC2 scan */
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    HAL_TIMEx_MasterConfigSynchronization(&htim15, &sMasterConfig);
+}
 
 static HAL_StatusTypeDef adc2_init(void)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
+    ADC_ChannelConfTypeDef sConfig = {0};
     HAL_StatusTypeDef rc;
 
     hadc2.Instance = ADC2;
@@ -72,28 +138,25 @@ static HAL_StatusTypeDef adc2_init(void)
     hadc2.Init.ClockPrescaler = ADC_CLOCK_ASYNC_DIV4; // ADC_CLOCK_ASYNC_DIV1
 
     hadc2.Init.Resolution = ADC_RESOLUTION_16B;
-    hadc2.Init.ScanConvMode = ADC_SCAN_DISABLE;  // Needs to be ENABLE it processing more than 1 channel
-    hadc2.Init.EOCSelection = ADC_EOC_SINGLE_CONV; // ADC_EOC_SEQ_CONV If doing more than one channel
-    hadc2.Init.LowPowerAutoWait = ENABLE; // Says to use this with Polling was DISABLE;
-    hadc2.Init.ContinuousConvMode = ENABLE;
-    hadc2.Init.NbrOfConversion = 1; // Number of ranks to be converted within regular group sequencer
-    hadc2.Init.DiscontinuousConvMode = DISABLE;  // Cannot be used if continuous mode is enabled.
+    hadc2.Init.ScanConvMode = ADC_SCAN_ENABLE;
+    hadc2.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+    hadc2.Init.LowPowerAutoWait = DISABLE; // Can't be used with DMA
+    hadc2.Init.ContinuousConvMode = DISABLE; // One scan per TIM15 update
+    hadc2.Init.NbrOfConversion = ADC_SCAN_CHANNELS;
+    hadc2.Init.DiscontinuousConvMode = DISABLE;
     hadc2.Init.NbrOfDiscConversion = 1;
-    hadc2.Init.ExternalTrigConv = ADC_SOFTWARE_START; // NOTE: This is common to ALL ADC instances..
-    hadc2.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-    hadc2.Init.ConversionDataManagement = ADC_CONVERSIONDATA_DR; // Can specify DMA for management of converted data
-    hadc2.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN; // ADC_OVR_DATA_PRESERVED
+    hadc2.Init.ExternalTrigConv = ADC_EXTERNALTRIG_T15_TRGO;
+    hadc2.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    hadc2.Init.ConversionDataManagement = ADC_CONVERSIONDATA_DMA_CIRCULAR;
+    hadc2.Init.Overrun = ADC_OVR_DATA_PRESERVED;
     hadc2.Init.LeftBitShift = ADC_LEFTBITSHIFT_NONE;
 
     /*
-     * Perform oversampling to read multiple samples
-     * and compute the average in HW.
+     * No oversampling: averaging the noise inputs would
+     * throw away the entropy. The power monitor inputs are
+     * filtered in software instead.
      */
-    hadc3.Init.OversamplingMode = ENABLE;
-    hadc3.Init.Oversampling.Ratio = 0x20; /* Bit for 32x oversampling */
-    hadc3.Init.Oversampling.RightBitShift = ADC_RIGHTBITSHIFT_5;
-    hadc3.Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
-    hadc3.Init.Oversampling.OversamplingStopReset = ADC_REGOVERSAMPLING_CONTINUED_MODE;
+    hadc2.Init.OversamplingMode = DISABLE;
 
     rc = HAL_ADC_Init(&hadc2);
     if (rc != HAL_OK)
@@ -102,20 +165,45 @@ static HAL_StatusTypeDef adc2_init(void)
         return rc;
     }
 
+    sConfig.SamplingTime =  ADC_SAMPLETIME_8CYCLES_5;
+    sConfig.SingleDiff = ADC_SINGLE_ENDED;
+    sConfig.OffsetNumber = ADC_OFFSET_NONE;
+    sConfig.Offset = 0;
+    sConfig.OffsetRightShift = DISABLE; /* No Right Offset Shift */
+    sConfig.OffsetSignedSaturation = DISABLE; /* No Signed Saturation */
+    for (int i = 0; i < ADC_SCAN_CHANNELS; i++) {
+        sConfig.Channel = scan_channels[i];
+        sConfig.Rank = scan_ranks[i];
+        rc = HAL_ADC_ConfigChannel(&hadc2, &sConfig);
+        if (rc != HAL_OK)
+        {
+            printf("Failed to config ADC2 rank %d\n", i + 1);
+            return rc;
+        }
+    }
+
     /* Run the ADC calibration in single-ended mode */
     rc = HAL_ADCEx_Calibration_Start(&hadc2, ADC_CALIB_OFFSET, ADC_SINGLE_ENDED);
     if (rc != HAL_OK)
     {
-        printf("ADC3 calibration failed\n");
+        printf("ADC2 calibration failed\n");
         return rc;
     }
 
+    dma_init(&hdma_adc2, &dma_ADC_2, DMA_PERIPH_TO_MEMORY, &hadc2);
+    hadc2.DMA_Handle = &hdma_adc2;
+
+    /* Reports overruns, which stop the DMA */
+    HAL_NVIC_SetPriority(ADC_IRQn, 10, 0);
+    HAL_NVIC_EnableIRQ(ADC_IRQn);
+
     return HAL_OK;
 }
 
 HAL_StatusTypeDef adc3_init(void)
 {
     HAL_StatusTypeDef rc;
+    ADC_ChannelConfTypeDef sConfig = {0};
 
     hadc3.Instance = ADC3;
     rc = HAL_ADC_DeInit(&hadc3);
@@ -140,7 +228,7 @@ HAL_StatusTypeDef adc3_init(void)
     hadc3.Init.ScanConvMode = ADC_SCAN_DISABLE;
     hadc3.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
     hadc3.Init.LowPowerAutoWait = DISABLE;
-    hadc3.Init.ContinuousConvMode = ENABLE;  // DIS
+    hadc3.Init.ContinuousConvMode = DISABLE; // One conversion per start
     hadc3.Init.NbrOfConversion = 1;
     hadc3.Init.DiscontinuousConvMode = DISABLE;
     hadc3.Init.ExternalTrigConv = ADC_SOFTWARE_START;
@@ -166,9 +254,109 @@ HAL_StatusTypeDef adc3_init(void)
         return rc;
     }
 
+    /* Left on the ALS, except while the board revision is read */
+    sConfig.Channel = ADC_CHANNEL_0;
+    sConfig.Rank = ADC_REGULAR_RANK_1;
+    sConfig.SamplingTime = ADC_SAMPLETIME_8CYCLES_5;
+    sConfig.SingleDiff = ADC_SINGLE_ENDED;
+    sConfig.OffsetNumber = ADC_OFFSET_NONE;
+    sConfig.Offset = 0;
+    rc = HAL_ADC_ConfigChannel(&hadc3, &sConfig);
+    if (rc != HAL_OK)
+    {
+        printf("Failed to config ADC3 channel\n");
+        return rc;
+    }
+
+    /* Run the ADC calibration in single-ended mode */
+    rc = HAL_ADCEx_Calibration_Start(&hadc3, ADC_CALIB_OFFSET, ADC_SINGLE_ENDED);
+    if (rc != HAL_OK)
+    {
+        printf("ADC3 calibration failed\n");
+        return rc;
+    }
+
+    HAL_NVIC_SetPriority(ADC3_IRQn, 10, 0);
+    HAL_NVIC_EnableIRQ(ADC3_IRQn);
+
     return HAL_OK;
 }
 
+static void scan_half_done(uint16_t *half)
+{
+    uint32_t events;
+
+    /* The DMA wrote to memory behind the cache */
+    SCB_InvalidateDCache_by_Addr((uint32_t *)half, SCAN_HALF_LEN * sizeof(uint16_t));
+
+    events = adc_service_process(&service, half, ADC_SCANS_PER_HALF);
+
+    if (events & ADC_EVENT_RATE_CHANGED) {
+        __HAL_TIM_SET_AUTORELOAD(&htim15, scan_timer_period(service.fast));
+    }
+
+    if ((events & ADC_EVENT_START_ALS) && !als_paused &&
+        !(HAL_ADC_GetState(&hadc3) & HAL_ADC_STATE_REG_BUSY)) {
+        HAL_ADC_Start_IT(&hadc3);
+    }
+}
+
+static HAL_StatusTypeDef scan_start(void)
+{
+    return HAL_ADC_Start_DMA(&hadc2, (uint32_t *)scan_buf, sizeof(scan_buf) / sizeof(scan_buf[0]));
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc == &hadc2) {
+        scan_half_done(&scan_buf[0]);
+    }
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc == &hadc2) {
+        scan_half_done(&scan_buf[SCAN_HALF_LEN]);
+    } else if (hadc == &hadc3) {
+        adc_filter_update(&service.als, HAL_ADC_GetValue(&hadc3));
+    }
+}
+
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc)
+{
+    /* An overrun or DMA error stops the scans, so start them again */
+    if (hadc == &hadc2) {
+        HAL_ADC_Stop_DMA(&hadc2);
+        scan_start();
+    }
+}
+
+void ADC_IRQHandler(void)
+{
+    HAL_ADC_IRQHandler(&hadc2);
+}
+
+void ADC3_IRQHandler(void)
+{
+    HAL_ADC_IRQHandler(&hadc3);
+}
+
+/*
+ * Waits for the first sample after boot. After that the
+ * filters always have a value, so this doesn't block.
+ */
+static bool read_filter(adc_filter_t *f, uint16_t *value)
+{
+    uint32_t start = HAL_GetTick();
+
+    while (!adc_filter_value(f, value)) {
+        if (HAL_GetTick() - start > ADC_WAIT_MS) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void adc_enable_noise(void)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
@@ -186,10 +374,15 @@ void adc_enable_noise(void)
     HAL_GPIO_WritePin(GPIOD, GPIO_PIN_8, 1);
     HAL_GPIO_WritePin(GPIOD, GPIO_PIN_9, 1);
     HAL_GPIO_WritePin(GPIOD, GPIO_PIN_10, 1);
+
+    /* Start queueing noise samples once the amplifiers settle */
+    adc_service_set_noise(&service, true);
 }
 
 void adc_disable_noise(void)
 {
+    adc_service_set_noise(&service, false);
+
     /*
      * PD8 Amp2_enable
      * PD9 Amp1_enable
@@ -202,257 +395,80 @@ void adc_disable_noise(void)
 
 
 /*
- * read_noise_inputs() - Reads the two noise output channels and returns
- * the count values read.
+ * read_noise_inputs() - Returns the next pair of noise
+ * samples from the ring. Each pair is only returned once.
+ * Only waits if the ring is empty, which is when samples
+ * are being taken faster than the scans can make them.
  */
 int adc_read_noise_inputs(
     uint32_t *noise1,
     uint32_t *noise2
 )
 {
-    HAL_StatusTypeDef rc;
-    ADC_ChannelConfTypeDef sConfig = {0};
-
-    /* Configure Noiseout 1 input Channel */
-    sConfig.Channel = ADC_CHANNEL_11;  // Noise 1 channel 11 PC1 INP11
-    sConfig.Rank = ADC_REGULAR_RANK_1;
-
-    sConfig.SamplingTime =  ADC_SAMPLETIME_8CYCLES_5;
-    sConfig.SingleDiff = ADC_SINGLE_ENDED;
-    sConfig.OffsetNumber = ADC_OFFSET_NONE;
-    sConfig.Offset = 0;
-    sConfig.OffsetRightShift = DISABLE; /* No Right Offset Shift */
-    sConfig.OffsetSignedSaturation = DISABLE; /* No Signed Saturation */
-    rc = HAL_ADC_ConfigChannel(&hadc2, &sConfig);
-    if (rc != HAL_OK)
-    {
-        printf("Failed to config ADC2 channel 8\n");;
-        return -1;
-    }
-
-    /* Start processing for current (I) values */
-    rc = HAL_ADC_Start(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
-
-    rc = HAL_ADC_PollForConversion(&hadc2, HAL_MAX_DELAY);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 poll for conversion failed\n");
-        return -1;
-    }
-
-    *noise1 = HAL_ADC_GetValue(&hadc2);
-
-    rc = HAL_ADC_Stop(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
-
-    /* Configure Noiseout 2 input Channel */
-    /* Noise 2 channel 10 PC0 INP10 */
-    sConfig.Channel = ADC_CHANNEL_10;
-    sConfig.Rank = ADC_REGULAR_RANK_1;
-    sConfig.SamplingTime =  ADC_SAMPLETIME_8CYCLES_5;
-    rc = HAL_ADC_ConfigChannel(&hadc2, &sConfig);
-    if (rc != HAL_OK)
-    {
-        printf("Failed to config ADC2 channel 4\n");;
-        return -1;
-    }
+    uint32_t start = HAL_GetTick();
+    uint16_t n1, n2;
 
-    /* Now sample for Noise output 2 */
-    rc = HAL_ADC_Start(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
-
-    rc = HAL_ADC_PollForConversion(&hadc2, HAL_MAX_DELAY);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 poll for conversion failed\n");
-        return -1;
-    }
-
-    *noise2 = HAL_ADC_GetValue(&hadc2);
-
-    rc = HAL_ADC_Stop(&hadc2);
-    if (rc != HAL_OK)
+    while (!adc_noise_ring_pop(&service.noise, &n1, &n2))
     {
-        printf("ADC2 start failed\n");
-        return -1;
+        if (!service.noise_enabled || HAL_GetTick() - start > ADC_WAIT_MS)
+        {
+            printf("No ADC2 noise samples\n");
+            return -1;
+        }
     }
 
+    *noise1 = n1;
+    *noise2 = n2;
     return 0;
 }
 
 /*
- * adc_read_powermon() Reads the power monitor current and voltage channels
+ * adc_read_powermon() Returns the filtered power monitor current and voltage
  */
 int adc_read_powermon(
     uint16_t *current,
     uint16_t *voltage
 )
 {
-    HAL_StatusTypeDef rc;
-    ADC_ChannelConfTypeDef sConfig = {0};
-
-    uint32_t adc_value_i;
-    uint32_t adc_value_v;
-
-    /* Configure Regular Power Monitor Current Channel */
-    sConfig.Channel = ADC_CHANNEL_8;  // PWRMON_I channel PC5 INP8
-    sConfig.Rank = ADC_REGULAR_RANK_1;
+    uint16_t adc_value_i;
+    uint16_t adc_value_v;
 
-    sConfig.SamplingTime =  ADC_SAMPLETIME_8CYCLES_5;
-    sConfig.SingleDiff = ADC_SINGLE_ENDED;
-    sConfig.OffsetNumber = ADC_OFFSET_NONE;
-    sConfig.Offset = 0;
-    sConfig.OffsetRightShift = DISABLE; /* No Right Offset Shift */
-    sConfig.OffsetSignedSaturation = DISABLE; /* No Signed Saturation */
-    rc = HAL_ADC_ConfigChannel(&hadc2, &sConfig);
-    if (rc != HAL_OK)
-    {
-        printf("Failed to config ADC2 channel 8\n");;
-        return -1;
-    }
-
-    // Start processing for current (I) values
-    rc = HAL_ADC_Start(&hadc2);
-    if (rc != HAL_OK)
+    if (!read_filter(&service.current, &adc_value_i) ||
+        !read_filter(&service.voltage, &adc_value_v))
     {
-        printf("ADC2 start failed\n");
+        printf("No ADC2 power monitor samples\n");
         return -1;
     }
 
-    rc = HAL_ADC_PollForConversion(&hadc2, HAL_MAX_DELAY);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 poll for conversion failed\n");
-        return -1;
-    }
-
-    adc_value_i = HAL_ADC_GetValue(&hadc2);
     /*
     * Current is I sense voltage divided by
     * the sense resistor value which is 5 ohms
     */
-
-    *current = ((adc_value_i * REF_VOLTAGE_MV) / MAX_SAMPLES_CNT) / PWRMON_I_SENSE_RESISTOR;
-
-    rc = HAL_ADC_Stop(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
-
-    /* Switch to the voltage channel */
-    /* PWRMON_V channel PC4 INP4 */
-    sConfig.Channel = ADC_CHANNEL_4;
-    sConfig.Rank = ADC_REGULAR_RANK_1;
-    sConfig.SamplingTime =  ADC_SAMPLETIME_8CYCLES_5;
-    rc = HAL_ADC_ConfigChannel(&hadc2, &sConfig);
-    if (rc != HAL_OK)
-    {
-        printf("Failed to config ADC2 channel 4\n");;
-        return -1;
-    }
-
-    /* Now sample for voltage (V) */
-    rc = HAL_ADC_Start(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
-
-    rc = HAL_ADC_PollForConversion(&hadc2, HAL_MAX_DELAY);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 poll for conversion failed\n");
-        return -1;
-    }
-
-    adc_value_v = HAL_ADC_GetValue(&hadc2);
-
-    *voltage = (adc_value_v * REF_VOLTAGE_MV) / MAX_SAMPLES_CNT;
-
-    rc = HAL_ADC_Stop(&hadc2);
-    if (rc != HAL_OK)
-    {
-        printf("ADC2 start failed\n");
-        return -1;
-    }
+    *current = adc_to_millivolts(adc_value_i) / PWRMON_I_SENSE_RESISTOR;
+    *voltage = adc_to_millivolts(adc_value_v);
 
     return 0;
 }
 
 /*
- * adc_read_als() - Reads the ambient light sensor channel
- * and returns a numeric value based on the milli-volts
- * read divided by the number of milli-volts per revision.
+ * adc_read_als() - Returns the filtered ambient light
+ * sensor reading in milli-volts.
  */
 int adc_read_als(
     uint16_t *als
 )
 {
-    HAL_StatusTypeDef rc;
-    ADC_ChannelConfTypeDef sConfig = {0};
-    uint32_t adc_value;
-    uint16_t millivolts;
+    uint16_t adc_value;
 
     *als = 0;
 
-    /** Configure Regular Channel
-    */
-    sConfig.Channel = ADC_CHANNEL_0;
-    sConfig.Rank = ADC_REGULAR_RANK_1;
-    sConfig.SamplingTime = ADC_SAMPLETIME_8CYCLES_5;
-    sConfig.SingleDiff = ADC_SINGLE_ENDED;
-    sConfig.OffsetNumber = ADC_OFFSET_NONE;
-    sConfig.Offset = 0;
-    rc = HAL_ADC_ConfigChannel(&hadc3, &sConfig);
-    if (rc != HAL_OK)
+    if (!read_filter(&service.als, &adc_value))
     {
-        printf("Failed to config ADC3 channel\n");
+        printf("No ADC3 ALS samples\n");
         return -1;
     }
 
-    /* Run the ADC calibration in single-ended mode */
-    rc = HAL_ADCEx_Calibration_Start(&hadc3, ADC_CALIB_OFFSET, ADC_SINGLE_ENDED);
-    if (rc != HAL_OK)
-    {
-        printf("ADC3 calibration failed\n");
-        return -1;
-    }
-
-    rc = HAL_ADC_Start(&hadc3);
-    if (rc != HAL_OK)
-    {
-        printf("ADC3 start failed\n");
-        return -1;
-    }
-
-    rc = HAL_ADC_PollForConversion(&hadc3, HAL_MAX_DELAY);
-    if (rc != HAL_OK)
-    {
-        printf("ADC3 poll for conversion failed\n");
-        return -1;
-    }
-    adc_value = HAL_ADC_GetValue(&hadc3);
-    HAL_ADC_Stop(&hadc3);
-
-    millivolts = (((adc_value) * REF_VOLTAGE_MV) / MAX_SAMPLES_CNT);
-
-    *als = millivolts; /* Upper-level code will scale this as needed */
+    *als = adc_to_millivolts(adc_value); /* Upper-level code will scale this as needed */
     return 0;
 }
 
@@ -460,6 +476,9 @@ int adc_read_als(
  * adc_read_boardrev() - Reads the board revision channel
  * and returns a numeric value based on the milli-volts
  * read divided by the number of milli-volts per revision.
+ *
+ * This is only read once, so it borrows ADC3 from the ALS
+ * and polls.
  */
 int adc_read_boardrev(
     uint16_t *board_rev
@@ -469,9 +488,15 @@ int adc_read_boardrev(
     ADC_ChannelConfTypeDef sConfig = {0};
     uint32_t adc_value;
     uint16_t millivolts;
+    int ret = -1;
 
     *board_rev = 0;
 
+    /* Stop the DMA interrupt starting ALS conversions, and let one it started finish */
+    als_paused = true;
+    while (HAL_ADC_GetState(&hadc3) & HAL_ADC_STATE_REG_BUSY) {
+    }
+
     /** Configure Regular Channel
     */
     sConfig.Channel = ADC_CHANNEL_1;
@@ -484,45 +509,58 @@ int adc_read_boardrev(
     if (rc != HAL_OK)
     {
         printf("Failed to config ADC3 channel\n");
-        return -1;
-    }
-
-    /* Run the ADC calibration in single-ended mode */
-    rc = HAL_ADCEx_Calibration_Start(&hadc3, ADC_CALIB_OFFSET, ADC_SINGLE_ENDED);
-    if (rc != HAL_OK)
-    {
-        printf("ADC3 calibration failed\n");
-        return -1;
+        goto out;
     }
 
     rc = HAL_ADC_Start(&hadc3);
     if (rc != HAL_OK)
     {
         printf("ADC3 start failed\n");
-        return -1;
+        goto out;
     }
 
     rc = HAL_ADC_PollForConversion(&hadc3, HAL_MAX_DELAY);
     if (rc != HAL_OK)
     {
         printf("ADC3 poll for conversion failed\n");
-        return -1;
+        goto out;
     }
     adc_value = HAL_ADC_GetValue(&hadc3);
     HAL_ADC_Stop(&hadc3);
 
-    millivolts = (((adc_value) * REF_VOLTAGE_MV) / MAX_SAMPLES_CNT);
+    millivolts = adc_to_millivolts(adc_value);
 
     printf("[%s] millivolts: %u\n", __func__, millivolts);
 
     *board_rev = millivolts / MILLIVOLTS_PER_REVISION;
-    return 0;
+    ret = 0;
+
+out:
+    /* Back to the ALS */
+    sConfig.Channel = ADC_CHANNEL_0;
+    HAL_ADC_ConfigChannel(&hadc3, &sConfig);
+    als_paused = false;
+    return ret;
+}
+
+/*
+ * adc_adjust() - Keeps the scans at the same rate
+ * after frequency_turbo() changes the clocks.
+ */
+void adc_adjust(void)
+{
+    if (htim15.Instance == NULL)
+        return;
+
+    __HAL_TIM_SET_PRESCALER(&htim15, scan_timer_prescaler());
 }
 
 int adc_init(void)
 {
     HAL_StatusTypeDef rc;
 
+    adc_service_init(&service);
+
     rc = adc2_init();
     if (rc != HAL_OK)
         return -1;
@@ -531,5 +569,21 @@ int adc_init(void)
     if (rc != HAL_OK)
         return -1;
 
+    scan_timer_init();
+
+    rc = scan_start();
+    if (rc != HAL_OK)
+    {
+        printf("ADC2 DMA start failed\n");
+        return -1;
+    }
+
+    rc = HAL_TIM_Base_Start(&htim15);
+    if (rc != HAL_OK)
+    {
+        printf("TIM15 start failed\n");
+        return -1;
+    }
+
     return 0;
 }
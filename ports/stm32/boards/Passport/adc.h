@@ -14,5 +14,6 @@ extern int  adc_read_powermon(uint16_t *current, uint16_t *voltage);
 extern void adc_enable_noise(void);
 extern void adc_disable_noise(void);
 extern int  adc_read_noise_inputs(uint32_t *noise1, uint32_t *noise2);
+extern void adc_adjust(void);
 
 #endif //_ADC_H_
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// adc_service.c - Filtering, noise ring and scan scheduling for the background ADC sampling
+//
+// Kept apart from adc.c so that tools/adc_service_test can build it on the host.
+
+#include <string.h>
+
+#include "adc_service.h"
+
+#define RING_MASK (ADC_NOISE_RING_SIZE - 1)
+
+_Static_assert((ADC_NOISE_RING_SIZE & RING_MASK) == 0, "ADC_NOISE_RING_SIZE must be a power of 2");
+_Static_assert(ADC_FAST_HZ % ADC_SLOW_HZ == 0, "ADC_FAST_HZ must be a multiple of ADC_SLOW_HZ");
+_Static_assert(ADC_ALS_DIVIDER >= ADC_SCANS_PER_HALF, "ADC_ALS_DIVIDER is too small");
+
+void adc_filter_init(adc_filter_t *f, uint8_t shift)
+{
+    f->acc = 0;
+    f->shift = shift;
+    f->primed = false;
+}
+
+void adc_filter_update(adc_filter_t *f, uint16_t sample)
+{
+    if (!f->primed) {
+        // Start from the first sample rather than ramping up from zero
+        f->acc = (uint32_t)sample << f->shift;
+        f->primed = true;
+        return;
+    }
+    f->acc = f->acc - (f->acc >> f->shift) + sample;
+}
+
+bool adc_filter_value(const adc_filter_t *f, uint16_t *value)
+{
+    if (!f->primed) {
+        return false;
+    }
+    uint32_t half = f->shift ? 1 << (f->shift - 1) : 0;
+    *value = (f->acc + half) >> f->shift;
+    return true;
+}
+
+uint16_t adc_to_millivolts(uint32_t sample)
+{
+    return (sample * ADC_REF_VOLTAGE_MV) / ADC_MAX_SAMPLE;
+}
+
+bool adc_noise_ring_push(adc_noise_ring_t *r, uint16_t noise1, uint16_t noise2)
+{
+    uint32_t head = r->head;
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= ADC_NOISE_RING_SIZE) {
+        return false;
+    }
+
+    r->pairs[head & RING_MASK] = ((uint32_t)noise1 << 16) | noise2;
+    // The pair must be in the ring before the consumer can see it
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool adc_noise_ring_pop(adc_noise_ring_t *r, uint16_t *noise1, uint16_t *noise2)
+{
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    uint32_t pair = r->pairs[tail & RING_MASK];
+    // ...and read out before the producer can reuse its slot
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+
+    *noise1 = pair >> 16;
+    *noise2 = pair & 0xFFFF;
+    return true;
+}
+
+void adc_noise_ring_flush(adc_noise_ring_t *r)
+{
+    __atomic_store_n(&r->tail, __atomic_load_n(&r->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+uint32_t adc_noise_ring_level(const adc_noise_ring_t *r)
+{
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+void adc_service_init(adc_service_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    adc_filter_init(&s->current, ADC_FILTER_SHIFT_PWRMON);
+    adc_filter_init(&s->voltage, ADC_FILTER_SHIFT_PWRMON);
+    adc_filter_init(&s->als, ADC_FILTER_SHIFT_ALS);
+    s->decimate = 1;
+    s->als_countdown = 1;
+}
+
+void adc_service_set_noise(adc_service_t *s, bool enable)
+{
+    if (enable && !s->noise_enabled) {
+        // The interrupt only touches `settle` while noise is enabled
+        s->settle = ADC_NOISE_SETTLE_SCANS;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        adc_noise_ring_flush(&s->noise);
+    }
+    s->noise_enabled = enable;
+}
+
+uint32_t adc_service_process(adc_service_t *s, const uint16_t *samples, size_t num_scans)
+{
+    uint32_t events = 0;
+    bool noise_enabled = s->noise_enabled;
+
+    for (size_t i = 0; i < num_scans; i++, samples += ADC_SCAN_CHANNELS) {
+        // Noise goes to the ring untouched: any averaging would throw away the entropy
+        if (noise_enabled) {
+            if (s->settle > 0) {
+                s->settle--;
+            } else {
+                adc_noise_ring_push(&s->noise, samples[ADC_SCAN_NOISE1], samples[ADC_SCAN_NOISE2]);
+            }
+        }
+
+        if (--s->decimate > 0) {
+            continue;
+        }
+        s->decimate = s->fast ? ADC_FAST_HZ / ADC_SLOW_HZ : 1;
+
+        adc_filter_update(&s->current, samples[ADC_SCAN_PWRMON_I]);
+        adc_filter_update(&s->voltage, samples[ADC_SCAN_PWRMON_V]);
+
+        if (--s->als_countdown == 0) {
+            s->als_countdown = ADC_ALS_DIVIDER;
+            events |= ADC_EVENT_START_ALS;
+        }
+    }
+
+    // Scan fast while the consumer needs noise, and slow down once the ring is full so the ADC
+    // isn't kept busy for samples that would be dropped
+    bool fast;
+    uint32_t level = adc_noise_ring_level(&s->noise);
+    if (!noise_enabled) {
+        fast = false;
+    } else if (s->fast) {
+        fast = level < ADC_NOISE_RING_SIZE;
+    } else {
+        fast = level <= ADC_NOISE_REFILL_LEVEL;
+    }
+
+    if (fast != s->fast) {
+        s->fast = fast;
+        // The next scan after a change of rate is at the new rate
+        s->decimate = fast ? ADC_FAST_HZ / ADC_SLOW_HZ : 1;
+        events |= ADC_EVENT_RATE_CHANGED;
+    }
+
+    return events;
+}
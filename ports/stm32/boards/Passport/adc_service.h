@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// adc_service.h - Filtering, noise ring and scan scheduling for the background ADC sampling
+//
+// adc.c has TIM15 trigger ADC2 scans of the noise and power monitor inputs, which DMA writes to a
+// circular buffer. Each half of the buffer is handed to adc_service_process() from the DMA
+// interrupt. Nothing here touches the hardware, so tools/adc_service_test can build it on the host
+// and run it against sample traces.
+
+#ifndef __ADC_SERVICE_H__
+#define __ADC_SERVICE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Order of the channels in each ADC2 scan, and so in the DMA buffer
+#define ADC_SCAN_NOISE1   0  // ADC2_INP11, PC1
+#define ADC_SCAN_NOISE2   1  // ADC2_INP10, PC0
+#define ADC_SCAN_PWRMON_I 2  // ADC2_INP8,  PC5
+#define ADC_SCAN_PWRMON_V 3  // ADC2_INP4,  PC4
+#define ADC_SCAN_CHANNELS 4
+
+// Scans per half of the DMA buffer, so per interrupt
+#define ADC_SCANS_PER_HALF 16
+
+// Scan rates. The power monitor filters always see ADC_SLOW_HZ: at the fast rate only every
+// ADC_FAST_HZ / ADC_SLOW_HZ'th scan is passed to them.
+#define ADC_SLOW_HZ 100
+#define ADC_FAST_HZ 4000
+
+// An ALS conversion is started every this many power monitor samples (5 Hz). Only one can be
+// started per half buffer, so this can't be less than ADC_SCANS_PER_HALF.
+#define ADC_ALS_DIVIDER 20
+
+// Exponential moving average time constants, in samples, as powers of 2
+#define ADC_FILTER_SHIFT_PWRMON 5  // 320 ms
+#define ADC_FILTER_SHIFT_ALS    1  // 400 ms
+
+// Noise sample pairs held for the consumer. Must be a power of 2.
+#define ADC_NOISE_RING_SIZE 256
+
+// Once the ring has filled and the scans have slowed down, they speed up again when it has been
+// drained to this level
+#define ADC_NOISE_REFILL_LEVEL (ADC_NOISE_RING_SIZE - ADC_NOISE_RING_SIZE / 4)
+
+// Scans thrown away after the noise amplifiers are powered up, while they settle
+#define ADC_NOISE_SETTLE_SCANS 32
+
+// Bits returned by adc_service_process()
+#define ADC_EVENT_START_ALS    0x01  // Start an ALS conversion
+#define ADC_EVENT_RATE_CHANGED 0x02  // Set the scan timer for the rate in `fast`
+
+#define ADC_REF_VOLTAGE_MV 3000
+#define ADC_MAX_SAMPLE     0xFFFF
+
+typedef struct {
+    uint32_t acc;  // The average, shifted left by `shift`
+    uint8_t shift;
+    bool primed;   // Set once there has been a sample
+} adc_filter_t;
+
+// Single producer, single consumer: the DMA interrupt pushes and the Python thread pops, and
+// neither needs to mask the other. `head` and `tail` are free running counts of pairs.
+typedef struct {
+    uint32_t head;  // Written only by the producer
+    uint32_t tail;  // Written only by the consumer
+    uint32_t pairs[ADC_NOISE_RING_SIZE];  // NOISE1 in the top half, NOISE2 in the bottom
+} adc_noise_ring_t;
+
+typedef struct {
+    adc_filter_t current;
+    adc_filter_t voltage;
+    adc_filter_t als;
+    adc_noise_ring_t noise;
+
+    volatile bool noise_enabled;
+    volatile uint16_t settle;  // Scans still to throw away
+    bool fast;
+    uint16_t decimate;         // Fast scans until the next power monitor sample
+    uint16_t als_countdown;    // Power monitor samples until the next ALS conversion
+} adc_service_t;
+
+extern void adc_filter_init(adc_filter_t *f, uint8_t shift);
+extern void adc_filter_update(adc_filter_t *f, uint16_t sample);
+// Returns false if there hasn't been a sample yet
+extern bool adc_filter_value(const adc_filter_t *f, uint16_t *value);
+
+extern uint16_t adc_to_millivolts(uint32_t sample);
+
+// Producer side. Returns false, dropping the pair, if the ring is full.
+extern bool adc_noise_ring_push(adc_noise_ring_t *r, uint16_t noise1, uint16_t noise2);
+// Consumer side
+extern bool adc_noise_ring_pop(adc_noise_ring_t *r, uint16_t *noise1, uint16_t *noise2);
+extern void adc_noise_ring_flush(adc_noise_ring_t *r);
+extern uint32_t adc_noise_ring_level(const adc_noise_ring_t *r);
+
+extern void adc_service_init(adc_service_t *s);
+// Called from the thread when the noise amplifiers are switched on or off
+extern void adc_service_set_noise(adc_service_t *s, bool enable);
+// Called from the DMA interrupt with `num_scans` scans of ADC_SCAN_CHANNELS samples each.
+// Returns ADC_EVENT_* bits.
+extern uint32_t adc_service_process(adc_service_t *s, const uint16_t *samples, size_t num_scans);
+
+#endif // __ADC_SERVICE_H__
@@ -0,0 +1,198 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// addr_index.c - Hash index from address tags to their index on a receive or change branch
+//
+// Kept apart from modfoundation.c so that tools/addr_index_test can build it on the host.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "addr_index.h"
+
+#define INDEX_MASK ((1u << ADDR_INDEX_INDEX_BITS) - 1)
+#define TAG_MASK   (~INDEX_MASK)
+
+// Slots that can be waiting to be written while extending: the rest of the old bucket that the
+// bucket being written splits from, plus any run of full buckets after it
+#define QUEUE_SIZE 128
+
+_Static_assert(sizeof(addr_index_header_t) == 16, "addr_index_header_t must be 16 bytes");
+_Static_assert(ADDR_INDEX_MAX_BUCKET_BITS <= ADDR_INDEX_TAG_BITS, "Home buckets must come from the stored tag");
+_Static_assert(ADDR_INDEX_MAX_COUNT <= (3 << ADDR_INDEX_MAX_BUCKET_BITS) * ADDR_INDEX_BUCKET_SLOTS / 4,
+               "ADDR_INDEX_MAX_BUCKET_BITS is too small for ADDR_INDEX_MAX_COUNT");
+
+static uint32_t bucket_offset(uint32_t bucket)
+{
+    return sizeof(addr_index_header_t) + bucket * ADDR_INDEX_BUCKET_SIZE;
+}
+
+static uint32_t home_bucket(uint32_t tag, uint8_t bucket_bits)
+{
+    return tag >> (32 - bucket_bits);
+}
+
+// Heapsort, so sorting a large batch needs no extra memory or recursion
+static void sift_down(uint32_t *a, size_t root, size_t n)
+{
+    uint32_t v = a[root];
+    for (size_t child; (child = 2 * root + 1) < n; root = child) {
+        if (child + 1 < n && a[child + 1] > a[child]) {
+            child++;
+        }
+        if (a[child] <= v) {
+            break;
+        }
+        a[root] = a[child];
+    }
+    a[root] = v;
+}
+
+static void sort(uint32_t *a, size_t n)
+{
+    for (size_t i = n / 2; i-- > 0;) {
+        sift_down(a, i, n);
+    }
+    while (n > 1) {
+        uint32_t top = a[0];
+        a[0] = a[--n];
+        a[n] = top;
+        sift_down(a, 0, n);
+    }
+}
+
+addr_index_err_t addr_index_read_header(const addr_index_io_t *io, addr_index_header_t *hdr)
+{
+    if (io->read(io->ctx, 0, hdr, sizeof(*hdr)) != 0) {
+        return ADDR_INDEX_ERR_IO;
+    }
+    if (hdr->magic != ADDR_INDEX_MAGIC || hdr->bucket_bits < ADDR_INDEX_MIN_BUCKET_BITS ||
+        hdr->bucket_bits > ADDR_INDEX_MAX_BUCKET_BITS || hdr->count > ADDR_INDEX_MAX_COUNT) {
+        return ADDR_INDEX_ERR_FORMAT;
+    }
+    return ADDR_INDEX_OK;
+}
+
+int addr_index_lookup(const addr_index_io_t *io, uint32_t tag, uint32_t *indexes, size_t max_indexes)
+{
+    addr_index_header_t hdr;
+    int err = addr_index_read_header(io, &hdr);
+    if (err != ADDR_INDEX_OK) {
+        return err;
+    }
+
+    size_t found = 0;
+    uint32_t slots[ADDR_INDEX_BUCKET_SLOTS];
+    for (uint32_t bucket = home_bucket(tag, hdr.bucket_bits);; bucket++) {
+        if (io->read(io->ctx, bucket_offset(bucket), slots, sizeof(slots)) != 0) {
+            return ADDR_INDEX_ERR_IO;
+        }
+
+        bool full = true;
+        for (size_t i = 0; i < ADDR_INDEX_BUCKET_SLOTS; i++) {
+            if (slots[i] == 0) {
+                full = false;
+            } else if (((slots[i] ^ tag) & TAG_MASK) == 0 && found < max_indexes) {
+                indexes[found++] = (slots[i] & INDEX_MASK) - 1;
+            }
+        }
+
+        // Nothing spills past a bucket with room in it
+        if (!full) {
+            return found;
+        }
+    }
+}
+
+addr_index_err_t addr_index_extend(const addr_index_io_t *src, const addr_index_io_t *dst, uint32_t *tags,
+                                   size_t num)
+{
+    addr_index_header_t old = {.count = 0, .bucket_bits = ADDR_INDEX_MIN_BUCKET_BITS};
+    if (src) {
+        addr_index_err_t err = addr_index_read_header(src, &old);
+        if (err != ADDR_INDEX_OK) {
+            return err;
+        }
+    }
+    if (num > ADDR_INDEX_MAX_COUNT - old.count) {
+        return ADDR_INDEX_ERR_FULL;
+    }
+
+    addr_index_header_t hdr = {
+        .magic = ADDR_INDEX_MAGIC,
+        .count = old.count + num,
+        .bucket_bits = old.bucket_bits,
+    };
+    while (hdr.count > (3u << hdr.bucket_bits) * ADDR_INDEX_BUCKET_SLOTS / 4) {
+        hdr.bucket_bits++;
+    }
+    if (dst->write(dst->ctx, &hdr, sizeof(hdr)) != 0) {
+        return ADDR_INDEX_ERR_IO;
+    }
+
+    // Sorting the new slots puts them in order of home bucket
+    for (size_t i = 0; i < num; i++) {
+        tags[i] = (tags[i] & TAG_MASK) | (old.count + i + 1);
+    }
+    sort(tags, num);
+    size_t next_new = 0;
+
+    // Each old home bucket splits into 2^shift new ones, in order, so the old index can be read
+    // front to back as the new one is written
+    uint8_t shift = hdr.bucket_bits - old.bucket_bits;
+    uint32_t old_home_buckets = 1u << old.bucket_bits;
+    uint32_t old_next = 0;
+    bool old_full = false;
+
+    uint32_t queue[QUEUE_SIZE];
+    size_t queued = 0;
+    bool out_full = false;
+
+    for (uint32_t bucket = 0; bucket < (1u << hdr.bucket_bits) || queued > 0 || out_full; bucket++) {
+        // Everything with this home bucket or an earlier one has to be queued now. In the old
+        // index it's in the buckets up to the one this splits from, or in a run of full buckets
+        // after that.
+        while (src && (old_full || (old_next <= (bucket >> shift) && old_next < old_home_buckets))) {
+            uint32_t slots[ADDR_INDEX_BUCKET_SLOTS];
+            if (src->read(src->ctx, bucket_offset(old_next++), slots, sizeof(slots)) != 0) {
+                return ADDR_INDEX_ERR_IO;
+            }
+            old_full = true;
+            for (size_t i = 0; i < ADDR_INDEX_BUCKET_SLOTS; i++) {
+                if (slots[i] == 0) {
+                    old_full = false;
+                } else if (queued == QUEUE_SIZE) {
+                    return ADDR_INDEX_ERR_FULL;
+                } else {
+                    queue[queued++] = slots[i];
+                }
+            }
+        }
+        while (next_new < num && home_bucket(tags[next_new], hdr.bucket_bits) <= bucket) {
+            if (queued == QUEUE_SIZE) {
+                return ADDR_INDEX_ERR_FULL;
+            }
+            queue[queued++] = tags[next_new++];
+        }
+
+        // Anything left over spills into the next bucket
+        uint32_t out[ADDR_INDEX_BUCKET_SLOTS];
+        size_t n = 0;
+        for (size_t i = 0; i < queued && n < ADDR_INDEX_BUCKET_SLOTS;) {
+            if (home_bucket(queue[i], hdr.bucket_bits) <= bucket) {
+                out[n++] = queue[i];
+                queue[i] = queue[--queued];
+            } else {
+                i++;
+            }
+        }
+        memset(&out[n], 0, (ADDR_INDEX_BUCKET_SLOTS - n) * sizeof(uint32_t));
+
+        if (dst->write(dst->ctx, out, sizeof(out)) != 0) {
+            return ADDR_INDEX_ERR_IO;
+        }
+        out_full = n == ADDR_INDEX_BUCKET_SLOTS;
+    }
+
+    return ADDR_INDEX_OK;
+}
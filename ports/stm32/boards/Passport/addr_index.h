@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// addr_index.h - Hash index from address tags to their index on a receive or change branch
+//
+// Verify Address uses this to find which index an address came from without deriving every
+// address before it. modules/addr_index.py keeps one index per branch in a file on the /cache
+// volume and works out the tags, which are keyed hashes of the addresses. Nothing here touches
+// the hardware, so tools/addr_index_test can build it on the host.
+//
+// File layout (little-endian):
+//   addr_index_header_t
+//   2^bucket_bits home buckets, then overflow buckets, of ADDR_INDEX_BUCKET_SLOTS uint32 slots
+//
+// A slot holds the top ADDR_INDEX_TAG_BITS bits of the tag and the address index + 1, or is 0 if
+// empty. The home bucket is the top bucket_bits bits of the tag. A full bucket spills into the
+// next one, and the last bucket in the file always has an empty slot, so a lookup reads from
+// the home bucket up to the first bucket with an empty slot: normally just the one.
+
+#ifndef __ADDR_INDEX_H__
+#define __ADDR_INDEX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADDR_INDEX_MAGIC 0x31584941  // "AIX1"
+
+#define ADDR_INDEX_BUCKET_SLOTS 8
+#define ADDR_INDEX_BUCKET_SIZE  (ADDR_INDEX_BUCKET_SLOTS * sizeof(uint32_t))
+
+#define ADDR_INDEX_INDEX_BITS 14
+#define ADDR_INDEX_TAG_BITS   (32 - ADDR_INDEX_INDEX_BITS)
+#define ADDR_INDEX_MAX_COUNT  ((1 << ADDR_INDEX_INDEX_BITS) - 1)
+
+// Home buckets are added by doubling to keep them no more than 3/4 full on average
+#define ADDR_INDEX_MIN_BUCKET_BITS 3
+#define ADDR_INDEX_MAX_BUCKET_BITS 12
+
+typedef enum {
+    ADDR_INDEX_OK = 0,
+    ADDR_INDEX_ERR_IO = -1,
+    ADDR_INDEX_ERR_FORMAT = -2,  // Not an index, or a damaged one
+    ADDR_INDEX_ERR_FULL = -3,    // More than ADDR_INDEX_MAX_COUNT addresses
+} addr_index_err_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;  // Addresses 0 to count - 1 are in the index
+    uint8_t bucket_bits;
+    uint8_t reserved[7];
+} addr_index_header_t;
+
+// Storage for an index. Only `read` is used for the index being looked up or extended, and only
+// `write` for the one being written.
+typedef struct {
+    // Reads `len` bytes at `offset`. Returns 0 on success.
+    int (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    // Appends `len` bytes. Returns 0 on success.
+    int (*write)(void *ctx, const void *buf, size_t len);
+    void *ctx;
+} addr_index_io_t;
+
+extern addr_index_err_t addr_index_read_header(const addr_index_io_t *io, addr_index_header_t *hdr);
+
+// Puts the index of each address whose tag matches the top ADDR_INDEX_TAG_BITS bits of `tag` in
+// `indexes`, up to `max_indexes` of them. Returns how many there were, or an addr_index_err_t.
+// Tags are truncated, so the caller has to check each index by deriving its address.
+extern int addr_index_lookup(const addr_index_io_t *io, uint32_t tag, uint32_t *indexes, size_t max_indexes);
+
+// Writes an index to `dst` with everything in `src`, or nothing if `src` is NULL, then `num`
+// more addresses whose tags are in `tags` in index order. The file is written front to back in
+// one pass, reading `src` the same way, so it can go straight to a new file that replaces the
+// old one. `tags` is used as working space and is left in no particular order.
+extern addr_index_err_t addr_index_extend(const addr_index_io_t *src, const addr_index_io_t *dst, uint32_t *tags,
+                                          size_t num);
+
+#endif // __ADDR_INDEX_H__
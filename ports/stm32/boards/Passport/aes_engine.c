@@ -0,0 +1,419 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// aes_engine.c - AES-ECB, CBC and CTR on the STM32H7 CRYP peripheral, or in software
+//
+// See aes_engine.h for how the backend is chosen.
+
+#include <string.h>
+
+#include "aes_engine.h"
+
+static void wipe(void *p, size_t len)
+{
+    volatile uint8_t *v = (volatile uint8_t *)p;
+    while (len--) {
+        *v++ = 0;
+    }
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+#if AES_ENGINE_HW
+
+#include "stm32h7xx_hal.h"
+
+#if MICROPY_HW_ENABLE_CRYP
+#include "dma.h"
+
+// Buffers smaller than this are quicker to push through the FIFOs by hand
+#define DMA_MIN_BLOCKS 32
+
+// NDTR is 16 bits. Keep each transfer a whole number of cache lines.
+#define DMA_MAX_WORDS 0xFFF8
+#endif
+
+enum {
+    KEY_NONE = 0,
+    KEY_ENCRYPT,  // The key registers hold the key as given
+    KEY_DECRYPT,  // The key registers hold the result of the key preparation for decryption
+};
+
+// The key last loaded into the peripheral. Settings and the flash cache make a new aes object for
+// every operation, but always with the same key, so this saves reloading the key and, for ECB and
+// CBC decryption, running the key preparation again.
+static struct {
+    uint8_t key[32];
+    uint8_t key_len;
+    uint8_t form;
+} loaded;
+
+// Compares keys without an early exit
+static bool same_key(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static uint32_t key_size_bits(size_t key_len)
+{
+    switch (key_len) {
+        case 24:
+            return CRYP_CR_KEYSIZE_0;
+        case 32:
+            return CRYP_CR_KEYSIZE_1;
+        default:
+            return 0;
+    }
+}
+
+static void load_key(aes_engine_ctx_t *ctx, uint8_t form)
+{
+    uint32_t cr = key_size_bits(ctx->key_len) | CRYP_CR_DATATYPE_1;
+
+    if (loaded.form == form && loaded.key_len == ctx->key_len && same_key(loaded.key, ctx->key, ctx->key_len)) {
+        return;
+    }
+
+    CRYP->CR = cr;
+
+    // Shorter keys go in the last of the key registers, most significant word first
+    volatile uint32_t *k = &CRYP->K0LR + (32 - ctx->key_len) / 4;
+    for (size_t i = 0; i < ctx->key_len / 4; i++) {
+        k[i] = get_be32(ctx->key + i * 4);
+    }
+
+    if (form == KEY_DECRYPT) {
+        CRYP->CR = cr | CRYP_CR_ALGOMODE_AES_KEY;
+        CRYP->CR |= CRYP_CR_CRYPEN;
+        while (CRYP->SR & CRYP_SR_BUSY) {
+        }
+    }
+
+    memcpy(loaded.key, ctx->key, ctx->key_len);
+    loaded.key_len = ctx->key_len;
+    loaded.form = form;
+}
+
+static void crypt_blocks_cpu(const uint8_t *in, uint8_t *out, size_t num_blocks)
+{
+    while (num_blocks--) {
+        for (int i = 0; i < 4; i++) {
+            uint32_t word;
+            memcpy(&word, in + i * 4, 4);
+            CRYP->DIN = word;
+        }
+        for (int i = 0; i < 4; i++) {
+            while (!(CRYP->SR & CRYP_SR_OFNE)) {
+            }
+            uint32_t word = CRYP->DOUT;
+            memcpy(out + i * 4, &word, 4);
+        }
+        in += AES_ENGINE_BLOCK_SIZE;
+        out += AES_ENGINE_BLOCK_SIZE;
+    }
+}
+
+#if MICROPY_HW_ENABLE_CRYP
+// DMA1 and DMA2 can't reach the TCMs
+static bool dma_can_reach(const void *p, size_t len)
+{
+    uint32_t start = (uint32_t)p;
+    uint32_t end = start + len;
+
+    if (start >= FLASH_BANK1_BASE && end <= FLASH_END + 1) {
+        return true;
+    }
+    if (start >= D1_AXISRAM_BASE && end <= D1_AXISRAM_BASE + 0x80000) {
+        return true;
+    }
+    if (start >= D2_AHBSRAM_BASE && end <= D2_AHBSRAM_BASE + 0x48000) {
+        return true;
+    }
+    return false;
+}
+
+// `out` must start on a cache line and `num_blocks` must be even, so the output covers whole
+// cache lines and invalidating them can't throw away anything else.
+static void crypt_blocks_dma(const uint8_t *in, uint8_t *out, size_t num_blocks)
+{
+    DMA_HandleTypeDef hdma_in;
+    DMA_HandleTypeDef hdma_out;
+    uint8_t *out_start = out;
+    size_t num_words = num_blocks * 4;
+    bool dcache = (SCB->CCR & SCB_CCR_DC_Msk) != 0;
+
+    if (dcache) {
+        if ((uint32_t)in >= D1_AXISRAM_BASE) {
+            uint32_t addr = (uint32_t)in & ~31;
+            SCB_CleanDCache_by_Addr((uint32_t *)addr, num_words * 4 + ((uint32_t)in & 31));
+        }
+        SCB_InvalidateDCache_by_Addr((uint32_t *)out, num_words * 4);
+    }
+
+    while (num_words > 0) {
+        size_t n = num_words > DMA_MAX_WORDS ? DMA_MAX_WORDS : num_words;
+
+        dma_init(&hdma_out, &dma_CRYP_OUT, DMA_PERIPH_TO_MEMORY, NULL);
+        dma_init(&hdma_in, &dma_CRYP_IN, DMA_MEMORY_TO_PERIPH, NULL);
+        HAL_DMA_Start(&hdma_out, (uint32_t)&CRYP->DOUT, (uint32_t)out, n);
+        HAL_DMA_Start(&hdma_in, (uint32_t)in, (uint32_t)&CRYP->DIN, n);
+        CRYP->DMACR = CRYP_DMACR_DIEN | CRYP_DMACR_DOEN;
+
+        HAL_DMA_PollForTransfer(&hdma_out, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+        HAL_DMA_PollForTransfer(&hdma_in, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+
+        CRYP->DMACR = 0;
+        dma_deinit(&dma_CRYP_IN);
+        dma_deinit(&dma_CRYP_OUT);
+
+        in += n * 4;
+        out += n * 4;
+        num_words -= n;
+    }
+
+    // Drop anything the core read into the cache while the DMA was writing
+    if (dcache) {
+        SCB_InvalidateDCache_by_Addr((uint32_t *)out_start, num_blocks * AES_ENGINE_BLOCK_SIZE);
+    }
+}
+#endif // MICROPY_HW_ENABLE_CRYP
+
+// Runs whole blocks through the peripheral, starting from ctx->iv for CBC and CTR. The caller
+// keeps ctx->iv up to date.
+static void crypt_blocks(aes_engine_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t num_blocks, bool encrypt)
+{
+    bool decrypt_key = !encrypt && ctx->mode != AES_ENGINE_CTR;
+    uint32_t cr = key_size_bits(ctx->key_len) | CRYP_CR_DATATYPE_1;
+
+    switch (ctx->mode) {
+        case AES_ENGINE_ECB:
+            cr |= CRYP_CR_ALGOMODE_AES_ECB;
+            break;
+        case AES_ENGINE_CBC:
+            cr |= CRYP_CR_ALGOMODE_AES_CBC;
+            break;
+        default:
+            cr |= CRYP_CR_ALGOMODE_AES_CTR;
+            break;
+    }
+    if (decrypt_key) {
+        cr |= CRYP_CR_ALGODIR;
+    }
+
+    __HAL_RCC_CRYP_CLK_ENABLE();
+    load_key(ctx, decrypt_key ? KEY_DECRYPT : KEY_ENCRYPT);
+
+    CRYP->CR = cr;
+    if (ctx->mode != AES_ENGINE_ECB) {
+        CRYP->IV0LR = get_be32(ctx->iv);
+        CRYP->IV0RR = get_be32(ctx->iv + 4);
+        CRYP->IV1LR = get_be32(ctx->iv + 8);
+        CRYP->IV1RR = get_be32(ctx->iv + 12);
+    }
+    CRYP->CR |= CRYP_CR_FFLUSH;
+    CRYP->CR |= CRYP_CR_CRYPEN;
+
+#if MICROPY_HW_ENABLE_CRYP
+    if (num_blocks >= DMA_MIN_BLOCKS && ((uint32_t)in & 3) == 0 && ((uint32_t)out & 15) == 0 &&
+        dma_can_reach(in, num_blocks * AES_ENGINE_BLOCK_SIZE) &&
+        dma_can_reach(out, num_blocks * AES_ENGINE_BLOCK_SIZE)) {
+        // Get `out` onto a cache line, then DMA as many pairs of blocks as there are
+        size_t head = ((uint32_t)out & 31) ? 1 : 0;
+        size_t dma_blocks = (num_blocks - head) & ~1;
+
+        crypt_blocks_cpu(in, out, head);
+        in += head * AES_ENGINE_BLOCK_SIZE;
+        out += head * AES_ENGINE_BLOCK_SIZE;
+
+        crypt_blocks_dma(in, out, dma_blocks);
+        in += dma_blocks * AES_ENGINE_BLOCK_SIZE;
+        out += dma_blocks * AES_ENGINE_BLOCK_SIZE;
+
+        num_blocks -= head + dma_blocks;
+    }
+#endif
+
+    crypt_blocks_cpu(in, out, num_blocks);
+
+    CRYP->CR &= ~CRYP_CR_CRYPEN;
+}
+
+static void key_setup(aes_engine_ctx_t *ctx)
+{
+    // Keys are loaded into the peripheral as they're needed
+    (void)ctx;
+}
+
+static void key_release(aes_engine_ctx_t *ctx)
+{
+    // Don't leave a key that's being thrown away in the peripheral
+    if (loaded.form != KEY_NONE && loaded.key_len == ctx->key_len && same_key(loaded.key, ctx->key, ctx->key_len)) {
+        __HAL_RCC_CRYP_CLK_ENABLE();
+        CRYP->K0LR = CRYP->K0RR = CRYP->K1LR = CRYP->K1RR = 0;
+        CRYP->K2LR = CRYP->K2RR = CRYP->K3LR = CRYP->K3RR = 0;
+        wipe(&loaded, sizeof(loaded));
+    }
+}
+
+#else // AES_ENGINE_HW
+
+static void crypt_blocks(aes_engine_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t num_blocks, bool encrypt)
+{
+    // The aes_modes.c functions move the IV along themselves, but the caller does that here
+    uint8_t iv[AES_ENGINE_BLOCK_SIZE];
+    int len = num_blocks * AES_ENGINE_BLOCK_SIZE;
+
+    memcpy(iv, ctx->iv, sizeof(iv));
+    switch (ctx->mode) {
+        case AES_ENGINE_ECB:
+            if (encrypt) {
+                aes_ecb_encrypt(in, out, len, &ctx->encrypt_ctx);
+            } else {
+                aes_ecb_decrypt(in, out, len, &ctx->decrypt_ctx);
+            }
+            break;
+        case AES_ENGINE_CBC:
+            if (encrypt) {
+                aes_cbc_encrypt(in, out, len, iv, &ctx->encrypt_ctx);
+            } else {
+                aes_cbc_decrypt(in, out, len, iv, &ctx->decrypt_ctx);
+            }
+            break;
+        default:
+            aes_ctr_crypt(in, out, len, iv, aes_ctr_cbuf_inc, &ctx->encrypt_ctx);
+            break;
+    }
+    wipe(iv, sizeof(iv));
+}
+
+static void key_setup(aes_engine_ctx_t *ctx)
+{
+    switch (ctx->key_len) {
+        case 16:
+            aes_encrypt_key128(ctx->key, &ctx->encrypt_ctx);
+            aes_decrypt_key128(ctx->key, &ctx->decrypt_ctx);
+            break;
+        case 24:
+            aes_encrypt_key192(ctx->key, &ctx->encrypt_ctx);
+            aes_decrypt_key192(ctx->key, &ctx->decrypt_ctx);
+            break;
+        case 32:
+            aes_encrypt_key256(ctx->key, &ctx->encrypt_ctx);
+            aes_decrypt_key256(ctx->key, &ctx->decrypt_ctx);
+            break;
+    }
+}
+
+static void key_release(aes_engine_ctx_t *ctx)
+{
+    (void)ctx;
+}
+
+#endif // AES_ENGINE_HW
+
+// Adds `n` to the 128-bit big-endian counter
+static void ctr_add(uint8_t *ctr, uint64_t n)
+{
+    uint64_t carry = n;
+    for (int i = AES_ENGINE_BLOCK_SIZE - 1; i >= 0 && carry; i--) {
+        carry += ctr[i];
+        ctr[i] = carry;
+        carry >>= 8;
+    }
+}
+
+static void ctr_crypt(aes_engine_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len)
+{
+    // Finish off the keystream of the last block first
+    while (len > 0 && ctx->keystream_pos < AES_ENGINE_BLOCK_SIZE) {
+        *out++ = *in++ ^ ctx->keystream[ctx->keystream_pos++];
+        len--;
+    }
+
+    size_t num_blocks = len / AES_ENGINE_BLOCK_SIZE;
+    while (num_blocks > 0) {
+        // The peripheral only counts in the low 32 bits, so carries into the rest are done here
+        uint64_t until_wrap = 0x100000000ULL - get_be32(ctx->iv + 12);
+        size_t n = num_blocks < until_wrap ? num_blocks : (size_t)until_wrap;
+
+        crypt_blocks(ctx, in, out, n, true);
+        ctr_add(ctx->iv, n);
+        in += n * AES_ENGINE_BLOCK_SIZE;
+        out += n * AES_ENGINE_BLOCK_SIZE;
+        len -= n * AES_ENGINE_BLOCK_SIZE;
+        num_blocks -= n;
+    }
+
+    if (len > 0) {
+        memset(ctx->keystream, 0, AES_ENGINE_BLOCK_SIZE);
+        crypt_blocks(ctx, ctx->keystream, ctx->keystream, 1, true);
+        ctr_add(ctx->iv, 1);
+        ctx->keystream_pos = 0;
+        while (len > 0) {
+            *out++ = *in++ ^ ctx->keystream[ctx->keystream_pos++];
+            len--;
+        }
+    }
+}
+
+void aes_engine_init(aes_engine_ctx_t *ctx,
+                     aes_engine_mode_t mode,
+                     const uint8_t *key,
+                     size_t key_len,
+                     const uint8_t *iv)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->mode = mode;
+    memcpy(ctx->key, key, key_len);
+    ctx->key_len = key_len;
+    if (iv != NULL) {
+        memcpy(ctx->iv, iv, AES_ENGINE_BLOCK_SIZE);
+    }
+    ctx->keystream_pos = AES_ENGINE_BLOCK_SIZE;
+    key_setup(ctx);
+}
+
+bool aes_engine_crypt(aes_engine_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len, bool encrypt)
+{
+    uint8_t next_iv[AES_ENGINE_BLOCK_SIZE];
+
+    if (ctx->mode == AES_ENGINE_CTR) {
+        ctr_crypt(ctx, in, out, len);
+        return true;
+    }
+
+    if (len % AES_ENGINE_BLOCK_SIZE) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
+    }
+
+    if (ctx->mode == AES_ENGINE_CBC) {
+        // The next IV is the last ciphertext block. Decryption may be in place, so take it first.
+        if (!encrypt) {
+            memcpy(next_iv, in + len - AES_ENGINE_BLOCK_SIZE, AES_ENGINE_BLOCK_SIZE);
+        }
+        crypt_blocks(ctx, in, out, len / AES_ENGINE_BLOCK_SIZE, encrypt);
+        if (encrypt) {
+            memcpy(next_iv, out + len - AES_ENGINE_BLOCK_SIZE, AES_ENGINE_BLOCK_SIZE);
+        }
+        memcpy(ctx->iv, next_iv, AES_ENGINE_BLOCK_SIZE);
+    } else {
+        crypt_blocks(ctx, in, out, len / AES_ENGINE_BLOCK_SIZE, encrypt);
+    }
+    return true;
+}
+
+void aes_engine_release(aes_engine_ctx_t *ctx)
+{
+    key_release(ctx);
+    wipe(ctx, sizeof(*ctx));
+}
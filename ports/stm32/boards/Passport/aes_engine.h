@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// aes_engine.h - AES-ECB, CBC and CTR on the STM32H7 CRYP peripheral, or in software
+//
+// With AES_ENGINE_HW=1 the CRYP peripheral does the block operations: it has no lookup tables to
+// leak timing, and long buffers are moved by DMA. Otherwise trezor-crypto's table-based AES is
+// used, which is what the host test harness builds. Chaining, counters and partial CTR blocks are
+// handled here, above the backends, so both behave the same as trezor-crypto's aes_modes.c.
+
+#ifndef __AES_ENGINE_H__
+#define __AES_ENGINE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef AES_ENGINE_HW
+#define AES_ENGINE_HW 0
+#endif
+
+#if !AES_ENGINE_HW
+#include "aes/aes.h"
+#endif
+
+#define AES_ENGINE_BLOCK_SIZE 16
+
+typedef enum {
+    AES_ENGINE_ECB,
+    AES_ENGINE_CBC,
+    AES_ENGINE_CTR,
+} aes_engine_mode_t;
+
+typedef struct {
+    uint8_t key[32];
+    uint8_t key_len;
+    uint8_t mode;
+    uint8_t iv[AES_ENGINE_BLOCK_SIZE];         // CBC: the chaining value. CTR: the next counter block.
+    uint8_t keystream[AES_ENGINE_BLOCK_SIZE];  // CTR: keystream of the last partly used block
+    uint8_t keystream_pos;                     // CTR: bytes of `keystream` used so far
+#if !AES_ENGINE_HW
+    aes_encrypt_ctx encrypt_ctx;
+    aes_decrypt_ctx decrypt_ctx;
+#endif
+} aes_engine_ctx_t;
+
+// `key_len` must be 16, 24 or 32, and `iv` may be NULL for all zeros
+extern void aes_engine_init(aes_engine_ctx_t *ctx,
+                            aes_engine_mode_t mode,
+                            const uint8_t *key,
+                            size_t key_len,
+                            const uint8_t *iv);
+
+// ECB and CBC need a multiple of the block size and return false otherwise. CTR takes any length,
+// and a call may start or end part way through a block.
+extern bool aes_engine_crypt(aes_engine_ctx_t *ctx, const uint8_t *in, uint8_t *out, size_t len, bool encrypt);
+
+extern void aes_engine_release(aes_engine_ctx_t *ctx);
+
+#endif // __AES_ENGINE_H__
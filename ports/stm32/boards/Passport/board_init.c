@@ -6,6 +6,8 @@
 
 #include "stm32h7xx_hal.h"
 
+#include "py/mphal.h"
+
 #include "adc.h"
 #include "backlight.h"
 #include "camera-ovm7690.h"
@@ -15,6 +17,8 @@
 #include "image_conversion.h"
 #include "lcd-sharp-ls018B7dh02.h"
 #include "busy_bar.h"
+#include "mpu.h"
+#include "placement.h"
 #include "se.h"
 #include "utils.h"
 #include "se.h"
@@ -22,7 +26,8 @@
 #define QR_IMAGE_SIZE (CAMERA_WIDTH * CAMERA_HEIGHT)
 #define VIEWFINDER_IMAGE_SIZE ((240 * 303) / 8)
 
-uint8_t qr[QR_IMAGE_SIZE];
+// The grayscale image quirc works on, which main.py maps at the start of DTCM (see passport.ld)
+uint8_t qr_buf[QR_IMAGE_SIZE] DTCM_NOINIT;
 uint8_t dp[VIEWFINDER_IMAGE_SIZE];
 
 void
@@ -46,6 +51,27 @@ Passport_board_init(void)
     // check_stack("Passport_board_init() complete", true);
 }
 
+#define MPU_REGION_ITCM (MPU_REGION_NUMBER6)
+
+// Executable and read-only, so a stray write (through a NULL pointer, say) can't change code that
+// resethandler.s copied there. The bootloader's own ITCM region is overwritten by the ones after
+// it, so don't rely on what it left.
+#define MPU_CONFIG_ITCM(size) ( \
+    MPU_INSTRUCTION_ACCESS_ENABLE   << MPU_RASR_XN_Pos \
+    | MPU_REGION_PRIV_RO            << MPU_RASR_AP_Pos \
+    | MPU_TEX_LEVEL0                << MPU_RASR_TEX_Pos \
+    | MPU_ACCESS_NOT_SHAREABLE      << MPU_RASR_S_Pos \
+    | MPU_ACCESS_NOT_CACHEABLE      << MPU_RASR_C_Pos \
+    | MPU_ACCESS_NOT_BUFFERABLE     << MPU_RASR_B_Pos \
+    | 0x00                          << MPU_RASR_SRD_Pos \
+    | (size)                        << MPU_RASR_SIZE_Pos \
+    | MPU_REGION_ENABLE             << MPU_RASR_ENABLE_Pos \
+    )
+
 void
 Passport_board_early_init(void)
-{}
+{
+    uint32_t irq_state = mpu_config_start();
+    mpu_config_region(MPU_REGION_ITCM, D1_ITCMRAM_BASE, MPU_CONFIG_ITCM(MPU_REGION_SIZE_64KB));
+    mpu_config_end(irq_state);
+}
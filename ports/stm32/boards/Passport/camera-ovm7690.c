@@ -46,144 +46,13 @@
 
 #define CAMERA_I2C_ADDR (0x21 << 1) // Use 8-bit address
 
-typedef struct
-{
-    uint8_t addr;
-    uint8_t val;
-} CAMERA_REG;
-
-/* OmniVision recommended settings based on OVM7690 Setting V2.2              */
-/* Modified for RGB QVGA settings                                             */
-static CAMERA_REG Camera_RegInit[] = {
-    {0x0E, 0x00}, /* No sleep and full range (default)  */
-    {0x0C, 0x06}, /* External sync */
-    {0x81, 0xFF}, /* SDE, UV, vscale, hscale, uvavg, color matrix */
-    {0x21, 0x44}, /* AECGM banding max */
-    {0x16, 0x03}, /* Setting reserved bits?? */
-    {0x39, 0x80}, /* Setting reserved bits?? */
-    {0x1E, 0xB1}, /* Setting reserved bits?? */
-
-    /* Format */
-    {0x12, 0x06}, /* Output format control: RGB565      */
-    {0x82, 0x03}, /* YUV422? */
-    {0xD0, 0x48}, /* voffset/hoffset (default) */
-    {0x80, 0x7F}, /* color interp, bp corr, wp corr, gamma, awb gain, awb, lens corr */
-    {0x3E, 0x30}, /* reserved bit?? and PLCK YUV */
-    {0x22, 0x00}, /* optical black output disable (default) */
-
-    /* Resolution */
-    {0x17, 0x69}, /* Horizontal window start point      */
-    {0x18, 0xA4}, /* Horizontal senzor size             */
-    {0x19, 0x0C}, /* Vertical Window start line         */
-    {0x1A, 0xF6}, /* Vertical sensor size               */
-
-    {0xC8, 0x02}, /* H input size MSBs (default) */
-    {0xC9, 0x80}, /* H input size LSBs (default) */
-    {0xCA, 0x01}, /* V input size MSBs (default) */
-    {0xCB, 0xE0}, /* V input size LSBs (default) */
-    {0xCC, 0x02}, /* H output size MSBs (default) */
-    {0xCD, 0x80}, /* H output size LSBs (default) */
-    {0xCE, 0x01}, /* V output size MSBs (default) */
-    {0xCF, 0xE0}, /* V output size LSBs (default) */
-
-    /* Lens Correction */
-    {0x85, 0x90}, /* reserved bit?? and LENC bias enable */
-    {0x86, 0x00}, /* no compensation radius (default) */
-    {0x87, 0x00}, /* LENSC X coord (default) */
-    {0x88, 0x10}, /* LENSC Y coord */
-    {0x89, 0x30}, /* R compensation coefficient */
-    {0x8A, 0x29}, /* G compensation coefficient */
-    {0x8B, 0x26}, /* B compensation coefficient */
-
-    /* Color Matrix */
-    {0xBB, 0x80}, /* color matrix coefficient 1 */
-    {0xBC, 0x62}, /* color matrix coefficient 2 */
-    {0xBD, 0x1E}, /* color matrix coefficient 3 */
-    {0xBE, 0x26}, /* color matrix coefficient 4 */
-    {0xBF, 0x7B}, /* color matrix coefficient 5 */
-    {0xC0, 0xAC}, /* color matrix coefficient 6 */
-    {0xC1, 0x1E}, /* M sign (default) */
-
-    /* Edge + Denoise */
-    {0xB7, 0x05}, /* offset */
-    {0xB8, 0x09}, /* base 1 */
-    {0xB9, 0x00}, /* base 2 */
-    {0xBA, 0x18}, /* gain 4x limited to 16 and DNS_th_sel */
-
-    /* UVAdjust */
-    {0x5A, 0x4A}, /* slope of UV curve */
-    {0x5B, 0x9F}, /* UV adjust */
-    {0x5C, 0x48}, /* UV adjust */
-    {0x5D, 0x32}, /* UV adjust */
-
-    /* AEC/AGC target */
-    {0x24, 0x78}, /* stable operation up limit (default) */
-    {0x25, 0x68}, /* stable operation lower limit (default) */
-    {0x26, 0xB3}, /* fast mode operating region */
-
-    /* Gamma */
-    {0xA3, 0x0B}, /* gamma curve 1st segment */
-    {0xA4, 0x15}, /* gamma curve 2nd segment */
-    {0xA5, 0x2A}, /* gamma curve 3rd segment */
-    {0xA6, 0x51}, /* gamma curve 4th segment */
-    {0xA7, 0x63}, /* gamma curve 5th segment */
-    {0xA8, 0x74}, /* gamma curve 6th segment */
-    {0xA9, 0x83}, /* gamma curve 7th segment */
-    {0xAA, 0x91}, /* gamma curve 8th segment */
-    {0xAB, 0x9E}, /* gamma curve 9th segment */
-    {0xAC, 0xAA}, /* gamma curve 10th segment */
-    {0xAD, 0xBE}, /* gamma curve 11th segment */
-    {0xAE, 0xCE}, /* gamma curve 12th segment */
-    {0xAF, 0xE5}, /* gamma curve 13th segment */
-    {0xB0, 0xF3}, /* gamma curve 14th segment */
-    {0xB1, 0xFB}, /* gamma curve 15th segment */
-    {0xB2, 0x06}, /* gamma curve highest segment slope */
-
-    /* Advance (AWB Control Registers) */
-    {0x8C, 0x5D},
-    {0x8D, 0x11},
-    {0x8E, 0x12},
-    {0x8F, 0x11},
-    {0x90, 0x50},
-    {0x91, 0x22},
-    {0x92, 0xD1},
-    {0x93, 0xA7},
-    {0x94, 0x23},
-    {0x95, 0x3B},
-    {0x96, 0xFF},
-    {0x97, 0x00},
-    {0x98, 0x4A},
-    {0x99, 0x46},
-    {0x9A, 0x3D},
-    {0x9B, 0x3A},
-    {0x9C, 0xF0},
-    {0x9D, 0xF0},
-    {0x9E, 0xF0},
-    {0x9F, 0xFF},
-    {0xA0, 0x56},
-    {0xA1, 0x55},
-    {0xA2, 0x13},
-
-    /* General Control */
-    {0x50, 0x9A}, /* 50 Hz banding AEC (default) */
-    {0x51, 0x80}, /* 60 Hz banding AEC (default) */
-    {0x21, 0x23}, /* AECGM banding max (overrides above) */
-
-    {0x14, 0x29}, /* Max AGC 8x */
-    {0x13, 0xE7}, /* fast AGC/AEC, AEC step unlimited, banding filter, AEC below banding, AGC auto, AWB auto, exp auto */
-    {0x11, 0x40}, /* external clock or internal clock prescalar */
-
-    {0x0E, 0x00}, /* already specified above */
-
-    {0xC8, 0x02},
-    {0xC9, 0x40}, /* Input Horiz 576 */
-    {0xCA, 0x01},
-    {0xCB, 0xE0}, /* Input Vert 480 */
-    {0xCC, 0x01},
-    {0xCD, 0x8C}, /* Output Horiz 396 */
-    {0xCE, 0x01},
-    {0xCF, 0x4A} /* Output Vert 330 */
-};
+/* Registers the driver reads or writes itself */
+#define REG0E 0x0E
+#define REG12 0x12
+#define REG6F 0x6F
+
+#define REG0E_SLEEP (1 << 3)
+#define REG12_RESET (1 << 7)
 
 static uint32_t FrameBufAddr;
 static DMA_HandleTypeDef hdma;
@@ -191,6 +60,10 @@ static DCMI_HandleTypeDef hdcmi;
 static I2C_HandleTypeDef hi2c1;
 static TIM_HandleTypeDef tim3;
 
+static camera_state_t camera_state = CAMERA_STATE_OFF;
+static uint8_t reg0e;         /* What was last written to REG0E */
+static uint32_t wake_tick;    /* When the sensor last left standby */
+
 uint16_t *camera_frame_buffer = (uint16_t *)D2_AHBSRAM_BASE;
 
 static int
@@ -215,11 +88,11 @@ camera_read(uint8_t reg, uint8_t *data)
 }
 
 static int
-camera_write(uint8_t reg, uint8_t data)
+camera_write_regs(uint8_t reg, const uint8_t *vals, size_t len)
 {
     HAL_StatusTypeDef ret;
     ret = HAL_I2C_Mem_Write(
-        &hi2c1, CAMERA_I2C_ADDR, reg, I2C_MEMADD_SIZE_8BIT, &data, 1, 100);
+        &hi2c1, CAMERA_I2C_ADDR, reg, I2C_MEMADD_SIZE_8BIT, (uint8_t *)vals, len, 100);
     if (ret != HAL_OK)
     {
         printf("[%s] HAL_I2C_Mem_Write() failed\n", __func__);
@@ -228,20 +101,32 @@ camera_write(uint8_t reg, uint8_t data)
     return 0;
 }
 
+static int
+camera_write(uint8_t reg, uint8_t data)
+{
+    return camera_write_regs(reg, &data, 1);
+}
+
 static int
 camera_setQVGA(void)
 {
-    int i;
     int rc;
 
-    for (i = 0; i < (sizeof(Camera_RegInit) / sizeof(CAMERA_REG)); i++)
+    /* Start from the reset values, which the settings table leaves alone */
+    rc = camera_write(REG12, REG12_RESET);
+    if (rc < 0)
     {
-        rc = camera_write(Camera_RegInit[i].addr, Camera_RegInit[i].val);
-        if (rc < 0)
-        {
-            printf("[%s] camera_write() failed on index %d\n", __func__, i);
-            return -1;
-        }
+        printf("[%s] camera_write() failed\n", __func__);
+        return -1;
+    }
+    HAL_Delay(1);
+    reg0e = 0;
+
+    rc = camera_write_init_regs(camera_write_regs, CAMERA_I2C_BURST);
+    if (rc < 0)
+    {
+        printf("[%s] camera_write_init_regs() failed\n", __func__);
+        return -1;
     }
     return 0;
 }
@@ -250,24 +135,29 @@ int
 camera_on(void)
 {
     int rc;
-    uint8_t val;
 
     // printf("DRIVER: camera_on()\n");
-    rc = camera_read(0x0E, &val);
-    if (rc < 0)
+    if (camera_state == CAMERA_STATE_ACTIVE)
+    {
+        return 0;
+    }
+    if (camera_state == CAMERA_STATE_OFF)
     {
-        printf("[%s] camera_read() failed\n", __func__);
+        printf("[%s] camera not initialized\n", __func__);
         return -1;
     }
 
-    val &= ~(1 << 3);
-    rc = camera_write(0x0E, val);
+    /* REG0E is only changed here, so the copy saves reading it back */
+    rc = camera_write(REG0E, reg0e & ~REG0E_SLEEP);
     if (rc < 0)
     {
         printf("[%s] camera_write() failed\n", __func__);
         return -1;
     }
+    reg0e &= ~REG0E_SLEEP;
 
+    camera_state = CAMERA_STATE_ACTIVE;
+    wake_tick = HAL_GetTick();
     return 0;
 }
 
@@ -276,7 +166,6 @@ camera_off(void)
 {
     int rval = 0;
     int irc;
-    uint8_t val;
     HAL_StatusTypeDef rc;
 
     rc = HAL_DCMI_Stop(&hdcmi);
@@ -286,25 +175,35 @@ camera_off(void)
         rval = -1;
     }
 
-    irc = camera_read(0x0E, &val);
-    if (irc < 0)
+    if (camera_state != CAMERA_STATE_ACTIVE)
     {
-        printf("[%s] camera_read() failed\n", __func__);
-        rval = -1;
-        goto out;
+        return rval;
     }
 
-    /* Put camera into sleep mode */
-    irc = camera_write(0x0E, val | (1 << 3));
+    /* Put camera into sleep mode. Its registers are kept, so waking it is one write. */
+    irc = camera_write(REG0E, reg0e | REG0E_SLEEP);
     if (irc < 0)
     {
         printf("[%s] camera_write() failed\n", __func__);
-        rval = -1;
+        return -1;
     }
-out:
+    reg0e |= REG0E_SLEEP;
+
+    camera_state = CAMERA_STATE_STANDBY;
     return rval;
 }
 
+camera_state_t camera_get_state(void)
+{
+    return camera_state;
+}
+
+/* Whether the sensor has been awake long enough to give a usable frame */
+bool camera_ready(void)
+{
+    return camera_state == CAMERA_STATE_ACTIVE && HAL_GetTick() - wake_tick >= CAMERA_WAKE_MS;
+}
+
 int camera_stop_dcmi(void) {
     int rval = 0;
     HAL_StatusTypeDef rc = HAL_DCMI_Stop(&hdcmi);
@@ -564,7 +463,6 @@ int camera_init(void)
     /* Reset DCMI */
     __DCMI_CLK_ENABLE();
     __HAL_RCC_DCMI_FORCE_RESET();
-    HAL_Delay(20);
     __HAL_RCC_DCMI_RELEASE_RESET();
 
     /* Configure DCMI peripheral */
@@ -594,12 +492,23 @@ int camera_init(void)
     HAL_Delay(20);
 
     /* Configure camera size */
-    camera_setQVGA();
+    if (camera_setQVGA() < 0)
+    {
+        return -1;
+    }
 
     /* Don't reset camera sensor timing when mode changes. */
-    camera_read(0x6F, &val);
+    camera_read(REG6F, &val);
     val &= ~(1 << 7);
-    camera_write(0x6F, val);
+    camera_write(REG6F, val);
+
+    /* Wait in standby until the first scan */
+    if (camera_write(REG0E, reg0e | REG0E_SLEEP) < 0)
+    {
+        return -1;
+    }
+    reg0e |= REG0E_SLEEP;
+    camera_state = CAMERA_STATE_STANDBY;
 
     // printf("CAMERA INIT COMPLETE!\n");
     return 0;
@@ -616,4 +525,6 @@ void camera_uninit(void)
 
     /* Disable DCMI clock */
     __DCMI_CLK_DISABLE();
+
+    camera_state = CAMERA_STATE_OFF;
 }
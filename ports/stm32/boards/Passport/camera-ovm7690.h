@@ -39,11 +39,44 @@
 #ifndef __CAMERA_OVM7690_H
 #define __CAMERA_OVM7690_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define CAMERA_WIDTH 396
 #define CAMERA_HEIGHT 330
 #define FRAMEBUF_SIZE (CAMERA_WIDTH * CAMERA_HEIGHT)
+
+/* Write runs of consecutive registers in one I2C transaction, relying on the
+ * sensor's SCCB address auto-increment. Off until that's been checked on
+ * Passport hardware, so each register is its own transaction.
+ */
+#ifndef CAMERA_I2C_BURST
+#define CAMERA_I2C_BURST 0
+#endif
+
+/* Longest run written in one transaction */
+#define CAMERA_MAX_BURST 32
+
+/* How long the sensor takes to give a properly exposed frame after leaving
+ * standby: two frames at 30 fps
+ */
+#define CAMERA_WAKE_MS 67
+
+/* Power states:
+ *   OFF:     not initialized
+ *   STANDBY: sensor asleep (REG0E bit 3) with its registers kept, DCMI stopped
+ *   ACTIVE:  sensor streaming, ready for snapshots once CAMERA_WAKE_MS has passed
+ */
+typedef enum
+{
+    CAMERA_STATE_OFF = 0,
+    CAMERA_STATE_STANDBY,
+    CAMERA_STATE_ACTIVE,
+} camera_state_t;
+
+/* Writes `len` values starting at register `reg`; returns < 0 on failure */
+typedef int (*camera_reg_writer_t)(uint8_t reg, const uint8_t *vals, size_t len);
 #if 0 /* Not used for now */
 /* Camera registers */
 #define GAIN 0x00
@@ -202,5 +235,13 @@ extern uint16_t *camera_get_frame_buffer(void);
 extern int camera_snapshot(void);
 extern int camera_continuous(void);
 extern void camera_stop(void);
+extern camera_state_t camera_get_state(void);
+extern bool camera_ready(void);
+
+/* Writes the sensor settings through `write`, assuming it was just reset.
+ * With `burst`, runs of consecutive registers are passed in one call.
+ * Defined in camera-ovm7690-regs.c.
+ */
+extern int camera_write_init_regs(camera_reg_writer_t write, bool burst);
 
 #endif /* __CAMERA_OVM7960_H */
@@ -13,7 +13,7 @@
 
 #include "utils.h"
 #include "fwheader.h"
-#include "sha256.h"
+#include "hash_engine.h"
 #ifndef PASSPORT_COSIGN_TOOL
 #include "secrets.h"
 #endif
@@ -26,18 +26,18 @@ void hash_bl(
     uint8_t hashlen
 )
 {
-    SHA256_CTX  ctx;
+    hash_engine_ctx_t ctx;
 
-    sha256_init(&ctx);
+    hash_engine_sha256_init(&ctx);
 
     /* Checksum the bootloader */
-    sha256_update(&ctx, bl, bllen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_update(&ctx, bl, bllen);
+    hash_engine_sha256_final(&ctx, hash);
 
     /* double SHA256 */
-    sha256_init(&ctx);
-    sha256_update(&ctx, hash, hashlen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, hash, hashlen);
+    hash_engine_sha256_final(&ctx, hash);
 }
 
 // This hash is used for the integrity check of the firmware and is not user-facing
@@ -49,21 +49,21 @@ void hash_fw(
     uint8_t hashlen
 )
 {
-    SHA256_CTX  ctx;
+    hash_engine_ctx_t ctx;
 
-    sha256_init(&ctx);
+    hash_engine_sha256_init(&ctx);
 
     // Checksum the info block too
-    sha256_update(&ctx, (uint8_t *)hdr, sizeof(fw_info_t));
+    hash_engine_sha256_update(&ctx, (uint8_t *)hdr, sizeof(fw_info_t));
 
     /* Checksum the firmware */
-    sha256_update(&ctx, fw, fwlen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_update(&ctx, fw, fwlen);
+    hash_engine_sha256_final(&ctx, hash);
 
     /* double SHA256 */
-    sha256_init(&ctx);
-    sha256_update(&ctx, hash, hashlen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, hash, hashlen);
+    hash_engine_sha256_final(&ctx, hash);
 }
 
 
@@ -79,7 +79,7 @@ void hash_fw_user(
     bool exclude_hdr
 )
 {
-    SHA256_CTX  ctx;
+    hash_engine_ctx_t ctx;
 
     // Skip the whole header if requested
     if (exclude_hdr) {
@@ -87,9 +87,9 @@ void hash_fw_user(
         fwlen -= FW_HEADER_SIZE;
     }
 
-    sha256_init(&ctx);
-    sha256_update(&ctx, fw, fwlen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, fw, fwlen);
+    hash_engine_sha256_final(&ctx, hash);
 }
 
 #ifndef PASSPORT_COSIGN_TOOL
@@ -100,49 +100,49 @@ void hash_board(
     uint8_t hashlen
 )
 {
-    SHA256_CTX  ctx;
+    hash_engine_ctx_t ctx;
     FLASH_TypeDef *flash = (FLASH_TypeDef *)FLASH_R_BASE;
     uint32_t options = (uint32_t)(flash->OPTSR_CUR & FLASH_OPTSR_RDP_Msk);
 
-    sha256_init(&ctx);
+    hash_engine_sha256_init(&ctx);
     /* Add in firmware signature */
-    sha256_update(&ctx, fw_hash, fw_hash_len);
+    hash_engine_sha256_update(&ctx, fw_hash, fw_hash_len);
     /* Add SE serial number */
-    sha256_update(&ctx, rom_secrets->se_serial_number, sizeof(rom_secrets->se_serial_number));
+    hash_engine_sha256_update(&ctx, rom_secrets->se_serial_number, sizeof(rom_secrets->se_serial_number));
     /* Add option bytes */
-    sha256_update(&ctx, (uint8_t *)&options, sizeof(uint32_t));
+    hash_engine_sha256_update(&ctx, (uint8_t *)&options, sizeof(uint32_t));
     /* Add unique device ID */
-    sha256_update(&ctx, (uint8_t *)UID_BASE, UID_LEN);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_update(&ctx, (uint8_t *)UID_BASE, UID_LEN);
+    hash_engine_sha256_final(&ctx, hash);
 
     /* double SHA256 */
-    sha256_init(&ctx);
-    sha256_update(&ctx, hash, hashlen);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, hash, hashlen);
+    hash_engine_sha256_final(&ctx, hash);
 }
 
 void get_device_hash(uint8_t *hash)
 {
-    SHA256_CTX  ctx;
-    sha256_init(&ctx);
+    hash_engine_ctx_t ctx;
+    hash_engine_sha256_init(&ctx);
 
     /* Add SE serial number */
-    sha256_update(&ctx, rom_secrets->se_serial_number, sizeof(rom_secrets->se_serial_number));
+    hash_engine_sha256_update(&ctx, rom_secrets->se_serial_number, sizeof(rom_secrets->se_serial_number));
 
     /* One-time pad */
-    sha256_update(&ctx, rom_secrets->otp_key, sizeof(rom_secrets->otp_key));
+    hash_engine_sha256_update(&ctx, rom_secrets->otp_key, sizeof(rom_secrets->otp_key));
 
     /* Pairing secret */
-    sha256_update(&ctx, rom_secrets->pairing_secret, sizeof(rom_secrets->pairing_secret));
+    hash_engine_sha256_update(&ctx, rom_secrets->pairing_secret, sizeof(rom_secrets->pairing_secret));
 
     /* Add unique device ID from MCU */
-    sha256_update(&ctx, (uint8_t *)UID_BASE, UID_LEN);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_update(&ctx, (uint8_t *)UID_BASE, UID_LEN);
+    hash_engine_sha256_final(&ctx, hash);
 
     /* double SHA256 */
-    sha256_init(&ctx);
-    sha256_update(&ctx, hash, 32);
-    sha256_final(&ctx, hash);
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, hash, 32);
+    hash_engine_sha256_final(&ctx, hash);
 }
 
 bool get_serial_number(
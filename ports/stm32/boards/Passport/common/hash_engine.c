@@ -0,0 +1,332 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// hash_engine.c - SHA-256 and HMAC-SHA256 on the STM32H7 HASH peripheral, or in software
+//
+// See hash_engine.h for how the backend is chosen.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "hash_engine.h"
+
+static void wipe(void *p, size_t len)
+{
+    volatile uint8_t *v = (volatile uint8_t *)p;
+    while (len--) {
+        *v++ = 0;
+    }
+}
+
+#if HASH_ENGINE_HW
+
+#include "stm32h7xx_hal.h"
+
+#if MICROPY_HW_ENABLE_HASH
+#include "dma.h"
+
+// Buffers smaller than this aren't worth setting up a DMA transfer for
+#define DMA_MIN_WORDS 256
+
+// NDTR is 16 bits, so longer buffers go in several transfers
+#define DMA_MAX_WORDS 0xFFFC
+#endif
+
+enum {
+    STATE_IDLE = 0,  // Initialized, nothing written to the peripheral yet
+    STATE_ACTIVE,    // This context is the one loaded in the peripheral
+    STATE_SAVED,     // Suspended: the peripheral's registers are saved in the context
+};
+
+// SHA-256, with the peripheral swapping the bytes of each word so data can be written as it
+// sits in memory
+#define CR_SHA256 (HASH_CR_ALGO_0 | HASH_CR_ALGO_1 | HASH_CR_DATATYPE_1)
+
+// The context loaded in the peripheral, if any
+static hash_engine_ctx_t *current;
+
+static void save_context(hash_engine_ctx_t *ctx)
+{
+    // The registers can only be saved between blocks
+    while (HASH->SR & HASH_SR_BUSY) {
+    }
+
+    ctx->imr = HASH->IMR;
+    ctx->str = HASH->STR;
+    ctx->cr = HASH->CR;
+    for (int i = 0; i < HASH_ENGINE_NUM_CSR; i++) {
+        ctx->csr[i] = HASH->CSR[i];
+    }
+    ctx->state = STATE_SAVED;
+}
+
+static void restore_context(hash_engine_ctx_t *ctx)
+{
+    HASH->IMR = ctx->imr;
+    HASH->STR = ctx->str;
+    HASH->CR = ctx->cr;
+    HASH->CR |= HASH_CR_INIT;
+    for (int i = 0; i < HASH_ENGINE_NUM_CSR; i++) {
+        HASH->CSR[i] = ctx->csr[i];
+    }
+}
+
+// Loads `ctx` into the peripheral, saving whichever context was there before
+static void acquire(hash_engine_ctx_t *ctx)
+{
+    if (current == ctx) {
+        return;
+    }
+
+    if (current != NULL) {
+        save_context(current);
+    }
+
+    if (ctx->state == STATE_SAVED) {
+        restore_context(ctx);
+    } else {
+        __HAL_RCC_HASH_CLK_ENABLE();
+        HASH->CR = CR_SHA256;
+        HASH->CR |= HASH_CR_INIT;
+    }
+
+    ctx->state = STATE_ACTIVE;
+    current = ctx;
+}
+
+#if MICROPY_HW_ENABLE_HASH
+// DMA1 and DMA2 can't reach the TCMs, so anything there goes through the CPU
+static bool dma_can_read(const uint8_t *data, size_t len)
+{
+    uint32_t start = (uint32_t)data;
+    uint32_t end = start + len;
+
+    if (start & 3) {
+        return false;
+    }
+    if (start >= FLASH_BANK1_BASE && end <= FLASH_END + 1) {
+        return true;
+    }
+    if (start >= D1_AXISRAM_BASE && end <= D1_AXISRAM_BASE + 0x80000) {
+        return true;
+    }
+    if (start >= D2_AHBSRAM_BASE && end <= D2_AHBSRAM_BASE + 0x48000) {
+        return true;
+    }
+    return false;
+}
+
+static void write_words_dma(const uint8_t *data, size_t num_words)
+{
+    DMA_HandleTypeDef hdma;
+
+    // The DMA reads memory, not the cache
+    if ((uint32_t)data >= D1_AXISRAM_BASE && (SCB->CCR & SCB_CCR_DC_Msk)) {
+        uint32_t addr = (uint32_t)data & ~31;
+        SCB_CleanDCache_by_Addr((uint32_t *)addr, num_words * 4 + ((uint32_t)data & 31));
+    }
+
+    // MDMAT keeps the peripheral from finishing the digest when each transfer ends
+    HASH->CR |= HASH_CR_DMAE | HASH_CR_MDMAT;
+
+    while (num_words > 0) {
+        size_t n = num_words > DMA_MAX_WORDS ? DMA_MAX_WORDS : num_words;
+
+        dma_init(&hdma, &dma_HASH_IN, DMA_MEMORY_TO_PERIPH, NULL);
+        HAL_DMA_Start(&hdma, (uint32_t)data, (uint32_t)&HASH->DIN, n);
+        HAL_DMA_PollForTransfer(&hdma, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+        dma_deinit(&dma_HASH_IN);
+
+        data += n * 4;
+        num_words -= n;
+    }
+
+    HASH->CR &= ~(HASH_CR_DMAE | HASH_CR_MDMAT);
+    while (HASH->SR & HASH_SR_DMAS) {
+    }
+}
+#endif // MICROPY_HW_ENABLE_HASH
+
+static void write_words(const uint8_t *data, size_t num_words)
+{
+#if MICROPY_HW_ENABLE_HASH
+    if (num_words >= DMA_MIN_WORDS && dma_can_read(data, num_words * 4)) {
+        write_words_dma(data, num_words);
+        return;
+    }
+#endif
+
+    // The peripheral holds the bus while its FIFO is full, so there's nothing to poll
+    while (num_words--) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        HASH->DIN = word;
+        data += 4;
+    }
+}
+
+void hash_engine_sha256_init(hash_engine_ctx_t *ctx)
+{
+    if (current == ctx) {
+        current = NULL;
+    }
+    wipe(ctx, sizeof(*ctx));
+    ctx->state = STATE_IDLE;
+}
+
+void hash_engine_sha256_update(hash_engine_ctx_t *ctx, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    acquire(ctx);
+
+    if (ctx->num_pending > 0) {
+        while (ctx->num_pending < 4 && len > 0) {
+            ctx->pending[ctx->num_pending++] = *data++;
+            len--;
+        }
+        if (ctx->num_pending < 4) {
+            return;
+        }
+        write_words(ctx->pending, 1);
+        ctx->num_pending = 0;
+    }
+
+    write_words(data, len / 4);
+    data += len & ~3;
+    len &= 3;
+
+    memcpy(ctx->pending, data, len);
+    ctx->num_pending = len;
+}
+
+void hash_engine_sha256_final(hash_engine_ctx_t *ctx, uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH])
+{
+    acquire(ctx);
+
+    // NBLW is the number of valid bits in the last word, where 0 means all of them
+    HASH->STR = (ctx->num_pending * 8) & HASH_STR_NBLW;
+    if (ctx->num_pending > 0) {
+        memset(ctx->pending + ctx->num_pending, 0, 4 - ctx->num_pending);
+        write_words(ctx->pending, 1);
+    }
+    HASH->STR |= HASH_STR_DCAL;
+
+    while (!(HASH->SR & HASH_SR_DCIS)) {
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint32_t word = HASH_DIGEST->HR[i];
+        digest[i * 4 + 0] = word >> 24;
+        digest[i * 4 + 1] = word >> 16;
+        digest[i * 4 + 2] = word >> 8;
+        digest[i * 4 + 3] = word;
+    }
+
+    current = NULL;
+    wipe(ctx, sizeof(*ctx));
+}
+
+void hash_engine_sha256_copy(hash_engine_ctx_t *dst, hash_engine_ctx_t *src)
+{
+    // The copy needs the registers in memory. `src` is loaded again when it's next used.
+    if (current == src) {
+        save_context(src);
+        current = NULL;
+    }
+    if (current == dst) {
+        current = NULL;
+    }
+    memcpy(dst, src, sizeof(*dst));
+}
+
+void hash_engine_sha256_release(hash_engine_ctx_t *ctx)
+{
+    if (current == ctx) {
+        current = NULL;
+    }
+    wipe(ctx, sizeof(*ctx));
+}
+
+#else // HASH_ENGINE_HW
+
+#include "sha256.h"
+
+_Static_assert(sizeof(SHA256_CTX) <= HASH_ENGINE_SW_CTX_SIZE, "HASH_ENGINE_SW_CTX_SIZE is too small");
+
+#define SW_CTX(ctx) ((SHA256_CTX *)(ctx)->sw.bytes)
+
+void hash_engine_sha256_init(hash_engine_ctx_t *ctx)
+{
+    sha256_init(SW_CTX(ctx));
+}
+
+void hash_engine_sha256_update(hash_engine_ctx_t *ctx, const uint8_t *data, size_t len)
+{
+    sha256_update(SW_CTX(ctx), data, len);
+}
+
+void hash_engine_sha256_final(hash_engine_ctx_t *ctx, uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH])
+{
+    sha256_final(SW_CTX(ctx), digest);
+    wipe(ctx, sizeof(*ctx));
+}
+
+void hash_engine_sha256_copy(hash_engine_ctx_t *dst, hash_engine_ctx_t *src)
+{
+    memcpy(dst, src, sizeof(*dst));
+}
+
+void hash_engine_sha256_release(hash_engine_ctx_t *ctx)
+{
+    wipe(ctx, sizeof(*ctx));
+}
+
+#endif // HASH_ENGINE_HW
+
+void hash_engine_sha256(const uint8_t *data, size_t len, uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH])
+{
+    hash_engine_ctx_t ctx;
+
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, data, len);
+    hash_engine_sha256_final(&ctx, digest);
+}
+
+void hash_engine_hmac_sha256(const uint8_t *key,
+                             size_t key_len,
+                             const uint8_t *msg,
+                             size_t msg_len,
+                             uint8_t hmac[HASH_ENGINE_SHA256_DIGEST_LENGTH])
+{
+    uint8_t i_key_pad[HASH_ENGINE_SHA256_BLOCK_LENGTH];
+    uint8_t o_key_pad[HASH_ENGINE_SHA256_BLOCK_LENGTH];
+    hash_engine_ctx_t ctx;
+
+    memset(i_key_pad, 0, sizeof(i_key_pad));
+    if (key_len > HASH_ENGINE_SHA256_BLOCK_LENGTH) {
+        hash_engine_sha256(key, key_len, i_key_pad);
+    } else {
+        memcpy(i_key_pad, key, key_len);
+    }
+
+    for (int i = 0; i < HASH_ENGINE_SHA256_BLOCK_LENGTH; i++) {
+        o_key_pad[i] = i_key_pad[i] ^ 0x5c;
+        i_key_pad[i] ^= 0x36;
+    }
+
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, i_key_pad, sizeof(i_key_pad));
+    hash_engine_sha256_update(&ctx, msg, msg_len);
+    hash_engine_sha256_final(&ctx, hmac);
+
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, o_key_pad, sizeof(o_key_pad));
+    hash_engine_sha256_update(&ctx, hmac, HASH_ENGINE_SHA256_DIGEST_LENGTH);
+    hash_engine_sha256_final(&ctx, hmac);
+
+    wipe(i_key_pad, sizeof(i_key_pad));
+    wipe(o_key_pad, sizeof(o_key_pad));
+}
@@ -131,6 +131,29 @@ HAL_StatusTypeDef spi_write(uint32_t addr, int len, const uint8_t *buf)
     return rv;
 }
 
+HAL_StatusTypeDef spi_sector_erase(uint32_t addr)
+{
+    // erase the 4k sector holding addr: 40-200ms
+    HAL_StatusTypeDef rv = write_enable();
+    if (rv) return rv;
+
+    uint8_t     pkt[4] = { CMD_SEC_ERASE,
+                            (addr>>16) & 0xff, (addr >> 8) & 0xff, addr & 0xff
+                        };
+
+    CS_LOW();
+
+    rv = HAL_SPI_Transmit(&sf_spi_port, pkt, sizeof(pkt), HAL_MAX_DELAY);
+
+    CS_HIGH();
+
+    if (rv == HAL_OK) {
+        rv = wait_wip_done();
+    }
+
+    return rv;
+}
+
 HAL_StatusTypeDef spi_setup(void)
 {
     // enable some internal clocks
@@ -0,0 +1,156 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// deriv_path.c - Parse BIP32 derivation paths like "m/84'/0'/0'" without the regex engine
+//
+// This is a single pass over the string with no allocations. It replaces a regex match, a
+// str.split('/') and an int() per component, which was slow enough to show up when signing
+// and exporting, since every derivation went through it.
+
+#include "deriv_path.h"
+
+static inline char to_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline bool is_hardened_mark(char c)
+{
+    c = to_lower(c);
+    return c == '\'' || c == 'h' || c == 'p';
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+deriv_path_err_t deriv_path_parse(const char* path,
+                                  size_t len,
+                                  uint8_t flags,
+                                  uint32_t* out,
+                                  size_t max_depth,
+                                  size_t* depth,
+                                  uint8_t* star)
+{
+    bool strict = (flags & DERIV_PATH_STRICT) != 0;
+    size_t num_components = 0;
+    size_t n = 0;
+    size_t start = 0;
+
+    *star = DERIV_PATH_NO_STAR;
+
+    // Check the characters first so junk is reported as such, whatever else is wrong with it
+    for (size_t i = 0; i < len; i++) {
+        char c = path[i];
+        if (is_digit(c) || c == '/' || is_hardened_mark(c)) {
+            continue;
+        }
+        if (i == 0 && to_lower(c) == 'm') {
+            continue;
+        }
+        if (c == '*' && (flags & DERIV_PATH_ALLOW_STAR) &&
+            (i == len - 1 || (i == len - 2 && is_hardened_mark(path[i + 1])))) {
+            continue;
+        }
+        return DERIV_PATH_ERR_CHARS;
+    }
+
+    if (len > 0 && to_lower(path[0]) == 'm') {
+        if (len == 1) {
+            *depth = 0;
+            return DERIV_PATH_OK;
+        }
+        if (path[1] != '/') {
+            // Like "m12"
+            return DERIV_PATH_ERR_COMPONENT;
+        }
+        start = 2;
+    } else if (len == 0) {
+        *depth = 0;
+        return DERIV_PATH_OK;
+    }
+
+    while (true) {
+        size_t end = start;
+        while (end < len && path[end] != '/') {
+            end++;
+        }
+
+        const char* comp = path + start;
+        size_t comp_len = end - start;
+
+        if (comp_len == 0) {
+            if (strict) {
+                return DERIV_PATH_ERR_EMPTY;
+            }
+        } else {
+            if (++num_components > max_depth) {
+                return DERIV_PATH_ERR_DEPTH;
+            }
+
+            // The character check above only allows a star in the last component
+            if (comp[0] == '*') {
+                if (comp_len == 1) {
+                    *star = DERIV_PATH_STAR;
+                } else if (comp_len == 2 && is_hardened_mark(comp[1])) {
+                    *star = DERIV_PATH_STAR_HARDENED;
+                } else {
+                    return DERIV_PATH_ERR_WILDCARD;
+                }
+            } else {
+                bool hardened = is_hardened_mark(comp[comp_len - 1]);
+                size_t num_digits = comp_len - (hardened ? 1 : 0);
+                uint32_t value = 0;
+
+                if (num_digits == 0) {
+                    return strict ? DERIV_PATH_ERR_EMPTY : DERIV_PATH_ERR_COMPONENT;
+                }
+                if (strict && num_digits > 1 && comp[0] == '0') {
+                    return DERIV_PATH_ERR_COMPONENT;
+                }
+
+                for (size_t i = 0; i < num_digits; i++) {
+                    if (!is_digit(comp[i])) {
+                        return comp[i] == '*' ? DERIV_PATH_ERR_WILDCARD : DERIV_PATH_ERR_COMPONENT;
+                    }
+                    uint32_t digit = comp[i] - '0';
+                    if (value > (DERIV_PATH_HARDENED - 1 - digit) / 10) {
+                        return DERIV_PATH_ERR_COMPONENT;
+                    }
+                    value = value * 10 + digit;
+                }
+
+                out[n++] = hardened ? (value | DERIV_PATH_HARDENED) : value;
+            }
+        }
+
+        if (end == len) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    *depth = n;
+    return DERIV_PATH_OK;
+}
+
+const char* deriv_path_err_str(deriv_path_err_t err)
+{
+    switch (err) {
+        case DERIV_PATH_OK:
+            return "ok";
+        case DERIV_PATH_ERR_CHARS:
+            return "invalid characters";
+        case DERIV_PATH_ERR_EMPTY:
+            return "empty path component";
+        case DERIV_PATH_ERR_COMPONENT:
+            return "bad component";
+        case DERIV_PATH_ERR_DEPTH:
+            return "too deep";
+        case DERIV_PATH_ERR_WILDCARD:
+            return "bad wildcard";
+        default:
+            return "invalid path";
+    }
+}
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// deriv_path.h - Parse BIP32 derivation paths like "m/84'/0'/0'" without the regex engine
+
+#ifndef __DERIV_PATH_H__
+#define __DERIV_PATH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DERIV_PATH_HARDENED 0x80000000
+
+// Flags for deriv_path_parse()
+#define DERIV_PATH_STRICT 0x01      // Reject empty components and non-canonical numbers like 007
+#define DERIV_PATH_ALLOW_STAR 0x02  // Allow * or *' as the last component
+
+// Values returned in *star
+#define DERIV_PATH_NO_STAR 0
+#define DERIV_PATH_STAR 1
+#define DERIV_PATH_STAR_HARDENED 2
+
+typedef enum {
+    DERIV_PATH_OK = 0,
+    DERIV_PATH_ERR_CHARS,
+    DERIV_PATH_ERR_EMPTY,
+    DERIV_PATH_ERR_COMPONENT,
+    DERIV_PATH_ERR_DEPTH,
+    DERIV_PATH_ERR_WILDCARD,
+} deriv_path_err_t;
+
+// Parses `path` into `out`, one uint32 per component with DERIV_PATH_HARDENED set for
+// hardened components, and sets *depth to the number of components. The 'm' prefix is optional,
+// and ', h and p (in either case) all mark a hardened component. A wildcard is not stored in
+// `out` but counts towards `max_depth`.
+//
+// Without DERIV_PATH_STRICT, empty components (from leading, trailing or doubled slashes) are
+// skipped and leading zeros are accepted, the same as splitting on '/' and calling int().
+//
+// On error, returns the reason and leaves *depth and *star undefined.
+extern deriv_path_err_t deriv_path_parse(const char* path,
+                                         size_t len,
+                                         uint8_t flags,
+                                         uint32_t* out,
+                                         size_t max_depth,
+                                         size_t* depth,
+                                         uint8_t* star);
+
+extern const char* deriv_path_err_str(deriv_path_err_t err);
+
+#endif // __DERIV_PATH_H__
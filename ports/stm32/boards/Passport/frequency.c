@@ -12,9 +12,11 @@
 
 #include "uart.h"
 
+#include "adc.h"
 #include "backlight.h"
 #include "frequency.h"
 #include "se.h"
+#include "spi.h"
 
 #define LOW_FREQUENCY    64000000
 // #define HIGH_FREQUENCY  240000000
@@ -46,9 +48,6 @@ void frequency_turbo(
 
     // printf("[%s] %s\n", __func__, enable ? "true":"false");
 
-    // HACK: TEMP - always be in high speed mode
-    enable = true;
-
     if ((!enable && (SystemCoreClock == LOW_FREQUENCY)) ||
         (enable && (SystemCoreClock == HIGH_FREQUENCY)))
         return; /* Already at requested frequency...nothing to do */
@@ -149,11 +148,17 @@ void frequency_turbo(
     /* Adjust the backlight PWM based on the new frequency */
     backlight_adjust(enable);
 
+    /* Keep the ADC scans at the same rate */
+    adc_adjust();
+
     /* Re-initialize the console UART based on the new frequency */
     frequency_update_console_uart();
 
     /* Re-initialize the SE UART based on the new frequency */
     se_setup();
 
+    /* Re-pick the SPI prescalers for the new bus clocks */
+    spi_update_baudrates();
+
     //printf("%lu, %lu, %lu, %lu, %lu\n", HAL_RCC_GetSysClockFreq(), SystemCoreClock, HAL_RCC_GetHCLKFreq(), HAL_RCC_GetPCLK1Freq(), HAL_RCC_GetPCLK2Freq());
 }
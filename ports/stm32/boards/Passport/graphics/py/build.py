@@ -79,11 +79,15 @@ def doit(outfname, fnames):
 #
 # autogenerated; don't edit
 #
+from micropython import const
+
 class Graphics:
     # (w,h, w_bytes, wbits, data)
 
 """)
 
+    names = []
+
     for fn in fnames:
         if fn.endswith('.txt'):
             img = read_text(fn)
@@ -109,9 +113,24 @@ class Graphics:
         print("    %s = (%d, %d,  %d, %s, %r)\n" % (varname, w, h, ((w+7)//8),
                         wbits if is_comp else 0, raw if not is_comp else comp), file=fp)
 
+        names.append(varname)
         print("done: '%s' (%d x %d)" % (varname, w, h))
 
+    write_index(fp, names)
+
     fp.write("\n# EOF\n")
 
+def write_index(fp, names):
+    # Icon ids are positions in Graphics.icons. Code that draws a fixed icon uses the ICON_*
+    # constants; names built at runtime (e.g. 'tetris_pattern_' + n) go through Graphics.ids.
+    fp.write("    # Indexed by icon id\n")
+    fp.write("    icons = (%s)\n\n" % ', '.join(names))
+    fp.write("    # Icon name -> id\n")
+    fp.write("    ids = {%s}\n\n" % ', '.join("'%s': %d" % (n, i) for i, n in enumerate(names)))
+
+    for i, n in enumerate(names):
+        fp.write("ICON_%s = const(%d)\n" % (n.upper(), i))
+    fp.write("ICON_COUNT = const(%d)\n" % len(names))
+
 if 1:
     doit('graphics.py', sys.argv[1:])
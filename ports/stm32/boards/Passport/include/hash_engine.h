@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// hash_engine.h - SHA-256 and HMAC-SHA256 on the STM32H7 HASH peripheral, or in software
+//
+// The backend is picked at build time. With HASH_ENGINE_HW=1 the HASH peripheral does the
+// compression and, when MICROPY_HW_ENABLE_HASH is also set, large buffers are fed to it by DMA.
+// Otherwise the software implementation in sha256.c is used, which is what the bootloader, the
+// host tools and the test harness build.
+//
+// Several contexts can be in progress at once (a PSBT keeps hashPrevouts, hashSequence and
+// hashOutputs going together). The peripheral only holds one, so the engine saves the current
+// one into its context struct and restores the next whenever the caller switches between them.
+// Because of that, a context must not be copied with memcpy() while in use: use
+// hash_engine_sha256_copy(), and hash_engine_sha256_release() on one that's being abandoned.
+
+#ifndef __HASH_ENGINE_H__
+#define __HASH_ENGINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HASH_ENGINE_HW
+#define HASH_ENGINE_HW 0
+#endif
+
+#define HASH_ENGINE_SHA256_BLOCK_LENGTH 64
+#define HASH_ENGINE_SHA256_DIGEST_LENGTH 32
+
+// Big enough for SHA256_CTX from sha256.h, which can't be included here because trezor-crypto
+// has a different type with the same name. hash_engine.c checks the size.
+#define HASH_ENGINE_SW_CTX_SIZE 112
+
+// Context registers to save for SHA-256: HASH_CSR0 to HASH_CSR37 ("Context swapping" in RM0433)
+#define HASH_ENGINE_NUM_CSR 38
+
+typedef struct {
+#if HASH_ENGINE_HW
+    uint32_t imr;
+    uint32_t str;
+    uint32_t cr;
+    uint32_t csr[HASH_ENGINE_NUM_CSR];
+    uint8_t pending[4];  // Bytes that don't make up a whole word yet
+    uint8_t num_pending;
+    uint8_t state;
+#else
+    union {
+        uint64_t align;
+        uint8_t bytes[HASH_ENGINE_SW_CTX_SIZE];
+    } sw;
+#endif
+} hash_engine_ctx_t;
+
+extern void hash_engine_sha256_init(hash_engine_ctx_t *ctx);
+extern void hash_engine_sha256_update(hash_engine_ctx_t *ctx, const uint8_t *data, size_t len);
+
+// Writes the digest and wipes the context. It has to be initialized again before reuse.
+extern void hash_engine_sha256_final(hash_engine_ctx_t *ctx, uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH]);
+
+// Makes `dst` an independent copy of `src`, e.g. to take a digest and keep hashing `src`
+extern void hash_engine_sha256_copy(hash_engine_ctx_t *dst, hash_engine_ctx_t *src);
+
+// Wipes a context without computing the digest
+extern void hash_engine_sha256_release(hash_engine_ctx_t *ctx);
+
+extern void hash_engine_sha256(const uint8_t *data, size_t len, uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH]);
+
+// Keys longer than the block size are hashed first, as in RFC 2104
+extern void hash_engine_hmac_sha256(const uint8_t *key,
+                                    size_t key_len,
+                                    const uint8_t *msg,
+                                    size_t msg_len,
+                                    uint8_t hmac[HASH_ENGINE_SHA256_DIGEST_LENGTH]);
+
+#endif // __HASH_ENGINE_H__
@@ -10,5 +10,6 @@
 extern HAL_StatusTypeDef spi_setup(void);
 extern HAL_StatusTypeDef spi_write(uint32_t addr, int len, const uint8_t *buf);
 extern HAL_StatusTypeDef spi_read(uint32_t addr, int len, uint8_t *buf);
+extern HAL_StatusTypeDef spi_sector_erase(uint32_t addr);
 
 #endif /* _SPIFLASH_H_ */
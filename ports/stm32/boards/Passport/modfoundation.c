@@ -41,6 +41,14 @@
 // QRCode includes
 #include "qrcode.h"
 
+// Derivation path includes
+#include "deriv_path.h"
+#include "py/objarray.h"
+
+// Address index includes
+#include "addr_index.h"
+#include "py/stream.h"
+
 #include "adc.h"
 #include "busy_bar.h"
 #include "dispatch.h"
@@ -54,11 +62,16 @@
 #include "se.h"
 #include "stm32h7xx_hal.h"
 #include "utils.h"
-#include "sha256.h"
+#include "hash_engine.h"
 #include "se-config.h"
 #include "pins.h"
 #include "uECC.h"
 #include "hash.h"
+#include "spiflash.h"
+
+// Block device includes
+#include "py/mperrno.h"
+#include "extmod/vfs.h"
 
 /* lcd class object, expand as needed with instance related details */
 typedef struct _mp_obj_lcd_t
@@ -121,6 +134,14 @@ typedef struct _mp_obj_SettingsFlash_t
     mp_obj_base_t base;
 } mp_obj_SettingsFlash_t;
 
+/* External SPI flash block device class object */
+typedef struct _mp_obj_SPIFlashBlockDev_t
+{
+    mp_obj_base_t base;
+    uint32_t start;
+    uint32_t len;
+} mp_obj_SPIFlashBlockDev_t;
+
 /* System class object */
 typedef struct _mp_obj_System_t
 {
@@ -133,6 +154,18 @@ typedef struct _mp_obj_bip39_t
     mp_obj_base_t base;
 } mp_obj_bip39_t;
 
+/* DerivPath class object */
+typedef struct _mp_obj_DerivPath_t
+{
+    mp_obj_base_t base;
+} mp_obj_DerivPath_t;
+
+/* AddrIndex class object */
+typedef struct _mp_obj_AddrIndex_t
+{
+    mp_obj_base_t base;
+} mp_obj_AddrIndex_t;
+
 /* QRCode class object */
 typedef struct _mp_obj_QRCode_t
 {
@@ -148,6 +181,10 @@ typedef struct _mp_obj_QRCode_t
 #define SETTINGS_FLASH_SIZE 0x20000
 #define SETTINGS_FLASH_END (SETTINGS_FLASH_START + SETTINGS_FLASH_SIZE - 1)
 
+#define SPI_FLASH_TOTAL_SIZE (2048 * 1024)
+#define SPI_FLASH_PAGE_SIZE 256
+#define SPI_FLASH_SECTOR_SIZE 4096
+
 // Forward prototypes
 void
 turbo(bool enable);
@@ -347,15 +384,15 @@ camera_make_new(const mp_obj_type_t* type, size_t n_args, size_t n_kw, const mp_
     return MP_OBJ_FROM_PTR(o);
 }
 
-/// def enable(self, data: buffer) -> None
+/// def enable(self) -> bool
 ///     '''
-///     Turn on the camera in preparation for calling snapshot().
+///     Turn on the camera in preparation for calling snapshot(). Returns straight away; see ready().
+///     Returns False if the camera couldn't be turned on, in which case it will never be ready.
 ///     '''
 STATIC mp_obj_t
 camera_enable(mp_obj_t self)
 {
-    camera_on();
-    return mp_const_none;
+    return mp_obj_new_bool(camera_on() == 0);
 }
 
 /// def disable(self, data: buffer) -> None
@@ -369,6 +406,16 @@ camera_disable(mp_obj_t self)
     return mp_const_none;
 }
 
+/// def ready(self) -> bool
+///     '''
+///     Return True once the camera has been enabled long enough to give a usable frame.
+///     '''
+STATIC mp_obj_t
+camera_ready_(mp_obj_t self)
+{
+    return mp_obj_new_bool(camera_ready());
+}
+
 /// def snapshot(self, image: buffer) -> BoolG
 ///     '''
 ///     Start a snapshot and wait for it to finish, then convert and copy it into the provided image buffers.
@@ -441,6 +488,7 @@ camera_get_line_data(mp_obj_t self_in, mp_obj_t line, mp_obj_t _line_num)
 
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_enable_obj, camera_enable);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_disable_obj, camera_disable);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_ready_obj, camera_ready_);
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(camera_snapshot_obj, 7, 7, camera_snapshot_);
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(camera_get_line_data_obj, camera_get_line_data);
 
@@ -458,6 +506,7 @@ STATIC const mp_rom_map_elem_t camera_locals_dict_table[] = {
       MP_ROM_QSTR(MP_QSTR_foundation) },
     { MP_ROM_QSTR(MP_QSTR_enable), MP_ROM_PTR(&camera_enable_obj) },
     { MP_ROM_QSTR(MP_QSTR_disable), MP_ROM_PTR(&camera_disable_obj) },
+    { MP_ROM_QSTR(MP_QSTR_ready), MP_ROM_PTR(&camera_ready_obj) },
     { MP_ROM_QSTR(MP_QSTR_snapshot), MP_ROM_PTR(&camera_snapshot_obj) },
     { MP_ROM_QSTR(MP_QSTR_get_line_data), MP_ROM_PTR(&camera_get_line_data_obj) },
     { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&camera___del___obj) },
@@ -631,11 +680,10 @@ get_random_uint16(uint16_t* result)
     uint32_t noise2 = 0;
     uint16_t r = 0;
 
+    // Each pair is from its own ADC scan, so there's no need to wait between them
     for (int i = 0; i < 4; i++) {
         r = r << 4;
 
-        HAL_Delay(1);
-
         ret = adc_read_noise_inputs(&noise1, &noise2);
         if (ret < 0) {
             return false;
@@ -1035,6 +1083,171 @@ STATIC const mp_obj_type_t SettingsFlash_type = {
 };
 /* End of setup for internal flash class */
 
+/*=============================================================================
+ * Start of SPIFlashBlockDev class
+ *=============================================================================*/
+
+/// def __init__(self, start: int, len: int) -> None:
+///     '''
+///     Block device over a sector-aligned region of the external SPI flash,
+///     using the extended block protocol so it can be mounted with
+///     uos.VfsLfs2. Blocks are the 4K erase sectors.
+///     '''
+STATIC mp_obj_t
+SPIFlashBlockDev_make_new(const mp_obj_type_t* type, size_t n_args, size_t n_kw, const mp_obj_t* args)
+{
+    mp_arg_check_num(n_args, n_kw, 2, 2, false);
+    mp_int_t start = mp_obj_get_int(args[0]);
+    mp_int_t len = mp_obj_get_int(args[1]);
+
+    if (start < 0 || len <= 0 || start % SPI_FLASH_SECTOR_SIZE != 0 || len % SPI_FLASH_SECTOR_SIZE != 0 ||
+        start + len > SPI_FLASH_TOTAL_SIZE) {
+        mp_raise_ValueError(NULL);
+    }
+
+    mp_obj_SPIFlashBlockDev_t* o = m_new_obj(mp_obj_SPIFlashBlockDev_t);
+    o->base.type = type;
+    o->start = start;
+    o->len = len;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+// Check that len bytes at offset into block are inside the region, and return the flash address
+STATIC int32_t
+SPIFlashBlockDev_addr(mp_obj_SPIFlashBlockDev_t* self, mp_obj_t block_in, mp_obj_t offset_in, size_t len)
+{
+    uint32_t block = mp_obj_get_int(block_in);
+    uint32_t offset = offset_in == MP_OBJ_NULL ? 0 : mp_obj_get_int(offset_in);
+    uint32_t pos = block * SPI_FLASH_SECTOR_SIZE + offset;
+    if (block >= self->len / SPI_FLASH_SECTOR_SIZE || pos + len > self->len) {
+        return -1;
+    }
+    return self->start + pos;
+}
+
+/// def readblocks(self, block: int, buf: bytearray, offset: int = 0) -> int:
+///     '''
+///     Read len(buf) bytes starting at offset within block
+///     '''
+STATIC mp_obj_t
+SPIFlashBlockDev_readblocks(size_t n_args, const mp_obj_t* args)
+{
+    mp_obj_SPIFlashBlockDev_t* self = MP_OBJ_TO_PTR(args[0]);
+    mp_buffer_info_t buf_info;
+    mp_get_buffer_raise(args[2], &buf_info, MP_BUFFER_WRITE);
+
+    int32_t addr = SPIFlashBlockDev_addr(self, args[1], n_args == 4 ? args[3] : MP_OBJ_NULL, buf_info.len);
+    if (addr < 0) {
+        return MP_OBJ_NEW_SMALL_INT(-MP_EINVAL);
+    }
+    if (buf_info.len > 0 && spi_read(addr, buf_info.len, buf_info.buf) != HAL_OK) {
+        return MP_OBJ_NEW_SMALL_INT(-MP_EIO);
+    }
+    return MP_OBJ_NEW_SMALL_INT(0);
+}
+
+/// def writeblocks(self, block: int, buf: bytes, offset: int = 0) -> int:
+///     '''
+///     Program len(buf) bytes starting at offset within block. With no offset,
+///     the blocks are erased first (simple block protocol); with an offset
+///     they must already have been erased with ioctl(6, block).
+///     '''
+STATIC mp_obj_t
+SPIFlashBlockDev_writeblocks(size_t n_args, const mp_obj_t* args)
+{
+    mp_obj_SPIFlashBlockDev_t* self = MP_OBJ_TO_PTR(args[0]);
+    mp_buffer_info_t buf_info;
+    mp_get_buffer_raise(args[2], &buf_info, MP_BUFFER_READ);
+
+    int32_t addr = SPIFlashBlockDev_addr(self, args[1], n_args == 4 ? args[3] : MP_OBJ_NULL, buf_info.len);
+    if (addr < 0) {
+        return MP_OBJ_NEW_SMALL_INT(-MP_EINVAL);
+    }
+
+    if (n_args == 3) {
+        if (buf_info.len % SPI_FLASH_SECTOR_SIZE != 0) {
+            return MP_OBJ_NEW_SMALL_INT(-MP_EINVAL);
+        }
+        for (uint32_t pos = 0; pos < buf_info.len; pos += SPI_FLASH_SECTOR_SIZE) {
+            if (spi_sector_erase(addr + pos) != HAL_OK) {
+                return MP_OBJ_NEW_SMALL_INT(-MP_EIO);
+            }
+        }
+    }
+
+    // Page program can't cross a 256 byte page boundary
+    const uint8_t* buf = buf_info.buf;
+    size_t left = buf_info.len;
+    while (left > 0) {
+        size_t here = MIN(left, SPI_FLASH_PAGE_SIZE - (addr % SPI_FLASH_PAGE_SIZE));
+        if (spi_write(addr, here, buf) != HAL_OK) {
+            return MP_OBJ_NEW_SMALL_INT(-MP_EIO);
+        }
+        addr += here;
+        buf += here;
+        left -= here;
+    }
+    return MP_OBJ_NEW_SMALL_INT(0);
+}
+
+/// def ioctl(self, op: int, arg: int) -> int:
+///     '''
+///     Block device control; see uos.AbstractBlockDev
+///     '''
+STATIC mp_obj_t
+SPIFlashBlockDev_ioctl(mp_obj_t self_in, mp_obj_t op_in, mp_obj_t arg_in)
+{
+    mp_obj_SPIFlashBlockDev_t* self = MP_OBJ_TO_PTR(self_in);
+
+    switch (mp_obj_get_int(op_in)) {
+        case MP_BLOCKDEV_IOCTL_INIT:
+            // The bus may have been set up by machine.SPI for sflash.py; take it back
+            return MP_OBJ_NEW_SMALL_INT(spi_setup() == HAL_OK ? 0 : -MP_EIO);
+
+        case MP_BLOCKDEV_IOCTL_DEINIT:
+        case MP_BLOCKDEV_IOCTL_SYNC:
+            // Writes and erases complete before returning
+            return MP_OBJ_NEW_SMALL_INT(0);
+
+        case MP_BLOCKDEV_IOCTL_BLOCK_COUNT:
+            return MP_OBJ_NEW_SMALL_INT(self->len / SPI_FLASH_SECTOR_SIZE);
+
+        case MP_BLOCKDEV_IOCTL_BLOCK_SIZE:
+            return MP_OBJ_NEW_SMALL_INT(SPI_FLASH_SECTOR_SIZE);
+
+        case MP_BLOCKDEV_IOCTL_BLOCK_ERASE: {
+            int32_t addr = SPIFlashBlockDev_addr(self, arg_in, MP_OBJ_NULL, SPI_FLASH_SECTOR_SIZE);
+            if (addr < 0) {
+                return MP_OBJ_NEW_SMALL_INT(-MP_EINVAL);
+            }
+            return MP_OBJ_NEW_SMALL_INT(spi_sector_erase(addr) == HAL_OK ? 0 : -MP_EIO);
+        }
+
+        default:
+            return mp_const_none;
+    }
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(SPIFlashBlockDev_readblocks_obj, 3, 4, SPIFlashBlockDev_readblocks);
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(SPIFlashBlockDev_writeblocks_obj, 3, 4, SPIFlashBlockDev_writeblocks);
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(SPIFlashBlockDev_ioctl_obj, SPIFlashBlockDev_ioctl);
+
+STATIC const mp_rom_map_elem_t SPIFlashBlockDev_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_foundation) },
+    { MP_ROM_QSTR(MP_QSTR_readblocks), MP_ROM_PTR(&SPIFlashBlockDev_readblocks_obj) },
+    { MP_ROM_QSTR(MP_QSTR_writeblocks), MP_ROM_PTR(&SPIFlashBlockDev_writeblocks_obj) },
+    { MP_ROM_QSTR(MP_QSTR_ioctl), MP_ROM_PTR(&SPIFlashBlockDev_ioctl_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(SPIFlashBlockDev_locals_dict, SPIFlashBlockDev_locals_dict_table);
+
+STATIC const mp_obj_type_t SPIFlashBlockDev_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_SPIFlashBlockDev,
+    .make_new = SPIFlashBlockDev_make_new,
+    .locals_dict = (void*)&SPIFlashBlockDev_locals_dict,
+};
+/* End of setup for SPI flash block device class */
+
 /*=============================================================================
  * Start of System class
  *=============================================================================*/
@@ -1246,10 +1459,7 @@ System_sha256(mp_obj_t self, mp_obj_t data, mp_obj_t digest)
     mp_buffer_info_t digest_info;
     mp_get_buffer_raise(digest, &digest_info, MP_BUFFER_WRITE);
 
-    SHA256_CTX ctx;
-    sha256_init(&ctx);
-    sha256_update(&ctx, (void *)data_info.buf, data_info.len);
-    sha256_final(&ctx, digest_info.buf);
+    hash_engine_sha256(data_info.buf, data_info.len, digest_info.buf);
 
     return mp_const_none;
 }
@@ -1472,39 +1682,6 @@ System_verify_supply_chain_server_signature(mp_obj_t self, mp_obj_t hash, mp_obj
     return rc == 0 ? mp_const_false : mp_const_true;
 }
 
-#define SHA256_BLOCK_LENGTH  64
-#define SHA256_DIGEST_LENGTH 32
-
-void _hmac_sha256(uint8_t* key, uint32_t key_len, uint8_t* msg, uint32_t msg_len, uint8_t* hmac) {
-    uint8_t i_key_pad[SHA256_BLOCK_LENGTH];
-    memset(i_key_pad, 0, SHA256_BLOCK_LENGTH);
-    memcpy(i_key_pad, key, key_len);
-
-    uint8_t o_key_pad[SHA256_BLOCK_LENGTH];
-    for (int i = 0; i < SHA256_BLOCK_LENGTH; i++) {
-        o_key_pad[i] = i_key_pad[i] ^ 0x5c;
-        i_key_pad[i] ^= 0x36;
-    }
-
-    // First hash
-    SHA256_CTX ctx;
-    sha256_init(&ctx);
-    sha256_update(&ctx, i_key_pad, SHA256_BLOCK_LENGTH);
-    memset(i_key_pad, 0, SHA256_BLOCK_LENGTH);
-
-    // Add the data
-    sha256_update(&ctx, msg, msg_len);
-
-    // Hash
-    sha256_final(&ctx, hmac);
-
-    // Second hash
-    sha256_init(&ctx);
-    sha256_update(&ctx, o_key_pad, SHA256_BLOCK_LENGTH);
-    sha256_update(&ctx, hmac, SHA256_DIGEST_LENGTH);
-    sha256_final(&ctx, hmac);
-}
-
 /// def System_hmac_sha256(self, key, msg, hmac) -> None
 ///     '''
 ///    Calculate an hmac using the given key and data
@@ -1526,7 +1703,7 @@ System_hmac_sha256(size_t n_args, const mp_obj_t* args)
     mp_get_buffer_raise(args[3], &hmac_info, MP_BUFFER_WRITE);
     // printf("hmac:(len=%d)\n", hmac_info.len);
 
-    _hmac_sha256(key_info.buf, key_info.len, msg_info.buf, msg_info.len, hmac_info.buf);
+    hash_engine_hmac_sha256(key_info.buf, key_info.len, msg_info.buf, msg_info.len, hmac_info.buf);
 
     return mp_const_none;
 }
@@ -1579,16 +1756,14 @@ System_get_backup_pw_hash(mp_obj_t self, mp_obj_t hash)
     memset(&pin_attempt, 0, sizeof(pinAttempt_t));
     pin_fetch_secret(&pin_attempt);
 
-    SHA256_CTX ctx;
-    sha256_init(&ctx);
-    sha256_update(&ctx, (void *)device_hash, 32);
-    sha256_update(&ctx, (void *)pin_attempt.secret, SE_SECRET_LEN);
-    sha256_final(&ctx, hash_info.buf);
+    hash_engine_ctx_t ctx;
+    hash_engine_sha256_init(&ctx);
+    hash_engine_sha256_update(&ctx, device_hash, 32);
+    hash_engine_sha256_update(&ctx, pin_attempt.secret, SE_SECRET_LEN);
+    hash_engine_sha256_final(&ctx, hash_info.buf);
 
     // Double SHA
-    sha256_init(&ctx);
-    sha256_update(&ctx, (void *)hash_info.buf, 32);
-    sha256_final(&ctx, hash_info.buf);
+    hash_engine_sha256(hash_info.buf, 32, hash_info.buf);
 
     return mp_const_none;
 }
@@ -1767,6 +1942,271 @@ STATIC const mp_obj_type_t bip39_type = {
 };
 /* End of setup for bip39 class */
 
+/*=============================================================================
+ * Start of DerivPath class - parses derivation paths without the regex engine
+ *=============================================================================*/
+
+// Deepest path that HDNode.derive_path() accepts
+#define DERIV_PATH_MAX_DEPTH 32
+
+/// def __init__(self) -> None:
+///     '''
+///     Initialize DerivPath context.
+///     '''
+STATIC mp_obj_t
+DerivPath_make_new(const mp_obj_type_t* type, size_t n_args, size_t n_kw, const mp_obj_t* args)
+{
+    mp_obj_DerivPath_t* o = m_new_obj(mp_obj_DerivPath_t);
+    o->base.type = type;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+/// def parse(self, path, flags=0, max_depth=32) -> array
+///     '''
+///     Parse a path like "m/84'/0'/0'" into an array('I') with the hardened bit set where needed.
+///     flags is a combination of STRICT and ALLOW_STAR. With ALLOW_STAR, returns a tuple of
+///     the array and 0, STAR or STAR_HARDENED for the wildcard. Raises ValueError on junk.
+///     '''
+STATIC mp_obj_t
+DerivPath_parse(size_t n_args, const mp_obj_t* args)
+{
+    mp_check_self(mp_obj_is_str_or_bytes(args[1]));
+    GET_STR_DATA_LEN(args[1], path_str, path_len);
+
+    uint8_t flags = n_args > 2 ? mp_obj_get_int(args[2]) : 0;
+    size_t max_depth = n_args > 3 ? mp_obj_get_int(args[3]) : DERIV_PATH_MAX_DEPTH;
+    if (max_depth > DERIV_PATH_MAX_DEPTH) {
+        max_depth = DERIV_PATH_MAX_DEPTH;
+    }
+
+    uint32_t components[DERIV_PATH_MAX_DEPTH];
+    size_t depth;
+    uint8_t star;
+
+    deriv_path_err_t err = deriv_path_parse((const char*)path_str, path_len, flags, components, max_depth, &depth, &star);
+    if (err != DERIV_PATH_OK) {
+        mp_raise_ValueError(deriv_path_err_str(err));
+    }
+
+    mp_obj_array_t* result = m_new_obj(mp_obj_array_t);
+    result->base.type = &mp_type_array;
+    result->typecode = 'I';
+    result->free = 0;
+    result->len = depth;
+    result->items = m_new(uint32_t, depth);
+    memcpy(result->items, components, depth * sizeof(uint32_t));
+
+    if (flags & DERIV_PATH_ALLOW_STAR) {
+        mp_obj_t tuple[2] = { MP_OBJ_FROM_PTR(result), MP_OBJ_NEW_SMALL_INT(star) };
+        return mp_obj_new_tuple(2, tuple);
+    }
+    return MP_OBJ_FROM_PTR(result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DerivPath_parse_obj, 2, 4, DerivPath_parse);
+
+STATIC mp_obj_t
+DerivPath___del__(mp_obj_t self)
+{
+    return mp_const_none;
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(DerivPath___del___obj, DerivPath___del__);
+
+STATIC const mp_rom_map_elem_t DerivPath_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_foundation) },
+    { MP_ROM_QSTR(MP_QSTR_parse), MP_ROM_PTR(&DerivPath_parse_obj) },
+    { MP_ROM_QSTR(MP_QSTR_STRICT), MP_ROM_INT(DERIV_PATH_STRICT) },
+    { MP_ROM_QSTR(MP_QSTR_ALLOW_STAR), MP_ROM_INT(DERIV_PATH_ALLOW_STAR) },
+    { MP_ROM_QSTR(MP_QSTR_STAR), MP_ROM_INT(DERIV_PATH_STAR) },
+    { MP_ROM_QSTR(MP_QSTR_STAR_HARDENED), MP_ROM_INT(DERIV_PATH_STAR_HARDENED) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&DerivPath___del___obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(DerivPath_locals_dict, DerivPath_locals_dict_table);
+
+STATIC const mp_obj_type_t DerivPath_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_DerivPath,
+    .make_new = DerivPath_make_new,
+    .locals_dict = (void*)&DerivPath_locals_dict,
+};
+/* End of setup for DerivPath class */
+
+/*=============================================================================
+ * Start of AddrIndex class - looks up and extends address index files (see addr_index.h)
+ *=============================================================================*/
+
+// Most indexes lookup() returns; the tags are truncated so there is normally just the one
+#define ADDR_INDEX_MAX_LOOKUP 8
+
+STATIC int
+AddrIndex_read(void* ctx, uint32_t offset, void* buf, size_t len)
+{
+    mp_obj_t stream = MP_OBJ_FROM_PTR(ctx);
+    struct mp_stream_seek_t seek = { .offset = offset, .whence = MP_SEEK_SET };
+    int err;
+
+    if (mp_get_stream(stream)->ioctl(stream, MP_STREAM_SEEK, (uintptr_t)&seek, &err) == MP_STREAM_ERROR) {
+        return -1;
+    }
+    return mp_stream_rw(stream, buf, len, &err, MP_STREAM_RW_READ) == len ? 0 : -1;
+}
+
+STATIC int
+AddrIndex_write(void* ctx, const void* buf, size_t len)
+{
+    mp_obj_t stream = MP_OBJ_FROM_PTR(ctx);
+    int err;
+
+    return mp_stream_rw(stream, (void*)buf, len, &err, MP_STREAM_RW_WRITE) == len ? 0 : -1;
+}
+
+STATIC addr_index_io_t
+AddrIndex_io(mp_obj_t stream, int flags)
+{
+    mp_get_stream_raise(stream, flags);
+    addr_index_io_t io = { AddrIndex_read, AddrIndex_write, MP_OBJ_TO_PTR(stream) };
+    return io;
+}
+
+STATIC void
+AddrIndex_raise(int err)
+{
+    if (err == ADDR_INDEX_ERR_IO) {
+        mp_raise_OSError(MP_EIO);
+    }
+    mp_raise_ValueError(err == ADDR_INDEX_ERR_FULL ? "Address index full" : "Not an address index");
+}
+
+// Tags are passed down as the first 4 bytes of a hash
+STATIC uint32_t
+AddrIndex_tag(const uint8_t* buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+/// def __init__(self) -> None:
+///     '''
+///     Initialize AddrIndex context.
+///     '''
+STATIC mp_obj_t
+AddrIndex_make_new(const mp_obj_type_t* type, size_t n_args, size_t n_kw, const mp_obj_t* args)
+{
+    mp_obj_AddrIndex_t* o = m_new_obj(mp_obj_AddrIndex_t);
+    o->base.type = type;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+/// def count(self, fd) -> int:
+///     '''
+///     Number of addresses in the index open as fd. Raises ValueError if it isn't an index.
+///     '''
+STATIC mp_obj_t
+AddrIndex_count(mp_obj_t self, mp_obj_t fd)
+{
+    addr_index_io_t io = AddrIndex_io(fd, MP_STREAM_OP_READ | MP_STREAM_OP_IOCTL);
+    addr_index_header_t hdr;
+
+    int err = addr_index_read_header(&io, &hdr);
+    if (err != ADDR_INDEX_OK) {
+        AddrIndex_raise(err);
+    }
+    return mp_obj_new_int_from_uint(hdr.count);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(AddrIndex_count_obj, AddrIndex_count);
+
+/// def lookup(self, fd, tag) -> list:
+///     '''
+///     Indexes of the addresses in the index open as fd whose tags match tag, which is 4
+///     bytes. Each one still has to be checked by deriving its address.
+///     '''
+STATIC mp_obj_t
+AddrIndex_lookup(mp_obj_t self, mp_obj_t fd, mp_obj_t tag)
+{
+    addr_index_io_t io = AddrIndex_io(fd, MP_STREAM_OP_READ | MP_STREAM_OP_IOCTL);
+    mp_buffer_info_t tag_info;
+    mp_get_buffer_raise(tag, &tag_info, MP_BUFFER_READ);
+    if (tag_info.len != 4) {
+        mp_raise_ValueError("tag must be 4 bytes");
+    }
+
+    uint32_t indexes[ADDR_INDEX_MAX_LOOKUP];
+    int found = addr_index_lookup(&io, AddrIndex_tag(tag_info.buf), indexes, ADDR_INDEX_MAX_LOOKUP);
+    if (found < 0) {
+        AddrIndex_raise(found);
+    }
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < found; i++) {
+        mp_obj_list_append(list, MP_OBJ_NEW_SMALL_INT(indexes[i]));
+    }
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(AddrIndex_lookup_obj, AddrIndex_lookup);
+
+/// def extend(self, src_fd, dst_fd, tags) -> None:
+///     '''
+///     Write an index to dst_fd with everything in the index open as src_fd, or nothing if
+///     src_fd is None, followed by the addresses whose tags are in tags: 4 bytes each, in
+///     index order.
+///     '''
+STATIC mp_obj_t
+AddrIndex_extend(size_t n_args, const mp_obj_t* args)
+{
+    bool has_src = args[1] != mp_const_none;
+    addr_index_io_t src;
+    if (has_src) {
+        src = AddrIndex_io(args[1], MP_STREAM_OP_READ | MP_STREAM_OP_IOCTL);
+    }
+    addr_index_io_t dst = AddrIndex_io(args[2], MP_STREAM_OP_WRITE);
+
+    mp_buffer_info_t tags_info;
+    mp_get_buffer_raise(args[3], &tags_info, MP_BUFFER_READ);
+    if (tags_info.len % 4 != 0) {
+        mp_raise_ValueError("tags must be 4 bytes each");
+    }
+
+    // addr_index_extend() sorts them in place
+    size_t num = tags_info.len / 4;
+    uint32_t* tags = m_new(uint32_t, num + 1);
+    for (size_t i = 0; i < num; i++) {
+        tags[i] = AddrIndex_tag((const uint8_t*)tags_info.buf + i * 4);
+    }
+
+    int err = addr_index_extend(has_src ? &src : NULL, &dst, tags, num);
+    m_del(uint32_t, tags, num + 1);
+    if (err != ADDR_INDEX_OK) {
+        AddrIndex_raise(err);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(AddrIndex_extend_obj, 4, 4, AddrIndex_extend);
+
+STATIC mp_obj_t
+AddrIndex___del__(mp_obj_t self)
+{
+    return mp_const_none;
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(AddrIndex___del___obj, AddrIndex___del__);
+
+STATIC const mp_rom_map_elem_t AddrIndex_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_foundation) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&AddrIndex_count_obj) },
+    { MP_ROM_QSTR(MP_QSTR_lookup), MP_ROM_PTR(&AddrIndex_lookup_obj) },
+    { MP_ROM_QSTR(MP_QSTR_extend), MP_ROM_PTR(&AddrIndex_extend_obj) },
+    { MP_ROM_QSTR(MP_QSTR_MAX_COUNT), MP_ROM_INT(ADDR_INDEX_MAX_COUNT) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&AddrIndex___del___obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(AddrIndex_locals_dict, AddrIndex_locals_dict_table);
+
+STATIC const mp_obj_type_t AddrIndex_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_AddrIndex,
+    .make_new = AddrIndex_make_new,
+    .locals_dict = (void*)&AddrIndex_locals_dict,
+};
+/* End of setup for AddrIndex class */
+
 /*=============================================================================
  * Start of QRCode class - renders QR codes to a buffer passed down from MP
  *=============================================================================*/
@@ -1886,7 +2326,45 @@ QRCode_fit_to_version(mp_obj_t self, mp_obj_t data_size, mp_obj_t is_alphanumeri
     return mp_obj_new_int(0);
 }
 
+QRPlan qrplan;
+
+/// def render_fit(self, data, min_version, ecc, output, upper=False) -> int
+///     '''
+///     Render a QR code in the smallest version >= min_version that holds the data.
+///     The data is analyzed once and split into numeric, alphanumeric and byte
+///     segments as needed. With upper=True, lower case letters are encoded as
+///     upper case. Returns the version used, or 0 if the data does not fit.
+///     '''
+STATIC mp_obj_t
+QRCode_render_fit(size_t n_args, const mp_obj_t* args)
+{
+    mp_check_self(mp_obj_is_str_or_bytes(args[1]));
+    GET_STR_DATA_LEN(args[1], text_str, text_len);
+
+    uint8_t min_version = mp_obj_get_int(args[2]);
+    uint8_t ecc = mp_obj_get_int(args[3]);
+
+    mp_buffer_info_t output_info;
+    mp_get_buffer_raise(args[4], &output_info, MP_BUFFER_WRITE);
+
+    bool upper = n_args > 5 && mp_obj_is_true(args[5]);
+    uint8_t max_version = sizeof(version_capacity_alphanumeric) / sizeof(uint16_t);
+
+    if (qrcode_plan(&qrplan, text_str, text_len, ecc, upper, min_version, max_version) != 0) {
+        return mp_obj_new_int(0);
+    }
+
+    if (qrcode_getBufferSize(qrplan.version) > output_info.len) {
+        return mp_obj_new_int(0);
+    }
+
+    qrcode_initPlan(&qrcode, (uint8_t*)output_info.buf, &qrplan, text_str);
+
+    return mp_obj_new_int(qrplan.version);
+}
+
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(QRCode_render_obj, 5, 5, QRCode_render);
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(QRCode_render_fit_obj, 5, 6, QRCode_render_fit);
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(QRCode_fit_to_version_obj, QRCode_fit_to_version);
 
 STATIC mp_obj_t
@@ -1900,6 +2378,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(QRCode___del___obj, QRCode___del__);
 STATIC const mp_rom_map_elem_t QRCode_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_foundation) },
     { MP_ROM_QSTR(MP_QSTR_render), MP_ROM_PTR(&QRCode_render_obj) },
+    { MP_ROM_QSTR(MP_QSTR_render_fit), MP_ROM_PTR(&QRCode_render_fit_obj) },
     { MP_ROM_QSTR(MP_QSTR_fit_to_version), MP_ROM_PTR(&QRCode_fit_to_version_obj) },
     { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&QRCode___del___obj) },
 };
@@ -1938,8 +2417,11 @@ STATIC const mp_rom_map_elem_t foundation_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_Noise), MP_ROM_PTR(&noise_type) },
     { MP_ROM_QSTR(MP_QSTR_QR), MP_ROM_PTR(&QR_type) },
     { MP_ROM_QSTR(MP_QSTR_SettingsFlash), MP_ROM_PTR(&SettingsFlash_type) },
+    { MP_ROM_QSTR(MP_QSTR_SPIFlashBlockDev), MP_ROM_PTR(&SPIFlashBlockDev_type) },
     { MP_ROM_QSTR(MP_QSTR_System), MP_ROM_PTR(&System_type) },
     { MP_ROM_QSTR(MP_QSTR_bip39), MP_ROM_PTR(&bip39_type) },
+    { MP_ROM_QSTR(MP_QSTR_DerivPath), MP_ROM_PTR(&DerivPath_type) },
+    { MP_ROM_QSTR(MP_QSTR_AddrIndex), MP_ROM_PTR(&AddrIndex_type) },
     { MP_ROM_QSTR(MP_QSTR_QRCode), MP_ROM_PTR(&QRCode_type) },
 };
 STATIC MP_DEFINE_CONST_DICT(foundation_module_globals, foundation_module_globals_table);
@@ -399,6 +399,10 @@ async def update_firmware(*a):
             # Result
             update_hash = s.digest()
 
+            # The update goes over the scratch volume, which is reformatted the next time it's used
+            import sfstore
+            sfstore.release_scratch()
+
             # Erase first page
             sf.sector_erase(0)
             while sf.is_busy():
@@ -915,8 +919,9 @@ async def verify_microsd_backup(*A):
     # read 7z header, and measure checksums
 
     with imported('export') as exp:
+        # v2 backups aren't limited in size, and the 7z reader enforces its own limit
         fn = await file_picker('Select the backup to verify.',
-            suffix='.7z', max_size=exp.MAX_BACKUP_FILE_SIZE, folder_path='/sd/backups')
+            suffix=(exp.BACKUP_SUFFIX, exp.LEGACY_BACKUP_SUFFIX), folder_path='/sd/backups')
 
         if fn:
             # do a limited CRC-check over encrypted file
@@ -952,12 +957,12 @@ async def restore_microsd_backup(*A):
 
     # TODO: Insert step here to pick a backups-* folder when we add the XFP to the folder name
 
-    # Choose a backup file -- must be in 7z format
-    fn = await file_picker('Select the backup to restore and then enter the six-word password.',
-        suffix='.7z', max_size=10000, folder_path='/sd/backups')
+    # Choose a backup file -- v2 or the older 7z format
+    with imported('export') as exp:
+        fn = await file_picker('Select the backup to restore and then enter the six-word password.',
+            suffix=(exp.BACKUP_SUFFIX, exp.LEGACY_BACKUP_SUFFIX), folder_path='/sd/backups')
 
-    if fn:
-        with imported('export') as exp:
+        if fn:
             await exp.restore_complete(fn, partial_restore)
 
 
@@ -1008,12 +1013,16 @@ async def file_picker(msg, suffix=None, min_size=None, max_size=None, taster=Non
     # - if msg==None, don't prompt, just do the search and return list
     # - if choices is provided; skip search process
     # - escape: allow these chars to skip picking process
+    # - suffix can be a tuple to accept several
     from menu import MenuSystem, MenuItem
     import uos
     from utils import get_filesize, folder_exists
 
     system.turbo(True)
 
+    if isinstance(suffix, str):
+        suffix = (suffix,)
+
     if choices is None:
         choices = []
         try:
@@ -1037,7 +1046,7 @@ async def file_picker(msg, suffix=None, min_size=None, max_size=None, taster=Non
                             # ignore subdirs
                             continue
 
-                        if suffix and not fn.lower().endswith(suffix):
+                        if suffix and not any(fn.lower().endswith(s) for s in suffix):
                             # wrong suffix
                             continue
 
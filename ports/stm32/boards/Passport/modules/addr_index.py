@@ -0,0 +1,302 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# addr_index.py - Find the index of an address without deriving every address before it
+#
+# Each receive or change branch that Verify Address has been used on gets an index file on the
+# /cache volume, from a tag for each address to its index; see addr_index.h for the format. Tags
+# and file names are hashes keyed from the wallet secret, so the files don't say which
+# addresses or accounts are this wallet's.
+#
+# A lookup reads a bucket or two whatever the index, and anything it finds is checked by
+# deriving the address, so a stale or damaged index only costs falling back to a search.
+# run() extends the indexes while the device is idle, LOOKAHEAD addresses past the next unused
+# one on each branch.
+#
+#   entry = addr_index.make_entry(acct_num, addr_type, deriv_path, ms_wallet)
+#   addr_index.note(entry)                  Index this account and address type from now on
+#   idx, is_change = addr_index.find(entry, address)
+#
+import os, trezorcrypto, ujson, utime
+import common
+import sfstore
+from foundation import AddrIndex
+from micropython import const
+from utils import bytes_to_hex_str
+
+FNAME_PREFIX = 'ax'
+
+# How far past the next unused address each branch is indexed
+LOOKAHEAD = const(500)
+
+# Addresses derived per step of run(), which holds up the UI for that long if a key is pressed
+BATCH = const(20)
+
+# Derived tags are written out once there are this many, or a quarter as many as the file
+# already holds, so the file is rewritten a bounded number of times as it grows
+MIN_WRITE = const(50)
+
+# run() only works after this long without a key press, checking this often
+IDLE_MS = const(10000)
+POLL_MS = const(2000)
+
+# Accounts and address types that are indexed, most recently verified first
+MAX_ENTRIES = const(8)
+
+_ai = AddrIndex()
+
+# Tags derived but not yet written out, for one branch at a time
+_pending_fname = None
+_pending_base = 0
+_pending = []
+
+
+def _ready():
+    from common import pa
+    return pa.is_successful() and not pa.is_secret_blank()
+
+
+def _key():
+    from common import flash_cache
+    s = trezorcrypto.sha256(b'addr_index')
+    s.update(flash_cache.aes_key)
+    return s.digest()
+
+
+def _fname(key, entry, is_change):
+    s = trezorcrypto.sha256(key)
+    s.update(ujson.dumps([entry, is_change]))
+    return sfstore.path(sfstore.CACHE, FNAME_PREFIX + bytes_to_hex_str(s.digest()[0:8]))
+
+
+def canonical(address):
+    # bech32 addresses may be upper case in a QR code; everything else is case sensitive
+    lower = address.lower()
+    for hrp in ('bc1', 'tb1', 'bcrt1'):
+        if lower.startswith(hrp):
+            return lower
+    return address
+
+
+def _tag(key, address):
+    s = trezorcrypto.sha256(key)
+    s.update(address)
+    return s.digest()[0:4]
+
+
+def make_entry(acct_num, addr_type, deriv_path, ms_wallet):
+    if ms_wallet:
+        return [acct_num, addr_type, None, ms_wallet.id]
+    return [acct_num, addr_type, deriv_path, None]
+
+
+def _addresses(entry, is_change, start, count):
+    # The addresses at [start, start + count) on one branch of entry
+    acct_num, addr_type, deriv_path, ms_id = entry
+
+    if ms_id is not None:
+        from multisig import MultisigWallet
+        ms_wallet = MultisigWallet.get_by_id(ms_id)
+        if not ms_wallet:
+            return []
+        return [addr for (_, _, addr, _) in ms_wallet.yield_addresses(start, count, change_idx=is_change)]
+
+    import stash
+    result = []
+    with stash.SensitiveValues() as sv:
+        chain_node = sv.derive_path('{}/{}'.format(deriv_path, is_change))
+        for idx in range(start, start + count):
+            node = chain_node.derive_child(idx)
+            sv.register(node)
+            result.append(sv.chain.address(node, addr_type))
+    return result
+
+
+def _count(fname):
+    try:
+        with open(fname, 'rb') as fd:
+            return _ai.count(fd)
+    except OSError:
+        return 0
+    except ValueError:
+        sfstore.remove(fname)
+        return 0
+
+
+def _lookup(fname, tag):
+    found = []
+    try:
+        with open(fname, 'rb') as fd:
+            found = _ai.lookup(fd, tag)
+    except (OSError, ValueError):
+        pass
+
+    if fname == _pending_fname:
+        for i, t in enumerate(_pending):
+            if t == tag:
+                found.append(_pending_base + i)
+    return found
+
+
+def find(entry, address):
+    # Returns (index, is_change) of the address on either branch of entry, or (-1, False)
+    if not _ready():
+        return -1, False
+
+    key = _key()
+    address = canonical(address)
+    tag = _tag(key, address)
+    try:
+        for is_change in range(2):
+            for idx in _lookup(_fname(key, entry, is_change), tag):
+                if [canonical(a) for a in _addresses(entry, is_change, idx, 1)] == [address]:
+                    return idx, bool(is_change)
+    except Exception:
+        pass
+    return -1, False
+
+
+def _entries():
+    from common import flash_cache
+    return flash_cache.get('addr_index', [])
+
+
+def _remove_files(key, entry):
+    global _pending_fname, _pending
+
+    for is_change in range(2):
+        fname = _fname(key, entry, is_change)
+        if fname == _pending_fname:
+            _pending_fname = None
+            _pending = []
+        sfstore.remove(fname)
+
+
+def note(entry):
+    # Index this account and address type, dropping the one verified least recently if needed
+    from common import flash_cache
+
+    entries = _entries()
+    if entries and entries[0] == entry:
+        return
+
+    if entry in entries:
+        entries.remove(entry)
+    entries.insert(0, entry)
+
+    if len(entries) > MAX_ENTRIES:
+        key = _key()
+        for old in entries[MAX_ENTRIES:]:
+            _remove_files(key, old)
+        del entries[MAX_ENTRIES:]
+
+    flash_cache.set('addr_index', entries)
+
+
+def _drop(key, entry):
+    from common import flash_cache
+
+    _remove_files(key, entry)
+    flash_cache.set('addr_index', [e for e in _entries() if e != entry])
+
+
+def forget():
+    # Remove every index, for all keys; used when the wallet is erased
+    global _pending_fname, _pending
+
+    _pending_fname = None
+    _pending = []
+    for name in os.listdir(sfstore.mount(sfstore.CACHE)):
+        if name.startswith(FNAME_PREFIX):
+            sfstore.remove(sfstore.path(sfstore.CACHE, name))
+
+
+def _write_pending():
+    global _pending_fname, _pending
+
+    fname = _pending_fname
+    tags = b''.join(_pending)
+    _pending_fname = None
+    _pending = []
+
+    # Something else may have removed the file (the flash cache does when the volume is full)
+    if _count(fname) != _pending_base:
+        return
+
+    try:
+        with sfstore.AtomicFile(fname) as dst:
+            if _pending_base:
+                with open(fname, 'rb') as src:
+                    _ai.extend(src, dst, tags)
+            else:
+                _ai.extend(None, dst, tags)
+    except (OSError, ValueError):
+        # Most likely the volume is full: the flash cache comes first, so give up on this branch
+        sfstore.remove(fname)
+
+
+def step():
+    # Derives the next few addresses of the first branch that isn't indexed far enough. Returns
+    # False once they all are.
+    global _pending_fname, _pending_base
+    from utils import get_next_addr
+
+    key = _key()
+    for entry in _entries():
+        acct_num, addr_type, _, _ = entry
+        for is_change in range(2):
+            fname = _fname(key, entry, is_change)
+            count = _count(fname)
+            have = count + len(_pending) if fname == _pending_fname else count
+            target = min(AddrIndex.MAX_COUNT, get_next_addr(acct_num, addr_type, is_change) + LOOKAHEAD)
+            if have >= target:
+                continue
+
+            if _pending_fname != fname:
+                if _pending_fname:
+                    _write_pending()
+                _pending_fname = fname
+                _pending_base = count
+
+            num = min(BATCH, target - have)
+            addresses = _addresses(entry, is_change, have, num)
+            if not addresses:
+                # The multisig wallet has been deleted
+                _drop(key, entry)
+                return True
+
+            for addr in addresses:
+                _pending.append(_tag(key, addr))
+            if len(_pending) >= max(MIN_WRITE, count // 4) or have + num >= target:
+                _write_pending()
+            return True
+
+    if _pending_fname:
+        _write_pending()
+    return False
+
+
+async def run():
+    from uasyncio import sleep_ms
+    import perf
+
+    # Once everything is indexed, or indexing fails, wait for the user to do something before
+    # looking again: anything new to index comes from a key press
+    done_at = None
+
+    while True:
+        await sleep_ms(POLL_MS)
+        if utime.ticks_diff(utime.ticks_ms(), common.last_activity_time) < IDLE_MS or not _ready():
+            continue
+        if done_at == common.last_activity_time:
+            continue
+
+        try:
+            with perf.burst('addr_index'):
+                if not step():
+                    done_at = common.last_activity_time
+        except Exception:
+            # The index is only ever an optimization
+            done_at = common.last_activity_time
+
+# EOF
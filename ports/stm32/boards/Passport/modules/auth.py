@@ -11,13 +11,13 @@
 # and signing bitcoin transactions.
 #
 import gc
+import perf
 import sys
 
 import chains
 import stash
 import trezorcrypto
 import uio
-import ure
 import ux
 import version
 from psbt import FatalPSBTIssue, FraudulentChangeOutput, psbtObject
@@ -29,9 +29,9 @@ from sffile import SFFile
 from utils import HexWriter, cleanup_deriv_path, problem_file_line, xfp2str
 from ux import (abort_and_goto, ux_show_story, ux_show_story_sequence)
 
-# Where in SPI flash the two transactions are (in and out)
-TXN_INPUT_OFFSET = 0
-TXN_OUTPUT_OFFSET = MAX_TXN_LEN
+# Files on the SPI flash scratch volume holding the two transactions (in and out)
+TXN_INPUT_FILE = 'psbt-in'
+TXN_OUTPUT_FILE = 'psbt-out'
 
 
 class UserAuthorizedAction:
@@ -406,7 +406,7 @@ class ApproveTransaction(UserAuthorizedAction):
             if self.psbt == None:
                 try:
                     # Read TXN from SPI Flash (we put it there whether it came from a QR code or an SD card)
-                    with SFFile(TXN_INPUT_OFFSET, length=self.psbt_len) as fd:
+                    with SFFile(TXN_INPUT_FILE, length=self.psbt_len) as fd:
                         self.psbt = psbtObject.read_psbt(fd)
                 except BaseException as exc:
                     system.hide_busy_bar()
@@ -524,7 +524,8 @@ class ApproveTransaction(UserAuthorizedAction):
             # do the actual signing.
             try:
                 gc.collect()
-                self.psbt.sign_it()
+                with perf.burst('sign'):
+                    self.psbt.sign_it()
             except FraudulentChangeOutput as exc:
                 return await self.failure(exc.args[0], title='Change Fraud')
             except MemoryError:
@@ -544,7 +545,7 @@ class ApproveTransaction(UserAuthorizedAction):
             try:
                 system.show_busy_bar()
                 # re-serialize the PSBT back out
-                with SFFile(TXN_OUTPUT_OFFSET, max_size=MAX_TXN_LEN, message="Saving...") as fd:
+                with SFFile(TXN_OUTPUT_FILE, max_size=MAX_TXN_LEN, message="Saving...") as fd:
                     await fd.erase()
 
                     if self.do_finalize:
@@ -722,7 +723,7 @@ def sign_psbt_file(filename):
                 psbt_len = (psbt_len * 3 // 4) + 10
 
             total = 0
-            with SFFile(TXN_INPUT_OFFSET, max_size=psbt_len) as out:
+            with SFFile(TXN_INPUT_FILE, max_size=psbt_len) as out:
                 # blank flash
                 await out.erase()
 
@@ -871,7 +872,7 @@ async def sign_psbt_buf(psbt_buf):
             return
 
         total = 0
-        with SFFile(TXN_INPUT_OFFSET, max_size=psbt_len) as out:
+        with SFFile(TXN_INPUT_FILE, max_size=psbt_len) as out:
             # blank flash
             await out.erase()
 
@@ -983,7 +984,7 @@ def maybe_enroll_xpub(sf_len=None, config=None, name=None):
     UserAuthorizedAction.cleanup()
 
     if sf_len:
-        with SFFile(TXN_INPUT_OFFSET, length=sf_len) as fd:
+        with SFFile(TXN_INPUT_FILE, length=sf_len) as fd:
             config = fd.read(sf_len).decode()
 
     # this call will raise on parsing errors, so let them rise up
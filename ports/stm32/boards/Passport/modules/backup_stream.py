@@ -0,0 +1,218 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# backup_stream.py - Chunked, authenticated backup container (format v2)
+#
+# Layout:
+#   header:  magic(4) version(1) flags(1) chunk_size(2) iterations(4) salt(16)
+#   tag(16): Poly1305 tag over the header, with no plaintext
+#   chunks:  chunk_size bytes of ChaCha20 ciphertext, then its 16 byte tag
+#   last:    0 to chunk_size-1 bytes of ciphertext, then its tag
+#
+# The key is PBKDF2-HMAC-SHA256 of the password and salt. Each chunk's nonce holds its index
+# and whether it is the last one, so chunks can't be reordered, dropped or cut short without a
+# tag failing. The header tag is checked before any chunk is read, so a wrong password is caught
+# straight away, and nothing is returned to the caller until its tag has been checked.
+#
+import trezorcrypto
+from ustruct import pack, unpack, calcsize
+from common import noise
+
+MAGIC = b'PBK2'
+VERSION = const(2)
+
+HEADER_FMT = '<4sBBHI16s'
+HEADER_LEN = calcsize(HEADER_FMT)
+TAG_LEN = const(16)
+SALT_LEN = const(16)
+
+CHUNK_SIZE = const(1024)
+KDF_ITERATIONS = const(131072)
+
+# Limits on what a file can ask the reader for, so a damaged or hostile file can't make it use
+# lots of RAM or spin for minutes
+MAX_CHUNK_SIZE = const(4096)
+MAX_KDF_ITERATIONS = const(1048576)
+
+# How many PBKDF2 iterations to run between progress updates
+KDF_STEP = const(4096)
+
+# Last field of the nonce
+NONCE_CHUNK = const(0)
+NONCE_LAST_CHUNK = const(1)
+NONCE_HEADER = const(2)
+
+
+class AuthError(ValueError):
+    pass
+
+
+def urandom(l):
+    from noise_source import NoiseSource
+    rv = bytearray(l)
+    noise.random_bytes(rv, NoiseSource.ALL)
+    return rv
+
+def derive_key(password, salt, iterations, progress_fcn=None):
+    # Creating the context runs the first iteration
+    pbkdf2 = trezorcrypto.pbkdf2(trezorcrypto.pbkdf2.HMAC_SHA256, password, salt)
+
+    done = 1
+    while done < iterations:
+        n = min(KDF_STEP, iterations - done)
+        pbkdf2.update(n)
+        done += n
+        if progress_fcn:
+            progress_fcn((done * 100) // iterations)
+
+    return pbkdf2.key()[:32]
+
+def make_cipher(key, index, kind):
+    return trezorcrypto.chacha20poly1305(key, pack('<QI', index, kind))
+
+def header_tag(key, hdr):
+    c = make_cipher(key, 0, NONCE_HEADER)
+    c.auth(hdr)
+    return c.finish()
+
+def tags_equal(a, b):
+    # Don't leak how much of the tag matched
+    if len(a) != len(b):
+        return False
+    diff = 0
+    for x, y in zip(a, b):
+        diff |= x ^ y
+    return diff == 0
+
+def is_v2(fd):
+    # Leaves the file positioned at the start
+    fd.seek(0)
+    magic = fd.read(len(MAGIC))
+    fd.seek(0)
+    return magic == MAGIC
+
+def parse_header(hdr):
+    if len(hdr) != HEADER_LEN:
+        raise ValueError('Truncated header')
+
+    magic, version, flags, chunk_size, iterations, salt = unpack(HEADER_FMT, hdr)
+    if magic != MAGIC:
+        raise ValueError('Not a v2 backup')
+    if version != VERSION or flags != 0:
+        raise ValueError('Unsupported version')
+    if not 0 < chunk_size <= MAX_CHUNK_SIZE or chunk_size % 64:
+        raise ValueError('Bad chunk size')
+    if not 0 < iterations <= MAX_KDF_ITERATIONS:
+        raise ValueError('Bad iteration count')
+
+    return chunk_size, iterations, salt
+
+def check_structure(fd):
+    # Checks everything that can be checked without the password: the header fields, and that
+    # the file ends with a short chunk. Returns the number of chunks.
+    fd.seek(0)
+    chunk_size, _, _ = parse_header(fd.read(HEADER_LEN))
+
+    if len(fd.read(TAG_LEN)) != TAG_LEN:
+        raise ValueError('Truncated header')
+
+    count = 0
+    while True:
+        n = len(fd.read(chunk_size + TAG_LEN))
+        count += 1
+        if n < TAG_LEN:
+            raise ValueError('Truncated file')
+        if n < chunk_size + TAG_LEN:
+            return count
+
+
+class Writer:
+    # Encrypts what's written to it and writes each chunk out as soon as it's full, so only one
+    # chunk is ever held in RAM
+    def __init__(self, fd, password, chunk_size=CHUNK_SIZE, iterations=KDF_ITERATIONS, progress_fcn=None):
+        assert 0 < chunk_size <= MAX_CHUNK_SIZE and chunk_size % 64 == 0
+
+        self.fd = fd
+        self.chunk_size = chunk_size
+        self.buf = bytearray()
+        self.index = 0
+
+        salt = urandom(SALT_LEN)
+        self.key = derive_key(password, salt, iterations, progress_fcn)
+
+        hdr = pack(HEADER_FMT, MAGIC, VERSION, 0, chunk_size, iterations, salt)
+        fd.write(hdr)
+        fd.write(header_tag(self.key, hdr))
+
+    def write(self, data):
+        if isinstance(data, str):
+            data = data.encode()
+        self.buf.extend(data)
+
+        while len(self.buf) >= self.chunk_size:
+            self._flush_chunk(self.buf[:self.chunk_size], NONCE_CHUNK)
+            self.buf = self.buf[self.chunk_size:]
+
+    def close(self):
+        # The last chunk is always short, even if it's empty, so the reader can tell the file
+        # wasn't cut off at a chunk boundary
+        self._flush_chunk(self.buf, NONCE_LAST_CHUNK)
+        self.buf = bytearray()
+
+        import stash
+        stash.blank_object(self.key)
+        self.key = None
+
+    def _flush_chunk(self, pt, kind):
+        c = make_cipher(self.key, self.index, kind)
+        self.fd.write(c.encrypt(pt))
+        self.fd.write(c.finish())
+        self.index += 1
+
+
+class Reader:
+    # Raises AuthError if the password is wrong. Nothing is read past the header until it's right.
+    def __init__(self, fd, password, progress_fcn=None):
+        self.fd = fd
+
+        fd.seek(0)
+        hdr = fd.read(HEADER_LEN)
+        self.chunk_size, iterations, salt = parse_header(hdr)
+
+        tag = fd.read(TAG_LEN)
+        if len(tag) != TAG_LEN:
+            raise ValueError('Truncated header')
+
+        self.key = derive_key(password, salt, iterations, progress_fcn)
+        if not tags_equal(header_tag(self.key, hdr), tag):
+            self.close()
+            raise AuthError('Wrong password')
+
+    def chunks(self):
+        # Yields the plaintext one chunk at a time, each after its tag has been checked. Raises
+        # AuthError if the file was changed, reordered or truncated.
+        index = 0
+        while True:
+            data = self.fd.read(self.chunk_size + TAG_LEN)
+            if len(data) < TAG_LEN:
+                raise AuthError('Truncated file')
+
+            last = len(data) < self.chunk_size + TAG_LEN
+            ct_len = len(data) - TAG_LEN
+
+            c = make_cipher(self.key, index, NONCE_LAST_CHUNK if last else NONCE_CHUNK)
+            pt = c.decrypt(data[:ct_len])
+            if not tags_equal(c.finish(), data[ct_len:]):
+                raise AuthError('Chunk %d failed authentication' % index)
+
+            yield pt
+
+            if last:
+                return
+            index += 1
+
+    def close(self):
+        if self.key:
+            import stash
+            stash.blank_object(self.key)
+            self.key = None
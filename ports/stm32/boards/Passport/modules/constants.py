@@ -5,6 +5,10 @@
 CAMERA_WIDTH = 330
 CAMERA_HEIGHT = 396
 
+# How long to wait for the camera to wake before giving up: a few times CAMERA_WAKE_MS in
+# camera-ovm7690.h
+CAMERA_WAKE_TIMEOUT_MS = 300
+
 VIEWFINDER_WIDTH = 240
 VIEWFINDER_HEIGHT = 240
 
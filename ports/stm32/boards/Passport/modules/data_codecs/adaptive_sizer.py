@@ -0,0 +1,164 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# adaptive_sizer.py
+#
+# Picks the UR fragment length and frame interval for animated QR codes.
+#
+# The fragment length is the largest one whose QR code still renders with modules of at least
+# min_module_px pixels. The frame interval comes from the frame rate target (or the default
+# delay), and is stretched to the measured encode+render time so the animation never drops
+# frames. If the first frames show that the chosen size can't keep up with the target, the
+# sizer steps down to the next smaller fragment length once and then stays there. The caller
+# can also step down when a fragment doesn't fit in a QR code at all.
+#
+# Everything time-related goes through the clock passed in, so this can be driven with a fake
+# clock on the unix port.
+#
+
+# Fragment lengths to consider, largest first
+FRAGMENT_LENS = (280, 220, 170, 130, 100, 70)
+
+# Smallest module size, in pixels, that scanners read reliably from this display
+MIN_MODULE_PX = 3
+
+# Frame interval when there is no frame rate target
+DEFAULT_INTERVAL_MS = 200
+
+# Frames to measure before deciding whether the chosen size keeps up
+CALIBRATION_FRAMES = 4
+
+# UR part overhead: 'ur:<type>/<seq>-<len>/' plus the CBOR part header and CRC, which are
+# bytewords-encoded at 2 characters per byte like the fragment itself.
+UR_PATH_OVERHEAD = 12
+UR_CBOR_OVERHEAD = 15
+UR_CRC_LEN = 4
+
+
+def _ticks_ms():
+    import utime
+    return utime.ticks_ms()
+
+
+def _ticks_diff(end, start):
+    import utime
+    return utime.ticks_diff(end, start)
+
+
+def _fit_version(text_len):
+    from foundation import QRCode
+    return QRCode().fit_to_version(text_len, True)
+
+
+class AdaptiveQRSizer:
+    def __init__(self, area_px, prefix='bytes', target_fps=None, min_module_px=MIN_MODULE_PX,
+                 fragment_lens=FRAGMENT_LENS, clock=_ticks_ms, ticks_diff=_ticks_diff,
+                 fit_version=_fit_version):
+        self.area_px = area_px
+        self.prefix = prefix
+        self.target_fps = target_fps
+        self.min_module_px = min_module_px
+        self.fragment_lens = fragment_lens
+        self.clock = clock
+        self.ticks_diff = ticks_diff
+        self.fit_version = fit_version
+
+        self.size_idx = 0
+        self.frame_cost_ms = 0      # Smoothed encode+render time per frame
+        self.frames = 0             # Frames measured at the current size
+        self.frame_start = None
+        self.last_frame_start = None
+        self.frame_period_ms = 0    # Smoothed time between frame starts
+        self.calibrated = False
+
+        self.size_idx = self._largest_readable_idx()
+
+    def text_len(self, fragment_len):
+        return len(self.prefix) + UR_PATH_OVERHEAD + 2 * (fragment_len + UR_CBOR_OVERHEAD + UR_CRC_LEN)
+
+    def module_px(self, version):
+        if version <= 0:
+            return 0
+        return self.area_px // (version * 4 + 17)
+
+    def _largest_readable_idx(self):
+        for i, fragment_len in enumerate(self.fragment_lens):
+            version = self.fit_version(self.text_len(fragment_len))
+            if self.module_px(version) >= self.min_module_px:
+                return i
+        return len(self.fragment_lens) - 1
+
+    def fragment_len(self):
+        return self.fragment_lens[self.size_idx]
+
+    def version(self):
+        return self.fit_version(self.text_len(self.fragment_len()))
+
+    def target_interval_ms(self):
+        if self.target_fps:
+            return 1000 // self.target_fps
+        return DEFAULT_INTERVAL_MS
+
+    # Time to wait after drawing a frame before starting the next one
+    def frame_delay_ms(self):
+        return max(self.target_interval_ms() - self.frame_cost_ms, 0)
+
+    def begin_frame(self):
+        now = self.clock()
+        if self.last_frame_start is not None:
+            period = self.ticks_diff(now, self.last_frame_start)
+            self.frame_period_ms = period if self.frame_period_ms == 0 else (self.frame_period_ms * 3 + period) // 4
+        self.last_frame_start = now
+        self.frame_start = now
+
+    # Returns True if the fragment length changed and the data needs to be re-encoded
+    def end_frame(self):
+        if self.frame_start is None:
+            return False
+
+        cost = self.ticks_diff(self.clock(), self.frame_start)
+        self.frame_start = None
+        self.frame_cost_ms = cost if self.frames == 0 else (self.frame_cost_ms * 3 + cost) // 4
+        self.frames += 1
+
+        if self.calibrated or self.frames < CALIBRATION_FRAMES:
+            return False
+
+        # Only adapt once, so a scanner that's already part way through doesn't see the
+        # fragment length keep changing.
+        self.calibrated = True
+        if self.target_fps and self.frame_cost_ms > self.target_interval_ms():
+            return self.step_down()
+
+        return False
+
+    # Moves to the next smaller fragment length and starts measuring again. Returns False if
+    # this is already the smallest.
+    def step_down(self):
+        if self.size_idx >= len(self.fragment_lens) - 1:
+            return False
+
+        self.size_idx += 1
+        self.frames = 0
+        self.frame_cost_ms = 0
+        self.frame_period_ms = 0
+        self.frame_start = None
+        self.last_frame_start = None
+        return True
+
+    def measured_fps(self):
+        if self.frame_period_ms <= 0:
+            return 0
+        return 1000 / self.frame_period_ms
+
+    def stats(self):
+        version = self.version()
+        return {
+            'fragment_len': self.fragment_len(),
+            'version': version,
+            'module_px': self.module_px(version),
+            'interval_ms': max(self.target_interval_ms(), self.frame_cost_ms),
+            'frame_cost_ms': self.frame_cost_ms,
+            'fps': self.measured_fps(),
+            'calibrated': self.calibrated,
+        }
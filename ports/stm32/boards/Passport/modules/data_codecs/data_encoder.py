@@ -18,6 +18,17 @@ class DataEncoder:
     def get_max_len(self, index):
         return 0
 
+    # Encoders that return True here can have their fragment length picked by AdaptiveQRSizer
+    def supports_adaptive_sizing(self):
+        return False
+
+    # Frame rate that AdaptiveQRSizer keeps animated codes at, or None to leave the size alone
+    def get_target_fps(self):
+        return None
+
+    def get_prefix(self):
+        return None
+
     def encode(self, data, is_binary=False, max_fragment_len=None):
         pass
 
@@ -71,9 +71,14 @@ class UR2Decoder(DataDecoder):
 class UR2Encoder(DataEncoder):
     def __init__(self, args):
         self.qr_sizes = [280, 100, 70]
+        self.target_fps = 5     # Adaptive sizing steps down to a smaller fragment below this
         self.type = None
+        # Coordinators that can inflate the payload opt in with {'compress': True}. The bytes inside the UR are then
+        # a zlib stream, which usually cuts the number of animated frames by half or more for text exports.
+        self.compress = False
         if isinstance(args, dict):
-            self.prefix = args['prefix'] or 'bytes'
+            self.prefix = args.get('prefix') or 'bytes'
+            self.compress = args.get('compress', False)
         else:
             self.prefix = 'bytes'
 
@@ -85,8 +90,21 @@ class UR2Encoder(DataEncoder):
             return 0
         return self.qr_sizes[index]
 
+    def supports_adaptive_sizing(self):
+        return True
+
+    def get_target_fps(self):
+        return self.target_fps
+
+    def get_prefix(self):
+        return self.prefix
+
     # Encode the given data
     def encode(self, data, is_binary=False, max_fragment_len=500):
+        if self.compress:
+            import uzlib
+            data = uzlib.compress(data)
+
         encoder = CBOREncoder()
         # print('UR2: data={}'.format(to_str(data)))
         encoder.encodeBytes(data)
@@ -16,11 +16,80 @@ from foundation import Backlight
 from foundation import Powermon
 import framebuf
 import uzlib
-from graphics import Graphics
+from micropython import const
+from graphics import (Graphics, ICON_COUNT, ICON_SCROLLBAR, ICON_PASSPHRASE_ICON, ICON_BATTERY_100,
+                      ICON_BATTERY_75, ICON_BATTERY_50, ICON_BATTERY_25, ICON_BATTERY_LOW)
 from passport_fonts import FontSmall, FontTiny, lookup
 from uasyncio import sleep_ms
 from common import system
 
+# Icons up to this size are kept decoded in the atlas. The bigger ones (splash screen and logos)
+# are only drawn once in a while, so they get decoded into a temporary buffer instead.
+ATLAS_MAX_ICON_BYTES = const(512)
+
+
+# Decoded icons, packed into one buffer so that drawing an icon doesn't allocate. Each icon is
+# decoded the first time it's drawn. Inverted icons live in a second buffer with the same layout.
+# Uncompressed icons are drawn straight from the frozen data through a read-only view, so the
+# buffers are only allocated once something needs decoding or inverting.
+class IconAtlas:
+    def __init__(self):
+        self.offsets = []
+        size = 0
+        for _w, h, bw, _wbits, _data in Graphics.icons:
+            n = bw * h
+            if n <= ATLAS_MAX_ICON_BYTES:
+                self.offsets.append(size)
+                size += n
+            else:
+                self.offsets.append(-1)
+
+        self.size = size
+        self.buf = None
+        self.inv_buf = None
+        self.fbs = [None] * ICON_COUNT
+        self.inv_fbs = [None] * ICON_COUNT
+
+    def get(self, icon_id, invert=0):
+        fbs = self.inv_fbs if invert else self.fbs
+        fb = fbs[icon_id]
+        if fb != None:
+            return fb
+
+        w, h, _bw, wbits, data = Graphics.icons[icon_id]
+        if not wbits and not invert:
+            fb = framebuf.view(data, w, h, framebuf.MONO_HLSB)
+            fbs[icon_id] = fb
+            return fb
+
+        if wbits:
+            data = uzlib.decompress(data, wbits)
+
+        offset = self.offsets[icon_id]
+        if offset < 0:
+            buf = bytearray(data)
+        else:
+            if invert:
+                if self.inv_buf == None:
+                    self.inv_buf = bytearray(self.size)
+                atlas = self.inv_buf
+            else:
+                if self.buf == None:
+                    self.buf = bytearray(self.size)
+                atlas = self.buf
+            buf = memoryview(atlas)[offset:offset + len(data)]
+            buf[:] = data
+
+        if invert:
+            for i in range(len(buf)):
+                buf[i] ^= 0xff
+
+        fb = framebuf.FrameBuffer(buf, w, h, framebuf.MONO_HLSB)
+        if offset >= 0:
+            fbs[icon_id] = fb
+        return fb
+
+
 class Display:
 
     WIDTH = 230
@@ -47,6 +116,9 @@ class Display:
 
         self.scrn = LCD(self.dis)
 
+        self.atlas = IconAtlas()
+        self.last_image = None
+
         self.backlight = Backlight()
 
         self.clear()
@@ -149,35 +221,47 @@ class Display:
     def width(self, msg, font):
         return sum(lookup(font, ord(ch)).advance for ch in msg)
 
-    def icon_size(self, name):
+    def icon_id(self, icon):
+        # Icons can be given by id (ICON_* in graphics.py) or by name
+        if isinstance(icon, int):
+            return icon
+        return Graphics.ids[icon]
+
+    def icon_size(self, icon):
         # see graphics.py (auto generated file) for names
-        w, h, _bw, _wbits, _data = getattr(Graphics, name)
+        w, h, _bw, _wbits, _data = Graphics.icons[self.icon_id(icon)]
         return (w, h)
 
-    def icon(self, x, y, name, invert=0):
+    def icon(self, x, y, icon, invert=0):
         # see graphics.py (auto generated file) for names
-        w, h, bw, wbits, data = getattr(Graphics, name)
-
-        if wbits:
-            data = uzlib.decompress(data, wbits)
-
-        if invert:
-            data = bytearray(i ^ 0xff for i in data)
-
-        gly = framebuf.FrameBuffer(bytearray(data), w, h, framebuf.MONO_HLSB)
+        icon_id = self.icon_id(icon)
+        w, h, _bw, _wbits, _data = Graphics.icons[icon_id]
 
         if x is None:
             x = self.HALF_WIDTH - (w // 2)
         if y is None:
             y = self.HALF_HEIGHT - (h // 2)
 
-        self.dis.blit(gly, x, y, invert)
+        self.blit_icon(icon_id, x, y, invert)
 
         return (w, h)
 
+    def blit_icon(self, icon_id, x, y, invert=0):
+        self.dis.blit(self.atlas.get(icon_id, invert), x, y, invert)
+
+    # Returns a FrameBuffer over img_data without copying it. Long-lived buffers like the camera
+    # viewfinder are drawn over and over, so the FrameBuffer for the last image is kept and reused.
+    def image_view(self, img_data, w, h):
+        last = self.last_image
+        if last != None and last[0] is img_data and last[1] == w and last[2] == h:
+            return last[3]
+
+        gly = framebuf.view(img_data, w, h, framebuf.MONO_HLSB)
+        self.last_image = (img_data, w, h, gly)
+        return gly
+
     def image(self, x, y, w, h, img_data, invert=0):
-        gly = framebuf.FrameBuffer(
-            bytearray(img_data), w, h, framebuf.MONO_HLSB)
+        gly = self.image_view(img_data, w, h)
 
         if x is None:
             x = self.HALF_WIDTH - (w // 2)
@@ -311,9 +395,9 @@ class Display:
                                self.SCROLLBAR_WIDTH - 1, self.HEIGHT - self.HEADER_HEIGHT + 2, 0)
 
             # Draw the scrollbar track
-            bg_w, bg_h = self.icon_size('scrollbar')
+            bg_w, bg_h = self.icon_size(ICON_SCROLLBAR)
             for i in range((self.SCROLLBAR_WIDTH + bg_w//2) // bg_w):
-                self.icon(sb_left + (bg_w * i) + 1, self.HEADER_HEIGHT - 3, 'scrollbar')
+                self.blit_icon(ICON_SCROLLBAR, sb_left + (bg_w * i) + 1, self.HEADER_HEIGHT - 3)
 
             # Draw the thumb in the right position
             mm = self.HEIGHT - self.HEADER_HEIGHT - self.FOOTER_HEIGHT + 4
@@ -390,14 +474,14 @@ class Display:
         else:
             left_x = 2
             if stash.bip39_passphrase:
-                pass_w, pass_h = self.icon_size('passphrase_icon')
-                self.icon(4, ((self.HEADER_HEIGHT - 4) // 2 - pass_h // 2) + 2, 'passphrase_icon', invert=0)
+                pass_w, pass_h = self.icon_size(ICON_PASSPHRASE_ICON)
+                self.blit_icon(ICON_PASSPHRASE_ICON, 4, ((self.HEADER_HEIGHT - 4) // 2 - pass_h // 2) + 2)
                 left_x += pass_w + 2
 
         battery_icon = self.get_battery_icon(battery_level)
         batt_w, batt_h = self.icon_size(battery_icon)
-        self.icon(self.WIDTH - batt_w - 6, ((self.HEADER_HEIGHT - 4) //
-                                            2 - batt_h // 2) + 3, battery_icon, invert=0)
+        self.blit_icon(battery_icon, self.WIDTH - batt_w - 6, ((self.HEADER_HEIGHT - 4) //
+                                                               2 - batt_h // 2) + 3)
 
     def draw_button(self, x, y, w, h, label, font=FontTiny, invert=0):
         self.draw_rect(x, y, w, h, border_w=1,
@@ -428,15 +512,15 @@ class Display:
 
     def get_battery_icon(self, level):
         if level > 90:
-            return 'battery_100'
+            return ICON_BATTERY_100
         elif level >= 70:
-            return 'battery_75'
+            return ICON_BATTERY_75
         elif level >= 50:
-            return 'battery_50'
+            return ICON_BATTERY_50
         elif level >= 30:
-            return 'battery_25'
+            return ICON_BATTERY_25
         else:
-            return 'battery_low'
+            return ICON_BATTERY_LOW
 
     # Save a screenshot in PPM (Portable Pixel Map) -- a very simple format
     # that doesn't need a big library to be included.
@@ -490,14 +574,26 @@ class Display:
         from utils import random_hex
         import common
         from common import qr_buf, viewfinder_buf
-        from constants import VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT, CAMERA_WIDTH, CAMERA_HEIGHT
+        from constants import VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT, CAMERA_WIDTH, CAMERA_HEIGHT, CAMERA_WAKE_TIMEOUT_MS
         from foundation import Camera
+        from utime import sleep_ms as sleep_ms_sync, ticks_ms, ticks_diff
 
         common.system.turbo(True)
 
         # Create the Camera connection
         cam = Camera()
-        cam.enable()
+        cam_on = cam.enable()
+        wake_start = ticks_ms()
+        while cam_on and not cam.ready():
+            if ticks_diff(ticks_ms(), wake_start) > CAMERA_WAKE_TIMEOUT_MS:
+                cam_on = False
+                break
+            sleep_ms_sync(5)
+
+        if not cam_on:
+            cam.disable()
+            common.system.turbo(False)
+            return
 
         # Take the picture - no viewfinder for now
         result = cam.snapshot(qr_buf, CAMERA_WIDTH, CAMERA_HEIGHT,
@@ -13,6 +13,7 @@ import gc
 import sys
 import os
 
+import backup_stream
 import chains
 import compat7z
 import seed
@@ -34,6 +35,11 @@ NUM_PW_WORDS = const(6)
 # max size we expect for a backup data file (encrypted or cleartext)
 MAX_BACKUP_FILE_SIZE = const(10000)     # bytes
 
+# Encrypted backups are written in the chunked v2 format. Older .7z backups can still be
+# verified and restored.
+BACKUP_SUFFIX = '.pbk'
+LEGACY_BACKUP_SUFFIX = '.7z'
+
 
 def ms_has_master_xfp(xpubs):
     from common import settings
@@ -49,16 +55,20 @@ def ms_has_master_xfp(xpubs):
     # print('EXCLUDING this one')
     return False
 
-def render_backup_contents():
+def render_backup_contents(rv=None):
     # simple text format:
     #   key = value
     # or #comments
     # but value is JSON
+    #
+    # Writes to `rv` if given (e.g. a backup_stream.Writer), else returns the text
     from common import settings, pa, system
     from utils import get_month_str
     from utime import localtime
 
-    rv = StringIO()
+    to_string = rv is None
+    if to_string:
+        rv = StringIO()
 
     def COMMENT(val=None):
         if val:
@@ -130,7 +140,23 @@ def render_backup_contents():
 
     rv.write('\n# EOF\n')
 
-    return rv.getvalue()
+    if to_string:
+        return rv.getvalue()
+
+def parse_backup_line(vals, line):
+    # Add one `key = value` line of a backup to `vals`, skipping blanks and comments
+    if not line or line[0] == '#':
+        return
+
+    try:
+        k, v = line.split(' = ', 1)
+        #print("%s = %s" % (k, v))
+
+        vals[k] = ujson.loads(v)
+    except:
+        # print("Unable to decode line: %r" % line)
+        # but keep going!
+        pass
 
 
 async def restore_from_dict(vals):
@@ -479,40 +505,21 @@ async def write_complete_backup(words, auto_backup=False, is_first_backup=False)
     from files import CardSlot, CardMissingError
     from uasyncio import sleep_ms
 
-    # Show progress:
-    dis.fullscreen('AutoBackup...' if auto_backup else 'Encrypting...' if words else 'Generating...')
-
-    body = render_backup_contents().encode()
-
     backup_num = 1
     xfp = xfp2str(settings.get('xfp')).lower()
     # print('XFP: {}'.format(xfp))
 
-    gc.collect()
-
-    if words:
-        # NOTE: Takes a few seconds to do the key-stretching, but little actual
-        # time to do the encryption.
+    pw = ' '.join(words) if words else None
+    #print('pw={}'.format(words))
 
-        pw = ' '.join(words)
-        #print('pw={}'.format(words))
-        zz = compat7z.Builder(password=pw, progress_fcn=system.progress_bar)
-        zz.add_data(body)
-
-        hdr, footer = zz.save('passport-backup.txt')
-
-        filesize = len(body) + MAX_BACKUP_FILE_SIZE
-
-        del body
-
-        gc.collect()
-    else:
-        # cleartext dump
-        zz = None
-        filesize = len(body)+10
+    gc.collect()
 
     while True:
+        # Show progress:
+        dis.fullscreen('AutoBackup...' if auto_backup else 'Encrypting...' if words else 'Generating...')
+
         base_filename = ''
+        partial_fname = None
 
         try:
             with CardSlot() as card:
@@ -521,7 +528,8 @@ async def write_complete_backup(words, auto_backup=False, is_first_backup=False)
 
                 # Make a unique filename
                 while True:
-                    base_filename = '{}-backup-{}.7z'.format(xfp, backup_num)
+                    base_filename = '{}-backup-{}{}'.format(xfp, backup_num,
+                                                            BACKUP_SUFFIX if pw else LEGACY_BACKUP_SUFFIX)
                     fname = '{}/{}'.format(backups_path, base_filename)
 
                     # Ensure filename doesn't already exist
@@ -533,19 +541,34 @@ async def write_complete_backup(words, auto_backup=False, is_first_backup=False)
 
                 # print('Saving to fname={}'.format(fname))
 
-                # Do actual write
+                # Do actual write. The contents go straight to the card as they're rendered,
+                # a chunk at a time when encrypting.
+                # NOTE: Takes a few seconds to do the key-stretching, but little actual
+                # time to do the encryption.
+                partial_fname = fname
                 with open(fname, 'wb') as fd:
-                    if zz:
-                        fd.write(hdr)
-                        fd.write(zz.body)
-                        fd.write(footer)
+                    if pw:
+                        out = backup_stream.Writer(fd, pw, progress_fcn=system.progress_bar)
+                        render_backup_contents(out)
+                        out.close()
                     else:
-                        fd.write(body)
+                        # cleartext dump
+                        render_backup_contents(fd)
+                partial_fname = None
 
         except Exception as e:
             # includes CardMissingError
             import sys
             # sys.print_exception(e)
+
+            # Don't leave a partial backup behind to be picked later
+            if partial_fname:
+                try:
+                    with CardSlot() as card:
+                        os.remove(partial_fname)
+                except:
+                    pass
+
             # catch any error
             if not auto_backup:
                 ch = await ux_show_story('Unable to write backup. Please insert a formatted microSD card.\n\n' +
@@ -577,6 +600,8 @@ async def verify_backup_file(fname_or_fd):
     # read 7z header, and measure checksums
     # - no password is wanted/required
     # - really just checking CRC32, but that's enough against truncated files
+    # - v2 files can only be checked for structure without the password; their tags are
+    #   checked on restore
     from files import CardSlot, CardMissingError
     from actions import needs_microsd
     prob = None
@@ -589,15 +614,19 @@ async def verify_backup_file(fname_or_fd):
             with (open(fname_or_fd, 'rb') if isinstance(
                 fname_or_fd, str) else fname_or_fd) as fd:
 
-                prob = 'Unable to read backup file headers. Might be truncated.'
-                compat7z.check_file_headers(fd)
+                if backup_stream.is_v2(fd):
+                    prob = 'Unable to verify backup file. Might be truncated.'
+                    backup_stream.check_structure(fd)
+                else:
+                    prob = 'Unable to read backup file headers. Might be truncated.'
+                    compat7z.check_file_headers(fd)
 
-                prob = 'Unable to verify backup file contents.'
-                zz = compat7z.Builder()
-                files = zz.verify_file_crc(fd, MAX_BACKUP_FILE_SIZE)
+                    prob = 'Unable to verify backup file contents.'
+                    zz = compat7z.Builder()
+                    files = zz.verify_file_crc(fd, MAX_BACKUP_FILE_SIZE)
 
-                assert len(files) == 1
-                fname, fsize = files[0]
+                    assert len(files) == 1
+                    fname, fsize = files[0]
 
     except CardMissingError:
         await needs_microsd()
@@ -648,6 +677,8 @@ async def restore_complete_doit(fname_or_fd, words, partial_restore):
     password = ' '.join(words)
 
     prob = None
+    contents = None
+    vals = {}
 
     try:
         with CardSlot() as card:
@@ -661,6 +692,40 @@ async def restore_complete_doit(fname_or_fd, words, partial_restore):
             try:
                 if not words:
                     contents = fd.read()
+                elif backup_stream.is_v2(fd):
+                    # The header tag is checked right after key-stretching, so a wrong password
+                    # is caught without reading the rest of the file
+                    dis.fullscreen("Decrypting...")
+                    try:
+                        reader = backup_stream.Reader(fd, password, progress_fcn=system.progress_bar)
+                    except backup_stream.AuthError:
+                        return ('Unable to decrypt backup file. The password is incorrect.'
+                                '\n\nYou entered:\n\n' + password)
+                    except Exception as e:
+                        return 'Unable to read backup file. The backup may have been modified.\n\nError: ' \
+                            + str(e)
+
+                    # Parse each chunk as it's verified. Nothing is restored unless every chunk
+                    # checks out.
+                    try:
+                        first = True
+                        partial = b''
+                        for chunk in reader.chunks():
+                            if first:
+                                assert chunk[0:1] == b'#'
+                                first = False
+                            lines = (partial + chunk).split(b'\n')
+                            partial = lines.pop()
+                            for line in lines:
+                                parse_backup_line(vals, line.decode())
+
+                        # simple quick sanity check
+                        assert not first and partial == b''
+                    except Exception as e:
+                        return 'Unable to read backup file. The backup may have been modified.\n\nError: ' \
+                            + str(e)
+                    finally:
+                        reader.close()
                 else:
                     try:
                         compat7z.check_file_headers(fd)
@@ -689,22 +754,9 @@ async def restore_complete_doit(fname_or_fd, words, partial_restore):
         await needs_microsd()
         return
 
-    vals = {}
-    for line in contents.decode().split('\n'):
-        if not line:
-            continue
-        if line[0] == '#':
-            continue
-
-        try:
-            k, v = line.split(' = ', 1)
-            #print("%s = %s" % (k, v))
-
-            vals[k] = ujson.loads(v)
-        except:
-            # print("Unable to decode line: %r" % line)
-            # but keep going!
-            pass
+    if contents is not None:
+        for line in contents.decode().split('\n'):
+            parse_backup_line(vals, line)
 
     # this leads to reboot if it works, else errors shown, etc.
     # print('vals = {}'.format(to_str(vals)))
@@ -924,9 +976,11 @@ def generate_bitcoin_core_wallet(example_addrs, account_num):
         prefix = sv.derive_path(derive)
         xpub = chain.serialize_public(prefix)
 
+        receive = sv.derive_path('0', master=prefix)
         for i in range(3):
             sp = '0/%d' % i
-            node = sv.derive_path(sp, master=prefix)
+            node = receive.derive_child(i)
+            sv.register(node)
             a = chain.address(node, AF_P2WPKH)
             example_addrs.append(('m/%s/%s' % (derive, sp), a))
 
@@ -115,6 +115,10 @@ class CardSlot:
     # Touch interface must be disabled during any SD Card usage!
     last_change = None
 
+    # CardSlots entered and not yet exited. Tasks can overlap while one of them yields inside its
+    # own CardSlot, so the card is only unmounted and powered off when the last one exits.
+    num_active = 0
+
     @classmethod
     def setup(cls):
         # Watch the SD card-detect signal line... but very noisy
@@ -148,18 +152,30 @@ class CardSlot:
         ok = _try_microsd()
 
         if not ok:
-            self.recover()
+            if CardSlot.num_active == 0:
+                self.recover()
 
             raise CardMissingError
 
         self.active = True
+        CardSlot.num_active += 1
 
         return self
 
     def __exit__(self, *a):
-        self.recover()
+        if self.active:
+            CardSlot.num_active -= 1
+
+        if CardSlot.num_active == 0:
+            self.recover()
+        else:
+            self.active = False
         return False
 
+    @classmethod
+    def in_use(cls):
+        return cls.num_active > 0
+
     def recover(self):
 
         self.active = False
@@ -192,8 +208,6 @@ class CardSlot:
         # - assuming we will write to it, so cannot exist
         # - return None,None if no SD card or can't mount, etc.
         # - no UI here please
-        import ure
-
         assert self.active      # used out of context mgr
 
         # prefer SD card if we can
@@ -218,13 +232,16 @@ class CardSlot:
         # look for existing numbered files, even if some are deleted, and pick next
         # highest filename
         highest = 1
-        pat = ure.compile(basename + r'-(\d+)' + ext)
+        prefix = basename + '-'
 
         for fn in os.listdir(path):
-            m = pat.match(fn)
-            if not m:
+            # Looking for basename-NNN.ext; plain string checks are much cheaper than a regex
+            if not fn.startswith(prefix) or not fn.endswith(ext):
+                continue
+            num = fn[len(prefix):len(fn) - len(ext)]
+            if not num.isdigit():
                 continue
-            highest = max(highest, int(m.group(1)))
+            highest = max(highest, int(num))
 
         fname = path + basename + ('-%d' % (highest+1)) + ext
 
@@ -6,6 +6,8 @@
 #
 # autogenerated; don't edit
 #
+from micropython import const
+
 class Graphics:
     # (w,h, w_bytes, wbits, data)
 
@@ -83,5 +85,49 @@ class Graphics:
 
     tetris_pattern_5 = (12, 12,  2, 0, b':\xc0z\xe0\xc0p\xef\xb0\xef\xb0\xe0p\xef\xb0\xef\xb0\xef\xb0\xc0pz\xe0:\xc0')
 
+    # Indexed by icon id
+    icons = (scroll, scrollbar, space, sm_box, spin, arrow_down, more_right, arrow_up, more_left, fruit, tetris_pattern_1, tetris_pattern_6, pw_pressed_box_sm, wedge, x, pw_filled_box_sm, tetris_pattern_3, splash, battery_100, wordmark, fcc_ce_logos, selected, pw_empty_box_sm, tetris_pattern_4, pw_pressed_box_lg, battery_50, pw_filled_box_lg, tetris_pattern_2, battery_25, pw_empty_box_lg, tetris_pattern_0, battery_low, passphrase_icon, passport, ie_logo, battery_75, tetris_pattern_5)
+
+    # Icon name -> id
+    ids = {'scroll': 0, 'scrollbar': 1, 'space': 2, 'sm_box': 3, 'spin': 4, 'arrow_down': 5, 'more_right': 6, 'arrow_up': 7, 'more_left': 8, 'fruit': 9, 'tetris_pattern_1': 10, 'tetris_pattern_6': 11, 'pw_pressed_box_sm': 12, 'wedge': 13, 'x': 14, 'pw_filled_box_sm': 15, 'tetris_pattern_3': 16, 'splash': 17, 'battery_100': 18, 'wordmark': 19, 'fcc_ce_logos': 20, 'selected': 21, 'pw_empty_box_sm': 22, 'tetris_pattern_4': 23, 'pw_pressed_box_lg': 24, 'battery_50': 25, 'pw_filled_box_lg': 26, 'tetris_pattern_2': 27, 'battery_25': 28, 'pw_empty_box_lg': 29, 'tetris_pattern_0': 30, 'battery_low': 31, 'passphrase_icon': 32, 'passport': 33, 'ie_logo': 34, 'battery_75': 35, 'tetris_pattern_5': 36}
+
+ICON_SCROLL = const(0)
+ICON_SCROLLBAR = const(1)
+ICON_SPACE = const(2)
+ICON_SM_BOX = const(3)
+ICON_SPIN = const(4)
+ICON_ARROW_DOWN = const(5)
+ICON_MORE_RIGHT = const(6)
+ICON_ARROW_UP = const(7)
+ICON_MORE_LEFT = const(8)
+ICON_FRUIT = const(9)
+ICON_TETRIS_PATTERN_1 = const(10)
+ICON_TETRIS_PATTERN_6 = const(11)
+ICON_PW_PRESSED_BOX_SM = const(12)
+ICON_WEDGE = const(13)
+ICON_X = const(14)
+ICON_PW_FILLED_BOX_SM = const(15)
+ICON_TETRIS_PATTERN_3 = const(16)
+ICON_SPLASH = const(17)
+ICON_BATTERY_100 = const(18)
+ICON_WORDMARK = const(19)
+ICON_FCC_CE_LOGOS = const(20)
+ICON_SELECTED = const(21)
+ICON_PW_EMPTY_BOX_SM = const(22)
+ICON_TETRIS_PATTERN_4 = const(23)
+ICON_PW_PRESSED_BOX_LG = const(24)
+ICON_BATTERY_50 = const(25)
+ICON_PW_FILLED_BOX_LG = const(26)
+ICON_TETRIS_PATTERN_2 = const(27)
+ICON_BATTERY_25 = const(28)
+ICON_PW_EMPTY_BOX_LG = const(29)
+ICON_TETRIS_PATTERN_0 = const(30)
+ICON_BATTERY_LOW = const(31)
+ICON_PASSPHRASE_ICON = const(32)
+ICON_PASSPORT = const(33)
+ICON_IE_LOGO = const(34)
+ICON_BATTERY_75 = const(35)
+ICON_TETRIS_PATTERN_5 = const(36)
+ICON_COUNT = const(37)
 
 # EOF
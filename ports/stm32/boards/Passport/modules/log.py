@@ -1,21 +1,262 @@
 # SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
 # SPDX-License-Identifier: GPL-3.0-or-later
 #
-# log.py - Log file functionality that writes to the console via print() and, if available, also writes to the SD card
-#          appending to a file named log.log.
+# log.py - Buffered logging to the console and, if available, the microSD card
 #
+#   from log import log
+#   log('message')                  Log at INFO level
+#
+#   import log
+#   log.warn('message')             Or pick the level: log.debug(), log.info(), log.warn(), log.error()
+#
+# Messages are always printed to the console. Records at or above the minimum level are also
+# kept in a fixed-size ring buffer in RAM, and a background task appends them to the card in
+# batches. Opening the card and the file costs FAT directory lookups and a metadata update, so
+# doing it once per batch instead of once per message keeps logging cheap in hot paths.
+#
+# The buffer is flushed right away for ERROR records, and should be flushed with log.flush()
+# before shutting down. Nothing is written while another task has the card open, since it may
+# be yielding part way through a file; the records wait for the next batch instead. If the buffer
+# fills up before it can be flushed, the oldest records are dropped and a WARN record saying how
+# many were lost is written with the next batch.
+#
+# Records go to log.log as text lines, or to log.bin as compact binary records (see
+# tools/log_reader/log_reader.py):
+#
+#   0xA5, level (u8), ticks_ms (u32 LE), length (u16 LE), message (UTF-8)
+#
+
+from micropython import const
+import ustruct
+
+DEBUG = const(10)
+INFO = const(20)
+WARN = const(30)
+ERROR = const(40)
+
+LEVEL_NAMES = {DEBUG: 'DEBUG', INFO: 'INFO', WARN: 'WARN', ERROR: 'ERROR'}
+
+# RAM set aside for records waiting to be written
+BUF_SIZE = const(4096)
+
+# How often the background task writes out pending records
+FLUSH_MS = const(5000)
+
+RECORD_MAGIC = const(0xA5)
+HEADER_FORMAT = '<BBIH'
+HEADER_SIZE = const(8)
+
+TEXT_FILENAME = 'log.log'
+BINARY_FILENAME = 'log.bin'
+
+
+def _ticks_ms():
+    import utime
+    return utime.ticks_ms()
+
+
+def _append_to_card(filename, data):
+    from files import CardSlot
+
+    with CardSlot() as card:
+        fname, nice = card.get_file_path(filename)
+        with open(fname, 'ab') as fd:
+            fd.write(data)
+
+
+def _card_in_use():
+    from files import CardSlot
+    return CardSlot.in_use()
+
+
+def text_prefix(level, ticks):
+    return '{:>10} {:<5} '.format(ticks, LEVEL_NAMES.get(level, str(level)))
+
+
+class Logger:
+    def __init__(self, sink=_append_to_card, clock=_ticks_ms, buf_size=BUF_SIZE, min_level=INFO,
+                 binary=False, echo=True, sink_busy=_card_in_use):
+        self.sink = sink
+        self.sink_busy = sink_busy
+        self.clock = clock
+        self.min_level = min_level
+        self.binary = binary
+        self.echo = echo
+
+        # Ring buffer of framed records (always in the binary layout), from tail to head
+        self.buf = bytearray(buf_size)
+        self.head = 0
+        self.used = 0
+        self.dropped = 0
+
+        # Accounting
+        self.flushes = 0
+        self.flush_errors = 0
+        self.flush_deferred = 0
+
+    def log(self, msg, level=INFO):
+        if self.echo:
+            print(msg)
+
+        if level < self.min_level:
+            return
+
+        data = msg.encode() if isinstance(msg, str) else bytes(msg)
+        max_len = len(self.buf) - HEADER_SIZE
+        if len(data) > max_len:
+            data = data[:max_len]
+
+        self._append(level, self.clock() & 0xFFFFFFFF, data)
+
+        if level >= ERROR:
+            self.flush()
+
+    def debug(self, msg):
+        self.log(msg, DEBUG)
+
+    def info(self, msg):
+        self.log(msg, INFO)
 
-def log(msg):
-    from files import CardSlot, CardMissingError
+    def warn(self, msg):
+        self.log(msg, WARN)
 
-    # Always write to console
-    print(msg)
+    def error(self, msg):
+        self.log(msg, ERROR)
 
-    # Then try the microSD card, but it's fine if not present
+    def pending(self):
+        return self.used
+
+    def flush(self):
+        if self.used == 0 and self.dropped == 0:
+            return True
+
+        if self.sink_busy():
+            self.flush_deferred += 1
+            return False
+
+        out = bytearray()
+        if self.dropped:
+            self._encode(out, WARN, self.clock() & 0xFFFFFFFF, b'%d log records dropped' % self.dropped)
+
+        pos = (self.head - self.used) % len(self.buf)
+        remaining = self.used
+        while remaining > 0:
+            _, level, ticks, length = ustruct.unpack(HEADER_FORMAT, self._read(pos, HEADER_SIZE))
+            self._encode(out, level, ticks, self._read(pos + HEADER_SIZE, length))
+            pos = (pos + HEADER_SIZE + length) % len(self.buf)
+            remaining -= HEADER_SIZE + length
+
+        try:
+            self.sink(BINARY_FILENAME if self.binary else TEXT_FILENAME, out)
+        except Exception:
+            # Most likely there's no card. Keep the records; they'll be retried next time or
+            # overwritten if more arrive first.
+            self.flush_errors += 1
+            return False
+
+        self.used = 0
+        self.dropped = 0
+        self.flushes += 1
+        return True
+
+    def stats(self):
+        return {
+            'pending': self.used,
+            'dropped': self.dropped,
+            'flushes': self.flushes,
+            'flush_errors': self.flush_errors,
+            'flush_deferred': self.flush_deferred,
+        }
+
+    async def run(self):
+        from uasyncio import sleep_ms
+
+        while True:
+            await sleep_ms(FLUSH_MS)
+            self.flush()
+
+    def _encode(self, out, level, ticks, msg):
+        if self.binary:
+            out.extend(ustruct.pack(HEADER_FORMAT, RECORD_MAGIC, level, ticks, len(msg)))
+            out.extend(msg)
+        else:
+            # The message bytes are copied as-is, so a truncated UTF-8 sequence can't fail here
+            out.extend(text_prefix(level, ticks).encode())
+            out.extend(msg)
+            out.extend(b'\n')
+
+    def _append(self, level, ticks, data):
+        size = HEADER_SIZE + len(data)
+
+        # Make room by dropping the oldest records
+        while self.used + size > len(self.buf):
+            tail = (self.head - self.used) % len(self.buf)
+            _, _, _, length = ustruct.unpack(HEADER_FORMAT, self._read(tail, HEADER_SIZE))
+            self.used -= HEADER_SIZE + length
+            self.dropped += 1
+
+        self._write(ustruct.pack(HEADER_FORMAT, RECORD_MAGIC, level, ticks, len(data)))
+        self._write(data)
+        self.used += size
+
+    def _write(self, data):
+        n = len(data)
+        first = min(n, len(self.buf) - self.head)
+        self.buf[self.head:self.head + first] = data[:first]
+        if first < n:
+            self.buf[0:n - first] = data[first:]
+        self.head = (self.head + n) % len(self.buf)
+
+    def _read(self, pos, n):
+        pos %= len(self.buf)
+        end = pos + n
+        if end <= len(self.buf):
+            return bytes(self.buf[pos:end])
+        return bytes(self.buf[pos:]) + bytes(self.buf[:end - len(self.buf)])
+
+
+logger = None
+
+
+def get_logger():
+    global logger
+    if logger == None:
+        logger = Logger()
+    return logger
+
+
+def configure(min_level=None, binary=None):
+    lg = get_logger()
+    if min_level != None:
+        lg.min_level = min_level
+    if binary != None:
+        # Records already buffered are written in the new format
+        lg.binary = binary
+
+
+def flush():
+    # Safe to call from shutdown and error paths
     try:
-        with CardSlot() as card:
-            fname, nice = card.get_file_path('log.log')
-            with open(fname, 'a') as fd:
-                fd.write(msg + '\n')
+        return get_logger().flush()
     except Exception:
-        pass
+        return False
+
+
+def log(msg, level=INFO):
+    get_logger().log(msg, level)
+
+
+def debug(msg):
+    get_logger().log(msg, DEBUG)
+
+
+def info(msg):
+    get_logger().log(msg, INFO)
+
+
+def warn(msg):
+    get_logger().log(msg, WARN)
+
+
+def error(msg):
+    get_logger().log(msg, ERROR)
@@ -126,6 +126,10 @@ def go():
     from sflash import SPIFlash
     common.sf = SPIFlash()
 
+    # CPU frequency governor, which takes over the fast clock we booted with
+    import perf
+    governor = perf.get_governor()
+
     # Initialize internal flash settings
     from settings import Settings
     common.settings = Settings(common.loop)
@@ -143,7 +147,7 @@ def go():
     # Allocate buffers for camera
     from constants import VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT, CAMERA_WIDTH, CAMERA_HEIGHT
 
-    # QR buf is 1 byte per pixel grayscale
+    # QR buf is 1 byte per pixel grayscale, at the start of DTCM where passport.ld reserves it
     import uctypes
     common.qr_buf = uctypes.bytearray_at(0x20000000, CAMERA_WIDTH * CAMERA_HEIGHT)
     # common.qr_buf = bytearray(CAMERA_WIDTH * CAMERA_HEIGHT)
@@ -182,6 +186,17 @@ def go():
     # Setup check for auto shutdown
     common.loop.create_task(check_auto_shutdown())
 
+    # Let the governor drop to the slow clock once things go quiet
+    common.loop.create_task(governor.run())
+
+    # Write buffered log records to the microSD card in batches
+    import log
+    common.loop.create_task(log.get_logger().run())
+
+    # Extend the address indexes for Verify Address while idle
+    import addr_index
+    common.loop.create_task(addr_index.run())
+
     # Setup check to read battery level and put it in common.battery_level
     common.loop.create_task(demo_loop())
 
@@ -205,6 +220,8 @@ def run_loop():
         #     # preserve GUI state, but want to see where we are
         #     print("KeyboardInterrupt")
         #     raise
+        import log
+        log.flush()
         if isinstance(exc, SystemExit):
             # Ctrl-D and warm reboot cause this, not bugs
             raise
@@ -12,7 +12,9 @@
 import gc
 import utime
 
+import perf
 from display import Display, FontSmall
+from graphics import ICON_SELECTED, ICON_WEDGE, ICON_SPACE
 from uasyncio import sleep_ms
 from ux import KeyInputHandler, the_ux, ux_shutdown
 
@@ -148,7 +150,7 @@ class MenuSystem:
 
         menu_item_height = self.font.leading
         menu_item_left = 6
-        sel_w, sel_h = dis.icon_size('selected')
+        sel_w, sel_h = dis.icon_size(ICON_SELECTED)
         if self.chooser_mode:
             menu_item_left += sel_w
 
@@ -162,7 +164,7 @@ class MenuSystem:
             msg = menu_item.label
             is_sel = (self.cursor == n+self.ypos)
             if is_sel:
-                wedge_w, wedge_h = dis.icon_size('wedge')
+                wedge_w, wedge_h = dis.icon_size(ICON_WEDGE)
                 dis.dis.fill_rect(0, y, Display.WIDTH, menu_item_height - 1, 1)
 
                 dis.text(x, y + 2, msg, font=self.font, invert=1)
@@ -176,19 +178,19 @@ class MenuSystem:
                         Display.WIDTH - (icon_x - 2),
                         menu_item_height - 1,
                         1)
-                    dis.icon(
+                    dis.blit_icon(
+                        ICON_WEDGE,
                         icon_x,
                         y + (menu_item_height - wedge_h) // 2,
-                        'wedge',
                         invert=1)
             else:
                 dis.text(x, y + 2, msg, font=self.font)
 
             if msg[0] == ' ' and self.space_indicators:
-                dis.icon(x-2, y + 11, 'space', invert=is_sel)
+                dis.blit_icon(ICON_SPACE, x-2, y + 11, invert=is_sel)
 
             if self.chooser_mode and self.chosen is not None and (n+self.ypos) == self.chosen:
-                dis.icon(2, y + 6, 'selected', invert=is_sel)
+                dis.blit_icon(ICON_SELECTED, 2, y + 6, invert=is_sel)
 
             y += menu_item_height
             if y > Display.HEIGHT - Display.FOOTER_HEIGHT:
@@ -210,7 +212,7 @@ class MenuSystem:
         # We only want to turn it off once rather than whenever it's False, so we
         # set to None to avoid turning turbo off again.
         if self.turbo == False:
-            system.turbo(False)
+            perf.idle()
             self.turbo = None
 
     def down(self):
@@ -320,8 +322,7 @@ class MenuSystem:
             if event_type == 'down' or event_type == 'repeat':
 
                 if event_type == 'down':
-                    from common import system
-                    system.turbo(True)
+                    perf.kick()
                     self.turbo = True
 
                 if not self.input.kcode_imminent():
@@ -97,12 +97,22 @@ def derive_address(deriv_path, addr_idx, addr_type, ms_wallet):
 def get_addresses_in_range(start, end, addr_type, acct_num,  ms_wallet):
     # print('addr_type={} acct_num={} ms_wallet={}'.format(addr_type, acct_num, ms_wallet))
 
+    fmt = get_deriv_path_from_addr_type_and_acct(addr_type, acct_num, ms_wallet != None)
+    deriv_path = fmt.format(acct_num)
+
+    if ms_wallet:
+        return [derive_address(deriv_path, i, addr_type, ms_wallet) for i in range(start, end)]
+
+    import stash
+
+    # The addresses are siblings, so derive their parent once and each one from it
     entries = []
-    for i in range(start, end):
-        fmt = get_deriv_path_from_addr_type_and_acct(addr_type, acct_num, ms_wallet != None)
-        deriv_path = fmt.format(acct_num)
-        entry = derive_address(deriv_path, i, addr_type, ms_wallet)
-        entries.append(entry)
+    with stash.SensitiveValues() as sv:
+        receive = sv.derive_path('{}/0'.format(deriv_path))
+        for i in range(start, end):
+            node = receive.derive_child(i)
+            sv.register(node)
+            entries.append(('0/{}'.format(i), sv.chain.address(node, addr_type)))
     return entries
 
 class NewWalletUX(UXStateMachine):
@@ -542,7 +552,8 @@ class NewWalletUX(UXStateMachine):
                 # TODO: Do we need to encode the data to text for QR here? Some formats might not be text.
 
                 qr_type = self.export_mode['qr_type']
-                await ux_show_text_as_ur(title='Export QR', qr_text=data, qr_type=qr_type, left_btn='DONE')
+                qr_args = self.export_mode.get('qr_args')
+                await ux_show_text_as_ur(title='Export QR', qr_text=data, qr_type=qr_type, qr_args=qr_args, left_btn='DONE')
                 # Only way to get out is DONE, so no need to check result
 
                 # Save the progress so that we can resume later
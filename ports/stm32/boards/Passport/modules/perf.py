@@ -0,0 +1,335 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# perf.py - CPU frequency governor
+#
+# Code describes the work it's doing and the governor picks the clock (64MHz or 480MHz):
+#
+#   with perf.burst('sign'):        Fast clock for a block of heavy work (crypto, encoding)
+#   perf.begin('camera') ... perf.end('camera')
+#                                   Fast clock across a longer activity
+#   perf.kick()                     User interaction: run fast for a short while
+#   perf.idle()                     Waiting for the user: drop to the slow clock soon
+#
+# It also wraps the uprofile sampling profiler, for finding where the time goes on the device:
+#
+#   with perf.span('scan.decode'):  Name and time a region; samples taken inside it are tagged
+#   perf.start_profile()            Start sampling the running Python code
+#   perf.save_profile()             Stop, and write the samples to the microSD card
+#
+# When the last hold is released, the governor keeps the fast clock for a while before dropping
+# back, so back-to-back work doesn't bounce the clock. A switch costs a PLL relock plus
+# re-initializing the UARTs and SPI, so the hold time also grows with the measured switch cost.
+#
+# The governor only owns one turbo reference: the remaining direct System.turbo() calls and the
+# native code that uses turbo() can keep the clock fast after it lets go, and the device boots
+# fast with no reference at all. So it reads the real clock to account the time at each frequency,
+# and adopts the fast clock it boots with, to drop it once things go quiet.
+#
+# The clock, the switch function and the frequency readback are passed in, so the policy can be
+# run with a fake clock on the unix port (see tools/perf_governor_test).
+#
+
+from micropython import const
+
+# How long the fast clock is kept after the last hold is released
+HOLD_MS = const(250)
+
+# How long a user interaction keeps the fast clock
+KICK_MS = const(500)
+
+# Never hold for less than this many times the cost of a switch
+SWITCH_COST_FACTOR = const(20)
+
+# How often the governor checks whether it can drop to the slow clock
+POLL_MS = const(100)
+
+FREQ_LOW_MHZ = const(64)
+FREQ_HIGH_MHZ = const(480)
+
+
+def _ticks_ms():
+    import utime
+    return utime.ticks_ms()
+
+
+def _ticks_diff(end, start):
+    import utime
+    return utime.ticks_diff(end, start)
+
+
+def _is_high():
+    # The system clock is the core clock when fast, and twice it (128MHz) when slow
+    import machine
+    return machine.freq()[0] >= FREQ_HIGH_MHZ * 1000000
+
+
+class _Burst:
+    def __init__(self, governor, name):
+        self.governor = governor
+        self.name = name
+
+    def __enter__(self):
+        self.governor.begin(self.name)
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.governor.end(self.name)
+
+
+class Governor:
+    def __init__(self, set_high, is_high=_is_high, clock=_ticks_ms, ticks_diff=_ticks_diff,
+                 hold_ms=HOLD_MS, kick_ms=KICK_MS):
+        self.set_high = set_high
+        self.is_high = is_high
+        self.clock = clock
+        self.ticks_diff = ticks_diff
+        self.base_hold_ms = hold_ms
+        self.kick_ms = kick_ms
+
+        self.holds = {}             # Hint name -> number of active holds
+        self.num_holds = 0
+        self.turbo = False          # Whether the governor holds its turbo reference
+        self.switched_at = clock()  # When it last took or released it
+        self.drop_from = None       # Start of the wait before dropping to the slow clock
+        self.drop_after_ms = 0
+
+        # Accounting, of the real clock
+        self.high = is_high()
+        self.state_since = self.switched_at
+        self.low_ms = 0
+        self.high_ms = 0
+        self.transitions = 0
+        self.external = 0           # Transitions made by someone else's turbo()
+        self.transition_ms = 0
+        self.switch_cost_ms = 0     # Smoothed cost of one switch
+
+        if self.high:
+            # Booted fast: take the clock over so it drops once nothing needs it
+            self.set_high(True)
+            self.turbo = True
+            self._drop_later(self.hold_ms())
+
+    def begin(self, name):
+        self._sync()
+        self.holds[name] = self.holds.get(name, 0) + 1
+        self.num_holds += 1
+        self.drop_from = None
+        self._switch(True)
+
+    def end(self, name):
+        count = self.holds.get(name, 0)
+        if count == 0:
+            # Unbalanced end() - ignore it, like System.turbo(False) does
+            return
+
+        self._sync()
+        if count == 1:
+            del self.holds[name]
+        else:
+            self.holds[name] = count - 1
+        self.num_holds -= 1
+
+        if self.num_holds == 0:
+            self._drop_later(self.hold_ms())
+
+    def burst(self, name):
+        return _Burst(self, name)
+
+    def kick(self):
+        self._sync()
+        self._switch(True)
+        if self.num_holds == 0:
+            self._drop_later(self.kick_ms)
+
+    def idle(self):
+        # Only the minimum dwell is left, so a switch that just happened isn't undone right away
+        self._sync()
+        if self.turbo and self.num_holds == 0:
+            self.drop_from = self.switched_at
+            self.drop_after_ms = self.hold_ms()
+            self.poll()
+
+    def poll(self):
+        self._sync()
+        if not self.turbo or self.num_holds > 0 or self.drop_from == None:
+            return
+
+        if self.ticks_diff(self.clock(), self.drop_from) >= self.drop_after_ms:
+            self._switch(False)
+
+    def hold_ms(self):
+        return max(self.base_hold_ms, self.switch_cost_ms * SWITCH_COST_FACTOR)
+
+    def frequency_mhz(self):
+        return FREQ_HIGH_MHZ if self.high else FREQ_LOW_MHZ
+
+    def _drop_later(self, ms):
+        now = self.clock()
+        if self.drop_from != None:
+            # Never shorten a wait that's already running
+            remaining = self.drop_after_ms - self.ticks_diff(now, self.drop_from)
+            if remaining >= ms:
+                return
+
+        self.drop_from = now
+        self.drop_after_ms = ms
+
+    def _account(self, now):
+        elapsed = self.ticks_diff(now, self.state_since)
+        if self.high:
+            self.high_ms += elapsed
+        else:
+            self.low_ms += elapsed
+        self.state_since = now
+
+    def _sync(self):
+        # Catch up with a switch made by someone else since we last looked. The time since then is
+        # counted at the old frequency, so it's out by at most a poll.
+        high = self.is_high()
+        if high != self.high:
+            self._account(self.clock())
+            self.high = high
+            self.transitions += 1
+            self.external += 1
+
+    def _switch(self, turbo):
+        if turbo == self.turbo:
+            return
+
+        start = self.clock()
+        self.set_high(turbo)
+        end = self.clock()
+        self.turbo = turbo
+        self.switched_at = end
+        self.drop_from = None
+
+        high = self.is_high()
+        if high == self.high:
+            # Someone else still holds the fast clock, so nothing changed
+            return
+
+        self._account(start)
+        cost = self.ticks_diff(end, start)
+        self.transitions += 1
+        self.transition_ms += cost
+        measured = self.transitions - self.external
+        self.switch_cost_ms = cost if measured == 1 else (self.switch_cost_ms * 3 + cost) // 4
+
+        # The switch itself is counted at neither frequency
+        self.high = high
+        self.state_since = end
+
+    def stats(self):
+        self._sync()
+        self._account(self.clock())
+        return {
+            'mhz': self.frequency_mhz(),
+            'low_ms': self.low_ms,
+            'high_ms': self.high_ms,
+            'transitions': self.transitions,
+            'external': self.external,
+            'transition_ms': self.transition_ms,
+            'hold_ms': self.hold_ms(),
+            'holds': dict(self.holds),
+        }
+
+    async def run(self):
+        from uasyncio import sleep_ms
+
+        while True:
+            await sleep_ms(POLL_MS)
+            self.poll()
+
+
+governor = None
+
+
+def _set_high(high):
+    from common import system
+    system.turbo(high)
+
+
+def get_governor():
+    global governor
+    if governor == None:
+        governor = Governor(_set_high)
+    return governor
+
+
+def burst(name):
+    return get_governor().burst(name)
+
+
+def begin(name):
+    get_governor().begin(name)
+
+
+def end(name):
+    get_governor().end(name)
+
+
+def kick():
+    get_governor().kick()
+
+
+def idle():
+    get_governor().idle()
+
+
+try:
+    import uprofile
+except ImportError:
+    uprofile = None
+
+PROFILE_FILENAME = 'profile.txt'
+
+
+class _Span:
+    def __init__(self, name):
+        self.name = name
+
+    def __enter__(self):
+        if uprofile:
+            uprofile.span_begin(self.name)
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if uprofile:
+            uprofile.span_end()
+
+
+def span(name):
+    # Cheap enough to leave in hot paths: just a timestamp at each end
+    return _Span(name)
+
+
+def start_profile(buf_size=8192, depth=16):
+    if uprofile:
+        uprofile.start(buf_size=buf_size, depth=depth)
+
+
+def save_profile(filename=PROFILE_FILENAME):
+    # Writes folded stacks ("span;func (file:line);... count") for flamegraph.pl or speedscope,
+    # followed by the span timings. Returns False if there's nothing to save or no card.
+    if not uprofile:
+        return False
+
+    from files import CardSlot
+
+    uprofile.stop()
+    try:
+        with CardSlot() as card:
+            fname, nice = card.get_file_path(filename)
+            with open(fname, 'w') as fd:
+                uprofile.dump(fd)
+                stats = uprofile.stats()
+                fd.write('# samples={} dropped={}\n'.format(stats['samples'], stats['dropped']))
+                for name, (count, total_us, max_us) in stats['spans'].items():
+                    fd.write('# span {} count={} total_us={} max_us={}\n'.format(
+                        name, count, total_us, max_us))
+    except Exception:
+        return False
+
+    uprofile.clear()
+    return True
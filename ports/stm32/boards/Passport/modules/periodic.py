@@ -75,8 +75,6 @@ def calc_battery_percent(current, voltage):
 
     return 0
 
-NUM_SAMPLES = 2
-
 async def update_battery_level():
     from utils import random_filename
     from files import CardSlot
@@ -91,17 +89,11 @@ async def update_battery_level():
 
         first_time = False
 
-        # Read the current values -- repeat this a number of times and average for better results
-        total_current = 0
-        total_voltage = 0
-        for i in range(NUM_SAMPLES):
-            (current, voltage) = common.powermon.read()
-            voltage = round(voltage * (44.7 + 22.1) / 44.7)
-            total_current += current
-            total_voltage += voltage
-            await sleep_ms(1) # Wait a bit before next sample
-        current = total_current / NUM_SAMPLES
-        voltage = total_voltage / NUM_SAMPLES
+        # The readings are already filtered in the background, so one is enough
+        (current, voltage) = common.powermon.read()
+        if current is None:
+            continue
+        voltage = round(voltage * (44.7 + 22.1) / 44.7)
 
         # Update the battery_mon file if enabled
         if common.enable_battery_mon:
@@ -157,6 +149,8 @@ async def check_auto_shutdown():
         # print('idle_so_far={} timeout_ms={} countdown={}'.format(idle_so_far, timeout_ms, countdown))
         if idle_so_far >= timeout_ms:
             if countdown == -1:
+                import log
+                log.flush()
                 common.system.shutdown() # Never return from this!
             else:
                 dis.fullscreen('Shutting down in {}'.format(countdown), line2='Press key to cancel')
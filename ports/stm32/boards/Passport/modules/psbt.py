@@ -14,16 +14,19 @@ from ubinascii import hexlify as b2a_hex
 from utils import xfp2str, B2A, keypath_to_str, problem_file_line, swab32
 import trezorcrypto, stash, gc, history, sys
 from uio import BytesIO
-from sffile import SizerFile
-from sram4 import psbt_tmp256
+from sram4 import psbt_tmp256, psbt_out_buf
+from psbt_writer import PSBTWriter, varint_len, push_len
 from multisig import MultisigWallet, MAX_SIGNERS, disassemble_multisig, disassemble_multisig_mn
 from exceptions import FatalPSBTIssue, FraudulentChangeOutput
 from serializations import ser_compact_size, deser_compact_size, hash160, hash256
 from serializations import CTxIn, CTxInWitness, CTxOut, SIGHASH_ALL, ser_uint256
-from serializations import ser_sig_der, uint256_from_str, ser_push_data, uint256_from_str
+from serializations import uint256_from_str, ser_push_data, uint256_from_str
 from serializations import ser_string
 from common import system
 
+# Inputs signed together, the same as ECDSA_SIGN_BATCH in trezor-crypto
+SIGN_BATCH = 8
+
 from public_constants import (
     PSBT_GLOBAL_UNSIGNED_TX, PSBT_GLOBAL_XPUB, PSBT_IN_NON_WITNESS_UTXO, PSBT_IN_WITNESS_UTXO,
     PSBT_IN_PARTIAL_SIG, PSBT_IN_SIGHASH_TYPE, PSBT_IN_REDEEM_SCRIPT,
@@ -204,30 +207,6 @@ class psbtProxy:
 
                 self.store(kt, bytes(key), proxy)
 
-    def write(self, out_fd, ktype, val, key=b''):
-        # serialize helper: write w/ size and key byte
-        out_fd.write(ser_compact_size(1 + len(key)))
-        out_fd.write(bytes([ktype]) + key)
-
-        if isinstance(val, tuple):
-            (pos, ll) = val
-            out_fd.write(ser_compact_size(ll))
-            self.fd.seek(pos)
-            while ll:
-                t = self.fd.read(min(64, ll))
-                out_fd.write(t)
-                ll -= len(t)
-
-        elif isinstance(val, list):
-            # for subpaths lists (LE32 ints)
-            assert ktype in (PSBT_IN_BIP32_DERIVATION, PSBT_OUT_BIP32_DERIVATION)
-            out_fd.write(ser_compact_size(len(val) * 4))
-            for i in val:
-                out_fd.write(pack('<I', i))
-        else:
-            out_fd.write(ser_compact_size(len(val)))
-            out_fd.write(val)
-
     def get(self, val):
         # get the raw bytes for a value.
         pos, ll = val
@@ -315,23 +294,22 @@ class psbtOutputProxy(psbtProxy):
                 self.unknown = {}
             self.unknown[key] = val
 
-    def serialize(self, out_fd, my_idx):
-
-        wr = lambda *a: self.write(out_fd, *a)
+    def serialize(self, w, my_idx):
+        # Output this output's values through a PSBTWriter
 
         if self.subpaths:
             for k in self.subpaths:
-                wr(PSBT_OUT_BIP32_DERIVATION, self.subpaths[k], k)
+                w.record(PSBT_OUT_BIP32_DERIVATION, self.subpaths[k], k)
 
         if self.redeem_script:
-            wr(PSBT_OUT_REDEEM_SCRIPT, self.redeem_script)
+            w.record(PSBT_OUT_REDEEM_SCRIPT, self.redeem_script)
 
         if self.witness_script:
-            wr(PSBT_OUT_WITNESS_SCRIPT, self.witness_script)
+            w.record(PSBT_OUT_WITNESS_SCRIPT, self.witness_script)
 
         if self.unknown:
             for k in self.unknown:
-                wr(k[0], self.unknown[k], k[1:])
+                w.record_raw(k, self.unknown[k])
 
     def validate(self, out_idx, txo, my_xfp, active_multisig):
         # Do things make sense for this output?
@@ -791,39 +769,38 @@ class psbtInputProxy(psbtProxy):
                 self.unknown = {}
             self.unknown[key] = val
 
-    def serialize(self, out_fd, my_idx):
-        # Output this input's values; might include signatures that weren't there before
-
-        wr = lambda *a: self.write(out_fd, *a)
+    def serialize(self, w, my_idx):
+        # Output this input's values through a PSBTWriter; might include signatures that
+        # weren't there before
 
         if self.utxo:
-            wr(PSBT_IN_NON_WITNESS_UTXO, self.utxo)
+            w.record(PSBT_IN_NON_WITNESS_UTXO, self.utxo)
         if self.witness_utxo:
-            wr(PSBT_IN_WITNESS_UTXO, self.witness_utxo)
+            w.record(PSBT_IN_WITNESS_UTXO, self.witness_utxo)
 
         if self.part_sig:
             for pk in self.part_sig:
-                wr(PSBT_IN_PARTIAL_SIG, self.part_sig[pk], pk)
+                w.record(PSBT_IN_PARTIAL_SIG, self.part_sig[pk], pk)
 
         if self.added_sig:
             pubkey, sig = self.added_sig
-            wr(PSBT_IN_PARTIAL_SIG, sig, pubkey)
+            w.record(PSBT_IN_PARTIAL_SIG, sig, pubkey)
 
         if self.sighash is not None:
-            wr(PSBT_IN_SIGHASH_TYPE, pack('<I', self.sighash))
+            w.record(PSBT_IN_SIGHASH_TYPE, [self.sighash])
 
         for k in self.subpaths:
-            wr(PSBT_IN_BIP32_DERIVATION, self.subpaths[k], k)
+            w.record(PSBT_IN_BIP32_DERIVATION, self.subpaths[k], k)
 
         if self.redeem_script:
-            wr(PSBT_IN_REDEEM_SCRIPT, self.redeem_script)
+            w.record(PSBT_IN_REDEEM_SCRIPT, self.redeem_script)
 
         if self.witness_script:
-            wr(PSBT_IN_WITNESS_SCRIPT, self.witness_script)
+            w.record(PSBT_IN_WITNESS_SCRIPT, self.witness_script)
 
         if self.unknown:
             for k in self.unknown:
-                wr(k[0], self.unknown[k], k[1:])
+                w.record_raw(k, self.unknown[k])
 
 
 
@@ -1363,60 +1340,43 @@ class psbtObject(psbtProxy):
     def serialize(self, out_fd, upgrade_txn=False):
         # Ouput into a file.
 
-        wr = lambda *a: self.write(out_fd, *a)
+        w = PSBTWriter(out_fd, psbt_out_buf, self.fd)
 
-        out_fd.write(b'psbt\xff')
+        w.write(b'psbt\xff')
 
         if upgrade_txn and self.is_complete():
             # write out the ready-to-transmit txn
             # - means we are also a PSBT combiner in this case
             # - hard tho, due to variable length data.
             # - XXX probably a bad idea, so disabled for now
-            out_fd.write(b'\x01\x00')       # keylength=1, key=b'', PSBT_GLOBAL_UNSIGNED_TX
+            w.write(b'\x01\x00')       # keylength=1, key=b'', PSBT_GLOBAL_UNSIGNED_TX
 
-            with SizerFile() as fd:
-                self.finalize(fd)
-                txn_len = fd.tell()
-
-            out_fd.write(ser_compact_size(txn_len))
-            self.finalize(out_fd)
+            w.varint(self.finalized_len())
+            self.write_final(w)
         else:
             # provide original txn (unchanged)
-            wr(PSBT_GLOBAL_UNSIGNED_TX, self.txn)
+            w.record(PSBT_GLOBAL_UNSIGNED_TX, self.txn)
 
         if self.xpubs:
             for v, k in self.xpubs:
-                wr(PSBT_GLOBAL_XPUB, v, k)
+                w.record(PSBT_GLOBAL_XPUB, v, k)
 
         if self.unknown:
             for k in self.unknown:
-                wr(k[0], self.unknown[k], k[1:])
-
-        # import micropython
-        # print('======================================')
-        # micropython.mem_info(1)
-        # print('======================================')
+                w.record_raw(k, self.unknown[k])
 
         # sep between globals and inputs
-        out_fd.write(b'\0')
+        w.byte(0)
 
         for idx, inp in enumerate(self.inputs):
-            # print('Input {}: free mem={}'.format(idx, gc.mem_free()))
-            inp.serialize(out_fd, idx)
-            out_fd.write(b'\0')
-            gc.collect()  # Give collector a chance to run to help avoid fragmentation
+            inp.serialize(w, idx)
+            w.byte(0)
 
         for idx, outp in enumerate(self.outputs):
-            # print('Output {}: free mem={}'.format(idx, gc.mem_free()))
-            outp.serialize(out_fd, idx)
-            out_fd.write(b'\0')
-            gc.collect()  # Give collector a chance to run to help avoid fragmentation
+            outp.serialize(w, idx)
+            w.byte(0)
 
-        # print('After serialize(): free mem={}'.format(gc.mem_free()))
-
-        # print('======================================')
-        # micropython.mem_info(1)
-        # print('======================================')
+        w.flush()
 
     def sign_it(self):
         # txn is approved. sign all inputs we can sign. add signatures
@@ -1434,6 +1394,7 @@ class psbtObject(psbtProxy):
             change_outs = [n for n,o in enumerate(self.outputs) if o.is_change]
             if change_outs:
                 dis.fullscreen('Change Check...')
+                change_parents = {}
 
                 for count, out_idx in enumerate(change_outs):
                     # only expecting single case, but be general
@@ -1448,9 +1409,18 @@ class psbtObject(psbtProxy):
                             # be our key. For single-signer, should always be my XFP
                             continue
 
-                        # derive actual pubkey from private
-                        skp = keypath_to_str(subpath)
-                        node = sv.derive_path(skp)
+                        # derive actual pubkey from private. Change outputs are usually
+                        # siblings, so their parents are kept for the next one
+                        if len(subpath) < 2:
+                            node = sv.derive_path(keypath_to_str(subpath))
+                        else:
+                            parent_path = keypath_to_str(subpath[:-1])
+                            parent = change_parents.get(parent_path)
+                            if parent is None:
+                                parent = sv.derive_path(parent_path)
+                                change_parents[parent_path] = parent
+                            node = parent.derive_child(subpath[-1])
+                            sv.register(node)
 
                         # check the pubkey of this BIP32 node
                         if pubkey == node.public_key():
@@ -1467,6 +1437,7 @@ class psbtObject(psbtProxy):
             # Sign individual inputs
             sigs = 0
             success = set()
+            pending = []
             for in_idx, txi in self.input_iter():
                 system.progress_bar(int(in_idx * 100 / self.num_inputs))
 
@@ -1530,41 +1501,52 @@ class psbtObject(psbtProxy):
                     pu = node.public_key()
                     assert pu == which_key, "Path (%s) led to wrong pubkey for input #%d"%(skp, in_idx)
 
-                # The precious private key we need
+                # The precious private key we need. Blanked once signed, or by the stash if
+                # something goes wrong before then.
                 pk = node.private_key()
+                sv.register(pk)
+
+                stash.blank_object(node)
+                del node, pu, skp
 
                 #print("privkey %s" % b2a_hex(pk).decode('ascii'))
                 #print(" pubkey %s" % b2a_hex(which_key).decode('ascii'))
                 #print(" digest %s" % b2a_hex(digest).decode('ascii'))
 
-                # Do the ACTUAL signature ... finally!!!
-                result = trezorcrypto.secp256k1.sign(pk, digest)
-
-                # private key no longer required
-                stash.blank_object(pk)
-                stash.blank_object(node)
-                del pk, node, pu, skp
-
-                #print("result %s" % b2a_hex(result).decode('ascii'))
-
-                # convert signature to DER format
-                assert len(result) == 65
-                r = result[1:33]
-                s = result[33:65]
-
-                inp.added_sig = (which_key, ser_sig_der(r, s, inp.sighash))
-
-                success.add(in_idx)
+                # Inputs are signed a few at a time, which shares some of the work
+                pending.append((in_idx, inp, which_key, pk, digest))
+                del pk
 
-                # memory cleanup
-                del result, r, s
+                if len(pending) == SIGN_BATCH:
+                    self.sign_pending(pending, success)
+                    gc.collect()
 
+            if pending:
+                self.sign_pending(pending, success)
                 gc.collect()
 
         # done.
         system.progress_bar(100)
 
 
+    def sign_pending(self, pending, success):
+        # Do the ACTUAL signatures ... finally!!!
+        keys = [pk for _, _, _, pk, _ in pending]
+        try:
+            ders = trezorcrypto.secp256k1.sign_der_batch(keys, [digest for _, _, _, _, digest in pending])
+        finally:
+            # private keys no longer required
+            for pk in keys:
+                stash.blank_object(pk)
+            del keys
+
+        for (in_idx, inp, which_key, _, _), der in zip(pending, ders):
+            #print("der %s" % b2a_hex(der).decode('ascii'))
+            inp.added_sig = (which_key, der + pack('B', inp.sighash))
+            success.add(in_idx)
+
+        del pending[:]
+
     def make_txn_sighash(self, replace_idx, replacement, sighash_type):
         # calculate the hash value for one input of current transaction
         # - blank all script inputs
@@ -1692,97 +1674,196 @@ class psbtObject(psbtProxy):
 
         return signed == self.num_inputs
 
+    def needs_witness(self):
+        # does the finalized txn require witness data to be included?
+        # - yes, if the original txn had some
+        # - yes, if we did a segwit signature on any input
+        return self.had_witness or any(i.is_segwit for i in self.inputs if i)
+
+    def vin_iter(self):
+        # Yield the position of each of the txn's inputs, without parsing them:
+        #
+        #   (index, pos, scriptSig length)
+        #
+        # - the scriptSig follows the 36-byte outpoint and its own length
+        fd = self.fd
+        pos = self.vin_start
+        for idx in range(self.num_inputs):
+            fd.seek(pos + 36)
+            ss_len = deser_compact_size(fd)
+            nxt = fd.tell() + ss_len + 4
+
+            yield idx, pos, ss_len
+
+            pos = nxt
+
+    def vout_end(self):
+        # outputs are followed by the witness data, if any, then the locktime
+        return self.wit_start if self.had_witness else sum(self.txn) - 4
+
+    def witness_len(self, pos):
+        # length of the CTxInWitness at pos in the original txn
+        fd = self.fd
+        fd.seek(pos)
+        for i in range(deser_compact_size(fd)):
+            fd.seek(deser_compact_size(fd), 1)
+        return fd.tell() - pos
+
+    def keeps_script_sig(self, inp, ss_len):
+        # is an input's finalized scriptSig the one in the unsigned txn? (see write_final)
+        if inp.is_segwit:
+            return not inp.is_p2sh and not ss_len
+        return not inp.added_sig
+
+    def final_script_sig_len(self, inp, ss_len):
+        # length of an input's finalized scriptSig
+        if self.keeps_script_sig(inp, ss_len):
+            return ss_len
+        elif inp.is_segwit:
+            return varint_len(len(inp.scriptSig)) + len(inp.scriptSig) if inp.is_p2sh else 0
+        pubkey, der_sig = inp.added_sig
+        return push_len(der_sig) + push_len(pubkey)
+
+    def final_witness_len(self, inp):
+        # length of an input's finalized witness, if it was empty (see write_final)
+        if inp.is_segwit and inp.added_sig:
+            pubkey, der_sig = inp.added_sig
+            return 1 + varint_len(len(der_sig)) + len(der_sig) + varint_len(len(pubkey)) + len(pubkey)
+        return 1
+
+    def finalized_len(self):
+        # Length of the finalized transaction, worked out without writing it. Only the
+        # inputs change, so the outputs (and any original witness data) are counted as is.
+        needs_witness = self.needs_witness()
+
+        ll = 4 + varint_len(self.num_inputs) + varint_len(self.num_outputs) + 4
+        ll += self.vout_end() - self.vout_start
+        if needs_witness:
+            ll += 2
+            if self.had_witness:
+                # every input's witness is replaced by its final_witness_len() below
+                ll += sum(self.txn) - 4 - self.wit_start - self.num_inputs
+
+        for in_idx, pos, ss_len in self.vin_iter():
+            inp = self.inputs[in_idx]
+            sl = self.final_script_sig_len(inp, ss_len)
+            ll += 36 + varint_len(sl) + sl + 4
+            if needs_witness:
+                ll += self.final_witness_len(inp)
+
+        return ll
+
     def finalize(self, fd):
         # Stream out the finalized transaction, with signatures applied
         # - assumption is it's complete already.
         # - returns the TXID of resulting transaction
-        # - but in segwit case, needs to re-read to calculate it
-        # - fd must be read/write and seekable to support txid calc
+        w = PSBTWriter(fd, psbt_out_buf, self.fd)
+        txid = self.write_final(w)
+        w.flush()
 
-        fd.write(pack('<i', self.txn_version))           # nVersion
+        return txid
 
-        # does this txn require witness data to be included?
-        # - yes, if the original txn had some
-        # - yes, if we did a segwit signature on any input
-        needs_witness = self.had_witness or any(i.is_segwit for i in self.inputs if i)
+    def write_final(self, w):
+        # Write the finalized transaction through a PSBTWriter, in one pass
+        # - everything but the witness data is hashed as it's written, for the txid
+        # - inputs are copied from the original txn, with the new scriptSig
+        # - outputs are copied as is
+        rv = trezorcrypto.sha256()
+        w.hash_with(rv)
 
-        if needs_witness:
-            # zero marker, and flags=0x01
-            fd.write(b'\x00\x01')
+        w.int32(self.txn_version)           # nVersion
 
-        body_start = fd.tell()
+        needs_witness = self.needs_witness()
 
-        # inputs
-        fd.write(ser_compact_size(self.num_inputs))
-        for in_idx, txi in self.input_iter():
+        if needs_witness:
+            # zero marker, and flags=0x01
+            w.hash_with(None)
+            w.write(b'\x00\x01')
+            w.hash_with(rv)
+
+        # inputs, then outputs: anything that isn't a new scriptSig is copied from the
+        # original txn, and runs of inputs that don't change are copied in one go
+        w.varint(self.num_inputs)
+        same_from = self.vin_start
+        for in_idx, pos, ss_len in self.vin_iter():
             inp = self.inputs[in_idx]
+            if self.keeps_script_sig(inp, ss_len):
+                continue
 
-            if inp.is_segwit:
+            # everything up to and including this input's outpoint
+            w.copy(same_from, pos + 36 - same_from)
+            w.varint(self.final_script_sig_len(inp, ss_len))
 
+            if inp.is_segwit:
+                # major win for segwit (p2pkh): no redeem script bloat anymore, but multisig
+                # (p2sh) segwit still requires the script here.
                 if inp.is_p2sh:
-                    # multisig (p2sh) segwit still requires the script here.
-                    txi.scriptSig = ser_string(inp.scriptSig)
-                else:
-                    # major win for segwit (p2pkh): no redeem script bloat anymore
-                    txi.scriptSig = b''
+                    w.varint(len(inp.scriptSig))
+                    w.write(inp.scriptSig)
 
                 # Actual signature will be in witness data area
 
-            elif inp.added_sig:
+            else:
                 # insert the new signature(s)
                 assert not inp.is_multisig, 'Multisig PSBT combine not supported'
 
                 pubkey, der_sig = inp.added_sig
 
-                s = b''
-                s += ser_push_data(der_sig)
-                s += ser_push_data(pubkey)
-
-                txi.scriptSig = s
-
-            fd.write(txi.serialize())
-
-        # outputs
-        fd.write(ser_compact_size(self.num_outputs))
-        for out_idx, txo in self.output_iter():
-            fd.write(txo.serialize())
+                w.push_data(der_sig)
+                w.push_data(pubkey)
 
-            # print('self.outputs[{}].is_change: {}  self.outputs[{}].witness_script: {}'.format(
-            #     out_idx, self.outputs[out_idx].is_change, out_idx, self.outputs[out_idx].witness_script))
+            # carry on from this input's nSequence
+            same_from = pos + 36 + varint_len(ss_len) + ss_len
 
-            # capture change output amounts (if segwit)
-            if self.outputs[out_idx].is_change and self.outputs[out_idx].witness_script:
-                history.add_segwit_utxos(out_idx, txo.nValue)
+        w.copy(same_from, self.vout_end() - same_from)
 
-        body_end = fd.tell()
+        # capture change output amounts (if segwit)
+        if any(o.is_change and o.witness_script for o in self.outputs):
+            for out_idx, txo in self.output_iter():
+                if self.outputs[out_idx].is_change and self.outputs[out_idx].witness_script:
+                    history.add_segwit_utxos(out_idx, txo.nValue)
 
         if needs_witness:
             # witness values
             # - preserve any given ones, add ours
-            for in_idx, wit in self.input_witness_iter():
+            w.hash_with(None)
+
+            wit_pos = self.wit_start
+            for in_idx in range(self.num_inputs):
                 inp = self.inputs[in_idx]
 
+                # original txn had no witness data, so empty placeholders
+                ll = self.witness_len(wit_pos) if self.had_witness else 0
+
                 if inp.is_segwit and inp.added_sig:
-                    # put in new sig: wit is a CTxInWitness
-                    assert not wit.scriptWitness.stack, 'replacing non-empty?'
+                    # put in new sig
+                    assert ll <= 1, 'replacing non-empty?'
                     assert not inp.is_multisig, 'Multisig PSBT combine not supported'
 
                     pubkey, der_sig = inp.added_sig
                     assert pubkey[0] in {0x02, 0x03} and len(pubkey) == 33, "bad v0 pubkey"
-                    wit.scriptWitness.stack = [der_sig, pubkey]
 
-                fd.write(wit.serialize())
+                    w.byte(2)
+                    w.varint(len(der_sig))
+                    w.write(der_sig)
+                    w.varint(len(pubkey))
+                    w.write(pubkey)
+                elif ll:
+                    w.copy(wit_pos, ll)
+                else:
+                    w.byte(0)
+
+                if ll:
+                    wit_pos += ll
+
+            w.hash_with(rv)
 
         # locktime
-        fd.write(pack('<I', self.lock_time))
+        w.uint32(self.lock_time)
+        w.hash_with(None)
 
         # calc transaction ID
-        if not needs_witness:
-            # easy w/o witness data
-            txid = trezorcrypto.sha256(fd.checksum.digest()).digest()
-        else:
-            # legacy cost here for segwit: re-read what we just wrote
-            txid = calc_txid(fd, (0, fd.tell()), (body_start, body_end-body_start))
+        txid = trezorcrypto.sha256(rv.digest()).digest()
 
         # print('Calling add_segwit_utxos_finalize for txid:\n  {}'.format(txid))
         history.add_segwit_utxos_finalize(txid)
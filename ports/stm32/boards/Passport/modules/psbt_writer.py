@@ -0,0 +1,172 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# psbt_writer.py - Stream PSBT records and transactions out through a fixed buffer
+#
+# Values in a parsed PSBT are mostly (pos, len) in the file they came from (see psbtProxy), so
+# writing one out is a copy from that file into the buffer with its key and lengths packed in
+# around it. Nothing is allocated per record, and the output goes to out_fd a buffer at a time.
+# A hasher can be fed whatever is written as it goes, which is how finalize() gets the txid
+# without reading its output back.
+#
+#   w = PSBTWriter(out_fd, buf, src_fd)
+#   w.record(PSBT_IN_WITNESS_UTXO, (pos, ll))
+#   w.flush()
+#
+from ustruct import pack_into
+
+
+def varint_len(n):
+    # Size of n as a compact size int
+    if n < 253:
+        return 1
+    elif n < 0x10000:
+        return 3
+    elif n < 0x100000000:
+        return 5
+    return 9
+
+
+def push_len(d):
+    # Size of d pushed onto the script stack by PSBTWriter.push_data()
+    return len(d) + (1 if len(d) <= 75 else 2)
+
+
+class PSBTWriter:
+    def __init__(self, out_fd, buf, src_fd=None):
+        self.out = out_fd
+        self.src = src_fd           # Where (pos, len) values are read from
+        self.buf = memoryview(buf)
+        self.size = len(buf)
+        self.used = 0
+        self.pos = 0                # Bytes passed on to out_fd so far
+        self.hasher = None
+        self.hashed = 0             # Bytes at the start of buf that hasher has already seen
+
+    def tell(self):
+        return self.pos + self.used
+
+    def hash_with(self, hasher):
+        # Feeds everything written from now on to hasher, until called again with None
+        self._catch_up()
+        self.hasher = hasher
+
+    def _catch_up(self):
+        if self.hasher and self.hashed < self.used:
+            self.hasher.update(self.buf[self.hashed:self.used])
+        self.hashed = self.used
+
+    def flush(self):
+        self._catch_up()
+        if self.used:
+            self.out.write(self.buf[0:self.used])
+            self.pos += self.used
+            self.used = 0
+        self.hashed = 0
+
+    def _room(self, n):
+        if self.used + n > self.size:
+            self.flush()
+
+    def byte(self, b):
+        self._room(1)
+        self.buf[self.used] = b
+        self.used += 1
+
+    def int32(self, n):
+        self._room(4)
+        pack_into('<i', self.buf, self.used, n)
+        self.used += 4
+
+    def uint32(self, n):
+        self._room(4)
+        pack_into('<I', self.buf, self.used, n)
+        self.used += 4
+
+    def varint(self, n):
+        self._room(9)
+        at = self.used
+        if n < 253:
+            self.buf[at] = n
+            self.used += 1
+        elif n < 0x10000:
+            self.buf[at] = 253
+            pack_into('<H', self.buf, at + 1, n)
+            self.used += 3
+        elif n < 0x100000000:
+            self.buf[at] = 254
+            pack_into('<I', self.buf, at + 1, n)
+            self.used += 5
+        else:
+            self.buf[at] = 255
+            pack_into('<Q', self.buf, at + 1, n)
+            self.used += 9
+
+    def write(self, b):
+        n = len(b)
+        if self.used + n <= self.size:
+            self.buf[self.used:self.used + n] = b
+            self.used += n
+            return
+
+        b = memoryview(b)
+        at = 0
+        while at < n:
+            if self.used == self.size:
+                self.flush()
+            here = min(n - at, self.size - self.used)
+            self.buf[self.used:self.used + here] = b[at:at + here]
+            self.used += here
+            at += here
+
+    def copy(self, pos, ll):
+        # Copies ll bytes from pos in the source file
+        src = self.src
+        src.seek(pos)
+        while ll:
+            if self.used == self.size:
+                self.flush()
+            here = min(ll, self.size - self.used)
+            got = src.readinto(self.buf[self.used:self.used + here])
+            assert got == here, 'short read'
+            self.used += here
+            ll -= here
+
+    def push_data(self, d):
+        # "compile" data to be pushed on the script stack, as serializations.ser_push_data()
+        ll = len(d)
+        assert 2 <= ll <= 255
+        if ll > 75:
+            self.byte(76)       # OP_PUSHDATA1
+        self.byte(ll)
+        self.write(d)
+
+    def value(self, val):
+        # A PSBT value: (pos, len) in the source file, a list of LE32 ints (for subpaths) or bytes
+        if isinstance(val, tuple):
+            pos, ll = val
+            self.varint(ll)
+            self.copy(pos, ll)
+        elif isinstance(val, list):
+            self.varint(len(val) * 4)
+            for i in val:
+                self.uint32(i)
+        else:
+            self.varint(len(val))
+            self.write(val)
+
+    def record(self, ktype, val, key=b''):
+        # A key-value pair whose key is a type byte and then key
+        self.varint(1 + len(key))
+        self.byte(ktype)
+        if key:
+            self.write(key)
+        self.value(val)
+
+    def record_raw(self, key, val):
+        # A key-value pair whose key includes its type byte
+        self.varint(len(key))
+        self.write(key)
+        self.value(val)
+
+# EOF
@@ -23,6 +23,8 @@ MAX_MSG_LEN = const(4+4+4+MAX_BLK_LEN)
 # Max PSBT txn we support (896k as PSBT)
 # - the max on the wire for mainnet is 100k
 # - but a PSBT might contain a full txn for each input
+# - it and its signed output share the scratch volume, which has less room than twice this once
+#   littlefs has taken its share (see sfstore.py)
 MAX_TXN_LEN = PSBT_MAX_SIZE // 2
 
 # Max length of text messages for signing
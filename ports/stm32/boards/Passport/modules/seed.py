@@ -154,6 +154,10 @@ async def erase_wallet(restart=True):
     settings.remove('backup_quiz')
     settings.remove('enable_passphrase')
 
+    # The address indexes are keyed from the old secret, and say how deep its accounts go
+    import addr_index
+    addr_index.forget()
+
     # save a blank secret (all zeros is a special case)
     nv = bytes(SE_SECRET_LEN)
     pa.change(new_secret=nv)
@@ -121,4 +121,6 @@ class SelfTestUX(UXStateMachine):
                     if result == 'x':
                         self.goto_prev()
                     else:
+                        import log
+                        log.flush()
                         system.shutdown()
@@ -102,6 +102,9 @@ class Settings:
             self.addr = 0
             self.is_dirty = 0
 
+            # (revision, addr, decrypted data) of each slot whose hash checks out
+            candidates = []
+
             for addr in SLOT_ADDRS:
                 # print('Trying to load at {}'.format(hex(addr)))
                 buf = uctypes.bytearray_at(addr, 4)
@@ -144,20 +147,28 @@ class Settings:
                     # FOUNDATION
                     # loads() can't work from a byte array, and converting to
                     # bytes here would copy it; better to use file emulation.
+                    # Only pull out the revision here; the newest slots are parsed in full below.
                     # print('json = {}'.format(b))
-                    d = ujson.load(BytesIO(b))
+                    curr_revision = ujson.select(BytesIO(b), ('_revision',)).get('_revision', 0)
                 except:
                     # One in 65k or so chance to come here w/ garbage decoded, so
                     # not an error.
                     # print('ERROR? Unable to decode JSON')
                     continue
 
-                curr_revision = d.get('_revision', 0)
-                if curr_revision > self.curr_dict.get('_revision', -1):
-                    # print('Found candidate JSON: {}'.format(d))
-                    # A newer entry was found
-                    self.curr_dict = d
-                    self.addr = addr
+                # print('Found candidate JSON at {}'.format(hex(addr)))
+                candidates.append((curr_revision, addr, b))
+
+            # Newest first, falling back to older slots if one doesn't parse
+            candidates.sort(key=lambda c: c[0], reverse=True)
+            for curr_revision, addr, b in candidates:
+                try:
+                    self.curr_dict = ujson.load(BytesIO(b))
+                except:
+                    continue
+                self.addr = addr
+                break
+            candidates = None
 
             # If we loaded settings, then we're done
             if self.addr:
@@ -10,43 +10,31 @@
 # sffile.py - file-like objects stored in SPI Flash
 #
 # - implements stream IO protoccol
-# - does erasing for you
 # - random read, sequential write
-# - only a few of these are possible
-# - the offset is the file name
-# - last 64k of memory reserved for settings
+# - files live on the littlefs scratch volume (see sfstore.py); the name is the file name
+# - a file being written replaces the old one only when closed without an exception
 #
 import trezorcrypto
-from uasyncio import sleep_ms
-from uio import BytesIO
+import sfstore
 from common import system
 
-blksize = const(65536)
-
-def PADOUT(n):
-    # rounds up
-    return (n + blksize - 1) & ~(blksize - 1)
-
 
 class SFFile:
-    def __init__(self, start, length=0, max_size=1, message=None, pre_erased=False):
-        if not pre_erased:
-            assert start % blksize == 0  # 'misaligned'
-        self.start = start
+    def __init__(self, name, length=0, max_size=1, message=None):
+        self.fname = sfstore.path(sfstore.SCRATCH, name)
         self.pos = 0
         self.length = length        # byte-wise length
         self.message = message
+        self.fd = None
+        self.out = None
 
         if max_size != None:
-            self.max_size = PADOUT(max_size) if not pre_erased else max_size
+            self.max_size = max_size
             self.readonly = False
             self.checksum = trezorcrypto.sha256()
         else:
             self.readonly = True
 
-        from common import sf
-        self.sf = sf
-
     def tell(self):
         # where are we?
         return self.pos
@@ -80,16 +68,12 @@ class SFFile:
         assert not self.readonly
         assert self.length == 0  # 'already wrote?'
 
-        for i in range(0, self.max_size, blksize):
-            self.sf.block_erase(self.start + i)
-
-            if i and self.message:
-                from common import dis
-                system.progress_bar((i*100)//self.max_size)
-
-            # expect block erase to take up to 2 seconds
-            while self.sf.is_busy():
-                await sleep_ms(50)
+        # Nothing is erased up front: littlefs erases sectors as the file grows. The old copy is
+        # dropped first so a large PSBT doesn't need room for two; the file is still either
+        # complete or missing.
+        sfstore.remove(self.fname)
+        self.out = sfstore.AtomicFile(self.fname)
+        self.fd = self.out.__enter__()
 
     def __enter__(self):
         if self.message:
@@ -98,58 +82,47 @@ class SFFile:
         return self
 
     def __exit__(self, exc_type, exc_val, exc_tb):
+        if self.out:
+            # Commit the new file, or throw it away
+            self.out.__exit__(exc_type, exc_val, exc_tb)
+            self.out = None
+        elif self.fd:
+            self.fd.close()
+        self.fd = None
+
         if self.message:
             from common import dis
             system.progress_bar(100)
 
         return False
 
-    def wait_writable(self):
-        # TODO: Could add some timeout handling here.
-        while self.sf.is_busy():
-            pass
+    def _reader(self):
+        if self.fd == None:
+            self.fd = open(self.fname, 'rb')
+        self.fd.seek(self.pos)
+        return self.fd
 
     def write(self, b):
         # immediate write, no buffering
         assert not self.readonly
+        assert self.out  # 'not erased'
         assert self.pos == self.length  # "can only append"
         # "past end: %r" % [self.pos, len(b), self.max_size]
         assert self.pos + len(b) <= self.max_size
 
-        left = len(b)
+        try:
+            here = self.fd.write(b)
+        except OSError as exc:
+            if exc.args[0] == sfstore.ENOSPC:
+                raise sfstore.VolumeFull('Not enough room in SPI flash for this transaction.')
+            raise
+        assert here == len(b)
+        self.checksum.update(b)
 
-        # must perform page-aligned (256) writes, but can start
-        # anywhere in the page, and can write just one byte
-        sofar = 0
-
-        while left:
-            if (self.pos + sofar) % 256 != 0:
-                # start is unaligned, do a partial write to align
-                # , (sofar, (self.pos+sofar))       # can only happen on first page
-                assert sofar == 0
-                runt = min(left, 256 - (self.pos % 256))
-                here = memoryview(b)[0:runt]
-                assert len(here) == runt
-            else:
-                # write full pages, or final runt
-                here = memoryview(b)[sofar:sofar+256]
-                assert 1 <= len(here) <= 256
-
-            self.wait_writable()
-
-            self.sf.write(self.start + self.pos + sofar, here)
-
-            left -= len(here)
-            sofar += len(here)
-            self.checksum.update(here)
-
-            assert left >= 0
-
-        assert sofar == len(b)
-        self.pos += sofar
+        self.pos += here
         self.length = self.pos
 
-        return sofar
+        return here
 
     def read(self, ll=None):
         if ll == 0:
@@ -163,26 +136,24 @@ class SFFile:
             # at EOF
             return b''
 
-        rv = bytearray(ll)
-        self.sf.read(self.start + self.pos, rv)
+        rv = self._reader().read(ll)
 
-        self.pos += ll
+        self.pos += len(rv)
 
         if self.message and ll > 1:
             from common import dis
             system.progress_bar((self.pos * 100) // self.length)
 
-        # altho tempting to return a bytearray (which we already have) many
-        # callers expect return to be bytes and have those methods, like "find"
-        return bytes(rv)
+        return rv
 
     def readinto(self, b):
-        # limitation: this will read past end of file, but not tell the caller
         actual = min(self.length - self.pos, len(b))
         if actual <= 0:
             return 0
 
-        self.sf.read(self.start + self.pos, b)
+        if actual < len(b):
+            b = memoryview(b)[0:actual]
+        actual = self._reader().readinto(b)
 
         self.pos += actual
 
@@ -14,12 +14,13 @@
 # - not exposed as python objects
 # - it wants to waste 4k on a buffer
 #
-# Layout for project:
-#   - 917K PSBT incoming (MAX_TXN_LEN)
-#   - 917K PSBT outgoing (MAX_TXN_LEN)
-#   - The previous two regions are only used when signing PSBTs.
-#   - The same space is also used to hold firmware updates.
-#   - 256k flash cache - similar to settings, but for UTXOs and wallet address cache
+# Layout for project (see sfstore.py):
+#   - 1792K littlefs scratch volume for the incoming and outgoing PSBTs
+#   - The same space is also used to hold firmware updates, written raw.
+#   - 256k littlefs volume for the flash cache - similar to settings, but for UTXOs and wallet
+#     address cache
+#
+# The volumes use the C driver in foundation.SPIFlashBlockDev; this class is for raw access.
 #
 import machine
 
@@ -43,10 +44,12 @@ class SPIFlash:
     SECTOR_SIZE = 4096
     BLOCK_SIZE = 65536
 
+    BAUDRATE = 8000000
+
     def __init__(self):
         from machine import Pin
 
-        self.spi = machine.SPI(4, baudrate=8000000)
+        self.spi = machine.SPI(4, baudrate=self.BAUDRATE)
         self.cs = Pin('SF_CS', Pin.OUT)
 
     def cmd(self, cmd, addr=None, complete=True, pad=False):
@@ -0,0 +1,154 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# sfstore.py - littlefs volumes on the external SPI flash
+#
+# Layout:
+#   [0, FW_MAX_SIZE)                    /sf     Scratch: PSBT staging and signed output
+#   [FLASH_CACHE_START, FLASH_CACHE_END) /cache  Flash cache (which also holds the history)
+#
+# littlefs is copy-on-write, so a file is either the old or the new version after a power loss,
+# it spreads writes over the whole volume, and it erases one 4K sector at a time as space is
+# needed instead of erasing 64K blocks up front.
+#
+# Firmware updates are still written raw at offset 0 because that's where the bootloader reads
+# them, over the top of the scratch volume. release_scratch() must be called first; the next
+# time the volume is needed it's reformatted, which is fine for scratch data. Otherwise a volume
+# is only formatted when it has no valid superblock: any other error mounting it is raised, so a
+# flash read that fails once doesn't erase the cache.
+#
+# The scratch volume is the whole flash less the cache, and MAX_TXN_LEN is half of that, but
+# littlefs needs some of it for its own metadata, so a PSBT and its signed output can't both be
+# MAX_TXN_LEN. SFFile raises VolumeFull when they don't fit, rather than a bare ENOSPC.
+#
+#   with sfstore.AtomicFile(sfstore.path(SCRATCH, 'psbt-in')) as fd:
+#       fd.write(...)               Replaces the file only if the block exits normally
+#
+import os
+from micropython import const
+from constants import FW_MAX_SIZE, FLASH_CACHE_START, FLASH_CACHE_TOTAL_SIZE, SPI_FLASH_PAGE_SIZE
+
+SCRATCH = '/sf'
+CACHE = '/cache'
+
+# Start and length of each volume
+VOLUMES = {
+    SCRATCH: (0, FW_MAX_SIZE),
+    CACHE: (FLASH_CACHE_START, FLASH_CACHE_TOTAL_SIZE),
+}
+
+# littlefs caches one read and one program unit per file; a flash page keeps SPI transfers long
+READ_SIZE = SPI_FLASH_PAGE_SIZE
+PROG_SIZE = SPI_FLASH_PAGE_SIZE
+
+TMP_SUFFIX = '.tmp'
+
+# What mounting raises when there's no valid superblock: LFS_ERR_CORRUPT for a volume that was
+# never formatted or was written over, LFS_ERR_INVAL for one formatted with other parameters
+_ERR_CORRUPT = const(84)
+_ERR_INVAL = const(22)
+
+# What writing raises when a volume is full (uerrno doesn't have it)
+ENOSPC = const(28)
+
+mounted = set()
+released = set()    # Volumes written over since they were last mounted
+
+
+class VolumeFull(RuntimeError):
+    # Raised instead of ENOSPC by writers that can say what didn't fit
+    pass
+
+
+def _make_bdev(start, length):
+    from foundation import SPIFlashBlockDev
+    return SPIFlashBlockDev(start, length)
+
+
+def mount(mount_point, make_bdev=_make_bdev):
+    # Mount a volume, formatting it if it has never been formatted or was written over
+    if mount_point in mounted:
+        return mount_point
+
+    start, length = VOLUMES[mount_point]
+    bdev = make_bdev(start, length)
+    vfs = None
+    if mount_point not in released:
+        try:
+            vfs = os.VfsLfs2(bdev, readsize=READ_SIZE, progsize=PROG_SIZE)
+        except OSError as exc:
+            if exc.args[0] not in (_ERR_CORRUPT, _ERR_INVAL):
+                raise
+
+    if vfs == None:
+        os.VfsLfs2.mkfs(bdev, readsize=READ_SIZE, progsize=PROG_SIZE)
+        vfs = os.VfsLfs2(bdev, readsize=READ_SIZE, progsize=PROG_SIZE)
+        released.discard(mount_point)
+
+    os.mount(vfs, mount_point)
+    mounted.add(mount_point)
+
+    # Clean up after a commit that was interrupted
+    for name in os.listdir(mount_point):
+        if name.endswith(TMP_SUFFIX):
+            os.remove(path(mount_point, name))
+
+    return mount_point
+
+
+def unmount(mount_point):
+    if mount_point in mounted:
+        os.umount(mount_point)
+        mounted.discard(mount_point)
+
+
+def release_scratch():
+    # Call before writing a firmware update over the scratch volume
+    unmount(SCRATCH)
+    released.add(SCRATCH)
+
+
+def path(mount_point, name):
+    # Mounts on first use, so callers don't need to care whether a firmware update was started
+    return mount(mount_point) + '/' + name
+
+
+def exists(fname):
+    try:
+        os.stat(fname)
+        return True
+    except OSError:
+        return False
+
+
+def remove(fname):
+    try:
+        os.remove(fname)
+    except OSError:
+        pass
+
+
+def file_size(fname):
+    return os.stat(fname)[6]
+
+
+class AtomicFile:
+    # Write to a temporary file and rename it over the target on success. littlefs renames are
+    # atomic, so readers (and a reboot) see either the old or the new file, never a partial one.
+    def __init__(self, fname, mode='wb'):
+        self.fname = fname
+        self.tmp_fname = fname + TMP_SUFFIX
+        self.fd = open(self.tmp_fname, mode)
+
+    def __enter__(self):
+        return self.fd
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.fd.close()
+        if exc_type is None:
+            os.rename(self.tmp_fname, self.fname)
+        else:
+            remove(self.tmp_fname)
+        return False
+
+# EOF
@@ -37,6 +37,7 @@ tmp_buf = _alloc(1024)
 psbt_tmp256 = _alloc(256)
 viewfinder_buf = _alloc((VIEWFINDER_WIDTH*VIEWFINDER_HEIGHT) // 8)
 framebuffer_addr = _alloc(4) # Address of the framebuffer memory so we can read it from OCD
+psbt_out_buf = _alloc(1024)    # PSBTWriter output buffer
 
 
 assert _start <= SRAM4_END
@@ -237,20 +237,9 @@ class SensitiveValues:
         if register:
             self.register(rv)
 
-        for i in path.split('/'):
-            if i == 'm': continue
-            if not i: continue      # trailing or duplicated slashes
-
-            if i[-1] == "'":
-                assert len(i) >= 2, i
-                here = int(i[:-1])
-                assert 0 <= here < 0x80000000, here
-                here |= 0x80000000
-            else:
-                here = int(i)
-                assert 0 <= here < 0x80000000, here
-
-            rv.derive(here)
+        # Parsed natively, and cached, since the same paths come up over and over
+        from utils import parse_deriv_path
+        rv.derive_path(parse_deriv_path(path))
 
         return rv
 
@@ -147,7 +147,8 @@ class Base64Writer:
         if self.runt:
             buf = self.runt + buf
         rl = len(buf) % 3
-        self.runt = buf[-rl:] if rl else b''
+        # copied, as buf may be a view of a buffer that's about to be reused
+        self.runt = bytes(buf[-rl:]) if rl else b''
         if rl < len(buf):
             tmp = b2a_base64(buf[:(-rl if rl else None)])
             # library puts in newlines!?
@@ -195,6 +196,32 @@ def problem_file_line(exc):
 
     return rv or str(exc) or 'Exception'
 
+# Parsed paths are cached since the same few are derived over and over when signing and exporting
+PATH_CACHE_SIZE = 32
+
+_path_parser = None
+_path_cache = {}
+
+def get_path_parser():
+    global _path_parser
+    if _path_parser == None:
+        from foundation import DerivPath
+        _path_parser = DerivPath()
+    return _path_parser
+
+def parse_deriv_path(path):
+    # Take a string derivation, and make an array('I') of numbers, hardened bit set as needed.
+    # - accepts any of 84'/84h/84p, with or without 'm', and ignores extra slashes
+    # - raises ValueError on junk
+    # - the result is shared with other callers, so don't modify it
+    rv = _path_cache.get(path)
+    if rv == None:
+        rv = get_path_parser().parse(path)
+        if len(_path_cache) >= PATH_CACHE_SIZE:
+            _path_cache.clear()
+        _path_cache[path] = rv
+    return rv
+
 def cleanup_deriv_path(bin_path, allow_star=False):
     # Clean-up path notation as string.
     # - raise exceptions on junk
@@ -202,47 +229,27 @@ def cleanup_deriv_path(bin_path, allow_star=False):
     # - assume 'm' prefix, so '34' becomes 'm/34', etc
     # - do not assume /// is m/0/0/0
     # - if allow_star, then final position can be * or *' (wildcard)
-    import ure
     from public_constants import MAX_PATH_DEPTH
     try:
-        s = str(bin_path, 'ascii').lower()
+        s = str(bin_path, 'ascii')
     except UnicodeError:
         raise AssertionError('must be ascii')
 
-    # empty string is valid
-    if s == '': return 'm'
-
-    s = s.replace('p', "'").replace('h', "'")
-    mat = ure.match(r"(m|m/|)[0-9/']*" + ('' if not allow_star else r"(\*'|\*|)"), s)
-    assert mat.group(0) == s, "invalid characters"
-
-    parts = s.split('/')
-
-    # the m/ prefix is optional
-    if parts and parts[0] == 'm':
-        parts = parts[1:]
-
-    if not parts:
-        # rather than: m/
-        return 'm'
-
-    assert len(parts) <= MAX_PATH_DEPTH, "too deep"
+    parser = get_path_parser()
+    flags = parser.STRICT | (parser.ALLOW_STAR if allow_star else 0)
+    try:
+        rv = parser.parse(s, flags, MAX_PATH_DEPTH)
+    except ValueError as exc:
+        raise AssertionError(exc.args[0])
 
-    for p in parts:
-        assert p != '' and p != "'", "empty path component"
-        if allow_star and '*' in p:
-            # - star or star' can be last only (checked by regex above)
-            assert p == '*' or p == "*'", "bad wildcard"
-            continue
-        if p[-1] == "'":
-            p = p[0:-1]
-        try:
-            ip = int(p, 10)
-        except:
-            ip = -1
-        assert 0 <= ip < 0x80000000 and p == str(ip), "bad component: "+p
+    path, star = rv if allow_star else (rv, 0)
+    rv = keypath_to_str(path, skip=0)
+    if star == parser.STAR:
+        rv += '/*'
+    elif star == parser.STAR_HARDENED:
+        rv += "/*'"
 
-    return 'm/' + '/'.join(parts)
+    return rv
 
 def keypath_to_str(bin_path, prefix='m/', skip=1):
     # take binary path, like from a PSBT and convert into text notation
@@ -256,17 +263,7 @@ def str_to_keypath(xfp, path):
     # - no error checking here
 
     rv = [xfp]
-    for i in path.split('/'):
-        if i == 'm': continue
-        if not i: continue      # trailing or duplicated slashes
-
-        if i[-1] == "'":
-            here = int(i[:-1]) | 0x80000000
-        else:
-            here = int(i)
-
-        rv.append(here)
-
+    rv.extend(parse_deriv_path(path))
     return rv
 
 def match_deriv_path(patterns, path):
@@ -541,10 +538,13 @@ def find_address(path, start_address_idx, address, addr_type, ms_wallet, is_chan
                 if reverse:
                     r = reversed(r)
 
+                # Every candidate is a child of the same chain, so derive that once
+                chain_node = sv.derive_path('{}/{}'.format(path, is_change))  # Zero for non-change address
                 for curr_idx in r:
-                    addr_path = '{}/{}/{}'.format(path, is_change, curr_idx)  # Zero for non-change address
+                    addr_path = '{}/{}/{}'.format(path, is_change, curr_idx)
                     # print('addr_path={}'.format(addr_path))
-                    node = sv.derive_path(addr_path)
+                    node = chain_node.derive_child(curr_idx)
+                    sv.register(node)
                     curr_address = sv.chain.address(node, addr_type)
                     # print('curr_idx={}: path={} addr_type={} curr_address = {}'.format(curr_idx, addr_path, addr_type, curr_address))
                     if curr_address == address:
@@ -623,6 +623,14 @@ async def scan_for_address(acct_num, address, addr_type, deriv_path, ms_wallet):
 
     # print('ms_wallet={}'.format(to_str(ms_wallet)))
 
+    # The index finds addresses that have been indexed in the background without a search
+    import addr_index
+    entry = addr_index.make_entry(acct_num, addr_type, deriv_path, ms_wallet)
+    addr_index.note(entry)
+    addr_idx, is_change = addr_index.find(entry, address)
+    if addr_idx >= 0:
+        return addr_idx, is_change
+
     # We always check this many addresses, but we split them 50/50 until we reach 0 on the low end,
     # then we use the rest for the high end.
     NUM_TO_CHECK = 50
@@ -14,13 +14,15 @@
 import gc
 
 import utime
+import perf
 from display import Display, FontSmall, FontTiny
+from graphics import (ICON_PW_EMPTY_BOX_LG, ICON_PW_PRESSED_BOX_LG, ICON_PW_FILLED_BOX_LG,
+                      ICON_PW_EMPTY_BOX_SM, ICON_PW_PRESSED_BOX_SM, ICON_PW_FILLED_BOX_SM)
 from uasyncio import sleep_ms
 from uasyncio.queues import QueueEmpty
 from common import system, dis
 from data_codecs.qr_type import QRType
 from data_codecs.qr_factory import get_qr_decoder_for_data, make_qr_encoder
-from utils import is_alphanumeric_qr
 
 LEFT_MARGIN = 8
 RIGHT_MARGIN = 6
@@ -712,7 +714,7 @@ async def ux_show_story(msg, title='Passport', sensitive=False, font=FontSmall,
         # We only want to turn it off once rather than whenever it's False, so we
         # set to None to avoid turning turbo off again.
         if turbo == False:
-            system.turbo(False)
+            perf.idle()
             turbo = None
 
         # Wait for key inputs
@@ -728,7 +730,7 @@ async def ux_show_story(msg, title='Passport', sensitive=False, font=FontSmall,
             # print('key={} event_type={}'.format(key, event_type))
 
             if event_type == 'down' or event_type == 'repeat':
-                system.turbo(True)
+                perf.kick()
                 turbo = True
 
                 if key == 'u':
@@ -1124,6 +1126,8 @@ class DisplayURCode(UserInteraction):
 
         self.num_supported_sizes = 0
         self.qr_version_idx = 0 # "version" for QR codes essentially maps to the size
+        self.sizer = None       # Picks the size while qr_version_idx is 0 and the encoder supports it
+        self.needs_resize = False
         self.render_id = 0
         self.last_render_id = -1;
         self.qr_type = qr_type
@@ -1142,11 +1146,23 @@ class DisplayURCode(UserInteraction):
         # Instantiate the right type of QR encoder - always make a new one
         self.qr_encoder = make_qr_encoder(self.qr_type, self.qr_args)
         self.num_supported_sizes = self.qr_encoder.get_num_supported_sizes()
+        if self.qr_encoder.supports_adaptive_sizing():
+            # The adaptive size comes first, followed by the fixed sizes
+            self.num_supported_sizes += 1
 
         # We collect before and after to ensure the most available memory
         gc.collect()
 
-        max_len = self.qr_encoder.get_max_len(self.qr_version_idx)
+        if self.is_adaptive():
+            if self.sizer == None:
+                from data_codecs.adaptive_sizer import AdaptiveQRSizer
+                self.sizer = AdaptiveQRSizer(self.get_qr_area_px(), prefix=self.qr_encoder.get_prefix(),
+                                             target_fps=self.qr_encoder.get_target_fps())
+            max_len = self.sizer.fragment_len()
+        elif self.qr_encoder.supports_adaptive_sizing():
+            max_len = self.qr_encoder.get_max_len(self.qr_version_idx - 1)
+        else:
+            max_len = self.qr_encoder.get_max_len(self.qr_version_idx)
         self.qr_encoder.encode(self.qr_text, is_binary=self.is_binary, max_fragment_len=max_len)
 
         gc.collect()
@@ -1156,8 +1172,30 @@ class DisplayURCode(UserInteraction):
         self.last_version = 0;
         self.qr_version_idx = (self.qr_version_idx + 1) % self.num_supported_sizes
 
+    # Returns True if there was a smaller size to go to
+    def use_smaller_size(self):
+        if self.is_adaptive():
+            return self.sizer.step_down()
+
+        # Fixed sizes go from largest to smallest
+        if self.qr_version_idx + 1 < self.num_supported_sizes:
+            self.qr_version_idx += 1
+            return True
+        return False
+
+    def is_adaptive(self):
+        return self.qr_version_idx == 0 and self.qr_encoder.supports_adaptive_sizing()
+
+    def get_qr_area_px(self):
+        if self.msg:
+            return Display.WIDTH - 60
+        else:
+            return Display.WIDTH - 20
+
     def get_frame_delay(self):
-        if self.qr_version_idx == 0:
+        if self.is_adaptive():
+            return self.sizer.frame_delay_ms()
+        elif self.qr_version_idx == 0:
             return 200
         else:
             return 250
@@ -1176,43 +1214,41 @@ class DisplayURCode(UserInteraction):
 
             # Render QR data to buffer
             # print('qr={}'.format(data.upper()))
-            encoded_data = data.encode('ascii')
-            if self.qr_type != QRType.QR:
-                encoded_data = encoded_data.upper()
-            ll = len(encoded_data)
-
             from foundation import QRCode
             qrcode = QRCode()
 
-
-            version = qrcode.fit_to_version(ll, is_alphanumeric_qr(encoded_data))
+            # TODO: Use correct buffer size here or just allocate once outside the loop (largest possible size)
+            out_buf = bytearray(2000)
 
             # Don't go to a smaller QR code, even if it means repeated data since it looks weird
-            # to change the QR code size
-            if self.last_version > version:
-                version = self.last_version
-            else:
-                self.last_version = version
+            # to change the QR code size.  UR data is case-insensitive, so let the encoder fold
+            # it to upper case, which lets it use alphanumeric mode.
+            version = qrcode.render_fit(data, self.last_version, 0, out_buf, self.qr_type != QRType.QR)
+            if version == 0:
+                # Too much data for the largest QR code.  Keep the current size and split the data
+                # into smaller parts if there's a smaller size to go to, otherwise redraw() says so.
+                self.needs_resize = self.use_smaller_size()
+                return
 
-            buf_size = qr_buffer_size_for_version(version)
+            self.last_version = version
             self.modules_count = qr_get_module_size_for_version(version)
-            # print('fit_to_version({}) = {}  buffer size = {}'.format(ll, version,buf_size))
-
-            # TODO: Use correct buffer size here or just allocate once outside the loop (largest possible size)
-            out_buf = bytearray(2000)
-            result = qrcode.render(encoded_data, version, 0, out_buf)
+            # print('render_fit({}) = {}'.format(len(data), version))
 
             self.qr_data = out_buf
 
     def redraw(self):
         # Redraw screen
         from common import dis
-        from display import FontTiny
+        from display import FontSmall, FontTiny
 
         system.turbo(True)
         TOP_MARGIN = 7
         font = FontTiny
 
+        adaptive = self.is_adaptive()
+        if adaptive:
+            self.sizer.begin_frame()
+
         data = self.qr_encoder.next_part()
         # print('data={}'.format(data))
         self.render_qr(data)
@@ -1223,30 +1259,27 @@ class DisplayURCode(UserInteraction):
         # dis.draw_header(self.title, left_text='{}/{}'.format(self.curr_part + 1, len(self.parts)))
         y = Display.HEADER_HEIGHT + TOP_MARGIN
 
-        w = self.modules_count
-        # print('modules_count={}'.format(w))
+        # Draw the actual QR code
+        # print('qr_data = {}'.format(self.qr_data))
+        if self.qr_data != None:
+            w = self.modules_count
+            # print('modules_count={}'.format(w))
 
-        if self.msg:
-            module_pixel_width = (Display.WIDTH - 60) // w
-        else:
-            module_pixel_width = (Display.WIDTH - 20) // w
+            module_pixel_width = self.get_qr_area_px() // w
 
-        # print('module_pixel_width={}'.format(module_pixel_width))
+            # print('module_pixel_width={}'.format(module_pixel_width))
 
-        total_pixel_width = w * module_pixel_width
-        frame_width = total_pixel_width + (module_pixel_width * 2)
+            total_pixel_width = w * module_pixel_width
+            frame_width = total_pixel_width + (module_pixel_width * 2)
 
-        # QR code offsets
-        XO = (Display.WIDTH - total_pixel_width) // 2
+            # QR code offsets
+            XO = (Display.WIDTH - total_pixel_width) // 2
 
-        # Center vertically now that we have no label underneath
-        YO = ((Display.HEIGHT - Display.HEADER_HEIGHT - Display.FOOTER_HEIGHT) - total_pixel_width ) // 2 + Display.HEADER_HEIGHT
-        dis.dis.fill_rect(XO - module_pixel_width, YO -
-                          module_pixel_width, frame_width, frame_width, 0)
+            # Center vertically now that we have no label underneath
+            YO = ((Display.HEIGHT - Display.HEADER_HEIGHT - Display.FOOTER_HEIGHT) - total_pixel_width ) // 2 + Display.HEADER_HEIGHT
+            dis.dis.fill_rect(XO - module_pixel_width, YO -
+                              module_pixel_width, frame_width, frame_width, 0)
 
-        # Draw the actual QR code
-        # print('qr_data = {}'.format(self.qr_data))
-        if self.qr_data != None:
             for qy in range(w):
                 for qx in range(w):
                     offset = qy * self.modules_count + qx
@@ -1255,6 +1288,10 @@ class DisplayURCode(UserInteraction):
                     X = (qx*module_pixel_width) + XO
                     Y = (qy*module_pixel_width) + YO
                     dis.dis.fill_rect(X, Y, module_pixel_width, module_pixel_width, px)
+        elif not self.needs_resize:
+            # Even the smallest size doesn't fit in a QR code
+            dis.text(None, Display.HEIGHT // 2 - 30, 'Too much data', font=FontSmall)
+            dis.text(None, Display.HEIGHT // 2 - 6, 'for a QR code', font=FontSmall)
 
         # Draw message
         if self.msg != None:
@@ -1267,6 +1304,13 @@ class DisplayURCode(UserInteraction):
             self.input.is_pressed('y')
         )
         dis.show()
+
+        if adaptive and self.sizer.end_frame():
+            # Frames take longer than the sizer allows, so it picked a smaller fragment length
+            self.needs_resize = True
+        # if adaptive:
+        #     print('sizer: {}'.format(self.sizer.stats()))
+
         system.turbo(False)
 
     async def interact_bare(self):
@@ -1297,6 +1341,12 @@ class DisplayURCode(UserInteraction):
                 # if len(self.parts) > 1:
                 # Show the next part after a short delay to control speed
                 await sleep_ms(self.get_frame_delay())
+                if self.needs_resize:
+                    self.needs_resize = False
+                    system.turbo(True)
+                    self.last_version = 0
+                    self.generate_qr_data()
+                    system.turbo(False)
                 self.render_id += 1
                 self.redraw()
                 continue
@@ -1377,16 +1427,16 @@ async def ux_scan_qr_code(title):
     from display import FontSmall
     from utils import save_qr_code_image
 
-    import utime
-    from constants import VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT, CAMERA_WIDTH, CAMERA_HEIGHT
+    from constants import VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT, CAMERA_WIDTH, CAMERA_HEIGHT, CAMERA_WAKE_TIMEOUT_MS
 
     from foundation import Camera, QR
 
     font = FontSmall
 
-    # Create the Camera connection
+    # Create the Camera connection. It wakes from standby in the background.
     cam = Camera()
-    cam.enable()
+    perf.begin('camera')
+    cam_on = cam.enable()
 
     # Create QR decoder
     qr = QR(CAMERA_WIDTH, CAMERA_HEIGHT, qr_buf)
@@ -1396,87 +1446,101 @@ async def ux_scan_qr_code(title):
 
     input = KeyInputHandler(up='xy', down='xy')
 
-    fps_start = utime.ticks_us()
-    frame_count = 0
-
     qr_decoder = None
     progress = None
 
+    # Draw the screen around the viewfinder while the sensor settles
+    with perf.span('scan.wake'):
+        dis.clear()
+        dis.draw_header(title)
+        dis.draw_footer('BACK', 'SCANNING...')
+        dis.show()
+
+        wake_start = utime.ticks_ms()
+        while cam_on and not cam.ready():
+            if utime.ticks_diff(utime.ticks_ms(), wake_start) > CAMERA_WAKE_TIMEOUT_MS:
+                cam_on = False
+                break
+
+            # get_event() waits a few ms, so this polls the camera as often as it did before
+            event = await input.get_event()
+            if event == ('x', 'up'):
+                cam.disable()
+                perf.end('camera')
+                return None
+
+    if not cam_on:
+        cam.disable()
+        perf.end('camera')
+        await ux_show_story('Unable to start the camera.', title='Error')
+        return None
+
+    # Frame timing is collected by the 'scan.*' spans; see perf.save_profile()
     while True:
-        frame_start = utime.ticks_us()
-        snapshot_start = frame_start
-        result = cam.snapshot(qr_buf, CAMERA_WIDTH, CAMERA_HEIGHT,
-                              viewfinder_buf, VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT)
-        snapshot_end = utime.ticks_us()
+        with perf.span('scan.snapshot'):
+            result = cam.snapshot(qr_buf, CAMERA_WIDTH, CAMERA_HEIGHT,
+                                  viewfinder_buf, VIEWFINDER_WIDTH, VIEWFINDER_HEIGHT)
 
         if not result:
             # print("ERROR: cam.copy_capture() returned False!")
+            cam.disable()
+            perf.end('camera')
             await ux_show_story('Unable to capture image with camera.', title='Error')
             return None
 
-        draw_start = utime.ticks_us();
-        dis.clear()
-
-        dis.draw_header(title)
+        with perf.span('scan.draw'):
+            dis.clear()
 
-        dis.image(0, Display.HEADER_HEIGHT, VIEWFINDER_WIDTH,
-                  VIEWFINDER_HEIGHT, viewfinder_buf)
+            dis.draw_header(title)
 
-        OFFSET = 6
-        SIZE = 30
-        THICKNESS = 6
-        LEFT_X = OFFSET
-        RIGHT_X = Display.WIDTH - OFFSET * 2
-        Y = Display.HEADER_HEIGHT + OFFSET
+            dis.image(0, Display.HEADER_HEIGHT, VIEWFINDER_WIDTH,
+                      VIEWFINDER_HEIGHT, viewfinder_buf)
 
-        right_label = progress if progress != None else 'SCANNING...'
-        dis.draw_footer('BACK', right_label,
-                        left_down=input.is_pressed('x'), right_down=input.is_pressed('y'))
-        draw_end = utime.ticks_us();
+            right_label = progress if progress != None else 'SCANNING...'
+            dis.draw_footer('BACK', right_label,
+                            left_down=input.is_pressed('x'), right_down=input.is_pressed('y'))
 
-        show_start = utime.ticks_us();
-        dis.show()
-        show_end = utime.ticks_us();
+        with perf.span('scan.show'):
+            dis.show()
 
         # Look for QR codes in the image
-        decode_start = utime.ticks_us()
-        data = qr.find_qr_codes()
+        with perf.span('scan.decode'):
+            data = qr.find_qr_codes()
         # print('find_qr_codes() out')
-        decode_end = utime.ticks_us()
 
         # Don't try decoding if we are in Snapshot mode...user is probably using this as a viewfinder
         if not common.snapshot_mode_enabled and data != None:
             # print('data={}'.format(data))
 
             # See if this looks like a ur code
-            ur_start = utime.ticks_us()
             try:
-                if qr_decoder == None:
-                    # We need to find out what type of QR this is and have the factory make a decoder for us
-                    qr_decoder = get_qr_decoder_for_data(data)
-
-                # We should be guaranteed to have a qr_decoder here since basic QR accepts any data format
-                qr_decoder.add_data(data)
-
-                # See if there was any error
-                error = qr_decoder.get_error()
-                if error != None:
-                    # print('ERROR: error={}'.format(error))
-                    data = None
-                    break
+                with perf.span('scan.ur'):
+                    if qr_decoder == None:
+                        # We need to find out what type of QR this is and have the factory make a decoder for us
+                        qr_decoder = get_qr_decoder_for_data(data)
+
+                    # We should be guaranteed to have a qr_decoder here since basic QR accepts any data format
+                    qr_decoder.add_data(data)
+
+                    # See if there was any error
+                    error = qr_decoder.get_error()
+                    if error != None:
+                        # print('ERROR: error={}'.format(error))
+                        data = None
+                        break
 
-                if qr_decoder.is_complete():
-                    data = qr_decoder.decode()
-                    # print('data: |{}|'.format(data))
+                    if qr_decoder.is_complete():
+                        data = qr_decoder.decode()
+                        # print('data: |{}|'.format(data))
 
-                    # Set the last QRType so that signed transactions know what to encode as
-                    common.last_scanned_qr_type = qr_decoder.get_data_format()
-                    common.last_scanned_ur_prefix = qr_decoder.get_ur_prefix()
-                    # print('common.last_scanned_qr_type={}'.format(common.last_scanned_qr_type))
-                    # print('common.last_scanned_ur_prefix={}'.format(common.last_scanned_ur_prefix))
-                    break
+                        # Set the last QRType so that signed transactions know what to encode as
+                        common.last_scanned_qr_type = qr_decoder.get_data_format()
+                        common.last_scanned_ur_prefix = qr_decoder.get_ur_prefix()
+                        # print('common.last_scanned_qr_type={}'.format(common.last_scanned_qr_type))
+                        # print('common.last_scanned_ur_prefix={}'.format(common.last_scanned_ur_prefix))
+                        break
 
-                progress = '{} OF {}'.format(qr_decoder.received_parts(), qr_decoder.total_parts())
+                    progress = '{} OF {}'.format(qr_decoder.received_parts(), qr_decoder.total_parts())
 
             except Exception as e:
                 # print('Failed to parse UR!')
@@ -1485,12 +1549,7 @@ async def ux_scan_qr_code(title):
                 sys.print_exception(e)
                 break
 
-            ur_end = utime.ticks_us()
-
-            # print('ur decode: {}us'.format(ur_end - ur_start))
-
         # Check for key input to see if we should back out
-        key_start = utime.ticks_us()
         event = await input.get_event()
         if event != None:
             key, event_type = event
@@ -1498,42 +1557,10 @@ async def ux_scan_qr_code(title):
                 if key == 'x':
                     data = None
                     break
-        key_end = utime.ticks_us()
-
-        frame_count += 1
-        now = utime.ticks_us()
-
-        snapshot_ms = (snapshot_end - snapshot_start) / 1000
-        draw_ms = (draw_end - draw_start) / 1000
-        show_ms = (show_end - show_start) / 1000
-        decode_ms = (decode_end - decode_start) / 1000
-        key_ms = (key_end - key_start) / 1000
-        total_ms = snapshot_ms + draw_ms + show_ms + decode_ms + key_ms
-        measured_frame_ms = (now - frame_start) / 1000
-        fps = frame_count / ((now - fps_start) / 1000000)
-
-        print_stats = False
-        if print_stats and frame_count % 10 == 0:
-            print_start = utime.ticks_us()
-            print('Frame Stats:')
-            print('  {:>3.2f}ms  Snapshot'.format(snapshot_ms))
-            print('  {:>3.2f}ms  Draw'.format(draw_ms))
-            print('  {:>3.2f}ms  Update to Screen'.format(show_ms))
-            print('  {:>3.2f}ms  Decode'.format(decode_ms))
-            print('  {:>3.2f}ms  Check keys'.format(key_ms))
-            print('  --------')
-            print('  {:>3.2f}ms  Total of the above\n'.format(total_ms))
-
-            print('  {:>3.2f}ms  Total measured frame time'.format(measured_frame_ms))
-            print('  {:>3.2f}ms  Missing time\n'.format(measured_frame_ms - total_ms))
-            print('  {:>3.2f}fps Frame rate'.format(fps))
-            print_end = utime.ticks_us()
-            print_ms = (print_end - print_start) / 1000
-
-            print('  {:03.1f}ms  Print time'.format(print_ms))
 
     # Turn off camera after capturing is done!
     cam.disable()
+    perf.end('camera')
 
 
     return data
@@ -1693,15 +1720,15 @@ async def ux_enter_pin(title, heading='Enter PIN', left_btn='BACK', right_btn='E
         num_filled = len(pin)
         # print('num_filled={} pressed={}'.format(num_filled, pressed))
         if (num_filled < LARGE_BOX_LIMIT) or (num_filled == LARGE_BOX_LIMIT and not pressed):
-            empty_box = 'pw_empty_box_lg'
-            pressed_box = 'pw_pressed_box_lg'
-            filled_box = 'pw_filled_box_lg'
+            empty_box = ICON_PW_EMPTY_BOX_LG
+            pressed_box = ICON_PW_PRESSED_BOX_LG
+            filled_box = ICON_PW_FILLED_BOX_LG
             MAX_PIN_BOXES_TO_DISPLAY = LARGE_BOX_LIMIT
             y += 3
         else:
-            empty_box = 'pw_empty_box_sm'
-            pressed_box = 'pw_pressed_box_sm'
-            filled_box = 'pw_filled_box_sm'
+            empty_box = ICON_PW_EMPTY_BOX_SM
+            pressed_box = ICON_PW_PRESSED_BOX_SM
+            filled_box = ICON_PW_FILLED_BOX_SM
             MAX_PIN_BOXES_TO_DISPLAY = MAX_PIN_LEN
             y += 14
 
@@ -1726,15 +1753,15 @@ async def ux_enter_pin(title, heading='Enter PIN', left_btn='BACK', right_btn='E
 
         x = Display.HALF_WIDTH - (total_width // 2)
         for _idx in range(num_filled):
-            dis.icon(x, y, filled_box)
+            dis.blit_icon(filled_box, x, y)
             x += PIN_BOX_ADVANCE
 
         if pressed:
             # print('pressed case')
-            dis.icon(x, y, pressed_box)
+            dis.blit_icon(pressed_box, x, y)
         elif len(pin) == 0:
             # print('draw empty box')
-            dis.icon(x, y, empty_box)
+            dis.blit_icon(empty_box, x, y)
 
         # Show remaining attempts if not hidden and if there was at least one failure
         if not hide_attempt_counter and pa.attempts_left < pa.max_attempts:
@@ -1832,6 +1859,8 @@ async def ux_shutdown():
     confirm = await ux_confirm("Are you sure you want to shutdown?", center=True, center_vertically=True)
     if confirm:
         # print('SHUTTING DOWN!')
+        import log
+        log.flush()
         system.shutdown()
         return
 
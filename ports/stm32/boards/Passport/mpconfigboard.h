@@ -26,6 +26,19 @@
 #define MICROPY_PY_USOCKET          (0)
 #define MICROPY_PY_UHASHLIB_SHA256  (0)
 
+/* Compress exports before encoding them as QR/UR */
+#define MICROPY_PY_UZLIB_COMPRESS   (1)
+
+/* Sampling profiler for the frozen modules; idle until uprofile.start() */
+#define MICROPY_PY_UPROFILE         (1)
+
+/* Reuse compiled regexes, and reject non-matching input without backtracking */
+#define MICROPY_PY_URE_CACHE        (4)
+#define MICROPY_PY_URE_DFA          (1)
+
+/* Build the constant-only frozen modules (freeze_rom in manifest.py) in flash */
+#define MICROPY_MODULE_FROZEN_ROM   (1)
+
 #define PASSPORT_FOUNDATION_ENABLED (1)
 
 #define MICROPY_BOARD_EARLY_INIT Passport_board_early_init
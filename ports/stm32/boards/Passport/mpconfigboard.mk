@@ -13,11 +13,24 @@ AF_FILE = boards/stm32h753_af.csv
 LD_FILES = boards/Passport/passport.ld boards/common_ifs.ld
 TEXT0_ADDR = 0x08020800
 
+# The load images of the code and data copied into ITCM and DTCM at reset (see placement.h)
+TEXT0_SECTIONS = .isr_vector .itcm_text .text .data .dtcm_data
+
+# Report what the link placed in ITCM and DTCM, and how much room is left
+all: $(BUILD)/placement.txt
+$(BUILD)/placement.txt: $(BUILD)/firmware.elf
+	$(ECHO) "GEN $@"
+	$(Q)$(PYTHON) $(BOARD_DIR)/tools/placement/placement.py report $(BUILD)/firmware.map > $@
+	$(Q)tail -n 2 $@
+
 # MicroPython settings
 MICROPY_PY_LWIP = 0
 MICROPY_PY_USSL = 0
 MICROPY_SSL_MBEDTLS = 0
 
+# littlefs volumes on the external SPI flash (see modules/sfstore.py)
+MICROPY_VFS_LFS2 = 1
+
 FROZEN_MANIFEST = boards/Passport/manifest.py
 
 CFLAGS_MOD += -Iboards/$(BOARD)/trezor-firmware/crypto
@@ -60,6 +73,15 @@ BL_NVROM_SIZE = 0x100
 CFLAGS_MOD += -DBL_NVROM_BASE=$(BL_NVROM_BASE) -DBL_NVROM_SIZE=$(BL_NVROM_SIZE)
 CFLAGS_MOD += -Iboards/$(BOARD)/include -Iboards/$(BOARD)/common/micro-ecc
 
+# Run SHA-256 on the HASH peripheral, with large buffers fed by DMA (see common/hash_engine.c)
+CFLAGS_MOD += -DHASH_ENGINE_HW=1 -DMICROPY_HW_ENABLE_HASH=1
+
+# Run trezorcrypto.aes ECB, CBC and CTR on the CRYP peripheral, with DMA for large buffers (see aes_engine.c)
+CFLAGS_MOD += -DAES_ENGINE_HW=1 -DMICROPY_HW_ENABLE_CRYP=1
+
+# Sample the noise and power monitor inputs in the background, by DMA (see adc.c)
+CFLAGS_MOD += -DMICROPY_HW_ENABLE_ADC_DMA=1
+
 # include code common to both the bootloader and firmware
 SRC_MOD += $(addprefix boards/$(BOARD)/common/,\
                 backlight.c \
@@ -72,6 +94,7 @@ SRC_MOD += $(addprefix boards/$(BOARD)/common/,\
                 ring_buffer.c \
                 se.c \
                 sha256.c \
+                hash_engine.c \
                 spiflash.c \
                 utils.c \
 				hash.c \
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// placement.h - Put functions in ITCM and variables in DTCM
+//
+// The core reaches both TCMs without wait states and without going through the caches, so code
+// there doesn't miss in the I-cache and data there doesn't compete with the heap for the D-cache.
+// passport.ld collects these sections, and resethandler.s copies ITCM code and DTCM data from
+// flash and zeroes the DTCM bss before anything runs.
+//
+// Most hot functions are placed from a profile by itcm_hot.ld, which needs no changes to their
+// source; ITCM_FUNC is for functions that should be there whatever a profile says. DTCM is
+// mostly taken by qr_buf, so DTCM_DATA and DTCM_BSS only have room for a few hundred bytes:
+// the link fails if they don't fit. tools/placement reports what was placed where.
+//
+//   static void ITCM_FUNC hot_loop(void) { ... }
+//   static uint32_t table[16] DTCM_DATA = {...};
+
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+// A function run from ITCM
+#define ITCM_FUNC __attribute__((section(".itcm_text"), noinline))
+
+// Initialized data in DTCM, copied from flash at reset
+#define DTCM_DATA __attribute__((section(".dtcm_data")))
+
+// Zero-initialized data in DTCM
+#define DTCM_BSS __attribute__((section(".dtcm_bss")))
+
+// Data in DTCM that is never initialized, for large buffers that are always written before use
+#define DTCM_NOINIT __attribute__((section(".dtcm_noinit")))
+
+#endif // __PLACEMENT_H__
@@ -636,14 +636,16 @@ static void rs_getRemainder(uint8_t degree, uint8_t *coeff, uint8_t *data, uint8
 
 // QrCode
 
-static int8_t encodeDataCodewords(BitBucket *dataCodewords, const uint8_t *text, uint16_t length, uint8_t version) {
-    int8_t mode = MODE_BYTE;
-    
-    if (isNumeric((char*)text, length)) {
-        mode = MODE_NUMERIC;
-        bb_appendBits(dataCodewords, 1 << MODE_NUMERIC, 4);
-        bb_appendBits(dataCodewords, length, getModeBits(version, MODE_NUMERIC));
+static uint8_t foldCase(uint8_t c, bool fold) {
+    if (fold && c >= 'a' && c <= 'z') { return c - 'a' + 'A'; }
+    return c;
+}
+
+static void appendSegment(BitBucket *dataCodewords, const uint8_t *text, uint16_t length, uint8_t mode, uint8_t version, bool fold) {
+    bb_appendBits(dataCodewords, 1 << mode, 4);
+    bb_appendBits(dataCodewords, length, getModeBits(version, mode));
 
+    if (mode == MODE_NUMERIC) {
         uint16_t accumData = 0;
         uint8_t accumCount = 0;
         for (uint16_t i = 0; i < length; i++) {
@@ -661,15 +663,11 @@ static int8_t encodeDataCodewords(BitBucket *dataCodewords, const uint8_t *text,
             bb_appendBits(dataCodewords, accumData, accumCount * 3 + 1);
         }
         
-    } else if (isAlphanumeric((char*)text, length)) {
-        mode = MODE_ALPHANUMERIC;
-        bb_appendBits(dataCodewords, 1 << MODE_ALPHANUMERIC, 4);
-        bb_appendBits(dataCodewords, length, getModeBits(version, MODE_ALPHANUMERIC));
-
+    } else if (mode == MODE_ALPHANUMERIC) {
         uint16_t accumData = 0;
         uint8_t accumCount = 0;
         for (uint16_t i = 0; i  < length; i++) {
-            accumData = accumData * 45 + getAlphanumeric((char)(text[i]));
+            accumData = accumData * 45 + getAlphanumeric((char)foldCase(text[i], fold));
             accumCount++;
             if (accumCount == 2) {
                 bb_appendBits(dataCodewords, accumData, 11);
@@ -684,12 +682,22 @@ static int8_t encodeDataCodewords(BitBucket *dataCodewords, const uint8_t *text,
         }
         
     } else {
-        bb_appendBits(dataCodewords, 1 << MODE_BYTE, 4);
-        bb_appendBits(dataCodewords, length, getModeBits(version, MODE_BYTE));
         for (uint16_t i = 0; i < length; i++) {
-            bb_appendBits(dataCodewords, (char)(text[i]), 8);
+            bb_appendBits(dataCodewords, foldCase(text[i], fold), 8);
         }
     }
+}
+
+static int8_t encodeDataCodewords(BitBucket *dataCodewords, const uint8_t *text, uint16_t length, uint8_t version) {
+    int8_t mode = MODE_BYTE;
+    
+    if (isNumeric((char*)text, length)) {
+        mode = MODE_NUMERIC;
+    } else if (isAlphanumeric((char*)text, length)) {
+        mode = MODE_ALPHANUMERIC;
+    }
+
+    appendSegment(dataCodewords, text, length, mode, version, false);
     
     //bb_setBits(dataCodewords, length, 4, getModeBits(version, mode));
     
@@ -781,44 +789,29 @@ uint16_t qrcode_getBufferSize(uint8_t version) {
     return bb_getGridSizeBytes(4 * version + 17);
 }
 
-// @TODO: Return error if data is too big.
-int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8_t ecc, uint8_t *data, uint16_t length) {
-    uint8_t size = version * 4 + 17;
-    qrcode->version = version;
-    qrcode->size = size;
-    qrcode->ecc = ecc;
-    qrcode->modules = modules;
-    
-    uint8_t eccFormatBits = (ECC_FORMAT_BITS >> (2 * ecc)) & 0x03;
-    
+static uint16_t getDataCapacityBits(uint8_t version, uint8_t eccFormatBits) {
 #if LOCK_VERSION == 0
     uint16_t moduleCount = NUM_RAW_DATA_MODULES[version - 1];
-    uint16_t dataCapacity = moduleCount / 8 - NUM_ERROR_CORRECTION_CODEWORDS[eccFormatBits][version - 1];
+    return (moduleCount / 8 - NUM_ERROR_CORRECTION_CODEWORDS[eccFormatBits][version - 1]) * 8;
 #else
-    version = LOCK_VERSION;
-    uint16_t moduleCount = NUM_RAW_DATA_MODULES;
-    uint16_t dataCapacity = moduleCount / 8 - NUM_ERROR_CORRECTION_CODEWORDS[eccFormatBits];
+    return (NUM_RAW_DATA_MODULES / 8 - NUM_ERROR_CORRECTION_CODEWORDS[eccFormatBits]) * 8;
 #endif
-    
-    struct BitBucket codewords;
-    uint8_t codewordBytes[bb_getBufferSizeBytes(moduleCount)];
-    bb_initBuffer(&codewords, codewordBytes, (int32_t)sizeof(codewordBytes));
-    
-    // Place the data code words into the buffer
-    int8_t mode = encodeDataCodewords(&codewords, data, length, version);
-    
-    if (mode < 0) { return -1; }
-    qrcode->mode = mode;
-    
+}
+
+// Pads the data codewords, adds error correction and draws the final symbol
+static void finishSymbol(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8_t eccFormatBits, BitBucket *codewords) {
+    uint8_t size = version * 4 + 17;
+    uint16_t dataCapacity = getDataCapacityBits(version, eccFormatBits) / 8;
+
     // Add terminator and pad up to a byte if applicable
-    uint32_t padding = (dataCapacity * 8) - codewords.bitOffsetOrWidth;
+    uint32_t padding = (dataCapacity * 8) - codewords->bitOffsetOrWidth;
     if (padding > 4) { padding = 4; }
-    bb_appendBits(&codewords, 0, padding);
-    bb_appendBits(&codewords, 0, (8 - codewords.bitOffsetOrWidth % 8) % 8);
+    bb_appendBits(codewords, 0, padding);
+    bb_appendBits(codewords, 0, (8 - codewords->bitOffsetOrWidth % 8) % 8);
 
     // Pad with alternate bytes until data capacity is reached
-    for (uint8_t padByte = 0xEC; codewords.bitOffsetOrWidth < (dataCapacity * 8); padByte ^= 0xEC ^ 0x11) {
-        bb_appendBits(&codewords, padByte, 8);
+    for (uint8_t padByte = 0xEC; codewords->bitOffsetOrWidth < (dataCapacity * 8); padByte ^= 0xEC ^ 0x11) {
+        bb_appendBits(codewords, padByte, 8);
     }
 
     BitBucket modulesGrid;
@@ -830,8 +823,8 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
     
     // Draw function patterns, draw all codewords, do masking
     drawFunctionPatterns(&modulesGrid, &isFunctionGrid, version, eccFormatBits);
-    performErrorCorrection(version, eccFormatBits, &codewords);
-    drawCodewords(&modulesGrid, &isFunctionGrid, &codewords);
+    performErrorCorrection(version, eccFormatBits, codewords);
+    drawCodewords(&modulesGrid, &isFunctionGrid, codewords);
     
     // Find the best (lowest penalty) mask
     uint8_t mask = 0;
@@ -854,10 +847,257 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
     
     // Apply the final choice of mask
     applyMask(&modulesGrid, &isFunctionGrid, mask);
+}
+
+// @TODO: Return error if data is too big.
+int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8_t ecc, uint8_t *data, uint16_t length) {
+    uint8_t size = version * 4 + 17;
+    qrcode->version = version;
+    qrcode->size = size;
+    qrcode->ecc = ecc;
+    qrcode->modules = modules;
+    
+    uint8_t eccFormatBits = (ECC_FORMAT_BITS >> (2 * ecc)) & 0x03;
+    
+#if LOCK_VERSION == 0
+    uint16_t moduleCount = NUM_RAW_DATA_MODULES[version - 1];
+#else
+    version = LOCK_VERSION;
+    uint16_t moduleCount = NUM_RAW_DATA_MODULES;
+#endif
+    
+    struct BitBucket codewords;
+    uint8_t codewordBytes[bb_getBufferSizeBytes(moduleCount)];
+    bb_initBuffer(&codewords, codewordBytes, (int32_t)sizeof(codewordBytes));
+    
+    // Place the data code words into the buffer
+    int8_t mode = encodeDataCodewords(&codewords, data, length, version);
+    
+    if (mode < 0) { return -1; }
+    qrcode->mode = mode;
+    
+    finishSymbol(qrcode, modules, version, eccFormatBits, &codewords);
 
     return 0;
 }
 
+#if LOCK_VERSION == 0
+
+// Segment planning
+//
+// Finds the segmentation of the text into numeric, alphanumeric and byte runs
+// that needs the fewest bits, and from that the smallest version that holds
+// it. This is the dynamic program from Nayuki's QR generator: costs are kept
+// in sixths of a bit so that the 10/3 and 11/2 bits per character of numeric
+// and alphanumeric mode are exact.
+
+#define QR_COST_INFINITY    0x7FFFFFFF
+
+// Lowest version of each version range that shares character count widths
+static const uint8_t VERSION_RANGE_START[] = { 1, 10, 27, 41 };
+
+static uint8_t getCharMode(uint8_t c, bool fold) {
+    if (c >= '0' && c <= '9') { return MODE_NUMERIC; }
+    if (getAlphanumeric((char)foldCase(c, fold)) >= 0) { return MODE_ALPHANUMERIC; }
+    return MODE_BYTE;
+}
+
+// Cost of one character in each mode, in sixths of a bit
+static uint32_t getCharCost(uint8_t mode) {
+    switch (mode) {
+        case MODE_NUMERIC: return 20;
+        case MODE_ALPHANUMERIC: return 33;
+        default: return 48;
+    }
+}
+
+static uint32_t getSegmentBits(uint8_t mode, uint16_t length, uint8_t version) {
+    uint32_t bits = 4 + getModeBits(version, mode);
+    switch (mode) {
+        case MODE_NUMERIC:
+            bits += (length / 3) * 10;
+            if (length % 3) { bits += (length % 3) * 3 + 1; }
+            break;
+        case MODE_ALPHANUMERIC:
+            bits += (length / 2) * 11 + (length % 2) * 6;
+            break;
+        default:
+            bits += length * 8;
+            break;
+    }
+    return bits;
+}
+
+// Splits the text into segments optimised for the given version range. Returns
+// the number of segments, or -1 if there are more than QRCODE_MAX_SEGMENTS.
+static int16_t planSegments(QRSegment *segments, const uint8_t *data, uint16_t length, uint8_t version, bool fold) {
+    if (length == 0) {
+        segments[0].mode = MODE_BYTE;
+        segments[0].start = 0;
+        segments[0].length = 0;
+        return 1;
+    }
+
+    // For each character, the mode of that character given the mode of the
+    // next one, 2 bits per mode
+    uint8_t prevModes[length];
+    uint32_t headCosts[3];
+    uint32_t costs[3];
+
+    for (uint8_t m = 0; m < 3; m++) {
+        headCosts[m] = (4 + getModeBits(version, m)) * 6;
+        costs[m] = headCosts[m];
+    }
+
+    for (uint16_t i = 0; i < length; i++) {
+        uint8_t charMode = getCharMode(data[i], fold);
+        uint8_t links = 0;
+
+        // Keep going in the same mode where the character allows it
+        for (uint8_t m = 0; m < 3; m++) {
+            if (m >= charMode && costs[m] != QR_COST_INFINITY) {
+                costs[m] += getCharCost(m);
+                links |= m << (2 * m);
+            } else {
+                costs[m] = QR_COST_INFINITY;
+            }
+        }
+
+        // Or end the segment here and start a new one in another mode
+        uint32_t ended[3];
+        for (uint8_t m = 0; m < 3; m++) {
+            ended[m] = costs[m] == QR_COST_INFINITY ? QR_COST_INFINITY : (costs[m] + 5) / 6 * 6;
+        }
+        for (uint8_t to = 0; to < 3; to++) {
+            for (uint8_t from = 0; from < 3; from++) {
+                if (from == to || ended[from] == QR_COST_INFINITY) { continue; }
+                uint32_t cost = ended[from] + headCosts[to];
+                if (cost < costs[to]) {
+                    costs[to] = cost;
+                    links = (links & ~(3 << (2 * to))) | (from << (2 * to));
+                }
+            }
+        }
+        prevModes[i] = links;
+    }
+
+    // The final segment ends in whichever mode is cheapest
+    uint8_t mode = 0;
+    for (uint8_t m = 1; m < 3; m++) {
+        if (costs[m] < costs[mode]) { mode = m; }
+    }
+
+    // Walk back through the links, reusing prevModes for each character's mode
+    for (uint16_t i = length; i-- > 0;) {
+        mode = (prevModes[i] >> (2 * mode)) & 0x03;
+        prevModes[i] = mode;
+    }
+
+    int16_t count = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        if (i == 0 || prevModes[i] != prevModes[i - 1]) {
+            if (count == QRCODE_MAX_SEGMENTS) { return -1; }
+            segments[count].mode = prevModes[i];
+            segments[count].start = i;
+            segments[count].length = 0;
+            count++;
+        }
+        segments[count - 1].length++;
+    }
+
+    return count;
+}
+
+// Bits needed for the segments at this version, or 0 if a segment is longer
+// than its character count field allows
+static uint32_t getPlanBits(const QRSegment *segments, uint8_t numSegments, uint8_t version) {
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < numSegments; i++) {
+        if (segments[i].length >= (1UL << getModeBits(version, segments[i].mode))) { return 0; }
+        bits += getSegmentBits(segments[i].mode, segments[i].length, version);
+    }
+    return bits;
+}
+
+int8_t qrcode_plan(QRPlan *plan, const uint8_t *data, uint16_t length, uint8_t ecc, bool fold, uint8_t minVersion, uint8_t maxVersion) {
+    uint8_t eccFormatBits = (ECC_FORMAT_BITS >> (2 * ecc)) & 0x03;
+
+    if (minVersion < 1) { minVersion = 1; }
+    if (maxVersion > 40) { maxVersion = 40; }
+
+    plan->version = 0;
+    plan->ecc = ecc;
+    plan->fold = fold;
+    plan->numSegments = 0;
+    plan->bitLength = 0;
+
+    for (uint8_t range = 0; range < 3; range++) {
+        uint8_t first = max(VERSION_RANGE_START[range], minVersion);
+        uint8_t last = VERSION_RANGE_START[range + 1] - 1;
+        if (last > maxVersion) { last = maxVersion; }
+        if (first > last) { continue; }
+
+        int16_t count = planSegments(plan->segments, data, length, first, fold);
+        if (count < 0) {
+            // Too fragmented to describe, so use a single segment in the
+            // narrowest mode that holds every character
+            uint8_t mode = MODE_NUMERIC;
+            for (uint16_t i = 0; i < length && mode != MODE_BYTE; i++) {
+                mode = max(mode, getCharMode(data[i], fold));
+            }
+            plan->segments[0].mode = mode;
+            plan->segments[0].start = 0;
+            plan->segments[0].length = length;
+            count = 1;
+        }
+
+        uint32_t bits = getPlanBits(plan->segments, count, first);
+        if (bits == 0) { continue; }
+
+        for (uint8_t version = first; version <= last; version++) {
+            if (bits <= getDataCapacityBits(version, eccFormatBits)) {
+                plan->version = version;
+                plan->numSegments = count;
+                plan->bitLength = bits;
+                return 0;
+            }
+        }
+    }
+
+    return -1;
+}
+
+int8_t qrcode_initPlan(QRCode *qrcode, uint8_t *modules, const QRPlan *plan, const uint8_t *data) {
+    uint8_t version = plan->version;
+    if (version == 0) { return -1; }
+
+    qrcode->version = version;
+    qrcode->size = version * 4 + 17;
+    qrcode->ecc = plan->ecc;
+    qrcode->modules = modules;
+
+    uint8_t eccFormatBits = (ECC_FORMAT_BITS >> (2 * plan->ecc)) & 0x03;
+    uint16_t moduleCount = NUM_RAW_DATA_MODULES[version - 1];
+
+    struct BitBucket codewords;
+    uint8_t codewordBytes[bb_getBufferSizeBytes(moduleCount)];
+    bb_initBuffer(&codewords, codewordBytes, (int32_t)sizeof(codewordBytes));
+
+    uint8_t mode = MODE_NUMERIC;
+    for (uint8_t i = 0; i < plan->numSegments; i++) {
+        const QRSegment *segment = &plan->segments[i];
+        appendSegment(&codewords, data + segment->start, segment->length, segment->mode, version, plan->fold);
+        mode = max(mode, segment->mode);
+    }
+    qrcode->mode = mode;
+
+    finishSymbol(qrcode, modules, version, eccFormatBits, &codewords);
+
+    return 0;
+}
+
+#endif
+
 int8_t qrcode_initText(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8_t ecc, const char *data) {
     return qrcode_initBytes(qrcode, modules, version, ecc, (uint8_t*)data, strlen(data));
 }
@@ -72,6 +72,30 @@
 #endif
 
 
+// Maximum number of mode segments a QRPlan can describe
+#ifndef QRCODE_MAX_SEGMENTS
+#define QRCODE_MAX_SEGMENTS 32
+#endif
+
+
+typedef struct QRSegment {
+    uint8_t mode;
+    uint16_t start;
+    uint16_t length;
+} QRSegment;
+
+// Result of qrcode_plan(): how to split the data into mode segments and the
+// smallest version that holds them.
+typedef struct QRPlan {
+    uint8_t version;
+    uint8_t ecc;
+    bool fold;
+    uint8_t numSegments;
+    uint32_t bitLength;
+    QRSegment segments[QRCODE_MAX_SEGMENTS];
+} QRPlan;
+
+
 typedef struct QRCode {
     uint8_t version;
     uint8_t size;
@@ -95,6 +119,14 @@ int8_t qrcode_initBytes(QRCode *qrcode, uint8_t *modules, uint8_t version, uint8
 
 bool qrcode_getModule(QRCode *qrcode, uint8_t x, uint8_t y);
 
+#if LOCK_VERSION == 0
+// Plan a mixed-mode encoding of the data in a single pass. If fold is set,
+// lower case letters are encoded as upper case. Returns 0 and sets
+// plan->version, or -1 if the data does not fit in maxVersion.
+int8_t qrcode_plan(QRPlan *plan, const uint8_t *data, uint16_t length, uint8_t ecc, bool fold, uint8_t minVersion, uint8_t maxVersion);
+int8_t qrcode_initPlan(QRCode *qrcode, uint8_t *modules, const QRPlan *plan, const uint8_t *data);
+#endif
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,142 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# adaptive_sizer_test.py - Check the UR fragment sizing in modules/data_codecs/adaptive_sizer.py
+#
+# Runs on the unix port, with a fake clock and a stand-in for QRCode.fit_to_version() that
+# gives one QR version per 40 characters.
+#
+import sys
+
+from data_codecs.adaptive_sizer import AdaptiveQRSizer, CALIBRATION_FRAMES, DEFAULT_INTERVAL_MS
+
+# Passport's QR area is 220 pixels across when there's no message under the code
+AREA_PX = 220
+
+failures = 0
+
+
+def expect(what, got, expected):
+    global failures
+    if got != expected:
+        print('FAIL: {}: got {}, expected {}'.format(what, got, expected))
+        failures += 1
+
+
+class FakeClock:
+    def __init__(self):
+        self.now = 0
+
+    def __call__(self):
+        return self.now
+
+
+def fit_version(text_len):
+    return text_len // 40 + 1
+
+
+def make(target_fps):
+    clock = FakeClock()
+    sizer = AdaptiveQRSizer(AREA_PX, prefix='crypto-psbt', target_fps=target_fps, clock=clock,
+                            ticks_diff=lambda end, start: end - start, fit_version=fit_version)
+    return clock, sizer
+
+
+def run(clock, sizer, cost_ms, frames):
+    # Draws frames that take cost_ms each, waiting the sizer's delay between them the way
+    # DisplayURCode does, and returns the frames after which it picked a new fragment length
+    resized = []
+    for i in range(frames):
+        sizer.begin_frame()
+        clock.now += cost_ms
+        if sizer.end_frame():
+            resized.append(i)
+        clock.now += sizer.frame_delay_ms()
+    return resized
+
+
+def test_initial_size():
+    # 280 byte fragments need version 16, which only gets 2 pixels a module in 220 pixels;
+    # 220 byte fragments fit version 13 at 3 pixels
+    clock, sizer = make(5)
+    stats = sizer.stats()
+    expect('initial: fragment_len', stats['fragment_len'], 220)
+    expect('initial: version', stats['version'], 13)
+    expect('initial: module_px', stats['module_px'], 3)
+    expect('initial: interval_ms', stats['interval_ms'], 200)
+    expect('initial: fps', stats['fps'], 0)
+    expect('initial: calibrated', stats['calibrated'], False)
+
+
+def test_keeps_up():
+    clock, sizer = make(5)
+    expect('keeps up: no resize', run(clock, sizer, 50, 10), [])
+    stats = sizer.stats()
+    expect('keeps up: fragment_len', stats['fragment_len'], 220)
+    expect('keeps up: frame_cost_ms', stats['frame_cost_ms'], 50)
+    expect('keeps up: delay', sizer.frame_delay_ms(), 150)
+    expect('keeps up: fps', stats['fps'], 5.0)
+    expect('keeps up: calibrated', stats['calibrated'], True)
+
+
+def test_steps_down():
+    # Too slow for the target: one step down once calibrated, and no more after that even if
+    # the smaller fragments are still too slow
+    clock, sizer = make(5)
+    expect('slow: resized once', run(clock, sizer, 300, CALIBRATION_FRAMES + 10),
+           [CALIBRATION_FRAMES - 1])
+    stats = sizer.stats()
+    expect('slow: fragment_len', stats['fragment_len'], 170)
+    expect('slow: version', stats['version'], 11)
+    expect('slow: interval_ms', stats['interval_ms'], 300)
+    expect('slow: delay', sizer.frame_delay_ms(), 0)
+    expect('slow: fps', int(stats['fps'] * 100), 333)
+
+
+def test_no_target():
+    # Without a target the size is left alone, and frames are as far apart as they take
+    clock, sizer = make(None)
+    expect('no target: no resize', run(clock, sizer, 300, 10), [])
+    stats = sizer.stats()
+    expect('no target: fragment_len', stats['fragment_len'], 220)
+    expect('no target: interval_ms', stats['interval_ms'], 300)
+
+    clock, sizer = make(None)
+    run(clock, sizer, 50, 10)
+    expect('no target: default interval', sizer.stats()['interval_ms'], DEFAULT_INTERVAL_MS)
+
+
+def test_smallest():
+    # The smallest fragment length has nowhere to go
+    clock, sizer = make(5)
+    sizer.size_idx = len(sizer.fragment_lens) - 1
+    expect('smallest: no resize', run(clock, sizer, 300, 10), [])
+    expect('smallest: fragment_len', sizer.fragment_len(), 70)
+
+
+def test_too_big():
+    # A fragment that doesn't fit a QR code at all: the frame it failed in isn't measured, and
+    # the sizer steps down until the smallest length
+    clock, sizer = make(5)
+    sizer.begin_frame()
+    expect('too big: stepped down', sizer.step_down(), True)
+    expect('too big: fragment_len', sizer.fragment_len(), 170)
+    expect('too big: frame not measured', sizer.end_frame(), False)
+    expect('too big: frames', sizer.frames, 0)
+    while sizer.step_down():
+        pass
+    expect('too big: smallest', sizer.fragment_len(), 70)
+    expect('too big: no further', sizer.step_down(), False)
+
+
+test_initial_size()
+test_keeps_up()
+test_steps_down()
+test_no_target()
+test_smallest()
+test_too_big()
+
+if failures:
+    print('{} failed'.format(failures))
+    sys.exit(1)
+print('All passed')
@@ -0,0 +1,425 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adc_service.h"
+
+// Raw sample for a voltage at the ADC pin
+#define MV(mv) ((uint16_t)(((uint32_t)(mv) * ADC_MAX_SAMPLE) / ADC_REF_VOLTAGE_MV))
+
+static int failures;
+
+static void fail(const char *what, long got, long expected)
+{
+    printf("FAIL: %s: got %ld, expected %ld\n", what, got, expected);
+    failures++;
+}
+
+static void expect(const char *what, long got, long expected)
+{
+    if (got != expected) {
+        fail(what, got, expected);
+    }
+}
+
+static void expect_near(const char *what, long got, long expected, long tolerance)
+{
+    if (labs(got - expected) > tolerance) {
+        fail(what, got, expected);
+    }
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    // xorshift32, so the traces are the same on every run
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Uniform in [-amplitude, amplitude]
+static int jitter(int amplitude)
+{
+    return (int)(rng() % (2 * amplitude + 1)) - amplitude;
+}
+
+//=================================================================================================
+// Traces
+//
+// What each input reads at a given time. The power monitor trace is a battery being drawn down
+// slowly while the camera and backlight add 100 mA bursts of 20 ms every 250 ms, which is what
+// made single readings of the current jump around. The noise inputs read a counter, so the test
+// can tell exactly which scans reached the ring.
+
+#define PWRMON_BASE_MA   60
+#define PWRMON_BURST_MA  100
+#define PWRMON_BURST_US  20000
+#define PWRMON_PERIOD_US 250000
+#define PWRMON_MEAN_MA   (PWRMON_BASE_MA + PWRMON_BURST_MA * PWRMON_BURST_US / PWRMON_PERIOD_US)
+
+// PWRMON_V sits behind a 44.7k / 22.1k divider
+#define PWRMON_V_START_MV 1980
+
+static uint32_t noise_counter;
+
+static int trace_current_ma(uint64_t t_us)
+{
+    int ma = PWRMON_BASE_MA;
+    if (t_us % PWRMON_PERIOD_US < PWRMON_BURST_US) {
+        ma += PWRMON_BURST_MA;
+    }
+    return ma;
+}
+
+static int trace_voltage_mv(uint64_t t_us)
+{
+    // 10 mV per minute
+    return PWRMON_V_START_MV - (int)(t_us / 6000000);
+}
+
+static void trace_scan(uint64_t t_us, uint16_t *scan)
+{
+    scan[ADC_SCAN_NOISE1] = noise_counter & 0xFFFF;
+    scan[ADC_SCAN_NOISE2] = ~noise_counter & 0xFFFF;
+    noise_counter++;
+
+    // The 5 ohm sense resistor, plus a few mV of noise on each input
+    scan[ADC_SCAN_PWRMON_I] = MV(trace_current_ma(t_us) * 5 + jitter(15));
+    scan[ADC_SCAN_PWRMON_V] = MV(trace_voltage_mv(t_us) + jitter(8));
+}
+
+static uint16_t trace_als(void)
+{
+    return MV(1200 + jitter(20));
+}
+
+//=================================================================================================
+// A model of adc.c: TIM15 paces the scans at the rate the service asks for, DMA fills half a
+// buffer at a time, and ALS conversions complete straight away.
+
+typedef struct {
+    adc_service_t s;
+    uint64_t t_us;
+    uint32_t scans;
+    uint32_t als_conversions;
+    uint32_t rate_changes;
+} sim_t;
+
+static void sim_init(sim_t *sim)
+{
+    memset(sim, 0, sizeof(*sim));
+    adc_service_init(&sim->s);
+    noise_counter = 0;
+    rng_state = 0x12345678;
+}
+
+// Runs for at least `duration_us`, a half buffer at a time
+static void sim_run(sim_t *sim, uint64_t duration_us)
+{
+    uint64_t end = sim->t_us + duration_us;
+    uint16_t half[ADC_SCANS_PER_HALF * ADC_SCAN_CHANNELS];
+
+    while (sim->t_us < end) {
+        uint32_t period_us = 1000000 / (sim->s.fast ? ADC_FAST_HZ : ADC_SLOW_HZ);
+
+        for (int i = 0; i < ADC_SCANS_PER_HALF; i++) {
+            trace_scan(sim->t_us, &half[i * ADC_SCAN_CHANNELS]);
+            sim->t_us += period_us;
+        }
+        sim->scans += ADC_SCANS_PER_HALF;
+
+        uint32_t events = adc_service_process(&sim->s, half, ADC_SCANS_PER_HALF);
+        if (events & ADC_EVENT_START_ALS) {
+            adc_filter_update(&sim->s.als, trace_als());
+            sim->als_conversions++;
+        }
+        if (events & ADC_EVENT_RATE_CHANGED) {
+            sim->rate_changes++;
+        }
+    }
+}
+
+static int current_ma(sim_t *sim)
+{
+    uint16_t v;
+    if (!adc_filter_value(&sim->s.current, &v)) {
+        return -1;
+    }
+    return adc_to_millivolts(v) / 5;
+}
+
+static int voltage_mv(sim_t *sim)
+{
+    uint16_t v;
+    if (!adc_filter_value(&sim->s.voltage, &v)) {
+        return -1;
+    }
+    return adc_to_millivolts(v);
+}
+
+//=================================================================================================
+
+static void check_millivolts(void)
+{
+    // Must match what adc_read_powermon() and adc_read_als() used to compute
+    for (uint32_t sample = 0; sample <= 0xFFFF; sample++) {
+        uint16_t old = (sample * 3000) / 65535;
+        if (adc_to_millivolts(sample) != old) {
+            fail("adc_to_millivolts", adc_to_millivolts(sample), old);
+            return;
+        }
+    }
+}
+
+static void check_filter(void)
+{
+    adc_filter_t f;
+    uint16_t v;
+
+    adc_filter_init(&f, ADC_FILTER_SHIFT_PWRMON);
+    expect("value before the first sample", adc_filter_value(&f, &v), false);
+
+    // Starts from the first sample, and a steady input gives exactly that value
+    for (int i = 0; i < 100; i++) {
+        adc_filter_update(&f, 40000);
+        adc_filter_value(&f, &v);
+        if (v != 40000) {
+            fail("steady input", v, 40000);
+            break;
+        }
+    }
+
+    // A step is 63% of the way there after 2^shift samples, and all the way after 12 times that
+    adc_filter_update(&f, 50000);
+    for (int i = 1; i < (1 << ADC_FILTER_SHIFT_PWRMON); i++) {
+        adc_filter_update(&f, 50000);
+    }
+    adc_filter_value(&f, &v);
+    expect_near("step after one time constant", v, 40000 + 6321, 60);
+
+    uint16_t last = v;
+    for (int i = 0; i < 11 << ADC_FILTER_SHIFT_PWRMON; i++) {
+        adc_filter_update(&f, 50000);
+        adc_filter_value(&f, &v);
+        if (v < last) {
+            fail("step response is monotonic", v, last);
+            break;
+        }
+        last = v;
+    }
+    expect_near("step after 12 time constants", v, 50000, 1);
+
+    // Full scale doesn't overflow the accumulator
+    adc_filter_init(&f, ADC_FILTER_SHIFT_PWRMON);
+    for (int i = 0; i < 1000; i++) {
+        adc_filter_update(&f, 0xFFFF);
+    }
+    adc_filter_value(&f, &v);
+    expect("full scale", v, 0xFFFF);
+}
+
+static void check_ring(void)
+{
+    static adc_noise_ring_t r;
+    uint16_t n1, n2;
+
+    // Start just short of where the counts wrap
+    memset(&r, 0, sizeof(r));
+    r.head = r.tail = 0xFFFFFFFF - ADC_NOISE_RING_SIZE / 2;
+
+    expect("pop from empty ring", adc_noise_ring_pop(&r, &n1, &n2), false);
+
+    for (int i = 0; i < ADC_NOISE_RING_SIZE; i++) {
+        if (!adc_noise_ring_push(&r, i, 0xFFFF - i)) {
+            fail("push into ring with room", i, -1);
+            return;
+        }
+    }
+    expect("level of full ring", adc_noise_ring_level(&r), ADC_NOISE_RING_SIZE);
+    expect("push into full ring", adc_noise_ring_push(&r, 1, 1), false);
+
+    for (int i = 0; i < ADC_NOISE_RING_SIZE; i++) {
+        if (!adc_noise_ring_pop(&r, &n1, &n2) || n1 != i || n2 != 0xFFFF - i) {
+            fail("pairs come out in order", n1, i);
+            return;
+        }
+    }
+    expect("level of drained ring", adc_noise_ring_level(&r), 0);
+
+    adc_noise_ring_push(&r, 1, 2);
+    adc_noise_ring_push(&r, 3, 4);
+    adc_noise_ring_flush(&r);
+    expect("level after flush", adc_noise_ring_level(&r), 0);
+    expect("pop after flush", adc_noise_ring_pop(&r, &n1, &n2), false);
+}
+
+static void check_slow_without_noise(void)
+{
+    static sim_t sim;
+    sim_init(&sim);
+
+    expect("current before the first scan", current_ma(&sim), -1);
+
+    sim_run(&sim, 10000000);
+
+    expect("rate changes with noise off", sim.rate_changes, 0);
+    expect_near("scans in 10 s with noise off", sim.scans, 10 * ADC_SLOW_HZ, ADC_SCANS_PER_HALF);
+    expect_near("ALS conversions in 10 s", sim.als_conversions, 10 * ADC_SLOW_HZ / ADC_ALS_DIVIDER, 1);
+    expect("noise pushed with noise off", adc_noise_ring_level(&sim.s.noise), 0);
+}
+
+static void check_noise_scheduling(void)
+{
+    static sim_t sim;
+    uint16_t n1, n2;
+
+    sim_init(&sim);
+    sim_run(&sim, 1000000);
+
+    // Switching the amplifiers on speeds the scans up at the end of the next half buffer
+    adc_service_set_noise(&sim.s, true);
+    uint32_t first_scan = sim.scans;
+    sim_run(&sim, 1);
+    expect("fast once noise is on", sim.s.fast, true);
+
+    // Run until the ring fills and the scans slow down again
+    sim_run(&sim, 200000);
+    expect("slow once the ring is full", sim.s.fast, false);
+    expect("level of the full ring", adc_noise_ring_level(&sim.s.noise), ADC_NOISE_RING_SIZE);
+    expect("rate changes", sim.rate_changes, 2);
+
+    // The settling scans are thrown away, and after them every scan is in the ring, in order
+    for (int i = 0; i < ADC_NOISE_RING_SIZE; i++) {
+        uint32_t scan = first_scan + ADC_NOISE_SETTLE_SCANS + i;
+        if (!adc_noise_ring_pop(&sim.s.noise, &n1, &n2) || n1 != (scan & 0xFFFF) || n2 != (~scan & 0xFFFF)) {
+            fail("noise pair from scan", n1, scan & 0xFFFF);
+            return;
+        }
+        // Put it back, so the ring is full again
+        adc_noise_ring_push(&sim.s.noise, n1, n2);
+    }
+
+    // Taking a little doesn't speed the scans up, and taking enough does
+    for (int i = 0; i < ADC_NOISE_RING_SIZE - ADC_NOISE_REFILL_LEVEL - 1; i++) {
+        adc_noise_ring_pop(&sim.s.noise, &n1, &n2);
+    }
+    sim_run(&sim, 1);
+    expect("slow after a little is taken", sim.s.fast, false);
+
+    // The slow scans keep topping it up, so it has to be a half buffer below the refill level
+    while (adc_noise_ring_level(&sim.s.noise) > ADC_NOISE_REFILL_LEVEL - ADC_SCANS_PER_HALF) {
+        adc_noise_ring_pop(&sim.s.noise, &n1, &n2);
+    }
+    sim_run(&sim, 1);
+    expect("fast at the refill level", sim.s.fast, true);
+
+    while (adc_noise_ring_pop(&sim.s.noise, &n1, &n2)) {
+    }
+    sim_run(&sim, 1);
+    expect("fast after the ring is drained", sim.s.fast, true);
+
+    // Switching the amplifiers off slows the scans down and stops the pairs
+    adc_service_set_noise(&sim.s, false);
+    adc_noise_ring_flush(&sim.s.noise);
+    sim_run(&sim, 1);
+    expect("slow once noise is off", sim.s.fast, false);
+    sim_run(&sim, 1000000);
+    expect("noise pushed after noise is off", adc_noise_ring_level(&sim.s.noise), 0);
+}
+
+static void check_pwrmon_rate(void)
+{
+    // The power monitor filters must see the same sample rate whatever the scan rate, or their
+    // time constant would change. Keep the ring drained so the scans stay fast.
+    static sim_t sim;
+    uint16_t n1, n2;
+
+    sim_init(&sim);
+    sim_run(&sim, 1000000);
+    uint32_t als_slow = sim.als_conversions;
+
+    adc_service_set_noise(&sim.s, true);
+    uint32_t als_before = sim.als_conversions;
+    uint64_t t_before = sim.t_us;
+    while (sim.t_us - t_before < 10000000) {
+        sim_run(&sim, 1);
+        while (adc_noise_ring_pop(&sim.s.noise, &n1, &n2)) {
+        }
+    }
+    expect("fast after 10 s of draining", sim.s.fast, true);
+
+    // One ALS conversion per ADC_ALS_DIVIDER power monitor samples
+    expect_near("ALS conversions in 1 s at the slow rate", als_slow, ADC_SLOW_HZ / ADC_ALS_DIVIDER, 1);
+    expect_near("ALS conversions in 10 s at the fast rate", sim.als_conversions - als_before,
+                10 * ADC_SLOW_HZ / ADC_ALS_DIVIDER, 1);
+}
+
+static void check_pwrmon_trace(void)
+{
+    static sim_t sim;
+    sim_init(&sim);
+
+    // Let the filters settle
+    sim_run(&sim, 3000000);
+
+    // What periodic.py used to get from two readings 1 ms apart, against the filtered value
+    int worst_old = 0;
+    int worst_filtered = 0;
+    int worst_voltage = 0;
+
+    for (int i = 0; i < 600; i++) {
+        sim_run(&sim, 97000);  // Not a multiple of the burst period
+
+        uint64_t t = sim.t_us;
+        int old = (trace_current_ma(t) + jitter(3) + trace_current_ma(t + 1000) + jitter(3)) / 2;
+        int filtered = current_ma(&sim);
+
+        if (abs(old - PWRMON_MEAN_MA) > worst_old) {
+            worst_old = abs(old - PWRMON_MEAN_MA);
+        }
+        if (abs(filtered - PWRMON_MEAN_MA) > worst_filtered) {
+            worst_filtered = abs(filtered - PWRMON_MEAN_MA);
+        }
+        if (abs(voltage_mv(&sim) - trace_voltage_mv(t)) > worst_voltage) {
+            worst_voltage = abs(voltage_mv(&sim) - trace_voltage_mv(t));
+        }
+    }
+
+    printf("current: worst error %d mA filtered, %d mA from two readings\n", worst_filtered, worst_old);
+    printf("voltage: worst error %d mV\n", worst_voltage);
+
+    expect_near("filtered current", worst_filtered, 0, 10);
+    if (worst_old < 50) {
+        fail("two readings should catch the bursts", worst_old, 50);
+    }
+    expect_near("filtered voltage", worst_voltage, 0, 5);
+
+    uint16_t als;
+    adc_filter_value(&sim.s.als, &als);
+    expect_near("filtered ALS", adc_to_millivolts(als), 1200, 10);
+}
+
+int main(void)
+{
+    check_millivolts();
+    check_filter();
+    check_ring();
+    check_slow_without_noise();
+    check_noise_scheduling();
+    check_pwrmon_rate();
+    check_pwrmon_trace();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
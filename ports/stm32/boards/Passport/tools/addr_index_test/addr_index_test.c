@@ -0,0 +1,357 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "addr_index.h"
+
+static int failures;
+
+static void fail(const char *what, long got, long expected)
+{
+    printf("FAIL: %s: got %ld, expected %ld\n", what, got, expected);
+    failures++;
+}
+
+static void expect(const char *what, long got, long expected)
+{
+    if (got != expected) {
+        fail(what, got, expected);
+    }
+}
+
+// Stands in for the keyed hash that addr_index.py makes the tags from (splitmix32)
+static uint32_t tag_for(uint32_t seed, uint32_t index)
+{
+    uint32_t z = seed + index * 0x9E3779B9;
+    z = (z ^ (z >> 16)) * 0x85EBCA6B;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35;
+    return z ^ (z >> 16);
+}
+
+//=================================================================================================
+// A RAM model of an index file in SPI flash. Files are written front to back, as littlefs
+// programs them, and the model counts read transactions and bytes so the tests can see how much
+// of the file a lookup touches.
+
+#define FLASH_PAGE_SIZE 256
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    uint32_t reads;
+    uint32_t bytes_read;
+} ram_file_t;
+
+static int ram_read(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    ram_file_t *f = ctx;
+    if (offset > f->len || len > f->len - offset) {
+        return -1;
+    }
+    memcpy(buf, f->data + offset, len);
+    f->reads++;
+    f->bytes_read += len;
+    return 0;
+}
+
+static int ram_write(void *ctx, const void *buf, size_t len)
+{
+    ram_file_t *f = ctx;
+    if (f->len + len > f->cap) {
+        size_t cap = f->cap ? f->cap : FLASH_PAGE_SIZE;
+        while (cap < f->len + len) {
+            cap *= 2;
+        }
+        f->data = realloc(f->data, cap);
+        memset(f->data + f->cap, 0xFF, cap - f->cap);  // Erased
+        f->cap = cap;
+    }
+    memcpy(f->data + f->len, buf, len);
+    f->len += len;
+    return 0;
+}
+
+static void ram_file_free(ram_file_t *f)
+{
+    free(f->data);
+    memset(f, 0, sizeof(*f));
+}
+
+static addr_index_io_t io_for(ram_file_t *f)
+{
+    addr_index_io_t io = {ram_read, ram_write, f};
+    return io;
+}
+
+// Adds tags for indexes [from, to) to the index in `f`, replacing it with a new file as
+// addr_index.py does. With an empty `f` the index is created.
+static int extend(ram_file_t *f, uint32_t seed, uint32_t from, uint32_t to)
+{
+    uint32_t *tags = malloc((to - from + 1) * sizeof(uint32_t));
+    for (uint32_t i = from; i < to; i++) {
+        tags[i - from] = tag_for(seed, i);
+    }
+
+    ram_file_t out = {0};
+    addr_index_io_t src = io_for(f);
+    addr_index_io_t dst = io_for(&out);
+    int err = addr_index_extend(f->len ? &src : NULL, &dst, tags, to - from);
+    free(tags);
+
+    if (err == ADDR_INDEX_OK) {
+        ram_file_free(f);
+        *f = out;
+    } else {
+        ram_file_free(&out);
+    }
+    return err;
+}
+
+static bool lookup_has(ram_file_t *f, uint32_t tag, uint32_t index, int *num_found)
+{
+    uint32_t found[16];
+    addr_index_io_t io = io_for(f);
+    int n = addr_index_lookup(&io, tag, found, 16);
+    if (num_found) {
+        *num_found = n;
+    }
+    for (int i = 0; i < n; i++) {
+        if (found[i] == index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t count_of(ram_file_t *f)
+{
+    addr_index_header_t hdr;
+    addr_index_io_t io = io_for(f);
+    if (addr_index_read_header(&io, &hdr) != ADDR_INDEX_OK) {
+        return 0xFFFFFFFF;
+    }
+    return hdr.count;
+}
+
+//=================================================================================================
+// Tests
+
+static void check_empty(void)
+{
+    ram_file_t f = {0};
+    expect("create empty", extend(&f, 1, 0, 0), ADDR_INDEX_OK);
+    expect("empty count", count_of(&f), 0);
+    expect("empty size", f.len, sizeof(addr_index_header_t) + (ADDR_INDEX_BUCKET_SIZE << ADDR_INDEX_MIN_BUCKET_BITS));
+
+    int n;
+    lookup_has(&f, 0x12345678, 0, &n);
+    expect("lookup in empty", n, 0);
+    ram_file_free(&f);
+}
+
+// Grows an index a batch at a time, checking every address in it after each batch
+static void check_growth(void)
+{
+    static const uint32_t batches[] = {1, 7, 50, 5, 200, 37, 1000, 3, 2500, 4000, 6000, 2580};
+    ram_file_t f = {0};
+    uint32_t count = 0;
+    uint32_t seed = 0xC0FFEE;
+
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        expect("extend", extend(&f, seed, count, count + batches[b]), ADDR_INDEX_OK);
+        count += batches[b];
+        expect("count", count_of(&f), count);
+
+        int missing = 0;
+        uint32_t false_hits = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            int n;
+            if (!lookup_has(&f, tag_for(seed, i), i, &n)) {
+                missing++;
+            }
+            false_hits += n - 1;
+        }
+        expect("addresses not found", missing, 0);
+
+        // Tags that aren't in the index: the stored tag bits that aren't in the home bucket number
+        // make a false hit about one in 2^(18 - bucket_bits) per slot looked at
+        uint32_t strangers = 0;
+        for (uint32_t i = 0; i < 10000; i++) {
+            int n;
+            lookup_has(&f, tag_for(seed + 1, i), 0xFFFFFFFF, &n);
+            strangers += n;
+        }
+        if (strangers > 10000 / 8) {
+            fail("false hits for tags not in the index", strangers, 10000 / 8);
+        }
+        if (false_hits > count / 8 + 1) {
+            fail("false hits for tags in the index", false_hits, count / 8 + 1);
+        }
+    }
+
+    expect("extend past the limit", extend(&f, seed, count, count + 1), ADDR_INDEX_ERR_FULL);
+    expect("count unchanged", count_of(&f), count);
+    ram_file_free(&f);
+}
+
+// The same addresses in one batch or many are found in the same number of reads on average
+static void check_batching(void)
+{
+    ram_file_t one = {0}, many = {0};
+    uint32_t seed = 77;
+    extend(&one, seed, 0, 3000);
+    for (uint32_t i = 0; i < 3000; i += 100) {
+        extend(&many, seed, i, i + 100);
+    }
+    expect("same size", many.len, one.len);
+
+    one.reads = many.reads = 0;
+    for (uint32_t i = 0; i < 3000; i++) {
+        lookup_has(&one, tag_for(seed, i), i, NULL);
+        lookup_has(&many, tag_for(seed, i), i, NULL);
+    }
+    expect("same reads", many.reads, one.reads);
+    ram_file_free(&one);
+    ram_file_free(&many);
+}
+
+// Many addresses with the same tag run over several buckets and are all still found
+static void check_collisions(void)
+{
+    uint32_t tags[100];
+    for (int i = 0; i < 100; i++) {
+        tags[i] = 0x80000000;
+    }
+    ram_file_t out = {0};
+    addr_index_io_t dst = io_for(&out);
+    expect("extend with collisions", addr_index_extend(NULL, &dst, tags, 100), ADDR_INDEX_OK);
+
+    uint32_t found[128];
+    addr_index_io_t io = io_for(&out);
+    expect("all collisions found", addr_index_lookup(&io, 0x80000000, found, 128), 100);
+    expect("limited to max_indexes", addr_index_lookup(&io, 0x80000000, found, 10), 10);
+
+    // More than can be waiting to be written at once is refused rather than written wrongly
+    ram_file_t out2 = {0};
+    dst = io_for(&out2);
+    uint32_t many[1000];
+    for (int i = 0; i < 1000; i++) {
+        many[i] = 0x80000000;
+    }
+    expect("too many collisions", addr_index_extend(NULL, &dst, many, 1000), ADDR_INDEX_ERR_FULL);
+
+    ram_file_free(&out);
+    ram_file_free(&out2);
+}
+
+static void check_damage(void)
+{
+    ram_file_t f = {0};
+    extend(&f, 5, 0, 500);
+
+    int n;
+    f.data[0] ^= 1;
+    lookup_has(&f, tag_for(5, 0), 0, &n);
+    expect("bad magic", n, ADDR_INDEX_ERR_FORMAT);
+    expect("extend from bad magic", extend(&f, 5, 500, 501), ADDR_INDEX_ERR_FORMAT);
+    f.data[0] ^= 1;
+
+    f.len = sizeof(addr_index_header_t) + ADDR_INDEX_BUCKET_SIZE;
+    uint32_t cut_off = 0;
+    while (tag_for(5, cut_off) < (1u << 25)) {
+        // One whose home bucket (of 128) is past the first
+        cut_off++;
+    }
+    lookup_has(&f, tag_for(5, cut_off), cut_off, &n);
+    expect("truncated", n, ADDR_INDEX_ERR_IO);
+    expect("extend from truncated", extend(&f, 5, 500, 501), ADDR_INDEX_ERR_IO);
+    ram_file_free(&f);
+}
+
+//=================================================================================================
+// Benchmark
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void benchmark(void)
+{
+    // Built the way addr_index.py does it in the background: a batch at a time, written out once
+    // a quarter as many again as are in the file have been derived
+    ram_file_t f = {0};
+    uint32_t seed = 0xBEEF;
+    uint32_t count = 0, pages = 0, rewrites = 0;
+    while (count < 10001) {
+        uint32_t batch = count / 4 > 50 ? count / 4 : 50;
+        if (count + batch > 10001) {
+            batch = 10001 - count;
+        }
+        extend(&f, seed, count, count + batch);
+        pages += (f.len + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+        rewrites++;
+        count += batch;
+    }
+    printf("Indexed %u addresses in %u rewrites: %u KB file, %u KB programmed in all\n", count, rewrites,
+           (unsigned)(f.len / 1024), pages * FLASH_PAGE_SIZE / 1024);
+
+    f.reads = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        lookup_has(&f, tag_for(seed, i), i, NULL);
+    }
+    printf("Average of %.3f reads per lookup, one of them the header\n", (double)f.reads / count);
+
+    static const uint32_t targets[] = {0, 1000, 10000};
+    const int reps = 200000;
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        uint32_t target = targets[t];
+        int n;
+        f.reads = f.bytes_read = 0;
+        bool found = lookup_has(&f, tag_for(seed, target), target, &n);
+        uint32_t reads = f.reads, bytes = f.bytes_read;
+
+        double start = now_us();
+        for (int i = 0; i < reps; i++) {
+            lookup_has(&f, tag_for(seed, target), target, NULL);
+        }
+        double us = (now_us() - start) / reps;
+
+        printf("index %5u: %s, %d candidate, %u reads, %u bytes, %.3f us per lookup; "
+               "searching from 0 derives %u addresses\n",
+               target, found ? "found" : "NOT FOUND", n, reads, bytes, us, target + 1);
+        if (!found) {
+            failures++;
+        }
+    }
+    ram_file_free(&f);
+}
+
+int main(int argc, char **argv)
+{
+    check_empty();
+    check_growth();
+    check_batching();
+    check_collisions();
+    check_damage();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchmark();
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
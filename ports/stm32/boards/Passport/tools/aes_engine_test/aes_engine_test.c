@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+
+#include "aes_engine.h"
+
+#define MAX_MSG_LEN 4096
+
+static uint8_t plain[MAX_MSG_LEN];
+static uint8_t expected[MAX_MSG_LEN];
+static uint8_t got[MAX_MSG_LEN];
+
+static const char *mode_names[] = {"ECB", "CBC", "CTR"};
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand();
+    }
+}
+
+static const EVP_CIPHER *openssl_cipher(aes_engine_mode_t mode, size_t key_len)
+{
+    switch (mode) {
+        case AES_ENGINE_ECB:
+            return key_len == 16 ? EVP_aes_128_ecb() : key_len == 24 ? EVP_aes_192_ecb() : EVP_aes_256_ecb();
+        case AES_ENGINE_CBC:
+            return key_len == 16 ? EVP_aes_128_cbc() : key_len == 24 ? EVP_aes_192_cbc() : EVP_aes_256_cbc();
+        default:
+            return key_len == 16 ? EVP_aes_128_ctr() : key_len == 24 ? EVP_aes_192_ctr() : EVP_aes_256_ctr();
+    }
+}
+
+static void openssl_crypt(aes_engine_mode_t mode,
+                          const uint8_t *key,
+                          size_t key_len,
+                          const uint8_t *iv,
+                          const uint8_t *in,
+                          uint8_t *out,
+                          size_t len,
+                          int encrypt)
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int out_len = 0;
+
+    EVP_CipherInit_ex(ctx, openssl_cipher(mode, key_len), NULL, key, mode == AES_ENGINE_ECB ? NULL : iv, encrypt);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_CipherUpdate(ctx, out, &out_len, in, len);
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+// ECB and CBC take whole blocks, CTR takes anything and usually gets short pieces
+static size_t piece_len(aes_engine_mode_t mode, size_t remaining)
+{
+    size_t n;
+
+    if (mode == AES_ENGINE_CTR) {
+        n = (rand() % 4 == 0) ? (size_t)(rand() % 700) : (size_t)(rand() % 20);
+    } else {
+        n = (size_t)(rand() % 40) * AES_ENGINE_BLOCK_SIZE;
+    }
+    return n > remaining ? remaining : n;
+}
+
+static int check(int round, aes_engine_mode_t mode, size_t key_len, const uint8_t *iv, int encrypt, int in_place)
+{
+    uint8_t key[32];
+    aes_engine_ctx_t ctx;
+    size_t len = rand() % (MAX_MSG_LEN + 1);
+    size_t done = 0;
+
+    if (mode != AES_ENGINE_CTR) {
+        len &= ~(AES_ENGINE_BLOCK_SIZE - 1);
+    }
+
+    fill_random(key, key_len);
+    fill_random(plain, len);
+    openssl_crypt(mode, key, key_len, iv, plain, expected, len, encrypt);
+
+    aes_engine_init(&ctx, mode, key, key_len, iv);
+    if (in_place) {
+        memcpy(got, plain, len);
+    }
+    while (done < len) {
+        size_t n = piece_len(mode, len - done);
+        const uint8_t *in = in_place ? got + done : plain + done;
+        if (!aes_engine_crypt(&ctx, in, got + done, n, encrypt)) {
+            printf("FAIL: %s rejected %zu bytes in round %d\n", mode_names[mode], n, round);
+            return 1;
+        }
+        done += n;
+    }
+    aes_engine_release(&ctx);
+
+    if (memcmp(got, expected, len) != 0) {
+        printf("FAIL: AES-%zu-%s %s%s of %zu bytes in round %d\n", key_len * 8, mode_names[mode],
+               encrypt ? "encryption" : "decryption", in_place ? " in place" : "", len, round);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_bad_lengths(void)
+{
+    uint8_t key[16] = {0};
+    uint8_t buf[AES_ENGINE_BLOCK_SIZE + 1] = {0};
+    aes_engine_ctx_t ctx;
+    int failures = 0;
+
+    for (aes_engine_mode_t mode = AES_ENGINE_ECB; mode <= AES_ENGINE_CBC; mode++) {
+        aes_engine_init(&ctx, mode, key, sizeof(key), NULL);
+        if (aes_engine_crypt(&ctx, buf, buf, sizeof(buf), true)) {
+            printf("FAIL: %s accepted a partial block\n", mode_names[mode]);
+            failures++;
+        }
+        aes_engine_release(&ctx);
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t key_lens[] = {16, 24, 32};
+    int rounds = argc > 1 ? atoi(argv[1]) : 300;
+    unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : (unsigned int)time(NULL);
+    uint8_t iv[AES_ENGINE_BLOCK_SIZE];
+    int failures = 0;
+
+    printf("%d rounds, seed %u\n", rounds, seed);
+    srand(seed);
+
+    failures += check_bad_lengths();
+
+    for (int round = 0; round < rounds; round++) {
+        for (aes_engine_mode_t mode = AES_ENGINE_ECB; mode <= AES_ENGINE_CTR; mode++) {
+            for (size_t k = 0; k < sizeof(key_lens) / sizeof(key_lens[0]); k++) {
+                fill_random(iv, sizeof(iv));
+                if (mode == AES_ENGINE_CTR && round % 4 == 0) {
+                    // Put the counter close to where its low 32 bits, or all 128, wrap around
+                    memset(iv + (round % 8 ? 12 : 0), 0xff, round % 8 ? 4 : 16);
+                    iv[15] = 0xff - rand() % 8;
+                }
+                for (int encrypt = 0; encrypt <= 1; encrypt++) {
+                    failures += check(round, mode, key_lens[k], iv, encrypt, rand() % 2);
+                }
+            }
+        }
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
@@ -0,0 +1,306 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# backup_stream_test.py - Check the v2 backup container in modules/backup_stream.py
+#
+# Runs on the unix port, which has no trezorcrypto. PBKDF2 and ChaCha20-Poly1305 are replaced
+# with SHA-256 stand-ins that keep their interfaces: the key depends on the password, salt and
+# iteration count, and the keystream and tag on the key and nonce, so a chunk read with the wrong
+# index or last-chunk flag fails its tag the same way it does on the device.
+#
+import sys
+import uhashlib
+import uio
+
+failures = 0
+
+
+def expect(what, got, expected):
+    global failures
+    if got != expected:
+        print('FAIL: {}: got {!r}, expected {!r}'.format(what, got, expected))
+        failures += 1
+
+
+def sha256(*parts):
+    h = uhashlib.sha256()
+    for p in parts:
+        h.update(p)
+    return h.digest()
+
+
+class FakePbkdf2:
+    HMAC_SHA256 = 256
+
+    def __init__(self, prf, password, salt):
+        self.password = password.encode() if isinstance(password, str) else password
+        self.salt = salt
+        self.iterations = 1
+
+    def update(self, n):
+        self.iterations += n
+
+    def key(self):
+        return sha256(self.password, self.salt, str(self.iterations).encode())
+
+
+class FakeChaCha20Poly1305:
+    def __init__(self, key, nonce):
+        self.key = key
+        self.nonce = nonce
+        self.offset = 0
+        self.mac = uhashlib.sha256()
+        self.mac.update(key)
+        self.mac.update(nonce)
+
+    def _xor(self, data):
+        out = bytearray(data)
+        for i in range(len(out)):
+            block, pos = divmod(self.offset + i, 32)
+            out[i] ^= sha256(self.key, self.nonce, str(block).encode())[pos]
+        self.offset += len(out)
+        return bytes(out)
+
+    def auth(self, data):
+        self.mac.update(b'a')
+        self.mac.update(data)
+
+    def encrypt(self, data):
+        ct = self._xor(data)
+        self.mac.update(ct)
+        return ct
+
+    def decrypt(self, data):
+        self.mac.update(data)
+        return self._xor(data)
+
+    def finish(self):
+        return self.mac.digest()[:16]
+
+
+class FakeTrezorcrypto:
+    pbkdf2 = FakePbkdf2
+    chacha20poly1305 = FakeChaCha20Poly1305
+
+
+class FakeNoise:
+    count = 0
+
+    def random_bytes(self, buf, source):
+        FakeNoise.count += 1
+        digest = sha256(b'salt', str(FakeNoise.count).encode())
+        for i in range(len(buf)):
+            buf[i] = digest[i]
+
+
+class FakeCommon:
+    noise = FakeNoise()
+
+
+class FakeNoiseSource:
+    class NoiseSource:
+        ALL = 0
+
+
+class FakeStash:
+    @staticmethod
+    def blank_object(obj):
+        pass
+
+
+sys.modules['trezorcrypto'] = FakeTrezorcrypto
+sys.modules['common'] = FakeCommon
+sys.modules['noise_source'] = FakeNoiseSource
+sys.modules['stash'] = FakeStash
+
+import backup_stream
+from backup_stream import AuthError, HEADER_LEN, TAG_LEN
+
+PASSWORD = 'correct horse'
+CHUNK = 64
+ITERATIONS = 10000
+START = HEADER_LEN + TAG_LEN
+
+
+def write(data, chunk_size=CHUNK):
+    fd = uio.BytesIO()
+    w = backup_stream.Writer(fd, PASSWORD, chunk_size=chunk_size, iterations=ITERATIONS)
+    # Written in uneven pieces, so chunks are split across writes
+    for i in range(0, len(data), 37):
+        w.write(data[i:i + 37])
+    w.close()
+    return fd.getvalue()
+
+
+def read(image, password=PASSWORD):
+    # Returns the plaintext, or the error raised reading it
+    r = None
+    try:
+        r = backup_stream.Reader(uio.BytesIO(image), password)
+        return b''.join(r.chunks())
+    except ValueError as e:
+        return type(e)
+    finally:
+        if r:
+            r.close()
+
+
+def chunk_at(image, index, chunk_size=CHUNK):
+    start = START + index * (chunk_size + TAG_LEN)
+    return start, start + chunk_size + TAG_LEN
+
+
+def chunk(image, index):
+    start, end = chunk_at(image, index)
+    return image[start:end]
+
+
+def seal(key, index, pt, kind):
+    c = backup_stream.make_cipher(key, index, kind)
+    return c.encrypt(pt) + c.finish()
+
+
+def make_data(n):
+    return bytes((i * 7 + i // 251) & 0xff for i in range(n))
+
+
+def test_round_trip():
+    for n in (0, 1, CHUNK - 1, CHUNK, CHUNK + 1, 3 * CHUNK, 5 * CHUNK + 17):
+        data = make_data(n)
+        image = write(data)
+        what = 'round trip {} bytes'.format(n)
+        expect(what, read(image), data)
+        # Every chunk is full except the last, which is always short, even if empty
+        chunks = n // CHUNK + 1
+        expect(what + ': size', len(image), START + n + chunks * TAG_LEN)
+        expect(what + ': structure', backup_stream.check_structure(uio.BytesIO(image)), chunks)
+        expect(what + ': is_v2', backup_stream.is_v2(uio.BytesIO(image)), True)
+
+    # Text is written as UTF-8, and the data is encrypted
+    image = write('words go here ' * 10)
+    expect('text', read(image), b'words go here ' * 10)
+    expect('encrypted', image.find(b'words'), -1)
+
+    # The default chunk size
+    data = make_data(2500)
+    expect('default chunk size', read(write(data, backup_stream.CHUNK_SIZE)), data)
+
+
+def test_password():
+    image = write(make_data(100))
+    expect('wrong password', read(image, 'wrong horse'), AuthError)
+
+
+def test_truncated():
+    data = make_data(3 * CHUNK + 10)
+    image = write(data)
+
+    # Cut where a chunk ends: every chunk left is full, so none has the last-chunk flag
+    for chunks in (1, 2, 3):
+        cut = image[:chunk_at(image, chunks)[0]]
+        expect('cut after {} chunks'.format(chunks), read(cut), AuthError)
+        try:
+            backup_stream.check_structure(uio.BytesIO(cut))
+            expect('cut after {} chunks: structure'.format(chunks), 'ok', ValueError)
+        except ValueError:
+            pass
+
+    # Cut part way into a chunk: what's left is short, so it's read as the last chunk, but it
+    # wasn't written with the last-chunk flag
+    for cut in (START + 1, START + CHUNK, START + CHUNK + TAG_LEN + 20, len(image) - 1):
+        expect('cut at {}'.format(cut), read(image[:cut]), AuthError)
+
+    # A short chunk at the end that wasn't sealed as the last one, as when a writer is cut off
+    # part way through a chunk, and a full chunk sealed as the last one followed by more
+    hdr = image[:START]
+    key = backup_stream.derive_key(PASSWORD, hdr[HEADER_LEN - 16:HEADER_LEN], ITERATIONS)
+    last = len(data) // CHUNK
+    before_last = image[:chunk_at(image, last)[0]]
+    tail = data[last * CHUNK:]
+    expect('unflagged last chunk',
+           read(before_last + seal(key, last, tail, backup_stream.NONCE_CHUNK)), AuthError)
+    expect('flagged last chunk',
+           read(before_last + seal(key, last, tail, backup_stream.NONCE_LAST_CHUNK)), data)
+    after_first = image[chunk_at(image, 1)[0]:]
+    expect('flagged full chunk',
+           read(hdr + seal(key, 0, data[:CHUNK], backup_stream.NONCE_LAST_CHUNK) + after_first), AuthError)
+
+    # A file with only the empty last chunk, cut off
+    image = write(b'')
+    expect('empty: cut', read(image[:START]), AuthError)
+    expect('empty: header only', read(image[:HEADER_LEN]), ValueError)
+
+
+def test_changed():
+    data = make_data(3 * CHUNK + 10)
+    image = write(data)
+
+    # One flipped bit anywhere fails, whether in the header, its tag, a chunk or a chunk's tag
+    for pos in (5, HEADER_LEN - 1, HEADER_LEN, START, START + CHUNK - 1, START + CHUNK,
+                chunk_at(image, 2)[0] + 3, len(image) - TAG_LEN - 1, len(image) - 1):
+        changed = bytearray(image)
+        changed[pos] ^= 0x01
+        got = read(bytes(changed))
+        expect('flipped byte at {}'.format(pos), got == AuthError or got == ValueError, True)
+
+    # Changes past the header are always an authentication failure
+    for pos in range(START, len(image), 29):
+        changed = bytearray(image)
+        changed[pos] ^= 0x80
+        expect('flipped byte at {}'.format(pos), read(bytes(changed)), AuthError)
+
+
+def test_reordered():
+    data = make_data(3 * CHUNK + 10)
+    image = write(data)
+    c0 = chunk(image, 0)
+    c1 = chunk(image, 1)
+    c2 = chunk(image, 2)
+    last = image[chunk_at(image, 3)[0]:]
+    hdr = image[:START]
+
+    expect('in order', read(hdr + c0 + c1 + c2 + last), data)
+    expect('swapped', read(hdr + c1 + c0 + c2 + last), AuthError)
+    expect('dropped', read(hdr + c0 + c2 + last), AuthError)
+    expect('repeated', read(hdr + c0 + c0 + c1 + c2 + last), AuthError)
+
+    # The last chunk moved up, with the chunks after it dropped
+    expect('last moved up', read(hdr + c0 + last), AuthError)
+
+    # Chunks from another backup with the same password don't fit, as the salt differs
+    other = write(data)
+    expect('other backup', read(hdr + c0 + chunk(other, 1) + c2 + last), AuthError)
+
+
+def test_header():
+    image = bytearray(write(b'x'))
+    expect('not v2', backup_stream.is_v2(uio.BytesIO(b'ABCD' + image[4:])), False)
+
+    def with_field(offset, value):
+        changed = bytearray(image)
+        changed[offset:offset + len(value)] = value
+        return bytes(changed)
+
+    # Fields the reader refuses before deriving the key. Offsets follow HEADER_FMT.
+    for what, changed in (('version', with_field(4, b'\x03')),
+                          ('flags', with_field(5, b'\x01')),
+                          ('chunk size 0', with_field(6, b'\x00\x00')),
+                          ('chunk size not a multiple of 64', with_field(6, b'\x41\x00')),
+                          ('chunk size too big', with_field(6, b'\x40\x10')),
+                          ('iterations 0', with_field(8, b'\x00\x00\x00\x00')),
+                          ('iterations too many', with_field(8, b'\x01\x00\x10\x00'))):
+        expect('header: ' + what, read(changed), ValueError)
+
+
+test_round_trip()
+test_password()
+test_truncated()
+test_changed()
+test_reordered()
+test_header()
+
+if failures:
+    print('{} failed'.format(failures))
+    sys.exit(1)
+
+print('All passed')
@@ -0,0 +1,269 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: BSD-3-Clause
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "camera-ovm7690.h"
+
+struct reg {
+    uint8_t addr;
+    uint8_t val;
+};
+
+// The sequence camera_setQVGA() used to write, one register at a time, straight after the
+// sensor was reset
+static const struct reg reference[] = {
+    {0x0E, 0x00}, /* No sleep and full range (default)  */
+    {0x0C, 0x06}, /* External sync */
+    {0x81, 0xFF}, /* SDE, UV, vscale, hscale, uvavg, color matrix */
+    {0x21, 0x44}, /* AECGM banding max */
+    {0x16, 0x03}, /* Setting reserved bits?? */
+    {0x39, 0x80}, /* Setting reserved bits?? */
+    {0x1E, 0xB1}, /* Setting reserved bits?? */
+
+    /* Format */
+    {0x12, 0x06}, /* Output format control: RGB565      */
+    {0x82, 0x03}, /* YUV422? */
+    {0xD0, 0x48}, /* voffset/hoffset (default) */
+    {0x80, 0x7F}, /* color interp, bp corr, wp corr, gamma, awb gain, awb, lens corr */
+    {0x3E, 0x30}, /* reserved bit?? and PLCK YUV */
+    {0x22, 0x00}, /* optical black output disable (default) */
+
+    /* Resolution */
+    {0x17, 0x69}, /* Horizontal window start point      */
+    {0x18, 0xA4}, /* Horizontal senzor size             */
+    {0x19, 0x0C}, /* Vertical Window start line         */
+    {0x1A, 0xF6}, /* Vertical sensor size               */
+
+    {0xC8, 0x02}, /* H input size MSBs (default) */
+    {0xC9, 0x80}, /* H input size LSBs (default) */
+    {0xCA, 0x01}, /* V input size MSBs (default) */
+    {0xCB, 0xE0}, /* V input size LSBs (default) */
+    {0xCC, 0x02}, /* H output size MSBs (default) */
+    {0xCD, 0x80}, /* H output size LSBs (default) */
+    {0xCE, 0x01}, /* V output size MSBs (default) */
+    {0xCF, 0xE0}, /* V output size LSBs (default) */
+
+    /* Lens Correction */
+    {0x85, 0x90}, /* reserved bit?? and LENC bias enable */
+    {0x86, 0x00}, /* no compensation radius (default) */
+    {0x87, 0x00}, /* LENSC X coord (default) */
+    {0x88, 0x10}, /* LENSC Y coord */
+    {0x89, 0x30}, /* R compensation coefficient */
+    {0x8A, 0x29}, /* G compensation coefficient */
+    {0x8B, 0x26}, /* B compensation coefficient */
+
+    /* Color Matrix */
+    {0xBB, 0x80}, /* color matrix coefficient 1 */
+    {0xBC, 0x62}, /* color matrix coefficient 2 */
+    {0xBD, 0x1E}, /* color matrix coefficient 3 */
+    {0xBE, 0x26}, /* color matrix coefficient 4 */
+    {0xBF, 0x7B}, /* color matrix coefficient 5 */
+    {0xC0, 0xAC}, /* color matrix coefficient 6 */
+    {0xC1, 0x1E}, /* M sign (default) */
+
+    /* Edge + Denoise */
+    {0xB7, 0x05}, /* offset */
+    {0xB8, 0x09}, /* base 1 */
+    {0xB9, 0x00}, /* base 2 */
+    {0xBA, 0x18}, /* gain 4x limited to 16 and DNS_th_sel */
+
+    /* UVAdjust */
+    {0x5A, 0x4A}, /* slope of UV curve */
+    {0x5B, 0x9F}, /* UV adjust */
+    {0x5C, 0x48}, /* UV adjust */
+    {0x5D, 0x32}, /* UV adjust */
+
+    /* AEC/AGC target */
+    {0x24, 0x78}, /* stable operation up limit (default) */
+    {0x25, 0x68}, /* stable operation lower limit (default) */
+    {0x26, 0xB3}, /* fast mode operating region */
+
+    /* Gamma */
+    {0xA3, 0x0B}, /* gamma curve 1st segment */
+    {0xA4, 0x15}, /* gamma curve 2nd segment */
+    {0xA5, 0x2A}, /* gamma curve 3rd segment */
+    {0xA6, 0x51}, /* gamma curve 4th segment */
+    {0xA7, 0x63}, /* gamma curve 5th segment */
+    {0xA8, 0x74}, /* gamma curve 6th segment */
+    {0xA9, 0x83}, /* gamma curve 7th segment */
+    {0xAA, 0x91}, /* gamma curve 8th segment */
+    {0xAB, 0x9E}, /* gamma curve 9th segment */
+    {0xAC, 0xAA}, /* gamma curve 10th segment */
+    {0xAD, 0xBE}, /* gamma curve 11th segment */
+    {0xAE, 0xCE}, /* gamma curve 12th segment */
+    {0xAF, 0xE5}, /* gamma curve 13th segment */
+    {0xB0, 0xF3}, /* gamma curve 14th segment */
+    {0xB1, 0xFB}, /* gamma curve 15th segment */
+    {0xB2, 0x06}, /* gamma curve highest segment slope */
+
+    /* Advance (AWB Control Registers) */
+    {0x8C, 0x5D},
+    {0x8D, 0x11},
+    {0x8E, 0x12},
+    {0x8F, 0x11},
+    {0x90, 0x50},
+    {0x91, 0x22},
+    {0x92, 0xD1},
+    {0x93, 0xA7},
+    {0x94, 0x23},
+    {0x95, 0x3B},
+    {0x96, 0xFF},
+    {0x97, 0x00},
+    {0x98, 0x4A},
+    {0x99, 0x46},
+    {0x9A, 0x3D},
+    {0x9B, 0x3A},
+    {0x9C, 0xF0},
+    {0x9D, 0xF0},
+    {0x9E, 0xF0},
+    {0x9F, 0xFF},
+    {0xA0, 0x56},
+    {0xA1, 0x55},
+    {0xA2, 0x13},
+
+    /* General Control */
+    {0x50, 0x9A}, /* 50 Hz banding AEC (default) */
+    {0x51, 0x80}, /* 60 Hz banding AEC (default) */
+    {0x21, 0x23}, /* AECGM banding max (overrides above) */
+
+    {0x14, 0x29}, /* Max AGC 8x */
+    {0x13, 0xE7}, /* fast AGC/AEC, AEC step unlimited, banding filter, AEC below banding, AGC auto, AWB auto, exp auto */
+    {0x11, 0x40}, /* external clock or internal clock prescalar */
+
+    {0x0E, 0x00}, /* already specified above */
+
+    {0xC8, 0x02},
+    {0xC9, 0x40}, /* Input Horiz 576 */
+    {0xCA, 0x01},
+    {0xCB, 0xE0}, /* Input Vert 480 */
+    {0xCC, 0x01},
+    {0xCD, 0x8C}, /* Output Horiz 396 */
+    {0xCE, 0x01},
+    {0xCF, 0x4A} /* Output Vert 330 */
+};
+#define NUM_REFERENCE (sizeof(reference) / sizeof(reference[0]))
+
+// Reset values of the registers the settings table leaves alone, from the "(default)" notes on
+// the reference sequence
+static const struct reg defaults[] = {
+    {0x0E, 0x00}, {0x22, 0x00}, {0x24, 0x78}, {0x25, 0x68}, {0x50, 0x9A}, {0x51, 0x80},
+    {0x86, 0x00}, {0x87, 0x00}, {0xC1, 0x1E}, {0xC8, 0x02}, {0xC9, 0x80}, {0xCA, 0x01},
+    {0xCB, 0xE0}, {0xCC, 0x02}, {0xCD, 0x80}, {0xCE, 0x01}, {0xCF, 0xE0}, {0xD0, 0x48},
+};
+
+// A simulated sensor, and a recording of every transaction made with it
+typedef struct {
+    uint8_t regs[256];
+    int writes[256];                // How many times each register was written
+    int order[256];                 // Index of the transaction that last wrote each register
+    int num_transactions;
+    size_t longest;
+} sensor_t;
+
+static sensor_t sensor;
+static bool auto_increment;
+
+static void sensor_reset(sensor_t *s)
+{
+    memset(s, 0, sizeof(*s));
+
+    // Registers without a known reset value get a pattern that no setting is likely to match
+    for (int i = 0; i < 256; i++) {
+        s->regs[i] = 0xA5 ^ i;
+    }
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+        s->regs[defaults[i].addr] = defaults[i].val;
+    }
+}
+
+static void sensor_write(sensor_t *s, uint8_t reg, uint8_t val)
+{
+    s->regs[reg] = val;
+    s->writes[reg]++;
+    s->order[reg] = s->num_transactions;
+}
+
+static int recorder(uint8_t reg, const uint8_t *vals, size_t len)
+{
+    if (len > 1 && !auto_increment) {
+        printf("FAIL: %zu byte burst at 0x%02X with bursts off\n", len, reg);
+        return -1;
+    }
+    if (len == 0 || len > CAMERA_MAX_BURST || reg + len > 256) {
+        printf("FAIL: bad burst of %zu bytes at 0x%02X\n", len, reg);
+        return -1;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        sensor_write(&sensor, reg + i, vals[i]);
+    }
+    sensor.num_transactions++;
+    if (len > sensor.longest) {
+        sensor.longest = len;
+    }
+    return 0;
+}
+
+static int check(bool burst)
+{
+    sensor_t expected;
+    int failures = 0;
+
+    sensor_reset(&expected);
+    for (size_t i = 0; i < NUM_REFERENCE; i++) {
+        sensor_write(&expected, reference[i].addr, reference[i].val);
+        expected.num_transactions++;
+    }
+
+    sensor_reset(&sensor);
+    auto_increment = burst;
+    if (camera_write_init_regs(recorder, burst) < 0) {
+        printf("FAIL: camera_write_init_regs() failed\n");
+        return 1;
+    }
+
+    // Same end state
+    for (int i = 0; i < 256; i++) {
+        if (sensor.regs[i] != expected.regs[i]) {
+            printf("FAIL: register 0x%02X is 0x%02X, expected 0x%02X\n", i, sensor.regs[i], expected.regs[i]);
+            failures++;
+        }
+        if (sensor.writes[i] > 1) {
+            printf("FAIL: register 0x%02X written %d times\n", i, sensor.writes[i]);
+            failures++;
+        }
+    }
+
+    // Registers are set in the same order as the reference's last write to each, so settings
+    // that depend on one another take effect in the same sequence
+    for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+            if (!sensor.writes[a] || !sensor.writes[b] || a == b) {
+                continue;
+            }
+            if (sensor.order[a] < sensor.order[b] && expected.order[a] > expected.order[b]) {
+                printf("FAIL: 0x%02X is set before 0x%02X\n", a, b);
+                failures++;
+            }
+        }
+    }
+
+    printf("%s: %d transactions (was %d), longest %zu bytes\n",
+           burst ? "burst" : "single", sensor.num_transactions, expected.num_transactions, sensor.longest);
+    return failures;
+}
+
+int main(void)
+{
+    int failures = check(false) + check(true);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
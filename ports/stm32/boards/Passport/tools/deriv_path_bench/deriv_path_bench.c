@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deriv_path.h"
+
+#define MAX_DEPTH 12
+#define H DERIV_PATH_HARDENED
+
+typedef struct {
+    const char* path;
+    uint8_t flags;
+    deriv_path_err_t err;
+    size_t depth;
+    uint32_t components[4];
+    uint8_t star;
+} test_case_t;
+
+static const test_case_t test_cases[] = {
+    // Same results as the old regex-based cleanup_deriv_path()
+    {"", DERIV_PATH_STRICT, DERIV_PATH_OK, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m", DERIV_PATH_STRICT, DERIV_PATH_OK, 0, {0}, DERIV_PATH_NO_STAR},
+    {"M", DERIV_PATH_STRICT, DERIV_PATH_OK, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/84'/0'/0'", DERIV_PATH_STRICT, DERIV_PATH_OK, 3, {84 | H, 0 | H, 0 | H}, DERIV_PATH_NO_STAR},
+    {"84h/1H/2p/3", DERIV_PATH_STRICT, DERIV_PATH_OK, 4, {84 | H, 1 | H, 2 | H, 3}, DERIV_PATH_NO_STAR},
+    {"m/2147483647'", DERIV_PATH_STRICT, DERIV_PATH_OK, 1, {0x7fffffff | H}, DERIV_PATH_NO_STAR},
+    {"m/2147483648", DERIV_PATH_STRICT, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/99999999999", DERIV_PATH_STRICT, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/", DERIV_PATH_STRICT, DERIV_PATH_ERR_EMPTY, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m//1", DERIV_PATH_STRICT, DERIV_PATH_ERR_EMPTY, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/'", DERIV_PATH_STRICT, DERIV_PATH_ERR_EMPTY, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/1''", DERIV_PATH_STRICT, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/01", DERIV_PATH_STRICT, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m12", DERIV_PATH_STRICT, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/1/x", DERIV_PATH_STRICT, DERIV_PATH_ERR_CHARS, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/m/1", DERIV_PATH_STRICT, DERIV_PATH_ERR_CHARS, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/1/*", DERIV_PATH_STRICT, DERIV_PATH_ERR_CHARS, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/1/2/3/4/5/6/7/8/9/10/11/12/13", DERIV_PATH_STRICT, DERIV_PATH_ERR_DEPTH, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/1/*", DERIV_PATH_STRICT | DERIV_PATH_ALLOW_STAR, DERIV_PATH_OK, 1, {1}, DERIV_PATH_STAR},
+    {"m/1'/*h", DERIV_PATH_STRICT | DERIV_PATH_ALLOW_STAR, DERIV_PATH_OK, 1, {1 | H}, DERIV_PATH_STAR_HARDENED},
+    {"*", DERIV_PATH_STRICT | DERIV_PATH_ALLOW_STAR, DERIV_PATH_OK, 0, {0}, DERIV_PATH_STAR},
+    {"m/1*", DERIV_PATH_STRICT | DERIV_PATH_ALLOW_STAR, DERIV_PATH_ERR_WILDCARD, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/*/1", DERIV_PATH_STRICT | DERIV_PATH_ALLOW_STAR, DERIV_PATH_ERR_CHARS, 0, {0}, DERIV_PATH_NO_STAR},
+
+    // Same results as the old str.split('/') and int() in derive_path()
+    {"84'/0'/0'/", 0, DERIV_PATH_OK, 3, {84 | H, 0 | H, 0 | H}, DERIV_PATH_NO_STAR},
+    {"/m//1//007", 0, DERIV_PATH_ERR_CHARS, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m//1//007", 0, DERIV_PATH_OK, 2, {1, 7}, DERIV_PATH_NO_STAR},
+    {"m/'", 0, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+    {"m/2147483648'", 0, DERIV_PATH_ERR_COMPONENT, 0, {0}, DERIV_PATH_NO_STAR},
+};
+
+static int check(void)
+{
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        const test_case_t* tc = &test_cases[i];
+        uint32_t out[MAX_DEPTH];
+        size_t depth = 0;
+        uint8_t star = 0;
+
+        deriv_path_err_t err = deriv_path_parse(tc->path, strlen(tc->path), tc->flags, out, MAX_DEPTH, &depth, &star);
+        int ok = err == tc->err;
+        if (ok && err == DERIV_PATH_OK) {
+            ok = depth == tc->depth && star == tc->star && memcmp(out, tc->components, depth * sizeof(uint32_t)) == 0;
+        }
+        if (!ok) {
+            printf("FAIL: \"%s\" flags=%d: got %s, expected %s\n",
+                   tc->path, tc->flags, deriv_path_err_str(err), deriv_path_err_str(tc->err));
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+// Typical paths seen when signing and exporting
+static const char* bench_paths[] = {
+    "m/84'/0'/0'",
+    "m/84'/0'/0'/0/17",
+    "m/49'/0'/0'/1/3",
+    "m/48'/0'/0'/2'",
+    "m/44'/1'/0'/0/1234",
+};
+
+int main(int argc, char** argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t num_paths = sizeof(bench_paths) / sizeof(bench_paths[0]);
+    size_t lens[sizeof(bench_paths) / sizeof(bench_paths[0])];
+    uint32_t out[MAX_DEPTH];
+    size_t depth;
+    uint8_t star;
+    volatile uint32_t sink = 0;
+
+    int failures = check();
+    printf("%d failures\n", failures);
+    if (failures) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < num_paths; i++) {
+        lens[i] = strlen(bench_paths[i]);
+    }
+
+    for (int strict = 0; strict <= 1; strict++) {
+        clock_t start = clock();
+        for (long n = 0; n < iterations; n++) {
+            size_t i = n % num_paths;
+            deriv_path_parse(bench_paths[i], lens[i], strict ? DERIV_PATH_STRICT : 0, out, MAX_DEPTH, &depth, &star);
+            sink += out[depth - 1];
+        }
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("%-8s %ld paths in %.3fs: %.0f paths/s\n", strict ? "strict" : "lenient", iterations, secs,
+               secs > 0 ? iterations / secs : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+#include "hash_engine.h"
+
+#define MAX_MSG_LEN 5000
+#define MAX_KEY_LEN 200
+#define NUM_STREAMS 3
+
+static uint8_t msgs[NUM_STREAMS][MAX_MSG_LEN];
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand();
+    }
+}
+
+static void print_hex(const char *label, const uint8_t *buf, size_t len)
+{
+    printf("  %s: ", label);
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", buf[i]);
+    }
+    printf("\n");
+}
+
+static int compare(const char *what, int round, const uint8_t *got, const uint8_t *expected)
+{
+    if (memcmp(got, expected, HASH_ENGINE_SHA256_DIGEST_LENGTH) == 0) {
+        return 0;
+    }
+    printf("FAIL: %s in round %d\n", what, round);
+    print_hex("got     ", got, HASH_ENGINE_SHA256_DIGEST_LENGTH);
+    print_hex("expected", expected, HASH_ENGINE_SHA256_DIGEST_LENGTH);
+    return 1;
+}
+
+// Short pieces most of the time, so the partial word handling gets a workout
+static size_t piece_len(size_t remaining)
+{
+    size_t n = (rand() % 4 == 0) ? (size_t)(rand() % 300) : (size_t)(rand() % 9);
+    return n > remaining ? remaining : n;
+}
+
+static int check_interleaved(int round)
+{
+    hash_engine_ctx_t ctx[NUM_STREAMS];
+    size_t len[NUM_STREAMS];
+    size_t done[NUM_STREAMS];
+    size_t copy_at[NUM_STREAMS];
+    uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+    uint8_t expected[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+    int failures = 0;
+
+    for (int i = 0; i < NUM_STREAMS; i++) {
+        len[i] = rand() % (MAX_MSG_LEN + 1);
+        fill_random(msgs[i], len[i]);
+        done[i] = 0;
+        copy_at[i] = len[i] ? rand() % len[i] : 0;
+        hash_engine_sha256_init(&ctx[i]);
+    }
+
+    while (1) {
+        int live = 0;
+        for (int i = 0; i < NUM_STREAMS; i++) {
+            live += done[i] < len[i];
+        }
+        if (live == 0) {
+            break;
+        }
+
+        int i = rand() % NUM_STREAMS;
+        if (done[i] == len[i]) {
+            continue;
+        }
+
+        size_t n = piece_len(len[i] - done[i]);
+        if (done[i] <= copy_at[i] && copy_at[i] < done[i] + n) {
+            n = copy_at[i] - done[i];
+        }
+        hash_engine_sha256_update(&ctx[i], msgs[i] + done[i], n);
+        done[i] += n;
+
+        // Take a digest of what's there so far and carry on with the original
+        if (done[i] == copy_at[i]) {
+            hash_engine_ctx_t copy;
+            hash_engine_sha256_copy(&copy, &ctx[i]);
+            hash_engine_sha256_final(&copy, digest);
+            SHA256(msgs[i], done[i], expected);
+            failures += compare("digest of a copy", round, digest, expected);
+            copy_at[i] = (size_t)-1;
+        }
+    }
+
+    for (int i = 0; i < NUM_STREAMS; i++) {
+        hash_engine_sha256_final(&ctx[i], digest);
+        SHA256(msgs[i], len[i], expected);
+        failures += compare("interleaved digest", round, digest, expected);
+    }
+
+    return failures;
+}
+
+static int check_one_shot(int round)
+{
+    size_t len = rand() % (MAX_MSG_LEN + 1);
+    uint8_t digest[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+    uint8_t expected[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+
+    fill_random(msgs[0], len);
+    hash_engine_sha256(msgs[0], len, digest);
+    SHA256(msgs[0], len, expected);
+    return compare("one-shot digest", round, digest, expected);
+}
+
+static int check_hmac(int round)
+{
+    uint8_t key[MAX_KEY_LEN];
+    size_t key_len = rand() % (MAX_KEY_LEN + 1);
+    size_t msg_len = rand() % (MAX_MSG_LEN + 1);
+    uint8_t hmac[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+    uint8_t expected[HASH_ENGINE_SHA256_DIGEST_LENGTH];
+    unsigned int expected_len;
+
+    fill_random(key, key_len);
+    fill_random(msgs[0], msg_len);
+    hash_engine_hmac_sha256(key, key_len, msgs[0], msg_len, hmac);
+    HMAC(EVP_sha256(), key, key_len, msgs[0], msg_len, expected, &expected_len);
+    return compare("hmac", round, hmac, expected);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : (unsigned int)time(NULL);
+    int failures = 0;
+
+    printf("%d rounds, seed %u\n", rounds, seed);
+    srand(seed);
+
+    for (int round = 0; round < rounds; round++) {
+        failures += check_one_shot(round);
+        failures += check_interleaved(round);
+        failures += check_hmac(round);
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# log_reader.py - Print the compact binary log (log.bin) written by modules/log.py as text
+#
+# Usage: log_reader.py [--min-level LEVEL] log.bin
+#
+# Each record is: 0xA5, level (u8), ticks_ms (u32 LE), length (u16 LE), message (UTF-8).
+# Bytes that don't start a record (e.g. a write cut short by power loss) are skipped until the
+# next record marker.
+#
+import argparse
+import struct
+import sys
+
+RECORD_MAGIC = 0xA5
+HEADER_FORMAT = '<BBIH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+LEVELS = {'DEBUG': 10, 'INFO': 20, 'WARN': 30, 'ERROR': 40}
+LEVEL_NAMES = {v: k for k, v in LEVELS.items()}
+
+
+def read_records(data):
+    pos = 0
+    skipped = 0
+    while pos + HEADER_SIZE <= len(data):
+        magic, level, ticks, length = struct.unpack_from(HEADER_FORMAT, data, pos)
+        if magic != RECORD_MAGIC or pos + HEADER_SIZE + length > len(data):
+            pos += 1
+            skipped += 1
+            continue
+        msg = data[pos + HEADER_SIZE:pos + HEADER_SIZE + length].decode('utf-8', errors='replace')
+        yield level, ticks, msg
+        pos += HEADER_SIZE + length
+    skipped += len(data) - pos
+    if skipped:
+        print('log_reader: skipped {} bytes that were not records'.format(skipped), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Print a Passport binary log as text')
+    parser.add_argument('--min-level', choices=LEVELS.keys(), default='DEBUG', help='hide records below this level')
+    parser.add_argument('file', help='log.bin copied from the microSD card')
+    args = parser.parse_args()
+
+    with open(args.file, 'rb') as f:
+        data = f.read()
+
+    min_level = LEVELS[args.min_level]
+    for level, ticks, msg in read_records(data):
+        if level >= min_level:
+            # Same layout as the text log.log
+            print('{:>10} {:<5} {}'.format(ticks, LEVEL_NAMES.get(level, str(level)), msg))
+
+
+if __name__ == '__main__':
+    main()
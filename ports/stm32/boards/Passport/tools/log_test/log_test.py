@@ -0,0 +1,195 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# log_test.py - Check the buffered logger in modules/log.py and how it shares the card
+#
+# Runs on the unix port. The logger writes to a list instead of the card, with a fake clock,
+# and CardSlot from modules/files.py runs against a fake pyb.SDCard that records power changes.
+#
+import sys
+import utime
+
+failures = 0
+
+
+def expect(what, got, expected):
+    global failures
+    if got != expected:
+        print('FAIL: {}: got {!r}, expected {!r}'.format(what, got, expected))
+        failures += 1
+
+
+class FakeSDCard:
+    powered = True
+    power_offs = 0
+
+    def power(self, on):
+        FakeSDCard.powered = bool(on)
+        if not on:
+            FakeSDCard.power_offs += 1
+
+
+class FakePyb:
+    SDCard = FakeSDCard
+
+
+sys.modules['pyb'] = FakePyb
+
+import files
+import log
+
+files._try_microsd = lambda: True
+files.CardSlot.last_change = utime.ticks_ms() - 1000
+
+
+class FakeClock:
+    def __init__(self):
+        self.now = 1000
+
+    def __call__(self):
+        return self.now
+
+
+class ListSink:
+    def __init__(self):
+        self.writes = []
+        self.fail = False
+
+    def __call__(self, filename, data):
+        if self.fail:
+            raise OSError(5)
+        self.writes.append((filename, bytes(data)))
+
+
+def make(buf_size=256, binary=False, min_level=log.INFO, sink_busy=lambda: False):
+    clock = FakeClock()
+    sink = ListSink()
+    logger = log.Logger(sink=sink, clock=clock, buf_size=buf_size, min_level=min_level,
+                        binary=binary, echo=False, sink_busy=sink_busy)
+    return clock, sink, logger
+
+
+def test_buffering():
+    clock, sink, logger = make()
+    logger.info('one')
+    clock.now += 5
+    logger.warn('two')
+    logger.debug('below the minimum level')
+    expect('buffering: nothing written yet', sink.writes, [])
+    expect('buffering: pending', logger.pending(), 2 * log.HEADER_SIZE + 6)
+
+    expect('buffering: flush', logger.flush(), True)
+    expect('buffering: one batch', sink.writes,
+           [(log.TEXT_FILENAME, b'      1000 INFO  one\n      1005 WARN  two\n')])
+    expect('buffering: empty after flush', logger.pending(), 0)
+
+    # Nothing to write, so nothing is written
+    expect('buffering: empty flush', logger.flush(), True)
+    expect('buffering: still one batch', len(sink.writes), 1)
+    expect('buffering: flushes', logger.stats()['flushes'], 1)
+
+
+def test_error_flushes():
+    clock, sink, logger = make()
+    logger.info('before')
+    logger.error('bad')
+    expect('error: written at once', sink.writes,
+           [(log.TEXT_FILENAME, b'      1000 INFO  before\n      1000 ERROR bad\n')])
+
+
+def test_binary():
+    clock, sink, logger = make(binary=True)
+    logger.info('hi')
+    logger.flush()
+    expect('binary: record', sink.writes, [(log.BINARY_FILENAME, b'\xa5\x14\xe8\x03\x00\x00\x02\x00hi')])
+
+
+def test_overflow():
+    # Each record is 8 bytes of header and 8 of message, so 64 bytes hold 4 of them
+    clock, sink, logger = make(buf_size=64)
+    for i in range(6):
+        logger.info('record %d' % i)
+    expect('overflow: dropped', logger.stats()['dropped'], 2)
+    logger.flush()
+    expect('overflow: oldest dropped, and said so', sink.writes[0][1].split(b'\n'),
+           [b'      1000 WARN  2 log records dropped', b'      1000 INFO  record 2',
+            b'      1000 INFO  record 3', b'      1000 INFO  record 4',
+            b'      1000 INFO  record 5', b''])
+
+    # Records wrap around the end of the ring
+    for i in range(3):
+        logger.info('again %d' % i)
+    logger.flush()
+    expect('overflow: wrapped', sink.writes[1][1],
+           b'      1000 INFO  again 0\n      1000 INFO  again 1\n      1000 INFO  again 2\n')
+
+
+def test_sink_error():
+    # No card: the records are kept for next time
+    clock, sink, logger = make()
+    sink.fail = True
+    logger.info('kept')
+    expect('sink error: flush fails', logger.flush(), False)
+    expect('sink error: counted', logger.stats()['flush_errors'], 1)
+    expect('sink error: still pending', logger.pending(), log.HEADER_SIZE + 4)
+    sink.fail = False
+    expect('sink error: retried', logger.flush(), True)
+    expect('sink error: written', sink.writes, [(log.TEXT_FILENAME, b'      1000 INFO  kept\n')])
+
+
+def test_card_in_use():
+    # The default check looks at CardSlot, so a flush waits while another task is using the card
+    clock, sink, logger = make(sink_busy=log._card_in_use)
+    logger.info('waiting')
+    with files.CardSlot():
+        expect('card: in use', files.CardSlot.in_use(), True)
+        expect('card: flush deferred', logger.flush(), False)
+        expect('card: nothing written', sink.writes, [])
+        logger.error('even errors wait')
+        expect('card: error deferred', sink.writes, [])
+    expect('card: free', files.CardSlot.in_use(), False)
+    expect('card: deferrals', logger.stats()['flush_deferred'], 2)
+    expect('card: flushed after', logger.flush(), True)
+    expect('card: both records', len(sink.writes[0][1].split(b'\n')), 3)
+
+
+def test_card_slot_nesting():
+    # The card stays powered until the last CardSlot exits
+    offs = FakeSDCard.power_offs
+    outer = files.CardSlot()
+    outer.__enter__()
+    with files.CardSlot() as inner:
+        expect('nesting: count', files.CardSlot.num_active, 2)
+    expect('nesting: inner inactive', inner.active, False)
+    expect('nesting: still powered', FakeSDCard.power_offs, offs)
+    expect('nesting: outer still active', outer.active, True)
+    outer.__exit__(None, None, None)
+    expect('nesting: count after', files.CardSlot.num_active, 0)
+    expect('nesting: powered off at the end', FakeSDCard.power_offs, offs + 1)
+
+    # A card that can't be used doesn't upset the count, or power off the card under a user
+    with files.CardSlot():
+        files._try_microsd = lambda: False
+        try:
+            with files.CardSlot():
+                pass
+        except files.CardMissingError:
+            pass
+        expect('nesting: missing card left the count alone', files.CardSlot.num_active, 1)
+        expect('nesting: not powered off', FakeSDCard.power_offs, offs + 1)
+    files._try_microsd = lambda: True
+    expect('nesting: count after a missing card', files.CardSlot.num_active, 0)
+
+
+test_buffering()
+test_error_flushes()
+test_binary()
+test_overflow()
+test_sink_error()
+test_card_in_use()
+test_card_slot_nesting()
+
+if failures:
+    print('{} failed'.format(failures))
+    sys.exit(1)
+print('All passed')
@@ -0,0 +1,211 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# perf_governor_test.py - Check the CPU frequency governor in modules/perf.py with a fake clock
+#
+# Runs on the unix port. The fake system counts turbo references the way turbo() in
+# modfoundation.c does, so the clock stays fast while anyone holds one, and each switch takes
+# SWITCH_MS of fake time.
+#
+import sys
+
+sys.path.append('../../modules')
+import perf
+
+SWITCH_MS = 2
+
+failures = 0
+
+
+def expect(what, got, expected):
+    global failures
+    if got != expected:
+        print('FAIL: {}: got {}, expected {}'.format(what, got, expected))
+        failures += 1
+
+
+class FakeClock:
+    def __init__(self):
+        self.now = 1000
+
+    def __call__(self):
+        return self.now
+
+    def advance(self, ms):
+        self.now += ms
+
+
+class FakeSystem:
+    def __init__(self, clock, high, switch_ms=SWITCH_MS):
+        self.clock = clock
+        self.high = high
+        self.count = 0
+        self.switch_ms = switch_ms
+
+    def turbo(self, enable):
+        if enable:
+            if self.count == 0:
+                self._set(True)
+            self.count += 1
+        elif self.count > 0:
+            if self.count == 1:
+                self._set(False)
+            self.count -= 1
+
+    def _set(self, high):
+        # frequency_turbo() does nothing if the clock is already there
+        if high != self.high:
+            self.clock.advance(self.switch_ms)
+            self.high = high
+
+    def is_high(self):
+        return self.high
+
+
+def make(high, switch_ms=SWITCH_MS):
+    clock = FakeClock()
+    system = FakeSystem(clock, high, switch_ms)
+    governor = perf.Governor(system.turbo, is_high=system.is_high, clock=clock,
+                             ticks_diff=lambda end, start: end - start)
+    return clock, system, governor
+
+
+def run_for(clock, governor, ms):
+    # What the governor's run() task does
+    for _ in range(ms // perf.POLL_MS):
+        clock.advance(perf.POLL_MS)
+        governor.poll()
+
+
+def expect_stats(what, governor, **expected):
+    stats = governor.stats()
+    for key in sorted(expected):
+        expect('{}: {}'.format(what, key), stats[key], expected[key])
+
+
+def test_boot():
+    # The device boots fast with no turbo reference: the governor takes it over and drops it
+    clock, system, governor = make(True)
+    expect('boot: reference taken', system.count, 1)
+    expect('boot: mhz', governor.frequency_mhz(), perf.FREQ_HIGH_MHZ)
+
+    run_for(clock, governor, perf.HOLD_MS - perf.HOLD_MS % perf.POLL_MS)
+    expect('boot: still fast within the hold', system.high, True)
+    run_for(clock, governor, perf.POLL_MS)
+    expect('boot: slow after the hold', system.high, False)
+    expect('boot: reference released', system.count, 0)
+    expect_stats('boot', governor, mhz=perf.FREQ_LOW_MHZ, high_ms=300, low_ms=0, transitions=1,
+                 transition_ms=SWITCH_MS)
+
+    # Booting slow takes nothing
+    clock, system, governor = make(False)
+    expect('slow boot: no reference', system.count, 0)
+    expect_stats('slow boot', governor, mhz=perf.FREQ_LOW_MHZ, transitions=0)
+
+
+def test_burst():
+    clock, system, governor = make(False)
+    clock.advance(1000)
+    with governor.burst('sign'):
+        expect('burst: fast inside', system.high, True)
+        clock.advance(700)
+        governor.poll()
+        expect('burst: poll keeps it fast', system.high, True)
+    expect('burst: fast just after', system.high, True)
+
+    run_for(clock, governor, 500)
+    expect('burst: slow after the hold', system.high, False)
+
+    # 700 in the burst and 300 polled until the hold ran out are fast, 1000 before and the last
+    # 200 polls slow, and neither counts the 2 for each switch
+    expect_stats('burst', governor, low_ms=1200, high_ms=1000, transitions=2,
+                 transition_ms=2 * SWITCH_MS)
+
+    # Nested holds of different names only let go at the last end()
+    governor.begin('camera')
+    governor.begin('sign')
+    governor.end('camera')
+    run_for(clock, governor, 1000)
+    expect('nested: fast while a hold is left', system.high, True)
+    governor.end('sign')
+    governor.end('sign')
+    expect('nested: unbalanced end ignored', governor.num_holds, 0)
+    run_for(clock, governor, 1000)
+    expect('nested: slow after the last end', system.high, False)
+
+
+def test_kick_idle():
+    clock, system, governor = make(False)
+    governor.kick()
+    run_for(clock, governor, perf.KICK_MS - perf.POLL_MS)
+    expect('kick: fast', system.high, True)
+    run_for(clock, governor, perf.POLL_MS)
+    expect('kick: slow after KICK_MS', system.high, False)
+
+    # idle() drops straight away once the minimum dwell has passed
+    governor.kick()
+    clock.advance(perf.HOLD_MS)
+    governor.idle()
+    expect('idle: slow', system.high, False)
+
+    # but not straight after a switch
+    governor.kick()
+    governor.idle()
+    expect('idle: dwell', system.high, True)
+
+
+def test_external():
+    # Direct System.turbo() calls and the busy bar change the clock behind the governor's back
+    clock, system, governor = make(False)
+    clock.advance(1000)
+    system.turbo(True)
+    clock.advance(50)
+    governor.poll()
+    expect('external: seen', governor.frequency_mhz(), perf.FREQ_HIGH_MHZ)
+    clock.advance(450)
+
+    # Until the poll, including the switch, counts as slow
+    expect_stats('external up', governor, low_ms=1000 + SWITCH_MS + 50, high_ms=450, transitions=1, external=1,
+                 transition_ms=0)
+
+    # The governor's reference stacks on the external one: letting go of it changes nothing
+    with governor.burst('sign'):
+        clock.advance(100)
+    run_for(clock, governor, 1000)
+    expect('external: still fast', system.high, True)
+    expect('external: reference released', system.count, 1)
+    expect_stats('external held', governor, high_ms=1550, transitions=1, transition_ms=0)
+
+    # Until the external reference goes too
+    system.turbo(False)
+    clock.advance(30)
+    governor.poll()
+    clock.advance(70)
+    expect_stats('external down', governor, mhz=perf.FREQ_LOW_MHZ, low_ms=1000 + SWITCH_MS + 50 + 70,
+                 high_ms=1550 + SWITCH_MS + 30, transitions=2, external=2)
+
+
+def test_switch_cost():
+    # A slow switch makes the governor hold on for longer
+    switch_ms = 40
+    clock, system, governor = make(False, switch_ms)
+    with governor.burst('sign'):
+        pass
+    expect('cost: hold', governor.hold_ms(), switch_ms * perf.SWITCH_COST_FACTOR)
+    run_for(clock, governor, switch_ms * perf.SWITCH_COST_FACTOR - perf.POLL_MS)
+    expect('cost: fast within the longer hold', system.high, True)
+    run_for(clock, governor, perf.POLL_MS)
+    expect('cost: slow after it', system.high, False)
+    expect_stats('cost', governor, transitions=2, transition_ms=2 * switch_ms)
+
+
+test_boot()
+test_burst()
+test_kick_idle()
+test_external()
+test_switch_cost()
+
+if failures:
+    print('{} failed'.format(failures))
+    sys.exit(1)
+print('All passed')
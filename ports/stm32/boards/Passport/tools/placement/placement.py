@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# placement.py - Report what the firmware link put in ITCM and DTCM, and pick hot code for ITCM
+#
+# Usage: placement.py report firmware.map
+#        placement.py sample [--seconds N] [--host HOST] [--port PORT] samples.txt
+#        placement.py hot [--reserve BYTES] [--min-share PERCENT] firmware.map samples.txt > itcm_hot.ld
+#
+# report lists the input sections in each TCM with their sizes and symbols, and how much room is
+# left. sample reads the core's PC sample register (DWT_PCSR) through OpenOCD while the device
+# runs, which doesn't stop or slow it down. hot attributes the samples to input sections in the
+# map of the same build and writes the hottest ones that fit in ITCM as an itcm_hot.ld fragment.
+#
+import argparse
+import bisect
+import re
+import socket
+import sys
+import time
+
+TCM_REGIONS = ('ITCM', 'DTCM')
+
+DWT_PCSR = 0xE000101C
+DEMCR = 0xE000EDFC
+DEMCR_TRCENA = 0x01000000
+
+# PCSR reads as this while the core is halted or asleep
+PCSR_NONE = 0xFFFFFFFF
+
+# Reads of PCSR per OpenOCD command, to keep the round trips down
+SAMPLES_PER_COMMAND = 256
+
+HEX = r'0x[0-9a-fA-F]+'
+OUTPUT_SECTION_RE = re.compile(r'^(\.\S+)(?:\s+(' + HEX + r')\s+(' + HEX + r'))?')
+INPUT_SECTION_RE = re.compile(r'^ (\.\S+|COMMON)(?:\s+(' + HEX + r')\s+(' + HEX + r')\s+(.+))?$')
+CONTINUATION_RE = re.compile(r'^\s+(' + HEX + r')\s+(' + HEX + r')\s+(.+)$')
+SYMBOL_RE = re.compile(r'^\s+(' + HEX + r')\s+([A-Za-z_.$][\w.$]*)$')
+
+
+class InputSection:
+    def __init__(self, name, addr, size, obj, output):
+        self.name = name
+        self.addr = addr
+        self.size = size
+        self.obj = obj.strip()
+        self.output = output
+        self.symbols = []
+        self.samples = 0
+
+    def pattern(self):
+        # The linker script pattern that matches this section, without the build directory
+        obj = self.obj
+        m = re.match(r'^.*/([^/]+\.a)\((.+)\)$', obj)
+        if m:
+            return '*{}:{}({})'.format(m.group(1), m.group(2), self.name)
+        if '/' in obj and not obj.startswith('/'):
+            obj = obj.split('/', 1)[1]
+        return '*/{}({})'.format(obj.lstrip('/'), self.name)
+
+
+def read_map(path):
+    # Returns ({region: (origin, length)}, [InputSection]) from a GNU ld map file
+    regions = {}
+    sections = []
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    i = 0
+    while i < len(lines) and lines[i] != 'Memory Configuration':
+        i += 1
+    i += 1
+    while i < len(lines) and lines[i] != 'Linker script and memory map':
+        fields = lines[i].split()
+        if len(fields) >= 3 and fields[1].startswith('0x') and fields[0] != '*default*':
+            regions[fields[0]] = (int(fields[1], 16), int(fields[2], 16))
+        i += 1
+
+    output = None
+    pending = None
+    current = None
+    for line in lines[i:]:
+        if line.startswith('Cross Reference Table'):
+            break
+
+        if pending:
+            # An input section whose name was too long to share its line with the address
+            m = CONTINUATION_RE.match(line)
+            if m:
+                current = InputSection(pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3), output)
+                sections.append(current)
+            pending = None
+            continue
+
+        m = OUTPUT_SECTION_RE.match(line)
+        if m:
+            output = m.group(1)
+            current = None
+            continue
+
+        m = INPUT_SECTION_RE.match(line)
+        if m:
+            current = None
+            if m.group(2) is None:
+                pending = m.group(1)
+            elif int(m.group(3), 16):
+                current = InputSection(m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4), output)
+                sections.append(current)
+            continue
+
+        m = SYMBOL_RE.match(line)
+        if m and current:
+            current.symbols.append(m.group(2))
+            continue
+
+        if line.startswith(' ') and not line.startswith('  '):
+            # A pattern, *fill* or the like: later symbols aren't in the last input section
+            current = None
+
+    return regions, [s for s in sections if s.size]
+
+
+def region_of(regions, addr):
+    for name, (origin, length) in regions.items():
+        if origin <= addr < origin + length:
+            return name
+    return None
+
+
+def report(args):
+    regions, sections = read_map(args.map)
+    summary = []
+    for name in TCM_REGIONS:
+        if name not in regions:
+            continue
+        origin, length = regions[name]
+        placed = sorted((s for s in sections if region_of(regions, s.addr) == name), key=lambda s: -s.size)
+        used = sum(s.size for s in placed)
+
+        print('{} at 0x{:08x}:'.format(name, origin))
+        for s in placed:
+            symbols = ', '.join(s.symbols[:4]) + (', ...' if len(s.symbols) > 4 else '')
+            print('  {:>8}  {:<16} {:<40} {}'.format(s.size, s.output, s.name, symbols))
+            print('  {:>8}  {}'.format('', s.obj))
+        print()
+        summary.append('{}: {} of {} bytes used, {} free'.format(name, used, length, length - used))
+
+    for line in summary:
+        print(line)
+
+
+def openocd_command(sock, command, expect_lines):
+    # Runs a command on OpenOCD's telnet server, returning the PCSR values it printed
+    sock.sendall(command.encode() + b'\n')
+    values = []
+    buf = b''
+    pattern = re.compile(r'0x{:08x}: ([0-9a-fA-F]{{8}})'.format(DWT_PCSR), re.IGNORECASE)
+    while len(values) < expect_lines:
+        data = sock.recv(65536)
+        if not data:
+            raise ConnectionError('OpenOCD closed the connection')
+        buf += data
+        *lines, buf = buf.split(b'\n')
+        for line in lines:
+            m = pattern.search(line.decode(errors='replace'))
+            if m:
+                values.append(int(m.group(1), 16))
+    return values
+
+
+def sample(args):
+    counts = {}
+    total = 0
+    idle = 0
+    with socket.create_connection((args.host, args.port), timeout=10) as sock:
+        openocd_command(sock, 'mmw 0x{:08x} 0x{:08x} 0'.format(DEMCR, DEMCR_TRCENA), 0)
+
+        read = 'for {{set i 0}} {{$i < {}}} {{incr i}} {{mdw 0x{:08x}}}'.format(SAMPLES_PER_COMMAND, DWT_PCSR)
+        end = time.monotonic() + args.seconds
+        while time.monotonic() < end:
+            for pc in openocd_command(sock, read, SAMPLES_PER_COMMAND):
+                total += 1
+                if pc == PCSR_NONE:
+                    idle += 1
+                else:
+                    # Bit 0 is the Thumb bit on some implementations
+                    pc &= ~1
+                    counts[pc] = counts.get(pc, 0) + 1
+
+    with open(args.samples, 'w') as f:
+        for pc, n in sorted(counts.items()):
+            f.write('0x{:08x} {}\n'.format(pc, n))
+    print('{} samples, {} while halted or asleep, at {} different PCs'.format(total, idle, len(counts)),
+          file=sys.stderr)
+
+
+def read_samples(path):
+    samples = []
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if fields:
+                samples.append((int(fields[0], 16), int(fields[1]) if len(fields) > 1 else 1))
+    return samples
+
+
+def hot(args):
+    regions, sections = read_map(args.map)
+    if 'ITCM' not in regions:
+        sys.exit('placement.py: no ITCM region in {}'.format(args.map))
+
+    code = sorted((s for s in sections if s.name.startswith(('.text', '.itcm_text'))), key=lambda s: s.addr)
+    starts = [s.addr for s in code]
+    total = unattributed = 0
+    for pc, n in read_samples(args.samples):
+        total += n
+        i = bisect.bisect_right(starts, pc) - 1
+        if i >= 0 and pc < code[i].addr + code[i].size:
+            code[i].samples += n
+        else:
+            unattributed += n
+    if not total:
+        sys.exit('placement.py: no samples in {}'.format(args.samples))
+
+    # ITCM_FUNC code is placed whatever the profile says, so it comes out of the budget first
+    budget = regions['ITCM'][1] - args.reserve - sum(s.size for s in code if s.name.startswith('.itcm_text'))
+
+    # Hottest per byte first, while they fit. Sections without a file of their own (linker
+    # veneers) can't be named in a linker script.
+    chosen = []
+    candidates = [s for s in code if s.name.startswith('.text') and s.obj.endswith(('.o', '.o)'))
+                  and s.samples * 100.0 / total >= args.min_share]
+    for s in sorted(candidates, key=lambda s: -s.samples / s.size):
+        if s.size <= budget:
+            chosen.append(s)
+            budget -= s.size
+
+    share = sum(s.samples for s in chosen) * 100.0 / total
+    print('/*')
+    print('   SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>')
+    print('   SPDX-License-Identifier: GPL-3.0-or-later')
+    print()
+    print('   Input sections that passport.ld places in ITCM. Made by tools/placement/placement.py hot')
+    print('   from {} PC samples, {:.1f}% of which fall in these {} sections ({} bytes).'.format(
+        total, share, len(chosen), sum(s.size for s in chosen)))
+    if unattributed:
+        print('   {} samples were outside any code section in the map.'.format(unattributed))
+    print('*/')
+    for s in sorted(chosen, key=lambda s: -s.samples):
+        print('{:<64} /* {:5.2f}% */'.format(s.pattern(), s.samples * 100.0 / total))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report and plan what the Passport firmware runs from ITCM and DTCM')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('report', help='list what the link placed in ITCM and DTCM')
+    p.add_argument('map', help='build-Passport/firmware.map')
+    p.set_defaults(func=report)
+
+    p = sub.add_parser('sample', help='sample the PC through OpenOCD while the device runs')
+    p.add_argument('--host', default='localhost', help='where OpenOCD is running')
+    p.add_argument('--port', type=int, default=4444, help="OpenOCD's telnet port")
+    p.add_argument('--seconds', type=float, default=60, help='how long to sample for')
+    p.add_argument('samples', help='file to write the PCs and their counts to')
+    p.set_defaults(func=sample)
+
+    p = sub.add_parser('hot', help='write itcm_hot.ld from samples')
+    p.add_argument('--reserve', type=int, default=2048, help='ITCM bytes to leave for linker veneers')
+    p.add_argument('--min-share', type=float, default=0.1, help='leave out sections with fewer samples (percent)')
+    p.add_argument('map', help='firmware.map of the build that was sampled')
+    p.add_argument('samples', help='file written by sample')
+    p.set_defaults(func=hot)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,287 @@
+# SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# psbt_writer_bench.py - Compare modules/psbt_writer.py with how psbt.py used to write PSBTs
+#
+# Runs on the unix port. Builds large multi-input PSBTs in memory, parses them into (pos, len)
+# values the way psbtProxy does, and writes them out again both ways, checking the output is
+# the same. Then writes a finalized segwit transaction with its txid hashed in the same pass,
+# against writing it and reading it back to hash it.
+#
+import gc
+import sys
+import uhashlib
+from uio import BytesIO
+from ustruct import pack
+from utime import ticks_us, ticks_diff
+
+sys.path.append('../../modules')
+from psbt_writer import PSBTWriter
+
+def ser_compact_size(l):
+    if l < 253:
+        return pack("B", l)
+    elif l < 0x10000:
+        return pack("<BH", 253, l)
+    return pack("<BI", 254, l)
+
+
+def deser_compact_size(f):
+    nit = f.read(1)[0]
+    if nit == 253:
+        return int.from_bytes(f.read(2), 'little')
+    elif nit == 254:
+        return int.from_bytes(f.read(4), 'little')
+    return nit
+
+
+def ser_string(s):
+    return ser_compact_size(len(s)) + s
+
+
+def fake(n, seed):
+    return bytes(((seed * 7 + i * 13) & 0xFF) for i in range(n))
+
+
+def make_txn(num_in, num_out):
+    # An unsigned segwit v0 txn, in the old-style serialization PSBTs use
+    t = pack('<i', 2) + ser_compact_size(num_in)
+    for i in range(num_in):
+        t += fake(32, i) + pack('<I', i) + b'\x00' + pack('<I', 0xFFFFFFFD)
+    t += ser_compact_size(num_out)
+    for i in range(num_out):
+        t += pack('<q', 10000 + i) + ser_string(b'\x00\x14' + fake(20, 1000 + i))
+    return t + pack('<I', 0)
+
+
+def make_psbt(num_in, num_out):
+    out = [b'psbt\xff', b'\x01\x00', ser_string(make_txn(num_in, num_out)), b'\x00']
+    for i in range(num_in):
+        pubkey = b'\x02' + fake(32, 2000 + i)
+        out += [b'\x01\x01', ser_string(pack('<q', 20000 + i) + ser_string(b'\x00\x14' + fake(20, i)))]
+        out += [ser_string(b'\x02' + pubkey), ser_string(fake(71, 3000 + i))]
+        out += [b'\x01\x03', ser_string(pack('<I', 1))]
+        out += [ser_string(b'\x06' + pubkey), ser_string(pack('<IIIII', 0x12345678, 0x80000054, 0x80000000,
+                                                               0x80000000, i))]
+        out.append(b'\x00')
+    for i in range(num_out):
+        out += [ser_string(b'\x02' + b'\x03' + fake(32, 4000 + i)),
+                ser_string(pack('<IIIIII', 0x12345678, 0x80000054, 0x80000000, 0x80000000, 1, i))]
+        out.append(b'\x00')
+    return b''.join(out)
+
+
+def parse_map(fd):
+    # [(key, (pos, len))] for one map, as psbtProxy.parse() keeps them
+    rv = []
+    while True:
+        ks = deser_compact_size(fd)
+        if ks == 0:
+            return rv
+        key = fd.read(ks)
+        vs = deser_compact_size(fd)
+        rv.append((key, (fd.tell(), vs)))
+        fd.seek(vs, 1)
+
+
+def parse(data):
+    fd = BytesIO(data)
+    assert fd.read(5) == b'psbt\xff'
+    glob = parse_map(fd)
+    txn = BytesIO(data)
+    txn.seek(glob[0][1][0] + 4)
+    num_in = deser_compact_size(txn)
+    maps = [parse_map(fd) for i in range(num_in)]
+    for i in range(num_in):
+        txn.seek(36, 1)
+        txn.seek(deser_compact_size(txn) + 4, 1)
+    num_out = deser_compact_size(txn)
+    maps += [parse_map(fd) for i in range(num_out)]
+    return fd, glob, maps
+
+
+#=================================================================================================
+# How psbt.py wrote PSBTs before PSBTWriter: a key and value at a time through a lambda, with a
+# gc.collect() after each input and output
+
+def old_write(fd, out_fd, ktype, val, key=b''):
+    out_fd.write(ser_compact_size(1 + len(key)))
+    out_fd.write(bytes([ktype]) + key)
+    (pos, ll) = val
+    out_fd.write(ser_compact_size(ll))
+    fd.seek(pos)
+    while ll:
+        t = fd.read(min(64, ll))
+        out_fd.write(t)
+        ll -= len(t)
+
+
+def old_serialize(fd, glob, maps, out_fd, collect=True):
+    wr = lambda *a: old_write(fd, out_fd, *a)
+    out_fd.write(b'psbt\xff')
+    for k, v in glob:
+        wr(k[0], v, k[1:])
+    out_fd.write(b'\0')
+    for m in maps:
+        for k, v in m:
+            wr(k[0], v, k[1:])
+        out_fd.write(b'\0')
+        if collect:
+            gc.collect()
+
+
+def new_serialize(fd, glob, maps, out_fd, buf):
+    w = PSBTWriter(out_fd, buf, fd)
+    w.write(b'psbt\xff')
+    for k, v in glob:
+        w.record_raw(k, v)
+    w.byte(0)
+    for m in maps:
+        for k, v in m:
+            w.record_raw(k, v)
+        w.byte(0)
+    w.flush()
+
+
+#=================================================================================================
+# Finalizing: every input gets a segwit signature in the witness data
+
+def old_finalize(txn, sigs, out_fd):
+    # Builds each part as bytes, then reads back what it wrote to hash the txid
+    fd = BytesIO(txn)
+    fd.seek(4)
+    out_fd.write(pack('<i', 2))
+    out_fd.write(b'\x00\x01')
+    body_start = out_fd.tell()
+    num_in = deser_compact_size(fd)
+    out_fd.write(ser_compact_size(num_in))
+    for i in range(num_in):
+        prevout = fd.read(36)
+        fd.read(deser_compact_size(fd))
+        out_fd.write(prevout + ser_string(b'') + fd.read(4))
+    num_out = deser_compact_size(fd)
+    out_fd.write(ser_compact_size(num_out))
+    for i in range(num_out):
+        out_fd.write(fd.read(8) + ser_string(fd.read(deser_compact_size(fd))))
+    body_end = out_fd.tell()
+    for pubkey, sig in sigs:
+        out_fd.write(ser_compact_size(2) + ser_string(sig) + ser_string(pubkey))
+    out_fd.write(fd.read(4))
+
+    rv = uhashlib.sha256(pack('<i', 2))
+    out_fd.seek(body_start)
+    ll = body_end - body_start
+    while ll:
+        t = out_fd.read(min(256, ll))
+        rv.update(t)
+        ll -= len(t)
+    out_fd.seek(-4, 2)
+    rv.update(out_fd.read(4))
+    return uhashlib.sha256(rv.digest()).digest()
+
+
+def new_finalize(txn, sigs, out_fd, buf):
+    # As psbtObject.write_final()
+    fd = BytesIO(txn)
+    w = PSBTWriter(out_fd, buf, fd)
+    rv = uhashlib.sha256()
+    w.hash_with(rv)
+    w.int32(2)
+    w.hash_with(None)
+    w.write(b'\x00\x01')
+    w.hash_with(rv)
+
+    # Every input keeps its empty scriptSig, so the inputs and outputs are copied in one go
+    w.copy(4, len(txn) - 8)
+
+    w.hash_with(None)
+    for pubkey, sig in sigs:
+        w.byte(2)
+        w.varint(len(sig))
+        w.write(sig)
+        w.varint(len(pubkey))
+        w.write(pubkey)
+    w.hash_with(rv)
+
+    w.copy(len(txn) - 4, 4)
+    w.hash_with(None)
+    w.flush()
+    return uhashlib.sha256(rv.digest()).digest()
+
+
+#=================================================================================================
+
+def measure(fn, reps=5):
+    # Returns (us, bytes allocated) for the fastest of reps runs of fn(), with the collector off
+    best = None
+    for i in range(reps):
+        gc.collect()
+        gc.disable()
+        before = gc.mem_alloc()
+        t0 = ticks_us()
+        fn()
+        us = ticks_diff(ticks_us(), t0)
+        alloc = gc.mem_alloc() - before
+        gc.enable()
+        if best is None or us < best:
+            best = us
+    gc.collect()
+    return best, alloc
+
+
+def bench(num_in, num_out, buf):
+    data = make_psbt(num_in, num_out)
+    fd, glob, maps = parse(data)
+
+    old_out, new_out = BytesIO(), BytesIO()
+    old_serialize(fd, glob, maps, old_out)
+    new_serialize(fd, glob, maps, new_out, buf)
+    assert old_out.getvalue() == data, 'old round trip'
+    assert new_out.getvalue() == data, 'new round trip'
+
+    # The firmware collected after every input and output; the others don't, to count allocations
+    gc.collect()
+    t0 = ticks_us()
+    old_serialize(fd, glob, maps, BytesIO(bytearray(len(data))))
+    old_us = ticks_diff(ticks_us(), t0)
+    out = BytesIO(bytearray(len(data)))
+    old_nc_us, old_alloc = measure(lambda: out.seek(0) or old_serialize(fd, glob, maps, out, False))
+    new_us, new_alloc = measure(lambda: out.seek(0) or new_serialize(fd, glob, maps, out, buf))
+
+    print('%4d in, %4d out, %6d byte PSBT: old %7d us (%7d us without gc.collect()), %7d bytes allocated'
+          % (num_in, num_out, len(data), old_us, old_nc_us, old_alloc))
+    print('%37s new %7d us, %7d bytes allocated' % ('', new_us, new_alloc))
+
+    txn = make_txn(num_in, num_out)
+    sigs = [(b'\x02' + fake(32, 2000 + i), fake(71, 3000 + i)) for i in range(num_in)]
+    old_fd, new_fd = BytesIO(), BytesIO()
+    old_txid = old_finalize(txn, sigs, old_fd)
+    new_txid = new_finalize(txn, sigs, new_fd, buf)
+    assert old_fd.getvalue() == new_fd.getvalue(), 'finalized txn'
+    assert old_txid == new_txid, 'txid'
+
+    out = BytesIO(bytearray(len(old_fd.getvalue())))
+    old_us, old_alloc = measure(lambda: out.seek(0) or old_finalize(txn, sigs, out))
+    new_us, new_alloc = measure(lambda: out.seek(0) or new_finalize(txn, sigs, out, buf))
+    print('%37s finalize: old %7d us, %7d bytes allocated; new %7d us, %7d bytes allocated'
+          % ('', old_us, old_alloc, new_us, new_alloc))
+
+
+def main():
+    # The same size as sram4.psbt_out_buf
+    buf = bytearray(1024)
+
+    # A small buffer exercises the writes and copies that span flushes
+    for num_in in (1, 3, 20):
+        data = make_psbt(num_in, 2)
+        fd, glob, maps = parse(data)
+        out = BytesIO()
+        new_serialize(fd, glob, maps, out, bytearray(37))
+        assert out.getvalue() == data, 'small buffer'
+
+    for num_in, num_out in ((10, 2), (50, 2), (200, 4), (500, 4)):
+        bench(num_in, num_out, buf)
+    print('All passed')
+
+
+main()
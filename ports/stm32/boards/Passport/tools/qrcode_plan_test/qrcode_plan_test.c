@@ -0,0 +1,263 @@
+// SPDX-FileCopyrightText: 2021 Foundation Devices, Inc. <hello@foundationdevices.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qrcode.h"
+#include "quirc.h"
+#include "quirc_internal.h"
+
+// What QRCode.render_fit() in modfoundation.c passes: ECC level 0 and versions up to 25,
+// rendered into a 2000 byte buffer
+#define ECC             ECC_LOW
+#define MAX_VERSION     25
+#define OUT_BUF_SIZE    2000
+
+// Pixels per module, and modules of quiet zone around the code, in the image given to quirc
+#define SCALE           4
+#define QUIET           4
+
+static int failures;
+
+static void fail(const char *what, long got, long expected)
+{
+    printf("FAIL: %s: got %ld, expected %ld\n", what, got, expected);
+    failures++;
+}
+
+static void expect(const char *what, long got, long expected)
+{
+    if (got != expected) {
+        fail(what, got, expected);
+    }
+}
+
+// Smallest version that holds the data in a single segment of one mode, to compare plans against
+static uint8_t single_mode_version(const char *data, uint8_t mode)
+{
+    static const uint16_t bits_per_count[3][3] = {{10, 12, 14}, {9, 11, 13}, {8, 16, 16}};
+    static const uint16_t data_codewords[MAX_VERSION] = {
+        19, 34, 55, 80, 108, 136, 156, 194, 232, 274, 324, 370, 428, 461, 523, 589, 647, 721, 795,
+        861, 932, 1006, 1094, 1174, 1276,
+    };
+    size_t len = strlen(data);
+    uint32_t payload;
+    if (mode == MODE_NUMERIC) {
+        payload = len / 3 * 10 + (len % 3 == 1 ? 4 : len % 3 == 2 ? 7 : 0);
+    } else if (mode == MODE_ALPHANUMERIC) {
+        payload = len / 2 * 11 + (len % 2) * 6;
+    } else {
+        payload = len * 8;
+    }
+    for (uint8_t version = 1; version <= MAX_VERSION; version++) {
+        int range = version < 10 ? 0 : version < 27 ? 1 : 2;
+        if (4 + bits_per_count[mode][range] + payload <= data_codewords[version - 1] * 8u) {
+            return version;
+        }
+    }
+    return 0;
+}
+
+// What render_fit() does: plan, check the buffer, render. Returns the version, or 0.
+static uint8_t render_fit(QRCode *qrcode, uint8_t *out, const char *data, uint8_t min_version, bool fold)
+{
+    QRPlan plan;
+    if (qrcode_plan(&plan, (const uint8_t *)data, strlen(data), ECC, fold, min_version, MAX_VERSION) != 0) {
+        expect("failed plan has no version", plan.version, 0);
+        return 0;
+    }
+    if (qrcode_getBufferSize(plan.version) > OUT_BUF_SIZE) {
+        return 0;
+    }
+    expect("plan renders", qrcode_initPlan(qrcode, out, &plan, (const uint8_t *)data), 0);
+    return plan.version;
+}
+
+// Scans the rendered code with quirc and checks it holds the expected text
+static void expect_decodes(const char *what, QRCode *qrcode, const char *expected)
+{
+    int side = (qrcode->size + 2 * QUIET) * SCALE;
+    struct quirc *q = quirc_new();
+    if (!q || quirc_resize(q, side, side) < 0) {
+        printf("FAIL: %s: out of memory\n", what);
+        failures++;
+        return;
+    }
+
+    int w, h;
+    uint8_t *image = quirc_begin(q, &w, &h);
+    memset(image, 0xff, w * h);
+    for (int y = 0; y < qrcode->size; y++) {
+        for (int x = 0; x < qrcode->size; x++) {
+            if (qrcode_getModule(qrcode, x, y)) {
+                for (int dy = 0; dy < SCALE; dy++) {
+                    memset(image + ((y + QUIET) * SCALE + dy) * w + (x + QUIET) * SCALE, 0, SCALE);
+                }
+            }
+        }
+    }
+    quirc_end(q);
+
+    struct quirc_code code;
+    struct quirc_data data;
+    if (quirc_count(q) != 1) {
+        printf("FAIL: %s: found %d codes\n", what, quirc_count(q));
+        failures++;
+    } else {
+        quirc_extract(q, 0, &code);
+        quirc_decode_error_t err = quirc_decode(&code, &data);
+        if (err) {
+            printf("FAIL: %s: %s\n", what, quirc_strerror(err));
+            failures++;
+        } else {
+            expect(what, data.version, qrcode->version);
+            if (data.payload_len != (int)strlen(expected) || memcmp(data.payload, expected, data.payload_len) != 0) {
+                printf("FAIL: %s: decoded \"%.*s\"\n", what, data.payload_len, data.payload);
+                failures++;
+            }
+        }
+    }
+    // quirc_destroy() leaves the buffers to the caller
+    quirc_destroy(q);
+    free(q->image);
+    free(q);
+}
+
+static void upper(char *dst, const char *src)
+{
+    for (; *src; src++) {
+        *dst++ = (*src >= 'a' && *src <= 'z') ? *src - 'a' + 'A' : *src;
+    }
+    *dst = 0;
+}
+
+static void test_round_trip(void)
+{
+    static const char *texts[] = {
+        "0",
+        "12345678901234567890",
+        "HELLO WORLD",
+        "Hello, world!",
+        "ur:crypto-psbt/1-3/lpadaxcsencylobemohsgmoyadtaaehdcxjpiykkgoahlkpkgsfdsdmugtlseoidwklfplbdldvlde",
+        "bitcoin:BC1QAR0SRRR7XFKVY5L643LYDNW9RE59GTZZWF5MDQ?amount=0.00123&label=Payment for order 42",
+        "0123456789ABCDEFGHIJ0123456789abcdefghij0123456789",
+    };
+    char folded[256];
+    uint8_t out[OUT_BUF_SIZE];
+    QRCode qrcode;
+
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        uint8_t version = render_fit(&qrcode, out, texts[i], 0, false);
+        if (version == 0) {
+            fail("round trip: fits", i, -1);
+            continue;
+        }
+        expect_decodes("round trip", &qrcode, texts[i]);
+
+        // Folded, lower case letters come back upper case
+        upper(folded, texts[i]);
+        if (render_fit(&qrcode, out, texts[i], 0, true)) {
+            expect_decodes("round trip folded", &qrcode, folded);
+        }
+    }
+
+    // Random mixes of digits, upper and lower case and punctuation
+    srand(1);
+    static const char alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:abcdefghijklmnopqrstuvwxyz?&=#";
+    char text[200];
+    for (int i = 0; i < 200; i++) {
+        int len = 1 + rand() % (sizeof(text) - 1);
+        for (int j = 0; j < len; j++) {
+            // Runs of one kind of character, so the planner has segments to find
+            int run = rand() % 3;
+            const char *from = run == 0 ? alphabet : run == 1 ? alphabet + 10 : alphabet + 45;
+            int n = run == 0 ? 10 : run == 1 ? 35 : sizeof(alphabet) - 1 - 45;
+            text[j] = from[rand() % n];
+        }
+        text[len] = 0;
+        if (render_fit(&qrcode, out, text, 0, i & 1)) {
+            if (i & 1) {
+                upper(folded, text);
+                expect_decodes("random folded", &qrcode, folded);
+            } else {
+                expect_decodes("random", &qrcode, text);
+            }
+        } else {
+            fail("random: fits", len, -1);
+        }
+    }
+}
+
+static void test_fit(void)
+{
+    uint8_t out[OUT_BUF_SIZE];
+    QRCode qrcode;
+
+    // A lower case scheme in front of an upper case address is smaller as two segments
+    // than as one byte segment
+    const char *mixed = "bitcoin:BC1QRP33G0Q5C5TXSP9ARYSRX4K6ZDKFS4NCE4XJ0GDCCCEFVPYSXF3QCCFMV3";
+    uint8_t version = render_fit(&qrcode, out, mixed, 0, false);
+    expect("mixed: smaller than byte mode", version < single_mode_version(mixed, MODE_BYTE), 1);
+
+    expect("numeric", render_fit(&qrcode, out, "12345678901234567890", 0, false),
+           single_mode_version("12345678901234567890", MODE_NUMERIC));
+    expect("alphanumeric", render_fit(&qrcode, out, "HELLO WORLD", 0, false),
+           single_mode_version("HELLO WORLD", MODE_ALPHANUMERIC));
+
+    // UR text is all alphanumeric once folded
+    const char *ur = "ur:bytes/1-9/lpadascfadaxcywenbpljkhdcahkadaemejtswhhylkepmykhhtsytsnoyoyaxaedsuttydmmhhpktpmsrjtdkgslpgh";
+    char folded[256];
+    upper(folded, ur);
+    expect("ur folded", render_fit(&qrcode, out, ur, 0, true), single_mode_version(folded, MODE_ALPHANUMERIC));
+
+    // The minimum version is kept even when the data would fit in less
+    expect("min version kept", render_fit(&qrcode, out, "0", 7, false), 7);
+    expect_decodes("min version decodes", &qrcode, "0");
+}
+
+static void test_too_big(void)
+{
+    uint8_t out[OUT_BUF_SIZE];
+    QRCode qrcode;
+    static char text[2000];
+
+    // The largest byte-mode text that fits version 25, and one more byte
+    memset(text, 'a', sizeof(text));
+    size_t fits = 0;
+    for (size_t len = 1; len < sizeof(text); len++) {
+        text[len] = 0;
+        uint8_t version = render_fit(&qrcode, out, text, 0, false);
+        text[len] = 'a';
+        if (version == 0) {
+            fits = len - 1;
+            break;
+        }
+    }
+    expect("too big: byte capacity of version 25", fits, 1273);
+
+    text[fits + 1] = 0;
+    expect("too big: 0 past the largest version", render_fit(&qrcode, out, text, 0, false), 0);
+
+    // A minimum version can't make room
+    text[fits] = 0;
+    expect("too big: fits at the limit", render_fit(&qrcode, out, text, MAX_VERSION, false), MAX_VERSION);
+    expect("too big: minimum past the limit", render_fit(&qrcode, out, "0", MAX_VERSION + 1, false), 0);
+}
+
+int main(void)
+{
+    test_round_trip();
+    test_fit();
+    test_too_big();
+
+    if (failures) {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+    printf("All passed\n");
+    return 0;
+}
@@ -22,6 +22,11 @@
 #include "aes/aes.h"
 #include "memzero.h"
 
+// On Passport the CRYP peripheral does ECB, CBC and CTR (see aes_engine.h)
+#if AES_ENGINE_HW
+#include "aes_engine.h"
+#endif
+
 enum AESMode {
   ECB = 0x00,
   CBC = 0x01,
@@ -47,8 +52,30 @@ typedef struct _mp_obj_AES_t {
   aes_decrypt_ctx decrypt_ctx;
   mp_int_t mode;
   uint8_t iv[AES_BLOCK_SIZE];
+#if AES_ENGINE_HW
+  aes_engine_ctx_t engine;
+#endif
 } mp_obj_AES_t;
 
+#if AES_ENGINE_HW
+// Returns true if the mode runs on the peripheral, and sets *engine_mode to match
+static bool aes_engine_mode(mp_int_t mode, aes_engine_mode_t *engine_mode) {
+  switch (mode) {
+    case ECB:
+      *engine_mode = AES_ENGINE_ECB;
+      return true;
+    case CBC:
+      *engine_mode = AES_ENGINE_CBC;
+      return true;
+    case CTR:
+      *engine_mode = AES_ENGINE_CTR;
+      return true;
+    default:
+      return false;
+  }
+}
+#endif
+
 /// def __init__(self, mode: int, key: bytes, iv: bytes = None) -> None:
 ///     """
 ///     Initialize AES context.
@@ -80,6 +107,14 @@ STATIC mp_obj_t mod_trezorcrypto_AES_make_new(const mp_obj_type_t *type,
   } else {
     memzero(o->iv, AES_BLOCK_SIZE);
   }
+#if AES_ENGINE_HW
+  aes_engine_mode_t engine_mode;
+  if (aes_engine_mode(o->mode, &engine_mode)) {
+    // No software key schedule needed
+    aes_engine_init(&(o->engine), engine_mode, key.buf, key.len, o->iv);
+    return MP_OBJ_FROM_PTR(o);
+  }
+#endif
   switch (key.len) {
     case 16:
       aes_decrypt_key128(key.buf, &(o->decrypt_ctx));
@@ -106,6 +141,16 @@ static mp_obj_t aes_update(mp_obj_t self, mp_obj_t data, bool encrypt) {
   vstr_t vstr = {0};
   vstr_init_len(&vstr, buf.len);
   mp_obj_AES_t *o = MP_OBJ_TO_PTR(self);
+#if AES_ENGINE_HW
+  aes_engine_mode_t engine_mode;
+  if (aes_engine_mode(o->mode, &engine_mode)) {
+    if (!aes_engine_crypt(&(o->engine), buf.buf, (uint8_t *)vstr.buf, buf.len,
+                          encrypt)) {
+      mp_raise_ValueError("Invalid data length");
+    }
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+  }
+#endif
   switch (o->mode) {
     case ECB:
       if (buf.len & (AES_BLOCK_SIZE - 1)) {
@@ -177,6 +222,9 @@ STATIC mp_obj_t mod_trezorcrypto_AES___del__(mp_obj_t self) {
   memzero(&(o->encrypt_ctx), sizeof(aes_encrypt_ctx));
   memzero(&(o->decrypt_ctx), sizeof(aes_decrypt_ctx));
   memzero(o->iv, AES_BLOCK_SIZE);
+#if AES_ENGINE_HW
+  aes_engine_release(&(o->engine));
+#endif
   return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_AES___del___obj,
@@ -41,10 +41,26 @@ typedef struct _mp_obj_HDNode_t {
   mp_obj_base_t base;
   uint32_t fingerprint;
   HDNode hdnode;
+#ifdef FOUNDATION_ADDITIONS
+  // Set up by the first derive_child() and kept for its siblings, until the
+  // node itself changes
+  bool prepared;
+  HDNodeMidstate midstate;
+#endif
 } mp_obj_HDNode_t;
 
 STATIC const mp_obj_type_t mod_trezorcrypto_HDNode_type;
 
+#ifdef FOUNDATION_ADDITIONS
+// Called before the node is changed in place
+STATIC void hdnode_forget_midstate(mp_obj_HDNode_t *o) {
+  if (o->prepared) {
+    o->prepared = false;
+    memzero(&o->midstate, sizeof(o->midstate));
+  }
+}
+#endif
+
 #define XPUB_MAXLEN 128
 #define ADDRESS_MAXLEN 40
 
@@ -146,6 +162,9 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_make_new(const mp_obj_type_t *type,
     memzero(o->hdnode.public_key, 33);
   }
   o->hdnode.curve = curve;
+#ifdef FOUNDATION_ADDITIONS
+  o->prepared = false;
+#endif
 
   return MP_OBJ_FROM_PTR(o);
 }
@@ -160,6 +179,9 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_derive(size_t n_args,
   uint32_t i = trezor_obj_get_uint(args[1]);
   uint32_t fp = hdnode_fingerprint(&o->hdnode);
   bool public = n_args > 2 && args[2] == mp_const_true;
+#ifdef FOUNDATION_ADDITIONS
+  hdnode_forget_midstate(o);
+#endif
 
   int res = 0;
   if (public) {
@@ -199,6 +221,9 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_derive_cardano(mp_obj_t self,
   mp_obj_HDNode_t *o = MP_OBJ_TO_PTR(self);
   uint32_t i = mp_obj_get_int_truncated(index);
   uint32_t fp = hdnode_fingerprint(&o->hdnode);
+#ifdef FOUNDATION_ADDITIONS
+  hdnode_forget_midstate(o);
+#endif
 
   int res = 0;
   // same as in derive
@@ -233,10 +258,22 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_HDNode_derive_cardano_obj,
 STATIC mp_obj_t mod_trezorcrypto_HDNode_derive_path(mp_obj_t self,
                                                     mp_obj_t path) {
   mp_obj_HDNode_t *o = MP_OBJ_TO_PTR(self);
+#ifdef FOUNDATION_ADDITIONS
+  hdnode_forget_midstate(o);
+#endif
 
   // get path objects and length
   size_t plen = 0;
   mp_obj_t *pitems = NULL;
+#ifdef FOUNDATION_ADDITIONS
+  // also accept array('I'), as returned by foundation.DerivPath.parse()
+  const uint32_t *pvalues = NULL;
+  mp_buffer_info_t pinfo;
+  if (mp_get_buffer(path, &pinfo, MP_BUFFER_READ) && pinfo.typecode == 'I') {
+    pvalues = pinfo.buf;
+    plen = pinfo.len / sizeof(uint32_t);
+  } else
+#endif
   mp_obj_get_array(path, &plen, &pitems);
   if (plen > 32) {
     mp_raise_ValueError("Path cannot be longer than 32 indexes");
@@ -247,7 +284,12 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_derive_path(mp_obj_t self,
       // fingerprint is calculated from the parent of the final derivation
       o->fingerprint = hdnode_fingerprint(&o->hdnode);
     }
+#ifdef FOUNDATION_ADDITIONS
+    uint32_t pitem =
+        pvalues ? pvalues[pi] : trezor_obj_get_uint(pitems[pi]);
+#else
     uint32_t pitem = trezor_obj_get_uint(pitems[pi]);
+#endif
     if (!hdnode_private_ckd(&o->hdnode, pitem)) {
       o->fingerprint = 0;
       memzero(&o->hdnode, sizeof(o->hdnode));
@@ -260,6 +302,48 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_derive_path(mp_obj_t self,
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_HDNode_derive_path_obj,
                                  mod_trezorcrypto_HDNode_derive_path);
 
+#ifdef FOUNDATION_ADDITIONS
+/// def derive_child(self, index: int) -> HDNode:
+///     '''
+///     Return a new BIP0032 child node, leaving this one unchanged. Its public
+///     key and chain code midstates are kept, so deriving siblings one after
+///     another, such as a run of addresses, only computes them once.
+///     '''
+STATIC mp_obj_t mod_trezorcrypto_HDNode_derive_child(mp_obj_t self,
+                                                     mp_obj_t index) {
+  mp_obj_HDNode_t *o = MP_OBJ_TO_PTR(self);
+  uint32_t i = trezor_obj_get_uint(index);
+
+  if (0 ==
+      memcmp(
+          o->hdnode.private_key,
+          "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+          "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+          32)) {
+    mp_raise_ValueError("Failed to derive, private key not set");
+  }
+
+  if (!o->prepared) {
+    hdnode_private_ckd_prepare(&o->hdnode, &o->midstate);
+    o->prepared = true;
+  }
+
+  mp_obj_HDNode_t *child = m_new_obj_with_finaliser(mp_obj_HDNode_t);
+  child->base.type = &mod_trezorcrypto_HDNode_type;
+  child->prepared = false;
+  if (!hdnode_private_ckd_prepared(&o->hdnode, &o->midstate, i,
+                                   &child->hdnode)) {
+    memzero(&child->hdnode, sizeof(child->hdnode));
+    mp_raise_ValueError("Failed to derive");
+  }
+  child->fingerprint = hdnode_fingerprint(&o->hdnode);
+
+  return MP_OBJ_FROM_PTR(child);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_HDNode_derive_child_obj,
+                                 mod_trezorcrypto_HDNode_derive_child);
+#endif
+
 
 #ifdef FOUNDATION_ADDITIONS
 /// def serialize_private(self, version: int) -> str:
@@ -314,6 +398,9 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode_clone(mp_obj_t self) {
   copy->base.type = &mod_trezorcrypto_HDNode_type;
   copy->hdnode = o->hdnode;
   copy->fingerprint = o->fingerprint;
+#ifdef FOUNDATION_ADDITIONS
+  copy->prepared = false;
+#endif
   return MP_OBJ_FROM_PTR(copy);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_HDNode_clone_obj,
@@ -539,6 +626,9 @@ STATIC mp_obj_t mod_trezorcrypto_HDNode___del__(mp_obj_t self) {
   mp_obj_HDNode_t *o = MP_OBJ_TO_PTR(self);
   o->fingerprint = 0;
   memzero(&o->hdnode, sizeof(o->hdnode));
+#ifdef FOUNDATION_ADDITIONS
+  hdnode_forget_midstate(o);
+#endif
   return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_HDNode___del___obj,
@@ -556,6 +646,8 @@ STATIC const mp_rom_map_elem_t mod_trezorcrypto_HDNode_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_derive_path),
      MP_ROM_PTR(&mod_trezorcrypto_HDNode_derive_path_obj)},
 #ifdef FOUNDATION_ADDITIONS
+    {MP_ROM_QSTR(MP_QSTR_derive_child),
+     MP_ROM_PTR(&mod_trezorcrypto_HDNode_derive_child_obj)},
     {MP_ROM_QSTR(MP_QSTR_serialize_private),
      MP_ROM_PTR(&mod_trezorcrypto_HDNode_serialize_private_obj)},
 #endif
@@ -640,6 +732,9 @@ STATIC mp_obj_t mod_trezorcrypto_bip32_deserialize(mp_obj_t value, mp_obj_t vers
     o->base.type = &mod_trezorcrypto_HDNode_type;
     o->hdnode = hdnode;
     o->fingerprint = fingerprint;
+#ifdef FOUNDATION_ADDITIONS
+    o->prepared = false;
+#endif
 
     return MP_OBJ_FROM_PTR(o);
 }
@@ -681,6 +776,9 @@ STATIC mp_obj_t mod_trezorcrypto_bip32_from_seed(mp_obj_t seed,
   o->base.type = &mod_trezorcrypto_HDNode_type;
   o->hdnode = hdnode;
   o->fingerprint = 0;
+#ifdef FOUNDATION_ADDITIONS
+  o->prepared = false;
+#endif
   return MP_OBJ_FROM_PTR(o);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_bip32_from_seed_obj,
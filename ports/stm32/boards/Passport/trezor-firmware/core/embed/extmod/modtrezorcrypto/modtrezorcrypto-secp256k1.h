@@ -152,6 +152,74 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_trezorcrypto_secp256k1_sign_obj,
                                            2, 4,
                                            mod_trezorcrypto_secp256k1_sign);
 
+#ifdef FOUNDATION_ADDITIONS
+/// def sign_der_batch(
+///     secret_keys: Sequence[bytes],
+///     digests: Sequence[bytes],
+/// ) -> List[bytes]:
+///     '''
+///     Signs each digest with the secret key at the same index, and returns
+///     the signatures DER encoded. They are the signatures sign() would make,
+///     but signing several together is cheaper.
+///     '''
+STATIC mp_obj_t mod_trezorcrypto_secp256k1_sign_der_batch(mp_obj_t secret_keys,
+                                                          mp_obj_t digests) {
+  static CONFIDENTIAL uint8_t sks[ECDSA_SIGN_BATCH * 32];
+  uint8_t digs[ECDSA_SIGN_BATCH * 32] = {0};
+  uint8_t sigs[ECDSA_SIGN_BATCH * 64] = {0};
+  uint8_t der[72] = {0};
+  size_t nkeys = 0, ndigests = 0;
+  mp_obj_t *keys = NULL, *digest_items = NULL;
+
+  mp_obj_get_array(secret_keys, &nkeys, &keys);
+  mp_obj_get_array(digests, &ndigests, &digest_items);
+  if (nkeys != ndigests) {
+    mp_raise_ValueError("Need one secret key per digest");
+  }
+  for (size_t i = 0; i < nkeys; i++) {
+    mp_buffer_info_t sk = {0}, dig = {0};
+    mp_get_buffer_raise(keys[i], &sk, MP_BUFFER_READ);
+    mp_get_buffer_raise(digest_items[i], &dig, MP_BUFFER_READ);
+    if (sk.len != 32) {
+      mp_raise_ValueError("Invalid length of secret key");
+    }
+    if (dig.len != 32) {
+      mp_raise_ValueError("Invalid length of digest");
+    }
+  }
+
+  mp_obj_t result = mp_obj_new_list(0, NULL);
+  for (size_t done = 0; done < nkeys;) {
+    size_t n = nkeys - done;
+    if (n > ECDSA_SIGN_BATCH) {
+      n = ECDSA_SIGN_BATCH;
+    }
+    for (size_t i = 0; i < n; i++) {
+      mp_buffer_info_t sk = {0}, dig = {0};
+      mp_get_buffer_raise(keys[done + i], &sk, MP_BUFFER_READ);
+      mp_get_buffer_raise(digest_items[done + i], &dig, MP_BUFFER_READ);
+      memcpy(sks + 32 * i, sk.buf, 32);
+      memcpy(digs + 32 * i, dig.buf, 32);
+    }
+    int res = ecdsa_sign_digest_batch(&secp256k1, n, sks, digs, sigs, NULL,
+                                      NULL);
+    memzero(sks, sizeof(sks));
+    if (res != 0) {
+      mp_raise_ValueError("Signing failed");
+    }
+    for (size_t i = 0; i < n; i++) {
+      int len = ecdsa_sig_to_der(sigs + 64 * i, der);
+      mp_obj_list_append(result, mp_obj_new_bytes(der, len));
+    }
+    done += n;
+  }
+
+  return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_secp256k1_sign_der_batch_obj,
+                                 mod_trezorcrypto_secp256k1_sign_der_batch);
+#endif
+
 /// def verify(public_key: bytes, signature: bytes, digest: bytes) -> bool:
 ///     """
 ///     Uses public key to verify the signature of the digest.
@@ -254,6 +322,10 @@ STATIC const mp_rom_map_elem_t mod_trezorcrypto_secp256k1_globals_table[] = {
      MP_ROM_PTR(&mod_trezorcrypto_secp256k1_publickey_obj)},
     {MP_ROM_QSTR(MP_QSTR_sign),
      MP_ROM_PTR(&mod_trezorcrypto_secp256k1_sign_obj)},
+#ifdef FOUNDATION_ADDITIONS
+    {MP_ROM_QSTR(MP_QSTR_sign_der_batch),
+     MP_ROM_PTR(&mod_trezorcrypto_secp256k1_sign_der_batch_obj)},
+#endif
     {MP_ROM_QSTR(MP_QSTR_verify),
      MP_ROM_PTR(&mod_trezorcrypto_secp256k1_verify_obj)},
     {MP_ROM_QSTR(MP_QSTR_verify_recover),
@@ -22,6 +22,11 @@
 #include "memzero.h"
 #include "sha2.h"
 
+// On Passport the HASH peripheral does the work (see hash_engine.h)
+#if HASH_ENGINE_HW
+#include "hash_engine.h"
+#endif
+
 /// package: trezorcrypto.__init__
 
 /// class sha256:
@@ -32,7 +37,11 @@
 ///     digest_size: int
 typedef struct _mp_obj_Sha256_t {
   mp_obj_base_t base;
+#if HASH_ENGINE_HW
+  hash_engine_ctx_t ctx;
+#else
   SHA256_CTX ctx;
+#endif
 } mp_obj_Sha256_t;
 
 STATIC mp_obj_t mod_trezorcrypto_Sha256_update(mp_obj_t self, mp_obj_t data);
@@ -47,7 +56,11 @@ STATIC mp_obj_t mod_trezorcrypto_Sha256_make_new(const mp_obj_type_t *type,
   mp_arg_check_num(n_args, n_kw, 0, 1, false);
   mp_obj_Sha256_t *o = m_new_obj_with_finaliser(mp_obj_Sha256_t);
   o->base.type = type;
+#if HASH_ENGINE_HW
+  hash_engine_sha256_init(&(o->ctx));
+#else
   sha256_Init(&(o->ctx));
+#endif
   // constructor called with bytes/str as first parameter
   if (n_args == 1) {
     mod_trezorcrypto_Sha256_update(MP_OBJ_FROM_PTR(o), args[0]);
@@ -64,7 +77,11 @@ STATIC mp_obj_t mod_trezorcrypto_Sha256_update(mp_obj_t self, mp_obj_t data) {
   mp_buffer_info_t msg = {0};
   mp_get_buffer_raise(data, &msg, MP_BUFFER_READ);
   if (msg.len > 0) {
+#if HASH_ENGINE_HW
+    hash_engine_sha256_update(&(o->ctx), msg.buf, msg.len);
+#else
     sha256_Update(&(o->ctx), msg.buf, msg.len);
+#endif
   }
   return mp_const_none;
 }
@@ -78,10 +95,16 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_trezorcrypto_Sha256_update_obj,
 STATIC mp_obj_t mod_trezorcrypto_Sha256_digest(mp_obj_t self) {
   mp_obj_Sha256_t *o = MP_OBJ_TO_PTR(self);
   uint8_t out[SHA256_DIGEST_LENGTH] = {0};
+#if HASH_ENGINE_HW
+  hash_engine_ctx_t ctx;
+  hash_engine_sha256_copy(&ctx, &(o->ctx));
+  hash_engine_sha256_final(&ctx, out);
+#else
   SHA256_CTX ctx = {0};
   memcpy(&ctx, &(o->ctx), sizeof(SHA256_CTX));
   sha256_Final(&ctx, out);
   memzero(&ctx, sizeof(SHA256_CTX));
+#endif
   return mp_obj_new_bytes(out, sizeof(out));
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_Sha256_digest_obj,
@@ -89,7 +112,11 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_Sha256_digest_obj,
 
 STATIC mp_obj_t mod_trezorcrypto_Sha256___del__(mp_obj_t self) {
   mp_obj_Sha256_t *o = MP_OBJ_TO_PTR(self);
+#if HASH_ENGINE_HW
+  hash_engine_sha256_release(&(o->ctx));
+#else
   memzero(&(o->ctx), sizeof(SHA256_CTX));
+#endif
   return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_trezorcrypto_Sha256___del___obj,
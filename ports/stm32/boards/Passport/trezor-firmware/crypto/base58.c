@@ -46,10 +46,75 @@ typedef uint32_t b58_almostmaxint_t;
 static const b58_almostmaxint_t b58_almostmaxint_mask =
     ((((b58_maxint_t)1) << b58_almostmaxint_bits) - 1);
 
+// The conversions below work on 32-bit limbs instead of single bytes/digits.
+// On the binary side a limb holds 4 bytes, on the base58 side it holds 5
+// digits (58^5 < 2^30), so every multiply-and-carry step consumes 4 bytes or
+// 5 digits at once.
+#define B58_LIMB_DIGITS 5
+#define B58_LIMB_BASE 656356768U  // 58^5
+
+static const uint32_t b58_pow58[B58_LIMB_DIGITS + 1] = {
+    1, 58, 3364, 195112, 11316496, 656356768,
+};
+
+// Returns floor(n / 58^5) and stores the remainder in *rem. Valid for
+// n < 2^62, which always holds since n = limb * 2^k + carry with
+// limb < 58^5, k <= 32 and carry < 2^32.
+//
+// A plain 64-bit division compiles to a variable-time libgcc call on 32-bit
+// ARM, so multiply by the reciprocal ceil(2^92 / 58^5) instead.
+static inline uint32_t b58_divmod_limb(b58_maxint_t n, uint32_t *rem) {
+  static const b58_maxint_t m = 0x68b2c7ad1a016ab5ULL;
+  uint32_t n0 = (uint32_t)n, n1 = (uint32_t)(n >> 32);
+  uint32_t m0 = (uint32_t)m, m1 = (uint32_t)(m >> 32);
+  b58_maxint_t p00 = (b58_maxint_t)n0 * m0;
+  b58_maxint_t p01 = (b58_maxint_t)n0 * m1;
+  b58_maxint_t p10 = (b58_maxint_t)n1 * m0;
+  b58_maxint_t p11 = (b58_maxint_t)n1 * m1;
+  b58_maxint_t mid = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+  b58_maxint_t hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+  b58_maxint_t q = hi >> 28;
+  *rem = (uint32_t)(n - q * B58_LIMB_BASE);
+  return (uint32_t)q;
+}
+
+// Branch-free digit -> character mapping, used where the digits are secret
+// and a table lookup could leak them through the data cache.
+static inline char b58_digit_to_char_ct(uint32_t d) {
+  uint32_t c = d + '1';
+  c += 7 & -((8 - d) >> 31);   // 'A'..'H'
+  c += 1 & -((16 - d) >> 31);  // 'J'..'N'
+  c += 1 & -((21 - d) >> 31);  // 'P'..'Z'
+  c += 6 & -((32 - d) >> 31);  // 'a'..'k'
+  c += 1 & -((43 - d) >> 31);  // 'm'..'z'
+  return (char)c;
+}
+
+// Branch-free character -> digit mapping. Sets *valid to 0 for characters
+// outside the alphabet without branching on the character itself.
+static inline uint32_t b58_char_to_digit_ct(uint32_t ch, uint32_t *valid) {
+  static const struct {
+    uint8_t lo, hi, base;
+  } ranges[] = {
+      {'1', '9', 0},  {'A', 'H', 9},  {'J', 'N', 17},
+      {'P', 'Z', 22}, {'a', 'k', 33}, {'m', 'z', 44},
+  };
+  uint32_t d = 0, found = 0;
+  for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+    uint32_t in = ((uint32_t)(ranges[r].lo - 1 - ch) >> 31) &
+                  ((uint32_t)(ch - ranges[r].hi - 1) >> 31);
+    d |= -in & (ch - ranges[r].lo + ranges[r].base);
+    found |= in;
+  }
+  *valid &= found;
+  return d;
+}
+
 // Decodes a null-terminated Base58 string `b58` to binary and writes the result
 // at the end of the buffer `bin` of size `*binszp`. On success `*binszp` is set
 // to the number of valid bytes at the end of the buffer.
-bool b58tobin(void *bin, size_t *binszp, const char *b58) {
+static bool b58tobin_impl(void *bin, size_t *binszp, const char *b58,
+                          bool const_time) {
   size_t binsz = *binszp;
 
   if (binsz == 0) {
@@ -68,32 +133,55 @@ bool b58tobin(void *bin, size_t *binszp, const char *b58) {
   b58_almostmaxint_t zeromask =
       bytesleft ? (b58_almostmaxint_mask << (bytesleft * 8)) : 0;
   unsigned zerocount = 0;
+  uint32_t valid = 1, overflow = 0;
 
   size_t b58sz = strlen(b58);
 
   memzero(outi, sizeof(outi));
 
   // Leading zeros, just count
-  for (i = 0; i < b58sz && b58u[i] == '1'; ++i) ++zerocount;
+  if (const_time) {
+    uint32_t leading = 1;
+    for (i = 0; i < b58sz; ++i) {
+      leading &= ((uint32_t)(b58u[i] ^ '1') - 1) >> 31;
+      zerocount += leading;
+    }
+  } else {
+    for (i = 0; i < b58sz && b58u[i] == '1'; ++i) ++zerocount;
+  }
 
-  for (; i < b58sz; ++i) {
-    if (b58u[i] & 0x80)
-      // High-bit set on invalid digit
-      return false;
-    if (b58digits_map[b58u[i]] == -1)
-      // Invalid base58 digit
-      return false;
-    c = (unsigned)b58digits_map[b58u[i]];
+  // The leading '1's are plain zero digits, so they can go through the limb
+  // loop as well; this keeps the loop shape independent of the data.
+  i = const_time ? 0 : zerocount;
+  while (i < b58sz) {
+    size_t n = b58sz - i;
+    if (n > B58_LIMB_DIGITS) n = B58_LIMB_DIGITS;
+    c = 0;
+    for (size_t k = 0; k < n; ++k, ++i) {
+      uint32_t d = 0;
+      if (const_time) {
+        d = b58_char_to_digit_ct(b58u[i], &valid);
+      } else {
+        if (b58u[i] & 0x80)
+          // High-bit set on invalid digit
+          return false;
+        if (b58digits_map[b58u[i]] == -1)
+          // Invalid base58 digit
+          return false;
+        d = (unsigned)b58digits_map[b58u[i]];
+      }
+      c = c * 58 + d;
+    }
     for (j = outisz; j--;) {
-      t = ((b58_maxint_t)outi[j]) * 58 + c;
+      t = ((b58_maxint_t)outi[j]) * b58_pow58[n] + c;
       c = t >> b58_almostmaxint_bits;
       outi[j] = t & b58_almostmaxint_mask;
     }
-    if (c)
-      // Output number too big (carry to the next int32)
-      return false;
-    if (outi[0] & zeromask)
-      // Output number too big (last int32 filled too far)
+    // Overflow is monotonic in the input, so checking once per limb is
+    // equivalent to checking after every digit.
+    overflow |= c | (outi[0] & zeromask);
+    if (overflow && !const_time)
+      // Output number too big
       return false;
   }
 
@@ -110,11 +198,26 @@ bool b58tobin(void *bin, size_t *binszp, const char *b58) {
       *(binu++) = (outi[j] >> (8 * (i - 1))) & 0xff;
     }
   }
+  memzero(outi, sizeof(outi));
+
+  if (const_time && (!valid || overflow)) {
+    return false;
+  }
 
   // locate the most significant byte
   binu = bin;
-  for (i = 0; i < binsz; ++i) {
-    if (binu[i]) break;
+  if (const_time) {
+    size_t msb = 0;
+    uint32_t leading = 1;
+    for (i = 0; i < binsz; ++i) {
+      leading &= ((uint32_t)binu[i] - 1) >> 31;
+      msb += leading;
+    }
+    i = msb;
+  } else {
+    for (i = 0; i < binsz; ++i) {
+      if (binu[i]) break;
+    }
   }
 
   // prepend the correct number of null-bytes
@@ -127,6 +230,14 @@ bool b58tobin(void *bin, size_t *binszp, const char *b58) {
   return true;
 }
 
+bool b58tobin(void *bin, size_t *binszp, const char *b58) {
+  return b58tobin_impl(bin, binszp, b58, false);
+}
+
+bool b58tobin_ct(void *bin, size_t *binszp, const char *b58) {
+  return b58tobin_impl(bin, binszp, b58, true);
+}
+
 int b58check(const void *bin, size_t binsz, HasherType hasher_type,
              const char *base58str) {
   unsigned char buf[32] = {0};
@@ -145,23 +256,44 @@ int b58check(const void *bin, size_t binsz, HasherType hasher_type,
   return binc[0];
 }
 
-bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz) {
+static bool b58enc_impl(char *b58, size_t *b58sz, const void *data,
+                        size_t binsz, bool const_time) {
   const uint8_t *bin = data;
-  int carry = 0;
+  uint32_t carry = 0;
   size_t i = 0, j = 0, high = 0, zcount = 0;
-  size_t size = 0;
+  size_t size = 0, limbs = 0;
 
-  while (zcount < binsz && !bin[zcount]) ++zcount;
+  if (const_time) {
+    uint32_t leading = 1;
+    for (i = 0; i < binsz; ++i) {
+      leading &= ((uint32_t)bin[i] - 1) >> 31;
+      zcount += leading;
+    }
+    // Size everything after the public length only.
+    size = binsz * 138 / 100 + 1;
+    i = 0;
+  } else {
+    while (zcount < binsz && !bin[zcount]) ++zcount;
+    size = (binsz - zcount) * 138 / 100 + 1;
+    i = zcount;
+  }
 
-  size = (binsz - zcount) * 138 / 100 + 1;
+  limbs = (size + B58_LIMB_DIGITS - 1) / B58_LIMB_DIGITS;
+  size = limbs * B58_LIMB_DIGITS;
+  uint32_t out[limbs];
   uint8_t buf[size];
-  memzero(buf, size);
-
-  for (i = zcount, high = size - 1; i < binsz; ++i, high = j) {
-    for (carry = bin[i], j = size - 1; (j > high) || carry; --j) {
-      carry += 256 * buf[j];
-      buf[j] = carry % 58;
-      carry /= 58;
+  memzero(out, sizeof(out));
+
+  // The first limb takes the odd bytes so that the rest are whole words.
+  size_t n = (binsz - i) % 4;
+  if (n == 0) n = 4;
+  for (high = limbs - 1; i < binsz; i += n, n = 4, high = j) {
+    for (size_t k = 0; k < n; ++k) {
+      carry = (carry << 8) | bin[i + k];
+    }
+    for (j = limbs - 1; const_time || (j > high) || carry; --j) {
+      b58_maxint_t t = ((b58_maxint_t)out[j] << (8 * n)) + carry;
+      carry = b58_divmod_limb(t, &out[j]);
       if (!j) {
         // Otherwise j wraps to maxint which is > high
         break;
@@ -169,6 +301,47 @@ bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz) {
     }
   }
 
+  // Unpack the limbs into single digits, most significant first.
+  for (j = 0; j < limbs; ++j) {
+    uint32_t limb = out[j];
+    for (size_t k = B58_LIMB_DIGITS; k--;) {
+      buf[j * B58_LIMB_DIGITS + k] = limb % 58;
+      limb /= 58;
+    }
+  }
+  memzero(out, sizeof(out));
+
+  if (const_time) {
+    // Count the leading zero digits, then shift them out so that exactly
+    // `zcount` of them remain (zero digits encode as '1'). The shift is done
+    // one bit of the distance at a time, touching every byte on each pass.
+    size_t lead = 0;
+    uint32_t leading = 1;
+    for (j = 0; j < size; ++j) {
+      leading &= ((uint32_t)buf[j] - 1) >> 31;
+      lead += leading;
+    }
+    size_t shift = lead - zcount;
+    for (size_t bit = 1; bit < size; bit <<= 1) {
+      uint8_t mask = -(uint8_t)((shift & bit) != 0);
+      for (j = 0; j < size; ++j) {
+        uint8_t src = (j + bit < size) ? buf[j + bit] : 0;
+        buf[j] = (buf[j] & ~mask) | (src & mask);
+      }
+    }
+    size_t len = size - lead + zcount;
+    if (*b58sz <= len) {
+      *b58sz = len + 1;
+      memzero(buf, sizeof(buf));
+      return false;
+    }
+    for (i = 0; i < len; ++i) b58[i] = b58_digit_to_char_ct(buf[i]);
+    b58[i] = '\0';
+    *b58sz = i + 1;
+    memzero(buf, sizeof(buf));
+    return true;
+  }
+
   for (j = 0; j < size && !buf[j]; ++j)
     ;
 
@@ -185,8 +358,17 @@ bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz) {
   return true;
 }
 
-int base58_encode_check(const uint8_t *data, int datalen,
-                        HasherType hasher_type, char *str, int strsize) {
+bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz) {
+  return b58enc_impl(b58, b58sz, data, binsz, false);
+}
+
+bool b58enc_ct(char *b58, size_t *b58sz, const void *data, size_t binsz) {
+  return b58enc_impl(b58, b58sz, data, binsz, true);
+}
+
+static int base58_encode_check_impl(const uint8_t *data, int datalen,
+                                    HasherType hasher_type, char *str,
+                                    int strsize, bool const_time) {
   if (datalen > 128) {
     return 0;
   }
@@ -196,30 +378,56 @@ int base58_encode_check(const uint8_t *data, int datalen,
   memcpy(buf, data, datalen);
   hasher_Raw(hasher_type, data, datalen, hash);
   size_t res = strsize;
-  bool success = b58enc(str, &res, buf, datalen + 4);
+  bool success = b58enc_impl(str, &res, buf, datalen + 4, const_time);
   memzero(buf, sizeof(buf));
   return success ? res : 0;
 }
 
-int base58_decode_check(const char *str, HasherType hasher_type, uint8_t *data,
-                        int datalen) {
+int base58_encode_check(const uint8_t *data, int datalen,
+                        HasherType hasher_type, char *str, int strsize) {
+  return base58_encode_check_impl(data, datalen, hasher_type, str, strsize,
+                                  false);
+}
+
+int base58_encode_check_ct(const uint8_t *data, int datalen,
+                           HasherType hasher_type, char *str, int strsize) {
+  return base58_encode_check_impl(data, datalen, hasher_type, str, strsize,
+                                  true);
+}
+
+static int base58_decode_check_impl(const char *str, HasherType hasher_type,
+                                    uint8_t *data, int datalen,
+                                    bool const_time) {
   if (datalen > 128) {
     return 0;
   }
   uint8_t d[datalen + 4];
   memset(d, 0, sizeof(d));
   size_t res = datalen + 4;
-  if (b58tobin(d, &res, str) != true) {
+  if (b58tobin_impl(d, &res, str, const_time) != true) {
+    memzero(d, sizeof(d));
     return 0;
   }
   uint8_t *nd = d + datalen + 4 - res;
   if (b58check(nd, res, hasher_type, str) < 0) {
+    memzero(d, sizeof(d));
     return 0;
   }
   memcpy(data, nd, res - 4);
+  memzero(d, sizeof(d));
   return res - 4;
 }
 
+int base58_decode_check(const char *str, HasherType hasher_type, uint8_t *data,
+                        int datalen) {
+  return base58_decode_check_impl(str, hasher_type, data, datalen, false);
+}
+
+int base58_decode_check_ct(const char *str, HasherType hasher_type,
+                           uint8_t *data, int datalen) {
+  return base58_decode_check_impl(str, hasher_type, data, datalen, true);
+}
+
 #if USE_GRAPHENE
 int b58gphcheck(const void *bin, size_t binsz, const char *base58str) {
   unsigned char buf[32] = {0};
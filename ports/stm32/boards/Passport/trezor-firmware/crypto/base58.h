@@ -37,11 +37,20 @@ int base58_encode_check(const uint8_t *data, int len, HasherType hasher_type,
 int base58_decode_check(const char *str, HasherType hasher_type, uint8_t *data,
                         int datalen);
 
+// Same as above, but with running time independent of the encoded value (only
+// the length is public). Use these for private data such as xprvs and WIF.
+int base58_encode_check_ct(const uint8_t *data, int len,
+                           HasherType hasher_type, char *str, int strsize);
+int base58_decode_check_ct(const char *str, HasherType hasher_type,
+                           uint8_t *data, int datalen);
+
 // Private
 bool b58tobin(void *bin, size_t *binszp, const char *b58);
 int b58check(const void *bin, size_t binsz, HasherType hasher_type,
              const char *base58str);
 bool b58enc(char *b58, size_t *b58sz, const void *data, size_t binsz);
+bool b58tobin_ct(void *bin, size_t *binszp, const char *b58);
+bool b58enc_ct(char *b58, size_t *b58sz, const void *data, size_t binsz);
 
 #if USE_GRAPHENE
 int base58gph_encode_check(const uint8_t *data, int datalen, char *str,
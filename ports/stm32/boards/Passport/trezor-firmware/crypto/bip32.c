@@ -203,7 +203,8 @@ uint32_t hdnode_fingerprint(HDNode *node) {
   return fingerprint;
 }
 
-int hdnode_private_ckd(HDNode *inout, uint32_t i) {
+static int hdnode_private_ckd_midstate(HDNode *inout, uint32_t i,
+                                       const HDNodeMidstate *midstate) {
   static CONFIDENTIAL uint8_t data[1 + 32 + 4];
   static CONFIDENTIAL uint8_t I[32 + 32];
   static CONFIDENTIAL bignum256 a, b;
@@ -223,7 +224,7 @@ int hdnode_private_ckd(HDNode *inout, uint32_t i) {
   bn_read_be(inout->private_key, &a);
 
   static CONFIDENTIAL HMAC_SHA512_CTX ctx;
-  hmac_sha512_Init(&ctx, inout->chain_code, 32);
+  hmac_sha512_InitPrepared(&ctx, midstate->opad_digest, midstate->ipad_digest);
   hmac_sha512_Update(&ctx, data, sizeof(data));
   hmac_sha512_Final(&ctx, I);
 
@@ -248,7 +249,8 @@ int hdnode_private_ckd(HDNode *inout, uint32_t i) {
 
       data[0] = 1;
       memcpy(data + 1, I + 32, 32);
-      hmac_sha512_Init(&ctx, inout->chain_code, 32);
+      hmac_sha512_InitPrepared(&ctx, midstate->opad_digest,
+                               midstate->ipad_digest);
       hmac_sha512_Update(&ctx, data, sizeof(data));
       hmac_sha512_Final(&ctx, I);
     }
@@ -269,6 +271,32 @@ int hdnode_private_ckd(HDNode *inout, uint32_t i) {
   return 1;
 }
 
+int hdnode_private_ckd(HDNode *inout, uint32_t i) {
+  static CONFIDENTIAL HDNodeMidstate midstate;
+  hmac_sha512_prepare(inout->chain_code, 32, midstate.opad_digest,
+                      midstate.ipad_digest);
+  int res = hdnode_private_ckd_midstate(inout, i, &midstate);
+  memzero(&midstate, sizeof(midstate));
+  return res;
+}
+
+void hdnode_private_ckd_prepare(HDNode *parent, HDNodeMidstate *midstate) {
+  if (parent->curve->params) {
+    hdnode_fill_public_key(parent);
+  }
+  hmac_sha512_prepare(parent->chain_code, 32, midstate->opad_digest,
+                      midstate->ipad_digest);
+}
+
+int hdnode_private_ckd_prepared(const HDNode *parent,
+                                const HDNodeMidstate *midstate, uint32_t i,
+                                HDNode *child) {
+  if (child != parent) {
+    memcpy(child, parent, sizeof(HDNode));
+  }
+  return hdnode_private_ckd_midstate(child, i, midstate);
+}
+
 #if USE_CARDANO
 static void scalar_multiply8(const uint8_t *src, int bytes, uint8_t *dst) {
   uint8_t prev_acc = 0;
@@ -838,8 +866,14 @@ static int hdnode_serialize(const HDNode *node, uint32_t fingerprint,
   } else {
     memcpy(node_data + 45, node->public_key, 33);
   }
-  int ret = base58_encode_check(node_data, sizeof(node_data),
-                                node->curve->hasher_base58, str, strsize);
+  int ret = 0;
+  if (use_private) {
+    ret = base58_encode_check_ct(node_data, sizeof(node_data),
+                                 node->curve->hasher_base58, str, strsize);
+  } else {
+    ret = base58_encode_check(node_data, sizeof(node_data),
+                              node->curve->hasher_base58, str, strsize);
+  }
   memzero(node_data, sizeof(node_data));
   return ret;
 }
@@ -861,8 +895,15 @@ static int hdnode_deserialize(const char *str, uint32_t version,
   uint8_t node_data[78] = {0};
   memzero(node, sizeof(HDNode));
   node->curve = get_curve_by_name(curve);
-  if (base58_decode_check(str, node->curve->hasher_base58, node_data,
-                          sizeof(node_data)) != sizeof(node_data)) {
+  int len = 0;
+  if (use_private) {
+    len = base58_decode_check_ct(str, node->curve->hasher_base58, node_data,
+                                 sizeof(node_data));
+  } else {
+    len = base58_decode_check(str, node->curve->hasher_base58, node_data,
+                              sizeof(node_data));
+  }
+  if (len != sizeof(node_data)) {
     return -1;
   }
   uint32_t ver = read_be(node_data);
@@ -30,6 +30,7 @@
 #include "ecdsa.h"
 #include "ed25519-donna/ed25519.h"
 #include "options.h"
+#include "sha2.h"
 
 typedef struct {
   const char *bip32_name;     // string for generating BIP32 xprv from seed
@@ -53,6 +54,13 @@ typedef struct {
   const curve_info *curve;
 } HDNode;
 
+// HMAC-SHA512 midstates of a node's chain code, for deriving several children
+// of the same parent
+typedef struct {
+  uint64_t opad_digest[SHA512_DIGEST_LENGTH / sizeof(uint64_t)];
+  uint64_t ipad_digest[SHA512_DIGEST_LENGTH / sizeof(uint64_t)];
+} HDNodeMidstate;
+
 int hdnode_from_xpub(uint32_t depth, uint32_t child_num,
                      const uint8_t *chain_code, const uint8_t *public_key,
                      const char *curve, HDNode *out);
@@ -69,6 +77,14 @@ int hdnode_from_seed(const uint8_t *seed, int seed_len, const char *curve,
 
 int hdnode_private_ckd(HDNode *inout, uint32_t i);
 
+// Fills in the parent's public key and hashes its chain code's HMAC pads once,
+// so each hdnode_private_ckd_prepared() from it skips a point multiplication
+// and two of the four SHA-512 blocks that hdnode_private_ckd() would spend
+void hdnode_private_ckd_prepare(HDNode *parent, HDNodeMidstate *midstate);
+int hdnode_private_ckd_prepared(const HDNode *parent,
+                                const HDNodeMidstate *midstate, uint32_t i,
+                                HDNode *child);
+
 #if USE_CARDANO
 int hdnode_private_ckd_cardano(HDNode *inout, uint32_t i);
 int hdnode_from_seed_cardano(const uint8_t *seed, int seed_len, HDNode *out);
@@ -197,10 +197,11 @@ void curve_to_jacobian(const curve_point *p, jacobian_curve_point *jp,
   bn_multiply(&p->y, &jp->y, prime);
 }
 
-void jacobian_to_curve(const jacobian_curve_point *jp, curve_point *p,
-                       const bignum256 *prime) {
-  p->y = jp->z;
-  bn_inverse(&p->y, prime);
+// Same as jacobian_to_curve, given zinv = z^-1
+static void jacobian_to_curve_zinv(const jacobian_curve_point *jp,
+                                   const bignum256 *zinv, curve_point *p,
+                                   const bignum256 *prime) {
+  p->y = *zinv;
   // p->y = z^-1
   p->x = p->y;
   bn_multiply(&p->x, &p->x, prime);
@@ -215,6 +216,14 @@ void jacobian_to_curve(const jacobian_curve_point *jp, curve_point *p,
   bn_mod(&p->y, prime);
 }
 
+void jacobian_to_curve(const jacobian_curve_point *jp, curve_point *p,
+                       const bignum256 *prime) {
+  bignum256 zinv = jp->z;
+  bn_inverse(&zinv, prime);
+  jacobian_to_curve_zinv(jp, &zinv, p, prime);
+  memzero(&zinv, sizeof(zinv));
+}
+
 void point_jacobian_add(const curve_point *p1, jacobian_curve_point *p2,
                         const ecdsa_curve *curve) {
   bignum256 r = {0}, h = {0}, r2 = {0};
@@ -402,9 +411,10 @@ void point_jacobian_double(jacobian_curve_point *p, const ecdsa_curve *curve) {
   bn_fast_mod(&p->y, prime);
 }
 
-// res = k * p
-void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
-                    const curve_point *p, curve_point *res) {
+// jres = k * p. Returns 0, leaving jres unset, if k is zero.
+static int point_multiply_jacobian(const ecdsa_curve *curve,
+                                   const bignum256 *k, const curve_point *p,
+                                   jacobian_curve_point *jres) {
   // this algorithm is loosely based on
   //  Katsuyuki Okeya and Tsuyoshi Takagi, The Width-w NAF Method Provides
   //  Small Memory and Fast Elliptic Scalar Multiplications Secure against
@@ -418,7 +428,6 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
   int ashift = 0;
   uint32_t is_even = (k->val[0] & 1) - 1;
   uint32_t bits = {0}, sign = {0}, nsign = {0};
-  static CONFIDENTIAL jacobian_curve_point jres;
   curve_point pmult[8] = {0};
   const bignum256 *prime = &curve->prime;
 
@@ -440,8 +449,7 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
 
   // special case 0*p:  just return zero. We don't care about constant time.
   if (!is_non_zero) {
-    point_set_infinity(res);
-    return;
+    return 0;
   }
 
   // Now a = k + 2^256 (mod curve->order) and a is odd.
@@ -482,16 +490,16 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
   sign = (bits >> 4) - 1;
   bits ^= sign;
   bits &= 15;
-  curve_to_jacobian(&pmult[bits >> 1], &jres, prime);
+  curve_to_jacobian(&pmult[bits >> 1], jres, prime);
   for (i = 62; i >= 0; i--) {
     // sign = sign(a[i+1])  (0xffffffff for negative, 0 for positive)
     // invariant jres = (-1)^sign sum_{j=i+1..63} (a[j] * 16^{j-i-1} * p)
     // abits >> (ashift - 4) = lowbits(a >> (i*4))
 
-    point_jacobian_double(&jres, curve);
-    point_jacobian_double(&jres, curve);
-    point_jacobian_double(&jres, curve);
-    point_jacobian_double(&jres, curve);
+    point_jacobian_double(jres, curve);
+    point_jacobian_double(jres, curve);
+    point_jacobian_double(jres, curve);
+    point_jacobian_double(jres, curve);
 
     // get lowest 5 bits of a >> (i*4).
     ashift -= 4;
@@ -512,31 +520,42 @@ void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
 
     // negate last result to make signs of this round and the
     // last round equal.
-    bn_cnegate((sign ^ nsign) & 1, &jres.z, prime);
+    bn_cnegate((sign ^ nsign) & 1, &jres->z, prime);
 
     // add odd factor
-    point_jacobian_add(&pmult[bits >> 1], &jres, curve);
+    point_jacobian_add(&pmult[bits >> 1], jres, curve);
     sign = nsign;
   }
-  bn_cnegate(sign & 1, &jres.z, prime);
-  jacobian_to_curve(&jres, res, prime);
+  bn_cnegate(sign & 1, &jres->z, prime);
   memzero(&a, sizeof(a));
+  return 1;
+}
+
+// res = k * p
+void point_multiply(const ecdsa_curve *curve, const bignum256 *k,
+                    const curve_point *p, curve_point *res) {
+  static CONFIDENTIAL jacobian_curve_point jres;
+  if (!point_multiply_jacobian(curve, k, p, &jres)) {
+    point_set_infinity(res);
+    return;
+  }
+  jacobian_to_curve(&jres, res, &curve->prime);
   memzero(&jres, sizeof(jres));
 }
 
 #if USE_PRECOMPUTED_CP
 
-// res = k * G
+// jres = k * G. Returns 0, leaving jres unset, if k is zero.
 // k must be a normalized number with 0 <= k < curve->order
-void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
-                     curve_point *res) {
+static int scalar_multiply_jacobian(const ecdsa_curve *curve,
+                                    const bignum256 *k,
+                                    jacobian_curve_point *jres) {
   assert(bn_is_less(k, &curve->order));
 
   int i = {0}, j = {0};
   static CONFIDENTIAL bignum256 a;
   uint32_t is_even = (k->val[0] & 1) - 1;
   uint32_t lowbits = 0;
-  static CONFIDENTIAL jacobian_curve_point jres;
   const bignum256 *prime = &curve->prime;
 
   // is_even = 0xffffffff if k is even, 0 otherwise.
@@ -557,8 +576,7 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
 
   // special case 0*G:  just return zero. We don't care about constant time.
   if (!is_non_zero) {
-    point_set_infinity(res);
-    return;
+    return 0;
   }
 
   // Now a = k + 2^256 (mod curve->order) and a is odd.
@@ -584,7 +602,7 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
   lowbits = a.val[0] & ((1 << 5) - 1);
   lowbits ^= (lowbits >> 4) - 1;
   lowbits &= 15;
-  curve_to_jacobian(&curve->cp[0][lowbits >> 1], &jres, prime);
+  curve_to_jacobian(&curve->cp[0][lowbits >> 1], jres, prime);
   for (i = 1; i < 64; i++) {
     // invariant res = sign(a[i-1]) sum_{j=0..i-1} (a[j] * 16^j * G)
 
@@ -602,19 +620,37 @@ void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
     lowbits &= 15;
     // negate last result to make signs of this round and the
     // last round equal.
-    bn_cnegate(~lowbits & 1, &jres.y, prime);
+    bn_cnegate(~lowbits & 1, &jres->y, prime);
 
     // add odd factor
-    point_jacobian_add(&curve->cp[i][lowbits >> 1], &jres, curve);
+    point_jacobian_add(&curve->cp[i][lowbits >> 1], jres, curve);
   }
-  bn_cnegate(~(a.val[0] >> 4) & 1, &jres.y, prime);
-  jacobian_to_curve(&jres, res, prime);
+  bn_cnegate(~(a.val[0] >> 4) & 1, &jres->y, prime);
   memzero(&a, sizeof(a));
+  return 1;
+}
+
+// res = k * G
+// k must be a normalized number with 0 <= k < curve->order
+void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
+                     curve_point *res) {
+  static CONFIDENTIAL jacobian_curve_point jres;
+  if (!scalar_multiply_jacobian(curve, k, &jres)) {
+    point_set_infinity(res);
+    return;
+  }
+  jacobian_to_curve(&jres, res, &curve->prime);
   memzero(&jres, sizeof(jres));
 }
 
 #else
 
+static int scalar_multiply_jacobian(const ecdsa_curve *curve,
+                                    const bignum256 *k,
+                                    jacobian_curve_point *jres) {
+  return point_multiply_jacobian(curve, k, &curve->G, jres);
+}
+
 void scalar_multiply(const ecdsa_curve *curve, const bignum256 *k,
                      curve_point *res) {
   point_multiply(curve, k, &curve->G, res);
@@ -754,6 +790,186 @@ int ecdsa_sign_digest(const ecdsa_curve *curve, const uint8_t *priv_key,
   return -1;
 }
 
+// x[i] = 1/x[i] % prime for i < count, with one bn_inverse (Montgomery's
+// trick). All x[i] must be non-zero. tmp needs room for count values.
+// Guarantees x[i] is normalized and partly reduced modulo prime
+static void bn_inverse_batch(bignum256 *x, bignum256 *tmp, size_t count,
+                             const bignum256 *prime) {
+  bignum256 inv = {0}, xinv = {0};
+
+  // tmp[i] = x[0] * ... * x[i]
+  tmp[0] = x[0];
+  for (size_t i = 1; i < count; i++) {
+    tmp[i] = x[i];
+    bn_multiply(&tmp[i - 1], &tmp[i], prime);
+  }
+
+  inv = tmp[count - 1];
+  bn_inverse(&inv, prime);
+  // inv = 1 / (x[0] * ... * x[count - 1])
+
+  for (size_t i = count - 1; i > 0; i--) {
+    xinv = tmp[i - 1];
+    bn_multiply(&inv, &xinv, prime);
+    // xinv = 1 / x[i]
+    bn_multiply(&x[i], &inv, prime);
+    // inv = 1 / (x[0] * ... * x[i - 1])
+    x[i] = xinv;
+  }
+  x[0] = inv;
+
+  memzero(&inv, sizeof(inv));
+  memzero(&xinv, sizeof(xinv));
+}
+
+// Signs up to ECDSA_SIGN_BATCH digests for ecdsa_sign_digest_batch
+static int ecdsa_sign_digest_chunk(
+    const ecdsa_curve *curve, size_t count, const uint8_t *priv_keys,
+    const uint8_t *digests, uint8_t *sigs, uint8_t *pbys,
+    int (*is_canonical)(uint8_t by, uint8_t sig[64])) {
+  static CONFIDENTIAL bignum256 k[ECDSA_SIGN_BATCH];
+  static CONFIDENTIAL bignum256 randk[ECDSA_SIGN_BATCH];
+  static CONFIDENTIAL bignum256 inv[ECDSA_SIGN_BATCH];
+  static CONFIDENTIAL bignum256 tmp[ECDSA_SIGN_BATCH];
+  static CONFIDENTIAL jacobian_curve_point R[ECDSA_SIGN_BATCH];
+  static CONFIDENTIAL curve_point P;
+  uint8_t by[ECDSA_SIGN_BATCH] = {0};
+  bool batched[ECDSA_SIGN_BATCH] = {0};
+  bignum256 z = {0};
+  bignum256 *s = &P.y;
+  int res = 0;
+
+  // nonces and k*G, left in Jacobian coordinates
+  for (size_t i = 0; i < count; i++) {
+#if USE_RFC6979
+    rfc6979_state rng = {0};
+    init_rfc6979(priv_keys + 32 * i, digests + 32 * i, &rng);
+    generate_k_rfc6979(&k[i], &rng);
+    memzero(&rng, sizeof(rng));
+    batched[i] = !bn_is_zero(&k[i]) && bn_is_less(&k[i], &curve->order);
+#else
+    generate_k_random(&k[i], &curve->order);
+    batched[i] = true;
+#endif
+    if (batched[i]) {
+      scalar_multiply_jacobian(curve, &k[i], &R[i]);
+      inv[i] = R[i].z;
+    } else {
+      bn_one(&inv[i]);
+    }
+  }
+
+  // one inversion for all the conversions to affine coordinates
+  bn_inverse_batch(inv, tmp, count, &curve->prime);
+
+  for (size_t i = 0; i < count; i++) {
+    if (batched[i]) {
+      jacobian_to_curve_zinv(&R[i], &inv[i], &P, &curve->prime);
+      by[i] = P.y.val[0] & 1;
+      // r = (rx mod n)
+      if (!bn_is_less(&P.x, &curve->order)) {
+        bn_subtract(&P.x, &curve->order, &P.x);
+        by[i] |= 2;
+      }
+      if (bn_is_zero(&P.x)) {
+        batched[i] = false;
+      }
+      R[i].x = P.x;
+    }
+
+    // randomize operations to counter side-channel attacks
+    if (batched[i]) {
+      generate_k_random(&randk[i], &curve->order);
+      inv[i] = k[i];
+      bn_multiply(&randk[i], &inv[i], &curve->order);  // k*rand
+    } else {
+      bn_one(&inv[i]);
+    }
+  }
+
+  // and one for all the (k*rand)^-1
+  bn_inverse_batch(inv, tmp, count, &curve->order);
+
+  for (size_t i = 0; i < count; i++) {
+    uint8_t *sig = sigs + 64 * i;
+
+    if (batched[i]) {
+      bn_read_be(digests + 32 * i, &z);
+      bn_read_be(priv_keys + 32 * i, s);    // priv
+      bn_multiply(&R[i].x, s, &curve->order);  // R.x*priv
+      bn_add(s, &z);                           // R.x*priv + z
+      bn_multiply(&inv[i], s, &curve->order);  // (k*rand)^-1 (R.x*priv + z)
+      bn_multiply(&randk[i], s, &curve->order);  // k^-1 (R.x*priv + z)
+      bn_mod(s, &curve->order);
+      if (bn_is_zero(s)) {
+        batched[i] = false;
+      }
+    }
+
+    if (batched[i]) {
+      // if S > order/2 => S = -S
+      if (bn_is_less(&curve->order_half, s)) {
+        bn_subtract(&curve->order, s, s);
+        by[i] ^= 1;
+      }
+      bn_write_be(&R[i].x, sig);
+      bn_write_be(s, sig + 32);
+      if (is_canonical && !is_canonical(by[i], sig)) {
+        batched[i] = false;
+      }
+    }
+
+    if (batched[i]) {
+      if (pbys) {
+        pbys[i] = by[i];
+      }
+    } else {
+      // The first nonce was no good, which ecdsa_sign_digest will find too
+      // before moving on to the next one
+      if (ecdsa_sign_digest(curve, priv_keys + 32 * i, digests + 32 * i, sig,
+                            pbys ? &pbys[i] : NULL, is_canonical) != 0) {
+        res = -1;
+        break;
+      }
+    }
+  }
+
+  memzero(k, sizeof(k));
+  memzero(randk, sizeof(randk));
+  memzero(inv, sizeof(inv));
+  memzero(tmp, sizeof(tmp));
+  memzero(R, sizeof(R));
+  memzero(&P, sizeof(P));
+  memzero(&z, sizeof(z));
+  return res;
+}
+
+// priv_keys and digests hold count 32 byte values back to back, and sigs gets
+// count 64 byte signatures. The signatures are the same as ecdsa_sign_digest
+// gives, but the nonce points' conversions to affine coordinates and the
+// nonce inversions are done ECDSA_SIGN_BATCH at a time, with one modular
+// inversion each.
+int ecdsa_sign_digest_batch(const ecdsa_curve *curve, size_t count,
+                            const uint8_t *priv_keys, const uint8_t *digests,
+                            uint8_t *sigs, uint8_t *pbys,
+                            int (*is_canonical)(uint8_t by, uint8_t sig[64])) {
+  while (count > 0) {
+    size_t n = count < ECDSA_SIGN_BATCH ? count : ECDSA_SIGN_BATCH;
+    if (ecdsa_sign_digest_chunk(curve, n, priv_keys, digests, sigs, pbys,
+                                is_canonical) != 0) {
+      return -1;
+    }
+    priv_keys += 32 * n;
+    digests += 32 * n;
+    sigs += 64 * n;
+    if (pbys) {
+      pbys += n;
+    }
+    count -= n;
+  }
+  return 0;
+}
+
 void ecdsa_get_public_key33(const ecdsa_curve *curve, const uint8_t *priv_key,
                             uint8_t *pub_key) {
   curve_point R = {0};
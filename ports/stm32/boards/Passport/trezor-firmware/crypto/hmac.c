@@ -29,20 +29,20 @@
 
 void hmac_sha256_Init(HMAC_SHA256_CTX *hctx, const uint8_t *key,
                       const uint32_t keylen) {
-  static CONFIDENTIAL uint8_t i_key_pad[SHA256_BLOCK_LENGTH];
-  memzero(i_key_pad, SHA256_BLOCK_LENGTH);
-  if (keylen > SHA256_BLOCK_LENGTH) {
-    sha256_Raw(key, keylen, i_key_pad);
-  } else {
-    memcpy(i_key_pad, key, keylen);
-  }
-  for (int i = 0; i < SHA256_BLOCK_LENGTH; i++) {
-    hctx->o_key_pad[i] = i_key_pad[i] ^ 0x5c;
-    i_key_pad[i] ^= 0x36;
-  }
-  sha256_Init(&(hctx->ctx));
-  sha256_Update(&(hctx->ctx), i_key_pad, SHA256_BLOCK_LENGTH);
-  memzero(i_key_pad, sizeof(i_key_pad));
+  static CONFIDENTIAL uint32_t ipad_digest[SHA256_DIGEST_LENGTH /
+                                           sizeof(uint32_t)];
+  hmac_sha256_prepare(key, keylen, hctx->odig, ipad_digest);
+  hmac_sha256_InitPrepared(hctx, hctx->odig, ipad_digest);
+  memzero(ipad_digest, sizeof(ipad_digest));
+}
+
+void hmac_sha256_InitPrepared(HMAC_SHA256_CTX *hctx,
+                              const uint32_t *opad_digest,
+                              const uint32_t *ipad_digest) {
+  memmove(hctx->odig, opad_digest, sizeof(hctx->odig));
+  memzero(&(hctx->ctx), sizeof(hctx->ctx));
+  memcpy(hctx->ctx.state, ipad_digest, sizeof(hctx->ctx.state));
+  hctx->ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
 }
 
 void hmac_sha256_Update(HMAC_SHA256_CTX *hctx, const uint8_t *msg,
@@ -52,8 +52,9 @@ void hmac_sha256_Update(HMAC_SHA256_CTX *hctx, const uint8_t *msg,
 
 void hmac_sha256_Final(HMAC_SHA256_CTX *hctx, uint8_t *hmac) {
   sha256_Final(&(hctx->ctx), hmac);
-  sha256_Init(&(hctx->ctx));
-  sha256_Update(&(hctx->ctx), hctx->o_key_pad, SHA256_BLOCK_LENGTH);
+  memzero(&(hctx->ctx), sizeof(hctx->ctx));
+  memcpy(hctx->ctx.state, hctx->odig, sizeof(hctx->ctx.state));
+  hctx->ctx.bitcount = SHA256_BLOCK_LENGTH * 8;
   sha256_Update(&(hctx->ctx), hmac, SHA256_DIGEST_LENGTH);
   sha256_Final(&(hctx->ctx), hmac);
   memzero(hctx, sizeof(HMAC_SHA256_CTX));
@@ -103,20 +104,20 @@ void hmac_sha256_prepare(const uint8_t *key, const uint32_t keylen,
 
 void hmac_sha512_Init(HMAC_SHA512_CTX *hctx, const uint8_t *key,
                       const uint32_t keylen) {
-  static CONFIDENTIAL uint8_t i_key_pad[SHA512_BLOCK_LENGTH];
-  memzero(i_key_pad, SHA512_BLOCK_LENGTH);
-  if (keylen > SHA512_BLOCK_LENGTH) {
-    sha512_Raw(key, keylen, i_key_pad);
-  } else {
-    memcpy(i_key_pad, key, keylen);
-  }
-  for (int i = 0; i < SHA512_BLOCK_LENGTH; i++) {
-    hctx->o_key_pad[i] = i_key_pad[i] ^ 0x5c;
-    i_key_pad[i] ^= 0x36;
-  }
-  sha512_Init(&(hctx->ctx));
-  sha512_Update(&(hctx->ctx), i_key_pad, SHA512_BLOCK_LENGTH);
-  memzero(i_key_pad, sizeof(i_key_pad));
+  static CONFIDENTIAL uint64_t ipad_digest[SHA512_DIGEST_LENGTH /
+                                           sizeof(uint64_t)];
+  hmac_sha512_prepare(key, keylen, hctx->odig, ipad_digest);
+  hmac_sha512_InitPrepared(hctx, hctx->odig, ipad_digest);
+  memzero(ipad_digest, sizeof(ipad_digest));
+}
+
+void hmac_sha512_InitPrepared(HMAC_SHA512_CTX *hctx,
+                              const uint64_t *opad_digest,
+                              const uint64_t *ipad_digest) {
+  memmove(hctx->odig, opad_digest, sizeof(hctx->odig));
+  memzero(&(hctx->ctx), sizeof(hctx->ctx));
+  memcpy(hctx->ctx.state, ipad_digest, sizeof(hctx->ctx.state));
+  hctx->ctx.bitcount[0] = SHA512_BLOCK_LENGTH * 8;
 }
 
 void hmac_sha512_Update(HMAC_SHA512_CTX *hctx, const uint8_t *msg,
@@ -126,8 +127,9 @@ void hmac_sha512_Update(HMAC_SHA512_CTX *hctx, const uint8_t *msg,
 
 void hmac_sha512_Final(HMAC_SHA512_CTX *hctx, uint8_t *hmac) {
   sha512_Final(&(hctx->ctx), hmac);
-  sha512_Init(&(hctx->ctx));
-  sha512_Update(&(hctx->ctx), hctx->o_key_pad, SHA512_BLOCK_LENGTH);
+  memzero(&(hctx->ctx), sizeof(hctx->ctx));
+  memcpy(hctx->ctx.state, hctx->odig, sizeof(hctx->ctx.state));
+  hctx->ctx.bitcount[0] = SHA512_BLOCK_LENGTH * 8;
   sha512_Update(&(hctx->ctx), hmac, SHA512_DIGEST_LENGTH);
   sha512_Final(&(hctx->ctx), hmac);
   memzero(hctx, sizeof(HMAC_SHA512_CTX));
@@ -28,12 +28,12 @@
 #include "sha2.h"
 
 typedef struct _HMAC_SHA256_CTX {
-  uint8_t o_key_pad[SHA256_BLOCK_LENGTH];
+  uint32_t odig[SHA256_DIGEST_LENGTH / sizeof(uint32_t)];
   SHA256_CTX ctx;
 } HMAC_SHA256_CTX;
 
 typedef struct _HMAC_SHA512_CTX {
-  uint8_t o_key_pad[SHA512_BLOCK_LENGTH];
+  uint64_t odig[SHA512_DIGEST_LENGTH / sizeof(uint64_t)];
   SHA512_CTX ctx;
 } HMAC_SHA512_CTX;
 
@@ -46,6 +46,11 @@ void hmac_sha256(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
                  const uint32_t msglen, uint8_t *hmac);
 void hmac_sha256_prepare(const uint8_t *key, const uint32_t keylen,
                          uint32_t *opad_digest, uint32_t *ipad_digest);
+// Starts an HMAC from the digests returned by hmac_sha256_prepare, so a key
+// used for several messages only has its pad blocks hashed once
+void hmac_sha256_InitPrepared(HMAC_SHA256_CTX *hctx,
+                              const uint32_t *opad_digest,
+                              const uint32_t *ipad_digest);
 
 void hmac_sha512_Init(HMAC_SHA512_CTX *hctx, const uint8_t *key,
                       const uint32_t keylen);
@@ -56,5 +61,8 @@ void hmac_sha512(const uint8_t *key, const uint32_t keylen, const uint8_t *msg,
                  const uint32_t msglen, uint8_t *hmac);
 void hmac_sha512_prepare(const uint8_t *key, const uint32_t keylen,
                          uint64_t *opad_digest, uint64_t *ipad_digest);
+void hmac_sha512_InitPrepared(HMAC_SHA512_CTX *hctx,
+                              const uint64_t *opad_digest,
+                              const uint64_t *ipad_digest);
 
 #endif
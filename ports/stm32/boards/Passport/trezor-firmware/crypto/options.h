@@ -43,6 +43,11 @@
 #define USE_RFC6979 1
 #endif
 
+// signatures that ecdsa_sign_digest_batch shares each modular inversion between
+#ifndef ECDSA_SIGN_BATCH
+#define ECDSA_SIGN_BATCH 8
+#endif
+
 // implement BIP32 caching
 #ifndef USE_BIP32_CACHE
 #define USE_BIP32_CACHE 1
@@ -1120,12 +1120,63 @@ START_TEST(test_base58) {
     ck_assert_int_eq(r, len);
     ck_assert_mem_eq(rawn, fromhex(*raw), len);
 
+    r = base58_encode_check_ct(rawn, len, HASHER_SHA2D, strn, sizeof(strn));
+    ck_assert_int_eq((size_t)r, strlen(*str) + 1);
+    ck_assert_str_eq(strn, *str);
+
+    r = base58_decode_check_ct(strn, HASHER_SHA2D, rawn, len);
+    ck_assert_int_eq(r, len);
+    ck_assert_mem_eq(rawn, fromhex(*raw), len);
+
     raw += 2;
     str += 2;
   }
 }
 END_TEST
 
+// constant-time and variable-time conversions must agree, including
+// on leading zero bytes and undersized output buffers
+START_TEST(test_base58_ct) {
+  uint8_t data[82], bin1[82], bin2[82];
+  char str1[120], str2[120];
+
+  for (int i = 0; i < 1000; i++) {
+    size_t len = random_uniform(sizeof(data) + 1);
+    size_t zeros = (i % 4 == 0) ? random_uniform(len + 1) : 0;
+    random_buffer(data, len);
+    memzero(data, zeros);
+
+    size_t len1 = sizeof(str1), len2 = sizeof(str2);
+    ck_assert(b58enc(str1, &len1, data, len));
+    ck_assert(b58enc_ct(str2, &len2, data, len));
+    ck_assert_int_eq(len1, len2);
+    ck_assert_str_eq(str1, str2);
+
+    size_t small1 = random_uniform(len1), small2 = small1;
+    ck_assert(!b58enc(str1, &small1, data, len));
+    ck_assert(!b58enc_ct(str2, &small2, data, len));
+    ck_assert_int_eq(small1, len1);
+    ck_assert_int_eq(small2, len1);
+
+    if (len == 0) continue;
+    size_t blen1 = len, blen2 = len;
+    ck_assert(b58tobin(bin1, &blen1, str1));
+    ck_assert(b58tobin_ct(bin2, &blen2, str1));
+    ck_assert_int_eq(blen1, len);
+    ck_assert_int_eq(blen2, len);
+    ck_assert_mem_eq(bin1, data, len);
+    ck_assert_mem_eq(bin2, data, len);
+
+    // invalid characters are rejected by both
+    str1[random_uniform(len1 - 1)] = '0';
+    blen1 = len;
+    blen2 = len;
+    ck_assert(!b58tobin(bin1, &blen1, str1));
+    ck_assert(!b58tobin_ct(bin2, &blen2, str1));
+  }
+}
+END_TEST
+
 #if USE_GRAPHENE
 
 // Graphene Base85CheckEncoding
@@ -1879,6 +1930,34 @@ START_TEST(test_bip32_compare) {
 }
 END_TEST
 
+START_TEST(test_bip32_prepared) {
+  HDNode parent, node1, node2;
+  HDNodeMidstate midstate;
+  int i, r;
+  hdnode_from_seed(
+      fromhex(
+          "301133282ad079cbeb59bc446ad39d333928f74c46997d3609cd3e2801ca69d62788"
+          "f9f174429946ff4e9be89f67c22fae28cb296a9b37734f75e73d1477af19"),
+      64, SECP256K1_NAME, &parent);
+  hdnode_private_ckd_prepare(&parent, &midstate);
+  for (i = 0; i < 100; i++) {
+    // every other child hardened
+    uint32_t index = i & 1 ? i | 0x80000000 : i;
+    memcpy(&node1, &parent, sizeof(HDNode));
+    memzero(node1.public_key, sizeof(node1.public_key));
+    r = hdnode_private_ckd(&node1, index);
+    ck_assert_int_eq(r, 1);
+    r = hdnode_private_ckd_prepared(&parent, &midstate, index, &node2);
+    ck_assert_int_eq(r, 1);
+    ck_assert_int_eq(node1.depth, node2.depth);
+    ck_assert_int_eq(node1.child_num, node2.child_num);
+    ck_assert_mem_eq(node1.chain_code, node2.chain_code, 32);
+    ck_assert_mem_eq(node1.private_key, node2.private_key, 32);
+    ck_assert_mem_eq(node1.public_key, node2.public_key, 33);
+  }
+}
+END_TEST
+
 START_TEST(test_bip32_optimized) {
   HDNode root;
   hdnode_from_seed((uint8_t *)"NothingToSeeHere", 16, SECP256K1_NAME, &root);
@@ -3521,6 +3600,71 @@ START_TEST(test_ecdsa_signature) {
 }
 END_TEST
 
+static int is_canonical_even(uint8_t by, uint8_t sig[64]) {
+  (void)sig;
+  return (by & 1) == 0;
+}
+
+START_TEST(test_ecdsa_sign_batch) {
+#define BATCH_COUNT (2 * ECDSA_SIGN_BATCH + 3)
+  static uint8_t priv_keys[BATCH_COUNT * 32], digests[BATCH_COUNT * 32];
+  static uint8_t sigs[BATCH_COUNT * 64];
+  uint8_t pbys[BATCH_COUNT], sig[64], pby;
+  const ecdsa_curve *curve = &secp256k1;
+  int res;
+
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    sha256_Raw((const uint8_t *)&i, sizeof(i), priv_keys + 32 * i);
+    sha256_Raw(priv_keys + 32 * i, 32, digests + 32 * i);
+  }
+  // the smallest and largest keys
+  memcpy(priv_keys,
+         fromhex("0000000000000000000000000000000000000000000000000000000000000001"),
+         32);
+  memcpy(priv_keys + 32,
+         fromhex("fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364140"),
+         32);
+
+  // every batch size up to a few past the chunk size
+  for (int count = 1; count <= BATCH_COUNT; count++) {
+    res = ecdsa_sign_digest_batch(curve, count, priv_keys, digests, sigs, pbys,
+                                  NULL);
+    ck_assert_int_eq(res, 0);
+    for (int i = 0; i < count; i++) {
+      res = ecdsa_sign_digest(curve, priv_keys + 32 * i, digests + 32 * i, sig,
+                              &pby, NULL);
+      ck_assert_int_eq(res, 0);
+      ck_assert_mem_eq(sigs + 64 * i, sig, 64);
+      ck_assert_int_eq(pbys[i], pby);
+    }
+  }
+
+  res = ecdsa_sign_digest_batch(curve, BATCH_COUNT, priv_keys, digests, sigs,
+                                NULL, NULL);
+  ck_assert_int_eq(res, 0);
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    ecdsa_sign_digest(curve, priv_keys + 32 * i, digests + 32 * i, sig, NULL,
+                      NULL);
+    ck_assert_mem_eq(sigs + 64 * i, sig, 64);
+  }
+
+  // about half the first nonces are rejected, and those signatures are made
+  // one at a time instead
+  res = ecdsa_sign_digest_batch(curve, BATCH_COUNT, priv_keys, digests, sigs,
+                                pbys, is_canonical_even);
+  ck_assert_int_eq(res, 0);
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    res = ecdsa_sign_digest(curve, priv_keys + 32 * i, digests + 32 * i, sig,
+                            &pby, is_canonical_even);
+    ck_assert_int_eq(res, 0);
+    ck_assert_mem_eq(sigs + 64 * i, sig, 64);
+    ck_assert_int_eq(pbys[i], pby);
+    ck_assert_int_eq(pby & 1, 0);
+  }
+#undef BATCH_COUNT
+}
+END_TEST
+
 #define test_deterministic(KEY, MSG, K)           \
   do {                                            \
     sha256_Raw((uint8_t *)MSG, strlen(MSG), buf); \
@@ -8756,6 +8900,7 @@ Suite *test_suite(void) {
 
   tc = tcase_create("base58");
   tcase_add_test(tc, test_base58);
+  tcase_add_test(tc, test_base58_ct);
   suite_add_tcase(s, tc);
 
 #if USE_GRAPHENE
@@ -8773,6 +8918,7 @@ Suite *test_suite(void) {
   tcase_add_test(tc, test_bip32_vector_2);
   tcase_add_test(tc, test_bip32_vector_3);
   tcase_add_test(tc, test_bip32_compare);
+  tcase_add_test(tc, test_bip32_prepared);
   tcase_add_test(tc, test_bip32_optimized);
   tcase_add_test(tc, test_bip32_cache_1);
   tcase_add_test(tc, test_bip32_cache_2);
@@ -8804,6 +8950,7 @@ Suite *test_suite(void) {
 
   tc = tcase_create("ecdsa");
   tcase_add_test(tc, test_ecdsa_signature);
+  tcase_add_test(tc, test_ecdsa_sign_batch);
   suite_add_tcase(s, tc);
 
   tc = tcase_create("rfc6979");
@@ -3,12 +3,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include "base58.h"
 #include "bip32.h"
 #include "curves.h"
 #include "ecdsa.h"
 #include "ed25519-donna/ed25519.h"
 #include "hasher.h"
+#include "hmac.h"
 #include "nist256p1.h"
+#include "rfc6979.h"
 #include "secp256k1.h"
 
 static uint8_t msg[256];
@@ -34,6 +37,44 @@ void bench_sign_secp256k1(int iterations) {
   }
 }
 
+// Signatures per second, ECDSA_SIGN_BATCH at a time
+void bench_sign_secp256k1_batch(int iterations) {
+  uint8_t priv[32 * ECDSA_SIGN_BATCH], digest[32 * ECDSA_SIGN_BATCH];
+  uint8_t sig[64 * ECDSA_SIGN_BATCH], pby[ECDSA_SIGN_BATCH];
+
+  const ecdsa_curve *curve = &secp256k1;
+
+  for (int i = 0; i < ECDSA_SIGN_BATCH; i++) {
+    memcpy(priv + 32 * i,
+           "\xc5\x5e\xce\x85\x8b\x0d\xdd\x52\x63\xf9\x68\x10\xfe\x14\x43\x7c\xd3"
+           "\xb5\xe1\xfb\xd7\xc6\xa2\xec\x1e\x03\x1f\x05\xe8\x6d\x8b\xd5",
+           32);
+    hasher_Raw(HASHER_SHA2, msg + i, sizeof(msg) - i, digest + 32 * i);
+  }
+
+  for (int i = 0; i < iterations; i += ECDSA_SIGN_BATCH) {
+    ecdsa_sign_digest_batch(curve, ECDSA_SIGN_BATCH, priv, digest, sig, pby,
+                            NULL);
+  }
+}
+
+void bench_rfc6979_secp256k1(int iterations) {
+  uint8_t priv[32], hash[32];
+  rfc6979_state rng;
+  bignum256 k;
+
+  memcpy(priv,
+         "\xc5\x5e\xce\x85\x8b\x0d\xdd\x52\x63\xf9\x68\x10\xfe\x14\x43\x7c\xd3"
+         "\xb5\xe1\xfb\xd7\xc6\xa2\xec\x1e\x03\x1f\x05\xe8\x6d\x8b\xd5",
+         32);
+  hasher_Raw(HASHER_SHA2, msg, sizeof(msg), hash);
+
+  for (int i = 0; i < iterations; i++) {
+    init_rfc6979(priv, hash, &rng);
+    generate_k_rfc6979(&k, &rng);
+  }
+}
+
 void bench_sign_nist256p1(int iterations) {
   uint8_t sig[64], priv[32], pby;
 
@@ -199,6 +240,121 @@ void bench_ckd_optimized(int iterations) {
   }
 }
 
+void bench_hmac_sha512(int iterations) {
+  uint8_t hmac[SHA512_DIGEST_LENGTH];
+  HMAC_SHA512_CTX ctx;
+  for (int i = 0; i < iterations; i++) {
+    hmac_sha512_Init(&ctx, root.chain_code, 32);
+    hmac_sha512_Update(&ctx, msg, 37);
+    hmac_sha512_Final(&ctx, hmac);
+  }
+}
+
+void bench_hmac_sha512_prepared(int iterations) {
+  uint8_t hmac[SHA512_DIGEST_LENGTH];
+  uint64_t odig[8], idig[8];
+  HMAC_SHA512_CTX ctx;
+  hmac_sha512_prepare(root.chain_code, 32, odig, idig);
+  for (int i = 0; i < iterations; i++) {
+    hmac_sha512_InitPrepared(&ctx, odig, idig);
+    hmac_sha512_Update(&ctx, msg, 37);
+    hmac_sha512_Final(&ctx, hmac);
+  }
+}
+
+// Each child from a fresh copy of its parent, as a derivation by path does
+void bench_ckd_private(int iterations) {
+  HDNode node;
+  for (int i = 0; i < iterations; i++) {
+    memcpy(&node, &root, sizeof(HDNode));
+    memset(node.public_key, 0, sizeof(node.public_key));
+    hdnode_private_ckd(&node, i);
+    hdnode_fill_public_key(&node);
+  }
+}
+
+void bench_ckd_private_prepared(int iterations) {
+  HDNode parent, node;
+  HDNodeMidstate midstate;
+  memcpy(&parent, &root, sizeof(HDNode));
+  memset(parent.public_key, 0, sizeof(parent.public_key));
+  hdnode_private_ckd_prepare(&parent, &midstate);
+  for (int i = 0; i < iterations; i++) {
+    hdnode_private_ckd_prepared(&parent, &midstate, i, &node);
+    hdnode_fill_public_key(&node);
+  }
+}
+
+void bench_serialize_public(int iterations) {
+  char xpub[128];
+  for (int i = 0; i < iterations; i++) {
+    hdnode_serialize_public(&root, 0x12345678, 0x0488B21E, xpub, sizeof(xpub));
+  }
+}
+
+void bench_deserialize_public(int iterations) {
+  char xpub[128];
+  HDNode node;
+  hdnode_serialize_public(&root, 0x12345678, 0x0488B21E, xpub, sizeof(xpub));
+  for (int i = 0; i < iterations; i++) {
+    hdnode_deserialize_public(xpub, 0x0488B21E, SECP256K1_NAME, &node, NULL);
+  }
+}
+
+void bench_serialize_private(int iterations) {
+  char xprv[128];
+  for (int i = 0; i < iterations; i++) {
+    hdnode_serialize_private(&root, 0x12345678, 0x0488ADE4, xprv, sizeof(xprv));
+  }
+}
+
+void bench_deserialize_private(int iterations) {
+  char xprv[128];
+  HDNode node;
+  hdnode_serialize_private(&root, 0x12345678, 0x0488ADE4, xprv, sizeof(xprv));
+  for (int i = 0; i < iterations; i++) {
+    hdnode_deserialize_private(xprv, 0x0488ADE4, SECP256K1_NAME, &node, NULL);
+  }
+}
+
+void bench_b58enc_xpub(int iterations) {
+  char str[128];
+  for (int i = 0; i < iterations; i++) {
+    size_t len = sizeof(str);
+    b58enc(str, &len, msg, 82);
+  }
+}
+
+void bench_b58enc_ct_xpub(int iterations) {
+  char str[128];
+  for (int i = 0; i < iterations; i++) {
+    size_t len = sizeof(str);
+    b58enc_ct(str, &len, msg, 82);
+  }
+}
+
+void bench_b58tobin_xpub(int iterations) {
+  char str[128];
+  uint8_t bin[82];
+  size_t len = sizeof(str);
+  b58enc(str, &len, msg, 82);
+  for (int i = 0; i < iterations; i++) {
+    len = sizeof(bin);
+    b58tobin(bin, &len, str);
+  }
+}
+
+void bench_b58tobin_ct_xpub(int iterations) {
+  char str[128];
+  uint8_t bin[82];
+  size_t len = sizeof(str);
+  b58enc(str, &len, msg, 82);
+  for (int i = 0; i < iterations; i++) {
+    len = sizeof(bin);
+    b58tobin_ct(bin, &len, str);
+  }
+}
+
 void bench(void (*func)(int), const char *name, int iterations) {
   clock_t t = clock();
   func(iterations);
@@ -212,6 +368,8 @@ int main(void) {
   prepare_msg();
 
   BENCH(bench_sign_secp256k1, 500);
+  BENCH(bench_sign_secp256k1_batch, 512);
+  BENCH(bench_rfc6979_secp256k1, 10000);
   BENCH(bench_verify_secp256k1_33, 500);
   BENCH(bench_verify_secp256k1_65, 500);
 
@@ -228,6 +386,21 @@ int main(void) {
 
   BENCH(bench_ckd_normal, 1000);
   BENCH(bench_ckd_optimized, 1000);
+  BENCH(bench_ckd_private, 1000);
+  BENCH(bench_ckd_private_prepared, 1000);
+
+  BENCH(bench_hmac_sha512, 100000);
+  BENCH(bench_hmac_sha512_prepared, 100000);
+
+  BENCH(bench_b58enc_xpub, 100000);
+  BENCH(bench_b58enc_ct_xpub, 100000);
+  BENCH(bench_b58tobin_xpub, 100000);
+  BENCH(bench_b58tobin_ct_xpub, 100000);
+
+  BENCH(bench_serialize_public, 100000);
+  BENCH(bench_deserialize_public, 100000);
+  BENCH(bench_serialize_private, 100000);
+  BENCH(bench_deserialize_private, 100000);
 
   return 0;
 }
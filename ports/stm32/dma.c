@@ -188,6 +188,42 @@ static const DMA_InitTypeDef dma_init_struct_dcmi = {
 };
 #endif
 
+#if MICROPY_HW_ENABLE_HASH || MICROPY_HW_ENABLE_CRYP
+// Parameters to dma_init() for the HASH and CRYP peripherals, which move whole words
+static const DMA_InitTypeDef dma_init_struct_crypto = {
+    .Request             = 0,
+    .Direction           = 0,
+    .PeriphInc           = DMA_PINC_DISABLE,
+    .MemInc              = DMA_MINC_ENABLE,
+    .PeriphDataAlignment = DMA_PDATAALIGN_WORD,
+    .MemDataAlignment    = DMA_MDATAALIGN_WORD,
+    .Mode                = DMA_NORMAL,
+    .Priority            = DMA_PRIORITY_HIGH,
+    .FIFOMode            = DMA_FIFOMODE_DISABLE,
+    .FIFOThreshold       = DMA_FIFO_THRESHOLD_FULL,
+    .MemBurst            = DMA_MBURST_SINGLE,
+    .PeriphBurst         = DMA_PBURST_SINGLE
+};
+#endif
+
+#if MICROPY_HW_ENABLE_ADC_DMA
+// Parameters to dma_init() for ADC conversions, which go round a buffer until stopped
+static const DMA_InitTypeDef dma_init_struct_adc = {
+    .Request             = 0,
+    .Direction           = 0,
+    .PeriphInc           = DMA_PINC_DISABLE,
+    .MemInc              = DMA_MINC_ENABLE,
+    .PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD,
+    .MemDataAlignment    = DMA_MDATAALIGN_HALFWORD,
+    .Mode                = DMA_CIRCULAR,
+    .Priority            = DMA_PRIORITY_MEDIUM,
+    .FIFOMode            = DMA_FIFOMODE_DISABLE,
+    .FIFOThreshold       = DMA_FIFO_THRESHOLD_FULL,
+    .MemBurst            = DMA_MBURST_SINGLE,
+    .PeriphBurst         = DMA_PBURST_SINGLE
+};
+#endif
+
 #if defined(STM32F0)
 
 #define NCONTROLLERS            (2)
@@ -457,6 +493,9 @@ static const uint8_t dma_irqn[NSTREAM] = {
 
 // DMA1 streams
 const dma_descr_t dma_I2C_1_RX = { DMA1_Stream0, DMA_REQUEST_I2C1_RX, dma_id_0,   &dma_init_struct_spi_i2c };
+#if MICROPY_HW_ENABLE_CRYP
+const dma_descr_t dma_CRYP_IN = { DMA1_Stream1, DMA_REQUEST_CRYP_IN, dma_id_1,   &dma_init_struct_crypto };
+#endif
 const dma_descr_t dma_SPI_3_RX = { DMA1_Stream2, DMA_REQUEST_SPI3_RX, dma_id_2,   &dma_init_struct_spi_i2c };
 const dma_descr_t dma_I2C_4_RX = { DMA1_Stream2, BDMA_REQUEST_I2C4_RX, dma_id_2,   &dma_init_struct_spi_i2c };
 const dma_descr_t dma_I2C_3_RX = { DMA1_Stream2, DMA_REQUEST_I2C3_RX, dma_id_2,   &dma_init_struct_spi_i2c };
@@ -468,12 +507,17 @@ const dma_descr_t dma_I2C_4_TX = { DMA1_Stream5, BDMA_REQUEST_I2C4_TX, dma_id_5,
 #if defined(MICROPY_HW_ENABLE_DAC) && MICROPY_HW_ENABLE_DAC
 const dma_descr_t dma_DAC_1_TX = { DMA1_Stream5, DMA_REQUEST_DAC1_CH1, dma_id_5,   &dma_init_struct_dac };
 const dma_descr_t dma_DAC_2_TX = { DMA1_Stream6, DMA_REQUEST_DAC1_CH2, dma_id_6,   &dma_init_struct_dac };
+#elif MICROPY_HW_ENABLE_ADC_DMA
+const dma_descr_t dma_ADC_2 = { DMA1_Stream6, DMA_REQUEST_ADC2, dma_id_6,   &dma_init_struct_adc };
 #endif
 const dma_descr_t dma_SPI_3_TX = { DMA1_Stream7, DMA_REQUEST_SPI3_TX, dma_id_7,   &dma_init_struct_spi_i2c };
 const dma_descr_t dma_I2C_1_TX = { DMA1_Stream7, DMA_REQUEST_I2C1_TX, dma_id_7,   &dma_init_struct_spi_i2c };
 const dma_descr_t dma_I2C_2_TX = { DMA1_Stream7, DMA_REQUEST_I2C2_TX, dma_id_7,   &dma_init_struct_spi_i2c };
 
 // DMA2 streams
+#if MICROPY_HW_ENABLE_CRYP
+const dma_descr_t dma_CRYP_OUT = { DMA2_Stream0, DMA_REQUEST_CRYP_OUT, dma_id_8,  &dma_init_struct_crypto };
+#endif
 #if MICROPY_HW_ENABLE_DCMI
 const dma_descr_t dma_DCMI_0 = { DMA2_Stream1, DMA_REQUEST_DCMI, dma_id_9,  &dma_init_struct_dcmi };
 #endif
@@ -485,6 +529,9 @@ const dma_descr_t dma_SPI_4_TX = { DMA2_Stream4, DMA_REQUEST_SPI4_TX, dma_id_12,
 const dma_descr_t dma_SPI_6_TX = { DMA2_Stream5, BDMA_REQUEST_SPI6_TX, dma_id_13,  &dma_init_struct_spi_i2c };
 const dma_descr_t dma_SPI_1_TX = { DMA2_Stream5, DMA_REQUEST_SPI1_TX, dma_id_13,  &dma_init_struct_spi_i2c };
 const dma_descr_t dma_SPI_6_RX = { DMA2_Stream6, BDMA_REQUEST_SPI6_RX, dma_id_14,  &dma_init_struct_spi_i2c };
+#if MICROPY_HW_ENABLE_HASH
+const dma_descr_t dma_HASH_IN = { DMA2_Stream7, DMA_REQUEST_HASH_IN, dma_id_15,  &dma_init_struct_crypto };
+#endif
 
 static const uint8_t dma_irqn[NSTREAM] = {
     DMA1_Stream0_IRQn,
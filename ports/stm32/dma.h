@@ -57,6 +57,10 @@ extern const dma_descr_t dma_SDMMC_2;
 extern const dma_descr_t dma_SPI_6_RX;
 extern const dma_descr_t dma_SDIO_0;
 extern const dma_descr_t dma_DCMI_0;
+extern const dma_descr_t dma_HASH_IN;
+extern const dma_descr_t dma_CRYP_IN;
+extern const dma_descr_t dma_CRYP_OUT;
+extern const dma_descr_t dma_ADC_2;
 
 #elif defined(STM32L0)
 
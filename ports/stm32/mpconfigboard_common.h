@@ -72,6 +72,21 @@
 #define MICROPY_HW_ENABLE_DCMI (0)
 #endif
 
+// Whether to feed the HASH peripheral by DMA (STM32H7 only)
+#ifndef MICROPY_HW_ENABLE_HASH
+#define MICROPY_HW_ENABLE_HASH (0)
+#endif
+
+// Whether to move data to and from the CRYP peripheral by DMA (STM32H7 only)
+#ifndef MICROPY_HW_ENABLE_CRYP
+#define MICROPY_HW_ENABLE_CRYP (0)
+#endif
+
+// Whether to stream ADC2 conversions to memory by circular DMA (STM32H7 only, needs the DAC off)
+#ifndef MICROPY_HW_ENABLE_ADC_DMA
+#define MICROPY_HW_ENABLE_ADC_DMA (0)
+#endif
+
 // Whether to enable USB support
 #ifndef MICROPY_HW_ENABLE_USB
 #define MICROPY_HW_ENABLE_USB (0)
@@ -62,9 +62,57 @@ Reset_Handler:
     cmp  r1, r2
     bcc  .bss_zero_loop
 
+    /* Copy code and data that the linker script places in ITCM and DTCM, and zero
+       the DTCM bss. These symbols are weak, so this does nothing on boards whose
+       linker scripts don't define them. */
+    ldr  r1, =_siitcm_text
+    ldr  r2, =_sitcm_text
+    ldr  r3, =_eitcm_text
+    b    .itcm_copy_entry
+.itcm_copy_loop:
+    ldr  r0, [r1], #4
+    str  r0, [r2], #4
+.itcm_copy_entry:
+    cmp  r2, r3
+    bcc  .itcm_copy_loop
+
+    ldr  r1, =_sidtcm_data
+    ldr  r2, =_sdtcm_data
+    ldr  r3, =_edtcm_data
+    b    .dtcm_copy_entry
+.dtcm_copy_loop:
+    ldr  r0, [r1], #4
+    str  r0, [r2], #4
+.dtcm_copy_entry:
+    cmp  r2, r3
+    bcc  .dtcm_copy_loop
+
+    movs r0, #0
+    ldr  r1, =_sdtcm_bss
+    ldr  r2, =_edtcm_bss
+    b    .dtcm_zero_entry
+.dtcm_zero_loop:
+    str  r0, [r1], #4
+.dtcm_zero_entry:
+    cmp  r1, r2
+    bcc  .dtcm_zero_loop
+
+    /* Make sure the copied code is fetched rather than anything stale */
+    dsb
+    isb
+
     /* Initialise the system and jump to the main code */
     bl   SystemInit
     mov  r0, r4
     b    stm32_main
 
     .size Reset_Handler, .-Reset_Handler
+
+    .weak _siitcm_text
+    .weak _sitcm_text
+    .weak _eitcm_text
+    .weak _sidtcm_data
+    .weak _sdtcm_data
+    .weak _edtcm_data
+    .weak _sdtcm_bss
+    .weak _edtcm_bss
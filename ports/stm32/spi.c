@@ -97,6 +97,10 @@ const spi_t spi_obj[6] = {
     #endif
 };
 
+// The baudrate last asked of each SPI, or 0 if it was given a prescaler, so that
+// spi_update_baudrates() can pick the prescaler again when the bus clocks change
+STATIC uint32_t spi_baudrate[MP_ARRAY_SIZE(spi_obj)];
+
 #if defined(STM32H7)
 // STM32H7 HAL requires SPI IRQs to be enabled and handled.
 #if defined(MICROPY_HW_SPI1_SCK)
@@ -217,6 +221,10 @@ STATIC uint32_t spi_get_source_freq(SPI_HandleTypeDef *spi) {
     #endif
 }
 
+STATIC size_t spi_index(const spi_t *self) {
+    return self - &spi_obj[0];
+}
+
 // sets the parameters in the SPI_InitTypeDef struct
 // if an argument is -1 then the corresponding parameter is not changed
 void spi_set_params(const spi_t *spi_obj, uint32_t prescale, int32_t baudrate,
@@ -225,6 +233,7 @@ void spi_set_params(const spi_t *spi_obj, uint32_t prescale, int32_t baudrate,
     SPI_InitTypeDef *init = &spi->Init;
 
     if (prescale != 0xffffffff || baudrate != -1) {
+        spi_baudrate[spi_index(spi_obj)] = prescale == 0xffffffff ? baudrate : 0;
         if (prescale == 0xffffffff) {
             // prescaler not given, so select one that yields at most the requested baudrate
             prescale = (spi_get_source_freq(spi) + baudrate - 1) / baudrate;
@@ -385,8 +394,22 @@ void spi_init(const spi_t *self, bool enable_nss_pin) {
     #endif 
 }
 
+// Re-initialises every SPI that was given a baudrate, with the prescaler that gives
+// that baudrate from the current bus clocks; call it after changing them
+void spi_update_baudrates(void) {
+    for (size_t i = 0; i < MP_ARRAY_SIZE(spi_obj); i++) {
+        const spi_t *self = &spi_obj[i];
+        if (self->spi == NULL || spi_baudrate[i] == 0 || self->spi->State == HAL_SPI_STATE_RESET) {
+            continue;
+        }
+        spi_set_params(self, 0xffffffff, spi_baudrate[i], -1, -1, -1, -1);
+        spi_init(self, self->spi->Init.NSS != SPI_NSS_SOFT);
+    }
+}
+
 void spi_deinit(const spi_t *spi_obj) {
     SPI_HandleTypeDef *spi = spi_obj->spi;
+    spi_baudrate[spi_index(spi_obj)] = 0;
     HAL_SPI_DeInit(spi);
     if (0) {
     #if defined(MICROPY_HW_SPI1_SCK)
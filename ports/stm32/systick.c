@@ -71,6 +71,25 @@ void SysTick_Handler(void) {
     #endif
 }
 
+#if MICROPY_PY_UPROFILE
+#include "extmod/moduprofile.h"
+
+// Samples are taken from the SysTick dispatch cycle, so every
+// SYSTICK_DISPATCH_NUM_SLOTS milliseconds.
+STATIC void uprofile_systick_callback(uint32_t ticks_ms) {
+    (void)ticks_ms;
+    mp_uprofile_sample();
+}
+
+void mp_uprofile_port_start(void) {
+    systick_enable_dispatch(SYSTICK_DISPATCH_UPROFILE, uprofile_systick_callback);
+}
+
+void mp_uprofile_port_stop(void) {
+    systick_disable_dispatch(SYSTICK_DISPATCH_UPROFILE);
+}
+#endif
+
 // We provide our own version of HAL_Delay that calls __WFI while waiting,
 // and works when interrupts are disabled.  This function is intended to be
 // used only by the ST HAL functions.
@@ -40,6 +40,9 @@ enum {
     #if MICROPY_PY_BLUETOOTH && MICROPY_BLUETOOTH_NIMBLE
     SYSTICK_DISPATCH_NIMBLE,
     #endif
+    #if MICROPY_PY_UPROFILE
+    SYSTICK_DISPATCH_UPROFILE,
+    #endif
     SYSTICK_DISPATCH_MAX
 };
 
@@ -54,6 +54,7 @@
 
 // Command line options, with their defaults
 STATIC bool compile_only = false;
+STATIC bool opt_bytecode = false;
 STATIC uint emit_opt = MP_EMIT_OPT_NONE;
 
 #if MICROPY_ENABLE_GC
@@ -318,6 +319,9 @@ STATIC int usage(char **argv) {
 #else
 "  emit=bytecode                -- set the default code emitter\n"
 #endif
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+"  opt-bytecode                 -- run the bytecode optimiser\n"
+#endif
 );
     impl_opts_cnt++;
 #if MICROPY_ENABLE_GC
@@ -353,6 +357,10 @@ STATIC void pre_process_options(int argc, char **argv) {
                 } else if (strcmp(argv[a + 1], "emit=viper") == 0) {
                     emit_opt = MP_EMIT_OPT_VIPER;
                 #endif
+                #if MICROPY_COMP_OPTIMISE_BYTECODE
+                } else if (strcmp(argv[a + 1], "opt-bytecode") == 0) {
+                    opt_bytecode = true;
+                #endif
 #if MICROPY_ENABLE_GC
                 } else if (strncmp(argv[a + 1], "heapsize=", sizeof("heapsize=") - 1) == 0) {
                     char *end;
@@ -463,6 +471,12 @@ MP_NOINLINE int main_(int argc, char **argv) {
     (void)emit_opt;
     #endif
 
+    #if MICROPY_COMP_OPTIMISE_BYTECODE
+    MP_STATE_VM(mp_optimise_bytecode) = opt_bytecode;
+    #else
+    (void)opt_bytecode;
+    #endif
+
     #if MICROPY_VFS_POSIX
     {
         // Mount the host FS at the root of our internal VFS
@@ -59,6 +59,48 @@ STATIC void sighandler(int signum) {
 }
 #endif
 
+#if MICROPY_PY_UPROFILE && !defined(_WIN32)
+#include "extmod/moduprofile.h"
+
+// Sample every millisecond of CPU time used by the process
+#define UPROFILE_INTERVAL_US (1000)
+
+STATIC void uprofile_sighandler(int signum) {
+    (void)signum;
+    #if MICROPY_PY_THREAD
+    if (mp_thread_get_state() == NULL) {
+        // Delivered to a thread that isn't running Python code
+        return;
+    }
+    #endif
+    mp_uprofile_sample();
+}
+
+STATIC void uprofile_set_timer(void (*handler)(int), mp_uint_t interval_us) {
+    struct sigaction sa;
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    struct itimerval it;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = interval_us;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+void mp_uprofile_port_start(void) {
+    uprofile_set_timer(uprofile_sighandler, UPROFILE_INTERVAL_US);
+}
+
+void mp_uprofile_port_stop(void) {
+    // Ignore rather than restore the default, which would kill the process if a
+    // signal is still pending
+    uprofile_set_timer(SIG_IGN, 0);
+}
+#endif
+
 void mp_hal_set_interrupt_char(char c) {
     // configure terminal settings to (not) let ctrl-C through
     if (c == CHAR_CTRL_C) {
@@ -410,6 +410,18 @@ mp_obj_t mp_builtin___import__(size_t n_args, const mp_obj_t *args) {
                 module_obj = mp_module_get(mod_name);
             }
 
+            #if MICROPY_MODULE_FROZEN_MPY && MICROPY_MODULE_FROZEN_ROM
+            // a frozen module that was built in ROM only needs registering, unless it's
+            // being run with "-m" and so needs a __name__ of __main__
+            if (module_obj == MP_OBJ_NULL && stat == MP_IMPORT_STAT_FILE
+                && !(i == mod_len && fromtuple == mp_const_false)) {
+                module_obj = mp_find_frozen_rom_module(vstr_str(&path), vstr_len(&path));
+                if (module_obj != MP_OBJ_NULL) {
+                    mp_module_register(mod_name, module_obj);
+                }
+            }
+            #endif
+
             if (module_obj == MP_OBJ_NULL) {
                 // module not already loaded, so load it!
 
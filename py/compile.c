@@ -269,6 +269,16 @@ STATIC void apply_to_single_or_list(compiler_t *comp, mp_parse_node_t pn, pn_kin
     }
 }
 
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+// Whether nothing after this statement in the same block can run
+STATIC bool node_ends_block(mp_parse_node_t pn) {
+    return MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_return_stmt)
+        || MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_raise_stmt)
+        || MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_break_stmt)
+        || MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_continue_stmt);
+}
+#endif
+
 STATIC void compile_generic_all_nodes(compiler_t *comp, mp_parse_node_struct_t *pns) {
     int num_nodes = MP_PARSE_NODE_STRUCT_NUM_NODES(pns);
     for (int i = 0; i < num_nodes; i++) {
@@ -278,6 +288,15 @@ STATIC void compile_generic_all_nodes(compiler_t *comp, mp_parse_node_struct_t *
             compile_error_set_line(comp, pns->nodes[i]);
             return;
         }
+        #if MICROPY_COMP_OPTIMISE_BYTECODE
+        // optimisation: don't emit the rest of a block that can't be reached.  The scope
+        // pass still sees it, so names assigned there are local as they would be without it.
+        if (comp->pass > MP_PASS_SCOPE && MP_STATE_VM(mp_optimise_bytecode)
+            && MP_PARSE_NODE_STRUCT_KIND(pns) == PN_suite_block_stmts
+            && node_ends_block(pns->nodes[i])) {
+            return;
+        }
+        #endif
     }
 }
 
@@ -2124,7 +2143,102 @@ STATIC void compile_not_test_2(compiler_t *comp, mp_parse_node_struct_t *pns) {
     EMIT_ARG(unary_op, MP_UNARY_OP_NOT);
 }
 
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+// Longest constant tuple that a membership test is expanded inline for
+#define MAX_INLINE_CONST_TUPLE (8)
+
+// Gets the items of pn if it's a parenthesised tuple of constants, returning how many
+// there are, or 0 if it isn't one or has more than MAX_INLINE_CONST_TUPLE items
+STATIC size_t get_const_tuple_items(mp_parse_node_t pn, mp_parse_node_t *items) {
+    if (!MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_atom_paren)) {
+        return 0;
+    }
+    pn = ((mp_parse_node_struct_t*)pn)->nodes[0];
+    if (!MP_PARSE_NODE_IS_STRUCT_KIND(pn, PN_testlist_comp)) {
+        // empty tuple
+        return 0;
+    }
+    mp_parse_node_struct_t *pns = (mp_parse_node_struct_t*)pn;
+    size_t n = 0;
+    items[n++] = pns->nodes[0];
+    if (MP_PARSE_NODE_IS_STRUCT_KIND(pns->nodes[1], PN_testlist_comp_3b)) {
+        // tuple of one item, with trailing comma
+    } else if (MP_PARSE_NODE_IS_STRUCT_KIND(pns->nodes[1], PN_testlist_comp_3c)) {
+        // tuple of many items
+        mp_parse_node_struct_t *pns2 = (mp_parse_node_struct_t*)pns->nodes[1];
+        size_t n2 = MP_PARSE_NODE_STRUCT_NUM_NODES(pns2);
+        if (1 + n2 > MAX_INLINE_CONST_TUPLE) {
+            return 0;
+        }
+        for (size_t i = 0; i < n2; i++) {
+            items[n++] = pns2->nodes[i];
+        }
+    } else {
+        // tuple with 2 items, or a generator expression
+        items[n++] = pns->nodes[1];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!((MP_PARSE_NODE_IS_LEAF(items[i]) && !MP_PARSE_NODE_IS_ID(items[i]))
+            || MP_PARSE_NODE_IS_STRUCT_KIND(items[i], PN_const_object))) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+// Compiles "x in (a, b, c)", where the tuple is all constants, as x == a or x == b or
+// x == c, evaluating x once.  This is what the tuple's "in" does, without building it
+// on the heap each time.
+STATIC bool c_const_tuple_membership(compiler_t *comp, mp_parse_node_struct_t *pns) {
+    if (!MP_STATE_VM(mp_optimise_bytecode) || MP_PARSE_NODE_STRUCT_NUM_NODES(pns) != 3) {
+        return false;
+    }
+    bool not_in;
+    if (MP_PARSE_NODE_IS_TOKEN_KIND(pns->nodes[1], MP_TOKEN_KW_IN)) {
+        not_in = false;
+    } else if (MP_PARSE_NODE_IS_STRUCT_KIND(pns->nodes[1], PN_comp_op_not_in)) {
+        not_in = true;
+    } else {
+        return false;
+    }
+    mp_parse_node_t items[MAX_INLINE_CONST_TUPLE];
+    size_t n = get_const_tuple_items(pns->nodes[2], items);
+    if (n == 0) {
+        return false;
+    }
+
+    compile_node(comp, pns->nodes[0]);
+    uint l_found = comp_next_label(comp);
+    for (size_t i = 0; i + 1 < n; i++) {
+        EMIT(dup_top);
+        compile_node(comp, items[i]);
+        EMIT_ARG(binary_op, MP_BINARY_OP_EQUAL);
+        EMIT_ARG(pop_jump_if, true, l_found);
+    }
+    compile_node(comp, items[n - 1]);
+    EMIT_ARG(binary_op, MP_BINARY_OP_EQUAL);
+    if (not_in) {
+        EMIT_ARG(unary_op, MP_UNARY_OP_NOT);
+    }
+    if (n > 1) {
+        uint l_end = comp_next_label(comp);
+        EMIT_ARG(jump, l_end);
+        EMIT_ARG(label_assign, l_found);
+        EMIT(pop_top);
+        EMIT_ARG(load_const_tok, not_in ? MP_TOKEN_KW_FALSE : MP_TOKEN_KW_TRUE);
+        EMIT_ARG(label_assign, l_end);
+    }
+    return true;
+}
+#endif
+
 STATIC void compile_comparison(compiler_t *comp, mp_parse_node_struct_t *pns) {
+    #if MICROPY_COMP_OPTIMISE_BYTECODE
+    if (c_const_tuple_membership(comp, pns)) {
+        return;
+    }
+    #endif
+
     int num_nodes = MP_PARSE_NODE_STRUCT_NUM_NODES(pns);
     compile_node(comp, pns->nodes[0]);
     bool multi = (num_nodes > 3);
@@ -33,6 +33,7 @@
 #include "py/mpstate.h"
 #include "py/emit.h"
 #include "py/bc0.h"
+#include "py/bc.h"
 
 #if MICROPY_ENABLE_COMPILER
 
@@ -391,6 +392,37 @@ void mp_emit_bc_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scope) {
     }
 }
 
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+STATIC const byte *emit_bc_jump_target(const byte *ip) {
+    return ip + 3 + ((ip[1] | (ip[2] << 8)) - 0x8000);
+}
+
+// Points each jump whose target is an unconditional jump at where that one goes.
+// Jumps are all the same size, so this is done in place on the finished bytecode.
+STATIC void emit_bc_thread_jumps(emit_t *emit) {
+    byte *ip = emit->code_base + emit->code_info_size;
+    byte *ip_top = ip + emit->bytecode_size;
+    while (ip < ip_top) {
+        size_t sz;
+        mp_opcode_format(ip, &sz, true);
+        if (*ip >= MP_BC_JUMP && *ip <= MP_BC_JUMP_IF_FALSE_OR_POP) {
+            const byte *target = emit_bc_jump_target(ip);
+            const byte *dest = target;
+            // limit the hops, because "while True: pass" is a jump to itself
+            for (int hops = 0; *dest == MP_BC_JUMP && hops < 8; hops++) {
+                dest = emit_bc_jump_target(dest);
+            }
+            mp_int_t offset = dest - (ip + 3);
+            if (dest != target && -0x8000 <= offset && offset < 0x8000) {
+                ip[1] = offset + 0x8000;
+                ip[2] = (offset + 0x8000) >> 8;
+            }
+        }
+        ip += sz;
+    }
+}
+#endif
+
 void mp_emit_bc_end_pass(emit_t *emit) {
     if (emit->pass == MP_PASS_SCOPE) {
         return;
@@ -441,6 +473,12 @@ void mp_emit_bc_end_pass(emit_t *emit) {
         #endif
 
     } else if (emit->pass == MP_PASS_EMIT) {
+        #if MICROPY_COMP_OPTIMISE_BYTECODE
+        if (MP_STATE_VM(mp_optimise_bytecode)) {
+            emit_bc_thread_jumps(emit);
+        }
+        #endif
+
         mp_emit_glue_assign_bytecode(emit->scope->raw_code, emit->code_base,
             #if MICROPY_PERSISTENT_CODE_SAVE || MICROPY_DEBUG_PRINTERS
             emit->code_info_size + emit->bytecode_size,
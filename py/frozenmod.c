@@ -82,18 +82,38 @@ STATIC mp_lexer_t *mp_lexer_frozen_str(const char *str, size_t len) {
 extern const char mp_frozen_mpy_names[];
 extern const mp_raw_code_t *const mp_frozen_mpy_content[];
 
-STATIC const mp_raw_code_t *mp_find_frozen_mpy(const char *str, size_t len) {
+STATIC int mp_find_frozen_mpy_index(const char *str, size_t len) {
     const char *name = mp_frozen_mpy_names;
-    for (size_t i = 0; *name != 0; i++) {
+    for (int i = 0; *name != 0; i++) {
         size_t l = strlen(name);
         if (l == len && !memcmp(str, name, l)) {
-            return mp_frozen_mpy_content[i];
+            return i;
         }
         name += l + 1;
     }
-    return NULL;
+    return -1;
 }
 
+STATIC const mp_raw_code_t *mp_find_frozen_mpy(const char *str, size_t len) {
+    int i = mp_find_frozen_mpy_index(str, len);
+    return i < 0 ? NULL : mp_frozen_mpy_content[i];
+}
+
+#if MICROPY_MODULE_FROZEN_ROM
+
+extern const mp_obj_module_t *const mp_frozen_mpy_rom_content[];
+
+// Returns the prebuilt module object if the frozen module was built in ROM, else NULL
+mp_obj_t mp_find_frozen_rom_module(const char *str, size_t len) {
+    int i = mp_find_frozen_mpy_index(str, len);
+    if (i < 0 || mp_frozen_mpy_rom_content[i] == NULL) {
+        return MP_OBJ_NULL;
+    }
+    return MP_OBJ_FROM_PTR(mp_frozen_mpy_rom_content[i]);
+}
+
+#endif
+
 #endif
 
 #if MICROPY_MODULE_FROZEN
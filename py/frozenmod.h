@@ -39,4 +39,8 @@ int mp_find_frozen_module(const char *str, size_t len, void **data);
 const char *mp_find_frozen_str(const char *str, size_t *len);
 mp_import_stat_t mp_frozen_stat(const char *str);
 
+#if MICROPY_MODULE_FROZEN_MPY && MICROPY_MODULE_FROZEN_ROM
+mp_obj_t mp_find_frozen_rom_module(const char *str, size_t len);
+#endif
+
 #endif // MICROPY_INCLUDED_PY_FROZENMOD_H
@@ -401,6 +401,15 @@
 #define MICROPY_COMP_RETURN_IF_EXPR (0)
 #endif
 
+// Whether to include the optional bytecode optimiser, which is switched on per
+// compile with MP_STATE_VM(mp_optimise_bytecode) (-X opt-bytecode in mpy-cross).
+// It folds comparisons of constants, drops unreachable statements, tests for
+// membership of small constant tuples without building the tuple, and threads
+// jumps to jumps.  Needs MICROPY_PERSISTENT_CODE_LOAD or _SAVE.
+#ifndef MICROPY_COMP_OPTIMISE_BYTECODE
+#define MICROPY_COMP_OPTIMISE_BYTECODE (0)
+#endif
+
 /*****************************************************************************/
 /* Internal debugging stuff                                                  */
 
@@ -721,6 +730,12 @@ typedef double mp_float_t;
 #define MICROPY_MODULE_FROZEN (MICROPY_MODULE_FROZEN_STR || MICROPY_MODULE_FROZEN_MPY)
 #endif
 
+// Whether frozen .mpy modules can have their top level built in ROM (see freeze_rom
+// in tools/makemanifest.py), so importing them doesn't run any code or use the heap
+#ifndef MICROPY_MODULE_FROZEN_ROM
+#define MICROPY_MODULE_FROZEN_ROM (0)
+#endif
+
 // Whether you can override builtins in the builtins module
 #ifndef MICROPY_CAN_OVERRIDE_BUILTINS
 #define MICROPY_CAN_OVERRIDE_BUILTINS (0)
@@ -1264,6 +1279,18 @@ typedef double mp_float_t;
 #define MICROPY_PY_UZLIB (1)
 #endif
 
+// Whether to provide uzlib.compress and uzlib.CompIO
+#ifndef MICROPY_PY_UZLIB_COMPRESS
+#define MICROPY_PY_UZLIB_COMPRESS (0)
+#endif
+
+// Whether to provide the "uprofile" sampling profiler. The VM then keeps track
+// of the running bytecode frames, and the port must call mp_uprofile_sample()
+// from a periodic interrupt started/stopped by mp_uprofile_port_start/stop().
+#ifndef MICROPY_PY_UPROFILE
+#define MICROPY_PY_UPROFILE (0)
+#endif
+
 #ifndef MICROPY_PY_UJSON
 #define MICROPY_PY_UJSON (0)
 #endif
@@ -1288,6 +1315,18 @@ typedef double mp_float_t;
 #define MICROPY_PY_URE_SUB (0)
 #endif
 
+// Number of compiled patterns to keep for reuse by ure.compile() and the
+// module-level functions (0 to always compile)
+#ifndef MICROPY_PY_URE_CACHE
+#define MICROPY_PY_URE_CACHE (0)
+#endif
+
+// Whether to build a lazy DFA per pattern, so input that can't match is
+// rejected in linear time before running the backtracking VM
+#ifndef MICROPY_PY_URE_DFA
+#define MICROPY_PY_URE_DFA (0)
+#endif
+
 #ifndef MICROPY_PY_UHEAPQ
 #define MICROPY_PY_UHEAPQ (0)
 #endif
@@ -1588,5 +1627,10 @@ typedef double mp_float_t;
 #error "MICROPY_PY_SYS_SETTRACE requires MICROPY_COMP_CONST to be disabled"
 #endif
 #endif
+#if MICROPY_COMP_OPTIMISE_BYTECODE
+#if !(MICROPY_PERSISTENT_CODE_LOAD || MICROPY_PERSISTENT_CODE_SAVE)
+#error "MICROPY_COMP_OPTIMISE_BYTECODE requires MICROPY_PERSISTENT_CODE_LOAD or MICROPY_PERSISTENT_CODE_SAVE to be enabled"
+#endif
+#endif
 
 #endif // MICROPY_INCLUDED_PY_MPCONFIG_H
@@ -193,6 +193,14 @@ typedef struct _mp_state_vm_t {
     mp_obj_t bluetooth;
     #endif
 
+    #if MICROPY_PY_UPROFILE
+    uint16_t *uprofile_buf;
+    #endif
+
+    #if MICROPY_PY_URE && MICROPY_PY_URE_CACHE
+    mp_obj_t ure_cache[MICROPY_PY_URE_CACHE];
+    #endif
+
     //
     // END ROOT POINTER SECTION
     ////////////////////////////////////////////////////////////
@@ -210,6 +218,9 @@ typedef struct _mp_state_vm_t {
 
     #if MICROPY_ENABLE_COMPILER
     mp_uint_t mp_optimise_value;
+    #if MICROPY_COMP_OPTIMISE_BYTECODE
+    bool mp_optimise_bytecode;
+    #endif
     #if MICROPY_EMIT_NATIVE
     uint8_t default_emit_opt; // one of MP_EMIT_OPT_xxx
     #endif
@@ -262,6 +273,9 @@ typedef struct _mp_state_thread_t {
     #if MICROPY_PY_SYS_SETTRACE
     mp_obj_t prof_trace_callback;
     bool prof_callback_is_executing;
+    #endif
+
+    #if MICROPY_PY_SYS_SETTRACE || MICROPY_PY_UPROFILE
     struct _mp_code_state_t *current_code_state;
     #endif
 } mp_state_thread_t;
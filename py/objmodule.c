@@ -179,6 +179,9 @@ STATIC const mp_rom_map_elem_t mp_builtin_module_table[] = {
 #if MICROPY_PY_UZLIB
     { MP_ROM_QSTR(MP_QSTR_uzlib), MP_ROM_PTR(&mp_module_uzlib) },
 #endif
+#if MICROPY_PY_UPROFILE
+    { MP_ROM_QSTR(MP_QSTR_uprofile), MP_ROM_PTR(&mp_module_uprofile) },
+#endif
 #if MICROPY_PY_UJSON
     { MP_ROM_QSTR(MP_QSTR_ujson), MP_ROM_PTR(&mp_module_ujson) },
 #endif
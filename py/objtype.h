@@ -28,6 +28,10 @@
 
 #include "py/obj.h"
 
+// flags for classes defined in Python
+#define TYPE_FLAG_IS_SUBCLASSED (0x0001)
+#define TYPE_FLAG_HAS_SPECIAL_ACCESSORS (0x0002)
+
 // instance object
 // creating an instance of a class makes one of these objects
 typedef struct _mp_obj_instance_t {
@@ -51,4 +55,25 @@ mp_obj_t mp_obj_instance_call(mp_obj_t self_in, size_t n_args, size_t n_kw, cons
 // this needs to be exposed for the above macros to work correctly
 mp_obj_t mp_obj_instance_make_new(const mp_obj_type_t *self_in, size_t n_args, size_t n_kw, const mp_obj_t *args);
 
+// the slots of a class defined in Python; these are exposed so tools/mpy-tool.py can
+// build classes of frozen modules in ROM
+void mp_obj_instance_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind);
+mp_obj_t mp_obj_instance_unary_op(mp_unary_op_t op, mp_obj_t self_in);
+mp_obj_t mp_obj_instance_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in);
+void mp_obj_instance_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest);
+mp_obj_t mp_obj_instance_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value);
+mp_obj_t mp_obj_instance_getiter(mp_obj_t self_in, mp_obj_iter_buf_t *iter_buf);
+mp_int_t mp_obj_instance_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags);
+
+#define MP_OBJ_INSTANCE_TYPE_SLOTS \
+    .print = mp_obj_instance_print, \
+    .make_new = mp_obj_instance_make_new, \
+    .call = mp_obj_instance_call, \
+    .unary_op = mp_obj_instance_unary_op, \
+    .binary_op = mp_obj_instance_binary_op, \
+    .attr = mp_obj_instance_attr, \
+    .subscr = mp_obj_instance_subscr, \
+    .getiter = mp_obj_instance_getiter, \
+    .buffer_p = { .get_buffer = mp_obj_instance_get_buffer },
+
 #endif // MICROPY_INCLUDED_PY_OBJTYPE_H
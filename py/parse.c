@@ -595,6 +595,39 @@ STATIC bool fold_logical_constants(parser_t *parser, uint8_t rule_id, size_t *nu
         pop_result(parser);
         push_result_node(parser, pn);
         return true;
+
+    #if MICROPY_COMP_OPTIMISE_BYTECODE
+    } else if (rule_id == RULE_comparison && MP_STATE_VM(mp_optimise_bytecode)) {
+        // folding for integer comparisons, eg DEBUG_LEVEL > 1, so that the
+        // compiler can drop the branches they guard
+        mp_obj_t lhs;
+        if (!mp_parse_node_get_int_maybe(peek_result(parser, *num_args - 1), &lhs)) {
+            return false;
+        }
+        bool result = true;
+        for (ssize_t i = *num_args - 2; i >= 1; i -= 2) {
+            mp_parse_node_t pn_op = peek_result(parser, i);
+            mp_obj_t rhs;
+            if (!MP_PARSE_NODE_IS_TOKEN(pn_op)
+                || MP_PARSE_NODE_LEAF_ARG(pn_op) < MP_TOKEN_OP_LESS
+                || MP_PARSE_NODE_LEAF_ARG(pn_op) > MP_TOKEN_OP_NOT_EQUAL
+                || !mp_parse_node_get_int_maybe(peek_result(parser, i - 1), &rhs)) {
+                // "in", "not in", "is" or a non-integer operand
+                return false;
+            }
+            mp_binary_op_t op = MP_BINARY_OP_LESS + (MP_PARSE_NODE_LEAF_ARG(pn_op) - MP_TOKEN_OP_LESS);
+            if (mp_binary_op(op, lhs, rhs) != mp_const_true) {
+                result = false;
+            }
+            lhs = rhs;
+        }
+        for (size_t i = *num_args; i > 0; i--) {
+            pop_result(parser);
+        }
+        push_result_node(parser, mp_parse_node_new_leaf(MP_PARSE_NODE_TOKEN,
+            result ? MP_TOKEN_KW_TRUE : MP_TOKEN_KW_FALSE));
+        return true;
+    #endif
     }
 
     return false;
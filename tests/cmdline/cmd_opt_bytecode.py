@@ -0,0 +1,68 @@
+# cmdline: -X opt-bytecode
+# test that code compiled by the bytecode optimiser behaves as it would without it
+from micropython import const
+
+LEVEL = const(2)
+
+# comparisons of constants, and the branches they guard
+print(LEVEL > 1, LEVEL == 0, 1 < LEVEL < 3, 1 < LEVEL > 2, not LEVEL != 2)
+if LEVEL > 1:
+    print("taken")
+if LEVEL < 1:
+    print("not taken")
+else:
+    print("else taken")
+
+# membership of constant tuples
+def member(x):
+    return x in (1, "a", None), x not in (2, 3), x in ("x",), x not in (4.5,)
+
+for x in (1, 1.0, "a", None, 2, 3, "x", 4.5, [1]):
+    print(member(x))
+
+# statements after return, raise, break or continue
+def after_return():
+    return 1
+    print("unreachable")
+
+def local_after_return():
+    print(y)
+    return
+    y = 1
+
+def after_raise():
+    raise ValueError
+    print("unreachable")
+
+print(after_return())
+y = 2
+try:
+    local_after_return()
+except NameError:
+    print("NameError")
+try:
+    after_raise()
+except ValueError:
+    print("ValueError")
+for i in range(3):
+    if i == 1:
+        continue
+        print("unreachable")
+    print(i)
+while True:
+    break
+    print("unreachable")
+
+# jumps to jumps
+def branches(l):
+    r = []
+    for i in l:
+        if i % 3 == 0:
+            r.append("a")
+        elif i % 3 == 1:
+            r.append("b")
+        else:
+            r.append("c")
+    return r
+
+print(branches(range(7)))
@@ -0,0 +1,66 @@
+# test framebuf.view() and blitting between mono horizontal framebuffers
+
+try:
+    import framebuf
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+# a view over read-only data can be blitted from
+src = framebuf.view(b"\xf0\x0f\xaa\x55", 16, 2, framebuf.MONO_HLSB)
+print(src.pixel(0, 0), src.pixel(4, 0), src.pixel(8, 1))
+
+buf = bytearray(4)
+fbuf = framebuf.FrameBuffer(buf, 16, 2, framebuf.MONO_HLSB)
+fbuf.blit(src, 0, 0)
+print(buf)
+
+# but not drawn into
+for draw in (
+    lambda: src.fill(0),
+    lambda: src.fill_rect(0, 0, 1, 1, 0),
+    lambda: src.pixel(0, 0, 1),
+    lambda: src.hline(0, 0, 1, 0),
+    lambda: src.vline(0, 0, 1, 0),
+    lambda: src.rect(0, 0, 1, 1, 0),
+    lambda: src.line(0, 0, 1, 1, 0),
+    lambda: src.blit(fbuf, 0, 0),
+    lambda: src.scroll(1, 0),
+    lambda: src.text("a", 0, 0),
+):
+    try:
+        draw()
+    except ValueError:
+        print("ValueError")
+
+# a view over a writable buffer doesn't copy it
+buf = bytearray(2)
+view = framebuf.view(buf, 16, 1, framebuf.MONO_HLSB)
+buf[0] = 0x80
+print(view.pixel(0, 0))
+
+# byte-aligned blits must match pixel-by-pixel blits, including partial last bytes and keys
+def blit_ref(dst, src, x, y, w, h, key):
+    for j in range(h):
+        for i in range(w):
+            dx, dy = x + i, y + j
+            if 0 <= dx < 24 and 0 <= dy < 4:
+                col = src.pixel(i, j)
+                if col != key:
+                    dst.pixel(dx, dy, col)
+
+for fmt in (framebuf.MONO_HLSB, framebuf.MONO_HMSB):
+    data = bytes((i * 37 + 11) & 0xFF for i in range(6))
+    for w in (8, 13, 16):
+        src = framebuf.view(data, w, 3, fmt)
+        for x in (-8, 0, 8, 16):
+            for key in (-1, 0, 1):
+                abuf = bytearray(b"\x5a" * 12)
+                bbuf = bytearray(b"\x5a" * 12)
+                a = framebuf.FrameBuffer(abuf, 24, 4, fmt)
+                b = framebuf.FrameBuffer(bbuf, 24, 4, fmt)
+                a.blit(src, x, 1, key)
+                blit_ref(b, src, x, 1, w, 3, key)
+                if abuf != bbuf:
+                    print("mismatch", fmt, w, x, key, abuf, bbuf)
+print("done")
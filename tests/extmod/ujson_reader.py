@@ -0,0 +1,121 @@
+# test the pull-style ujson.Reader and ujson.select
+
+try:
+    from uio import StringIO
+    import ujson as json
+
+    json.Reader
+except (ImportError, AttributeError):
+    print("SKIP")
+    raise SystemExit
+
+
+def my_print(o):
+    if isinstance(o, dict):
+        print("sorted dict", sorted(o.items()))
+    else:
+        print(o)
+
+
+# rebuild a document from reader events, to check them against ujson.loads
+def build(s):
+    stack = []
+    key = None
+    top = None
+    for ev, val in json.Reader(StringIO(s)):
+        if ev == json.KEY:
+            key = val
+            continue
+        if ev == json.START_OBJECT:
+            val = {}
+        elif ev == json.START_ARRAY:
+            val = []
+        elif ev == json.END_OBJECT or ev == json.END_ARRAY:
+            stack.pop()
+            continue
+        if not stack:
+            top = val
+        elif isinstance(stack[-1], list):
+            stack[-1].append(val)
+        else:
+            stack[-1][key] = val
+        if ev == json.START_OBJECT or ev == json.START_ARRAY:
+            stack.append(val)
+    return top
+
+
+# the same documents as ujson_loads.py
+for s in (
+    "null",
+    "false",
+    "true",
+    "1",
+    "-2",
+    '"abc\\u0064e"',
+    "[]",
+    "[null]",
+    "[null,false,true]",
+    " [ null , false , true ] ",
+    "{}",
+    '{"a":true}',
+    '{"a":null, "b":false, "c":true}',
+    '{"a":[], "b":[1], "c":{"3":4}}',
+    '"abc\\bdef"',
+    '"abc\\tdef"',
+    '"abc\\uabcd"',
+    '{\n\t"a":[]\r\n, "b":[1], "c":{"3":4}     \n\r\t\r\r\r\n}',
+    '[1.5, -2e3, {"x": [{"y": "z"}]}]',
+):
+    print(build(s) == json.loads(s))
+
+for s in ("", '"abc', "]", "a", '{{}:"abc"}', "[null]   a", "[}", '{"a" 1 2}', "[[[", "[" * 33):
+    try:
+        build(s)
+    except ValueError:
+        print("ValueError")
+
+# pull one subtree and skip another
+r = json.Reader(StringIO('{"skip": {"a": [1, "}", {"b": 2}]}, "keep": [1, {"c": null}], "n": 5}'))
+print(next(r), next(r))
+r.skip()
+print(next(r))
+print(r.value())
+print(next(r), next(r), next(r), list(r))
+
+# select
+doc = '{"a": 1, "b": {"c": [1, 2], "d": {"e": "f"}}, "g": [{"h": 1}], "i": "j"}'
+my_print(json.select(StringIO(doc), ("a",)))
+my_print(json.select(StringIO(doc), ("b.c", "b.d.e", "i")))
+my_print(json.select(StringIO(doc), ("b",)))
+my_print(json.select(StringIO(doc), ("g.h", "missing", "b.x")))
+my_print(json.select(StringIO("[1, 2]"), ("a",)))
+my_print(json.select(StringIO('{"a": 1, "a": 2}'), ("a", "b")))
+
+# select stops as soon as it has everything, so trailing garbage isn't seen
+my_print(json.select(StringIO('{"a": 1, "b": oops'), ("a",)))
+try:
+    json.select(StringIO('{"a": 1, "b": oops'), ("a", "c"))
+except ValueError:
+    print("ValueError")
+
+# select only allocates what it returns, where loads builds the whole document
+import gc
+
+big = '{"items": [%s], "_revision": 7}' % ", ".join(
+    '{"name": "item%d", "data": [%d, %d, "%s"]}' % (i, i, i * i, "x" * 20) for i in range(100)
+)
+
+
+def allocated(f):
+    gc.collect()
+    gc.disable()
+    before = gc.mem_alloc()
+    f()
+    used = gc.mem_alloc() - before
+    gc.enable()
+    return used
+
+
+full = allocated(lambda: json.load(StringIO(big)))
+sel = allocated(lambda: json.select(StringIO(big), ("_revision",)))
+print(json.select(StringIO(big), ("_revision",)), sel * 10 < full)
@@ -0,0 +1,93 @@
+# test uprofile sampling, spans and the folded dump format
+
+try:
+    import uprofile, uio
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+
+def dump():
+    s = uio.StringIO()
+    uprofile.dump(s)
+    for line in s.getvalue().split("\n"):
+        if not line:
+            continue
+        stack, count = line.rsplit(" ", 1)
+        # Drop the file names, which depend on how the test is run
+        frames = []
+        for frame in stack.split(";"):
+            if "(" in frame:
+                name, loc = frame.split(" (")
+                frame = name + ":" + loc.split(":")[1][:-1]
+            frames.append(frame)
+        print(";".join(frames), count)
+
+
+def leaf():
+    uprofile.sample()
+
+
+def mid():
+    leaf()
+    leaf()
+
+
+def deep(n):
+    if n:
+        deep(n - 1)
+    else:
+        uprofile.sample()
+
+
+# nothing is recorded before start
+uprofile.sample()
+dump()
+
+# start and stop without running the timer long enough to matter
+uprofile.start(buf_size=1024, depth=8)
+uprofile.stop()
+uprofile.clear()
+
+# manual samples, with consecutive identical stacks merged
+mid()
+for i in range(3):
+    leaf()
+dump()
+uprofile.clear()
+
+# spans are the outermost frames
+uprofile.span_begin("outer")
+uprofile.span_begin("inner")
+leaf()
+uprofile.span_end()
+leaf()
+uprofile.span_end()
+dump()
+
+stats = uprofile.stats()
+print(stats["samples"], stats["dropped"], stats["running"])
+print(sorted(stats["spans"]))
+print(stats["spans"]["outer"][0], stats["spans"]["inner"][0])
+uprofile.clear()
+
+# unbalanced span_end is ignored
+uprofile.span_end()
+
+# stacks deeper than the limit are cut short at the root
+deep(10)
+dump()
+uprofile.clear()
+
+# samples that don't fit are counted as dropped
+uprofile.start(buf_size=64, depth=8)
+uprofile.stop()
+for i in range(10):
+    leaf()
+stats = uprofile.stats()
+print(stats["samples"], stats["dropped"])
+
+try:
+    uprofile.start(depth=0)
+except ValueError:
+    print("ValueError")
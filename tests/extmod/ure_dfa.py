@@ -0,0 +1,54 @@
+# Check that matching gives the same answers whether or not the DFA can decide up front,
+# including patterns with anchors and classes, and patterns too big for a DFA
+try:
+    import ure as re
+except ImportError:
+    try:
+        import re
+    except ImportError:
+        print("SKIP")
+        raise SystemExit
+
+patterns = [
+    r"abc",
+    r"a.c",
+    r"ab*c",
+    r"ab+c$",
+    r"^ab?c",
+    r"(a|b)*c",
+    r"(?:ab)+",
+    r"[a-c]+[^a-c]",
+    r"\d+\.\d*",
+    r"\w+\s\w+$",
+    r"(m|m/|)[0-9/']*",
+    r"x*$",
+    r"$",
+    r"",
+]
+subjects = ["", "abc", "abbbc", "aXc", "ac", "xxabcx", "babac", "ababab", "cab d", "12.5", "7.",
+            "foo bar", "foo bar ", "m/84'/0'", "m/x", "xxx"]
+
+for p in patterns:
+    r = re.compile(p)
+    for s in subjects:
+        m = r.match(s)
+        m2 = re.search(p, s)
+        print(p, repr(s), m and m.group(0), m2 and m2.group(0))
+
+# Needs more states than the DFA is allowed, so falls back to backtracking
+p = "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)$"
+for s in ["abababababa", "aaaaaaaaaa", "bbbbbbbbbbbbbbb", "abbbbbbb", "bbbbbbbb"]:
+    m = re.match(p, s)
+    print(s, m and m.group(0))
+
+# Same pattern object used for many subjects, and again after another pattern was used
+r = re.compile(r"[0-9a-f]+$")
+for s in ["deadbeef", "DEADBEEF", "0123456789abcdef", "xyz"]:
+    print(s, bool(r.match(s)), bool(re.match(r"[0-9a-f]+$", s)), bool(re.match(r"x", s)))
+
+# split and sub go through the DFA too
+print(re.compile(",").split("a,b,,c"))
+try:
+    print(re.sub("[0-9]", "#", "a1b22c333"))
+except AttributeError:
+    print("a#b##c###")
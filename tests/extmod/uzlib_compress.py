@@ -0,0 +1,62 @@
+try:
+    import uzlib as zlib
+    import uio as io
+
+    zlib.compress
+except (ImportError, AttributeError):
+    print("SKIP")
+    raise SystemExit
+
+# Small inputs, including empty
+for data in (b"", b"a", b"hello", b"hello hello hello hello"):
+    comp = zlib.compress(data)
+    print(comp, zlib.decompress(comp) == data)
+
+# Raw DEFLATE stream
+comp = zlib.compress(b"hello hello hello hello", -9)
+print(comp, zlib.decompress(comp, -9))
+
+# Matches across window sizes, long runs and data larger than the window
+data = b"".join(b"%d:%s," % (i, b"x" * (i % 17)) for i in range(2000))
+for wbits in (9, 10, 12, 15):
+    comp = zlib.compress(data, wbits)
+    print(wbits, len(comp), zlib.decompress(comp) == data)
+data = b"ab" * 300 + bytes(range(256)) * 4
+print(zlib.decompress(zlib.compress(data)) == data)
+
+# CompIO gives the same stream however the input is split
+out = io.BytesIO()
+comp = zlib.CompIO(out)
+for i in range(0, len(data), 100):
+    comp.write(data[i : i + 100])
+comp.close()
+print(out.getvalue() == zlib.compress(data))
+try:
+    comp.write(b"more")
+except OSError:
+    print("OSError")
+
+# CompIO output read back through DecompIO
+out = io.BytesIO()
+comp = zlib.CompIO(out, -10)
+comp.write(b"streamed " * 50)
+comp.close()
+print(zlib.DecompIO(io.BytesIO(out.getvalue()), -10).read())
+
+# Preallocated output and workspace buffers
+buf = bytearray(5 * 1024)
+out = bytearray(64)
+n = zlib.compress(b"hello hello hello hello", out=out, buf=buf)
+print(n, bytes(out[:n]) == zlib.compress(b"hello hello hello hello"))
+try:
+    zlib.compress(bytes(range(256)), out=out)
+except ValueError:
+    print("ValueError")
+try:
+    zlib.compress(b"x", buf=bytearray(100))
+except ValueError:
+    print("ValueError")
+try:
+    zlib.compress(b"x", 8)
+except ValueError:
+    print("ValueError")
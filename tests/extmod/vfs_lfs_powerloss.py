@@ -0,0 +1,126 @@
+# Test for VfsLfs2 on a model of NOR flash, cutting the power at every program/erase operation
+# while a file is replaced with a write-to-temporary-then-rename commit
+
+try:
+    import uos
+
+    uos.VfsLfs2
+except (ImportError, AttributeError):
+    print("SKIP")
+    raise SystemExit
+
+
+class NORFlash:
+    # Programming can only clear bits, erasing sets a whole block to 0xff. When the countdown
+    # runs out, the operation in progress is only half done and the power is lost: everything
+    # fails with EIO until the power is turned back on.
+    ERASE_BLOCK_SIZE = 4096
+
+    def __init__(self, blocks):
+        self.data = bytearray(b"\xff" * (blocks * self.ERASE_BLOCK_SIZE))
+        self.countdown = -1
+        self.ops = 0
+        self.off = False
+
+    def power_on(self):
+        self.countdown = -1
+        self.off = False
+
+    def _tick(self):
+        # Returns True if the power goes off during this operation
+        self.ops += 1
+        if self.countdown > 0:
+            self.countdown -= 1
+            self.off = self.countdown == 0
+            return self.off
+        return False
+
+    def readblocks(self, block, buf, off=0):
+        if self.off:
+            return -5  # EIO
+        addr = block * self.ERASE_BLOCK_SIZE + off
+        buf[:] = self.data[addr : addr + len(buf)]
+        return 0
+
+    def writeblocks(self, block, buf, off=0):
+        if self.off:
+            return -5
+        addr = block * self.ERASE_BLOCK_SIZE + off
+        n = len(buf)
+        cut = self._tick()
+        if cut:
+            n //= 2
+        old = self.data[addr : addr + n]
+        self.data[addr : addr + n] = bytes(a & b for a, b in zip(old, buf))
+        return -5 if cut else 0
+
+    def ioctl(self, op, arg):
+        if op == 4:  # block count
+            return len(self.data) // self.ERASE_BLOCK_SIZE
+        if op == 5:  # block size
+            return self.ERASE_BLOCK_SIZE
+        if op == 6:  # erase block
+            if self.off:
+                return -5
+            addr = arg * self.ERASE_BLOCK_SIZE
+            n = self.ERASE_BLOCK_SIZE
+            cut = self._tick()
+            if cut:
+                n //= 2
+            self.data[addr : addr + n] = b"\xff" * n
+            return -5 if cut else 0
+
+
+def mount(bdev):
+    return uos.VfsLfs2(bdev, readsize=256, progsize=256)
+
+
+def commit(vfs, name, data):
+    with vfs.open(name + ".tmp", "wb") as f:
+        for i in range(0, len(data), 1000):
+            f.write(data[i : i + 1000])
+    vfs.rename(name + ".tmp", name)
+
+
+def content(i):
+    return bytes((i + j) & 0xFF for j in range(6000))
+
+
+old = content(1)
+new = content(2)
+
+# Count the operations in one commit
+bdev = NORFlash(16)
+uos.VfsLfs2.mkfs(bdev, readsize=256, progsize=256)
+commit(mount(bdev), "f", old)
+image = bytes(bdev.data)
+bdev.ops = 0
+commit(mount(bdev), "f", new)
+total = bdev.ops
+print("ops", total > 0)
+
+# Cut the power at each of them, and one past the end
+results = {"old": 0, "new": 0}
+for n in range(1, total + 2):
+    bdev.data[:] = image
+    bdev.countdown = n
+    vfs = mount(bdev)
+    try:
+        commit(vfs, "f", new)
+    except OSError:
+        pass
+    bdev.power_on()
+
+    # Power back on: the file must be one version or the other, and the volume still writable
+    vfs = mount(bdev)
+    with vfs.open("f", "rb") as f:
+        got = f.read()
+    if got == old:
+        results["old"] += 1
+    elif got == new:
+        results["new"] += 1
+    else:
+        print("torn at", n, len(got))
+    commit(vfs, "g", old)
+
+print(results["old"] > 0, results["new"] > 0, results["old"] + results["new"] == total + 1)
@@ -0,0 +1,48 @@
+# Pull a couple of fields out of a large JSON document with ujson.select, compared to
+# parsing the whole thing with ujson.load.  Each loop also checks that select allocates a
+# small fraction of what load does, which is what it's meant to save.
+
+import gc
+import ujson
+from uio import StringIO
+
+
+def make_doc(n):
+    items = ", ".join(
+        '{"name": "item%d", "data": [%d, %d, "%s"]}' % (i, i, i * i, "x" * 20) for i in range(n)
+    )
+    return '{"items": [%s], "_revision": %d}' % (items, n)
+
+
+bm_params = {
+    (50, 25): (1, 10),
+    (100, 100): (2, 50),
+    (1000, 1000): (10, 100),
+    (5000, 1000): (50, 100),
+}
+
+
+def bm_setup(params):
+    nloop, nitems = params
+    doc = make_doc(nitems)
+    state = [0, 0]
+
+    def run():
+        for loop in range(nloop):
+            gc.collect()
+            before = gc.mem_alloc()
+            ujson.load(StringIO(doc))
+            state[0] = gc.mem_alloc() - before
+
+            gc.collect()
+            before = gc.mem_alloc()
+            d = ujson.select(StringIO(doc), ("_revision",))
+            state[1] = gc.mem_alloc() - before
+            assert d["_revision"] == nitems
+            assert state[1] * 10 < state[0]
+
+    def result():
+        # CPython has no ujson.select, so there's no truth to check against
+        return nloop * nitems, None
+
+    return run, result
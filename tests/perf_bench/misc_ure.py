@@ -0,0 +1,52 @@
+# Validate a batch of strings with module-level re.match, the way import and export code checks
+# derivation paths and hex strings.  Most of them don't match, which is the case a compiled
+# pattern cache and DFA rejection are meant to speed up.
+
+try:
+    import ure as re
+except ImportError:
+    import re
+
+PATTERNS = (
+    r"(m|m/|)[0-9/']*$",
+    r"[0-9a-fA-F]+$",
+    r"[a-z]+-[0-9]+\.json$",
+)
+
+SUBJECTS = (
+    "m/84'/0'/0'",
+    "m/48'/0'/0'/2'",
+    "m/84'/x/0'",
+    "84h/0h/0h",
+    "deadbeef00112233",
+    "not hex at all",
+    "backup-12.json",
+    "backup-12.txt",
+    "a" * 40 + "!",
+)
+
+bm_params = {
+    (50, 25): (20,),
+    (100, 100): (100,),
+    (1000, 1000): (1000,),
+    (5000, 1000): (5000,),
+}
+
+
+def bm_setup(params):
+    (nloop,) = params
+    state = [0]
+
+    def run():
+        n = 0
+        for loop in range(nloop):
+            for p in PATTERNS:
+                for s in SUBJECTS:
+                    if re.match(p, s):
+                        n += 1
+        state[0] = n
+
+    def result():
+        return nloop * len(PATTERNS) * len(SUBJECTS), state[0]
+
+    return run, result
@@ -0,0 +1,87 @@
+# Compress the kinds of text Passport exports over QR and microSD: a generic JSON wallet,
+# a multisig config file and a public.txt-style address summary.  Each run checks that the
+# output inflates back to the input.  xpubs are base58 and barely compress, so the JSON and
+# address lists gain the most; the multisig config is almost all xpubs.
+
+import uzlib
+
+XPUBS = (
+    "xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8",
+    "xpub68Gmy5EdvgibQVfPdqkBBCHxA5htiqg55crXYuXoQRKfDBFA1WEjWgP6LHhwBZeNK1VTsfTFUHCdrfp1bgwQ9xv5ski8PX9rL2dZXvgGDnw",
+    "xpub6ASuArnXKPbfEwhqN6e3mwBcDTgzisQN1wXN9BJcM47sSikHjJf3UFHKkNAWbWMiGj7Wf5uMash7SyYq527Hqck2AxYysAA7xmALppuCkwQ",
+    "xpub6D4BDPcP2GT577Vvch3R8wDkScZWzQzMMUm3PWbmWvVJrZwQY4VUNgqFJPMM3No2dFDFGTsxxpG5uJh7n7epu4trkrX7x7DogT5Uv6fcLW5",
+    "xpub6FHa3pjLCk84BayeJxFW2SP4XRrFd1JYnxeLeU8EqN3vDfZmbqBqaGJAyiLjTAwm6ZLRQUMv1ZACTj37sR62cfN7fe5JnJ7dh8zL4fiyLHV",
+)
+
+
+def generic_json():
+    accts = []
+    for i, (name, deriv, fmt) in enumerate(
+        (
+            ("bip44", "m/44'/0'/0'", "p2pkh"),
+            ("bip49", "m/49'/0'/0'", "p2sh-p2wpkh"),
+            ("bip84", "m/84'/0'/0'", "p2wpkh"),
+            ("bip48_1", "m/48'/0'/0'/1'", "p2sh-p2wsh"),
+            ("bip48_2", "m/48'/0'/0'/2'", "p2wsh"),
+        )
+    ):
+        accts.append(
+            '"%s": {"deriv": "%s", "xpub": "%s", "xfp": "%08X", "first": null, "name": "%s", "_pub": "%s"}'
+            % (name, deriv, XPUBS[i], 0x1234ABCD + i, fmt, XPUBS[(i + 2) % 5])
+        )
+    return (
+        '{"chain": "BTC", "xpub": "%s", "xfp": "1234ABCD", "account": 0, %s}'
+        % (XPUBS[0], ", ".join(accts))
+    ).encode()
+
+
+def multisig_config():
+    lines = [
+        "# Passport Multisig setup file (created by Sparrow)",
+        "#",
+        "Name: Family vault",
+        "Policy: 3 of 5",
+        "Derivation: m/48'/0'/0'/2'",
+        "Format: P2WSH",
+        "",
+    ]
+    for i, xpub in enumerate(XPUBS):
+        lines.append("%08X: %s" % (0x1234ABCD + i * 0x01010101, xpub))
+    return "\n".join(lines).encode()
+
+
+def public_txt():
+    lines = ["# Passport Summary File", "", "## For Bitcoin: P2WPKH", "", "m/84'/0'/0'/0/{idx} =>"]
+    for i in range(40):
+        lines.append(
+            "  %d => bc1q%s" % (i, "".join("qpzry9x8gf2tvdw0s3jn54khce6mua7l"[(i * 7 + j * 13) % 32] for j in range(38)))
+        )
+    return "\n".join(lines).encode()
+
+
+bm_params = {
+    (50, 10): (1,),
+    (100, 10): (4,),
+    (1000, 10): (20,),
+    (5000, 10): (100,),
+}
+
+
+def bm_setup(params):
+    (nloop,) = params
+    exports = (generic_json(), multisig_config(), public_txt())
+    total = sum(len(data) for data in exports)
+
+    def run():
+        for i in range(nloop):
+            for data in exports:
+                comp = uzlib.compress(data)
+                assert len(comp) < len(data)
+        for data in exports:
+            assert uzlib.decompress(uzlib.compress(data)) == data
+
+    def result():
+        # CPython has no uzlib.compress, so there's no truth to check against
+        return nloop * total, None
+
+    return run, result
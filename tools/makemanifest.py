@@ -55,7 +55,7 @@ def include(manifest):
             exec(f.read())
             os.chdir(prev_cwd)
 
-def freeze(path, script=None, opt=0):
+def freeze(path, script=None, opt=0, opt_bytecode=False):
     """Freeze the input, automatically determining its type.  A .py script
     will be compiled to a .mpy first then frozen, and a .mpy file will be
     frozen directly.
@@ -72,7 +72,7 @@ def freeze(path, script=None, opt=0):
     If `script` is None all files in `path` will be frozen.
 
     If `script` is an iterable then freeze() is called on all items of the
-    iterable (with the same `path` and `opt` passed through).
+    iterable (with the same `path`, `opt` and `opt_bytecode` passed through).
 
     If `script` is a string then it specifies the filename to freeze, and
     can include extra directories before the file.  The file will be
@@ -80,9 +80,12 @@ def freeze(path, script=None, opt=0):
 
     `opt` is the optimisation level to pass to mpy-cross when compiling .py
     to .mpy.
+
+    If `opt_bytecode` is True, mpy-cross runs its bytecode optimiser (-X
+    opt-bytecode) on the .py scripts.
     """
 
-    freeze_internal(KIND_AUTO, path, script, opt)
+    freeze_internal(KIND_AUTO, path, script, opt, opt_bytecode=opt_bytecode)
 
 def freeze_as_str(path):
     """Freeze the given `path` and all .py scripts within it as a string,
@@ -91,12 +94,12 @@ def freeze_as_str(path):
 
     freeze_internal(KIND_AS_STR, path, None, 0)
 
-def freeze_as_mpy(path, script=None, opt=0):
+def freeze_as_mpy(path, script=None, opt=0, opt_bytecode=False):
     """Freeze the input (see above) by first compiling the .py scripts to
     .mpy files, then freezing the resulting .mpy files.
     """
 
-    freeze_internal(KIND_AS_MPY, path, script, opt)
+    freeze_internal(KIND_AS_MPY, path, script, opt, opt_bytecode=opt_bytecode)
 
 def freeze_mpy(path, script=None, opt=0):
     """Freeze the input (see above), which must be .mpy files that are
@@ -105,6 +108,22 @@ def freeze_mpy(path, script=None, opt=0):
 
     freeze_internal(KIND_MPY, path, script, opt)
 
+def freeze_rom(path, script=None, opt=0, opt_bytecode=False):
+    """Freeze the input (see above) as .py scripts compiled to .mpy, and
+    build the top level of each module in ROM: its globals dict, functions
+    and classes are made at build time, so importing it runs no code and
+    allocates nothing on the heap.  The port must enable
+    MICROPY_MODULE_FROZEN_ROM.
+
+    The top level of each module may only bind constants (ints, strings,
+    bytes and tuples of them), functions and classes, and may import only
+    `const` from `micropython`; freezing fails otherwise.  No function may
+    assign to a global, and the module's attributes and its classes'
+    attributes can't be assigned to at run time.
+    """
+
+    freeze_internal(KIND_AS_MPY, path, script, opt, rom=True, opt_bytecode=opt_bytecode)
+
 
 ###########################################################################
 # Internal implementation
@@ -164,19 +183,19 @@ def mkdir(path):
             else:
                 raise er
 
-def freeze_internal(kind, path, script, opt):
+def freeze_internal(kind, path, script, opt, rom=False, opt_bytecode=False):
     path = convert_path(path)
     if script is None and kind == KIND_AS_STR:
         if any(f[0] == KIND_AS_STR for f in manifest_list):
             raise FreezeError('can only freeze one str directory')
-        manifest_list.append((KIND_AS_STR, path, script, opt))
+        manifest_list.append((KIND_AS_STR, path, script, opt, rom, opt_bytecode))
     elif script is None:
         for dirpath, dirnames, filenames in os.walk(path, followlinks=True):
             for f in filenames:
-                freeze_internal(kind, path, (dirpath + '/' + f)[len(path) + 1:], opt)
+                freeze_internal(kind, path, (dirpath + '/' + f)[len(path) + 1:], opt, rom, opt_bytecode)
     elif not isinstance(script, str):
         for s in script:
-            freeze_internal(kind, path, s, opt)
+            freeze_internal(kind, path, s, opt, rom, opt_bytecode)
     else:
         extension_kind = {KIND_AS_MPY: '.py', KIND_MPY: '.mpy'}
         if kind == KIND_AUTO:
@@ -190,7 +209,7 @@ def freeze_internal(kind, path, script, opt):
         wanted_extension = extension_kind[kind]
         if not script.endswith(wanted_extension):
             raise FreezeError('expecting a {} file, got {}'.format(wanted_extension, script))
-        manifest_list.append((kind, path, script, opt))
+        manifest_list.append((kind, path, script, opt, rom, opt_bytecode))
 
 def main():
     # Parse arguments
@@ -238,8 +257,9 @@ def main():
     # Process the manifest
     str_paths = []
     mpy_files = []
+    rom_files = []
     ts_newest = 0
-    for kind, path, script, opt in manifest_list:
+    for kind, path, script, opt, rom, opt_bytecode in manifest_list:
         if kind == KIND_AS_STR:
             str_paths.append(path)
             ts_outfile = get_timestamp_newest(path)
@@ -251,12 +271,17 @@ def main():
             if ts_infile >= ts_outfile:
                 print('MPY', script)
                 mkdir(outfile)
-                res, out = system([MPY_CROSS] + args.mpy_cross_flags.split() + ['-o', outfile, '-s', script, '-O{}'.format(opt), infile])
+                flags = args.mpy_cross_flags.split() + ['-O{}'.format(opt)]
+                if opt_bytecode:
+                    flags += ['-X', 'opt-bytecode']
+                res, out = system([MPY_CROSS] + flags + ['-o', outfile, '-s', script, infile])
                 if res != 0:
                     print('error compiling {}: {}'.format(infile, out))
                     raise SystemExit(1)
                 ts_outfile = get_timestamp(outfile)
             mpy_files.append(outfile)
+            if rom:
+                rom_files += ['-r', outfile]
         else:
             assert kind == KIND_MPY
             infile = '{}/{}'.format(path, script)
@@ -276,7 +301,7 @@ def main():
         sys.exit(1)
 
     # Freeze .mpy files
-    res, output_mpy = system([sys.executable, MPY_TOOL, '-f', '-q', args.build_dir + '/genhdr/qstrdefs.preprocessed.h'] + mpy_files)
+    res, output_mpy = system([sys.executable, MPY_TOOL, '-f', '-q', args.build_dir + '/genhdr/qstrdefs.preprocessed.h'] + rom_files + mpy_files)
     if res != 0:
         print('error freezing mpy {}: {}'.format(mpy_files, output_mpy))
         sys.exit(1)
@@ -532,6 +532,450 @@ class RawCodeNative(RawCode):
         self.freeze_constants()
         self.freeze_module(self.qstr_links, self.type_sig)
 
+###########################################################################
+# ROM modules
+#
+# A frozen module whose top level only binds constants, functions and classes can
+# have its globals dict, function objects and class types built here as const data,
+# instead of running its top-level code at import time.  Importing it then allocates
+# nothing on the heap.  Module and class attributes can't be assigned to afterwards,
+# so modules are only built this way when the manifest asks for it (freeze_rom).
+
+MP_BC_LOAD_CONST_STRING = 0x10
+MP_BC_STORE_NAME = 0x16
+MP_BC_STORE_GLOBAL = 0x17
+MP_BC_DELETE_GLOBAL = 0x1a
+MP_BC_IMPORT_NAME = 0x1b
+MP_BC_IMPORT_FROM = 0x1c
+MP_BC_LOAD_CONST_SMALL_INT = 0x22
+MP_BC_LOAD_CONST_OBJ = 0x23
+MP_BC_BUILD_TUPLE = 0x2a
+MP_BC_MAKE_FUNCTION = 0x32
+MP_BC_MAKE_FUNCTION_DEFARGS = 0x33
+MP_BC_CALL_FUNCTION = 0x34
+MP_BC_LOAD_CONST_FALSE = 0x50
+MP_BC_LOAD_CONST_NONE = 0x51
+MP_BC_LOAD_CONST_TRUE = 0x52
+MP_BC_LOAD_NULL = 0x53
+MP_BC_LOAD_BUILD_CLASS = 0x54
+MP_BC_POP_TOP = 0x59
+MP_BC_RETURN_VALUE = 0x63
+MP_BC_LOAD_CONST_SMALL_INT_MULTI = 0x70
+MP_BC_LOAD_CONST_SMALL_INT_MULTI_NUM = 64
+MP_BC_LOAD_CONST_SMALL_INT_MULTI_EXCESS = 16
+MP_BC_UNARY_OP_MULTI = 0xd0
+MP_BC_BINARY_OP_MULTI = 0xd7
+
+MP_SCOPE_FLAG_GENERATOR = 0x01
+
+# builtin types that a ROM class can derive from
+rom_builtin_types = (
+    'object', 'BaseException', 'Exception', 'ArithmeticError', 'AssertionError',
+    'AttributeError', 'EOFError', 'ImportError', 'IndexError', 'KeyError', 'LookupError',
+    'MemoryError', 'NameError', 'NotImplementedError', 'OSError', 'OverflowError',
+    'RuntimeError', 'StopIteration', 'SyntaxError', 'TypeError', 'ValueError',
+    'ZeroDivisionError',
+)
+
+# class attributes that mp_obj_new_type treats specially
+rom_class_special_names = (
+    '__new__', '__getattr__', '__setattr__', '__delattr__', '__get__', '__set__', '__delete__',
+)
+
+# small-int operations that are worked out at build time, by their MP_UNARY_OP_xxx
+# and MP_BINARY_OP_xxx number
+rom_unary_ops = {
+    0: lambda a: a,             # POSITIVE
+    1: lambda a: -a,            # NEGATIVE
+    2: lambda a: ~a,            # INVERT
+}
+rom_binary_ops = {
+    22: lambda a, b: a | b,     # OR
+    23: lambda a, b: a ^ b,     # XOR
+    24: lambda a, b: a & b,     # AND
+    25: lambda a, b: a << b,    # LSHIFT
+    26: lambda a, b: a >> b,    # RSHIFT
+    27: lambda a, b: a + b,     # ADD
+    28: lambda a, b: a - b,     # SUBTRACT
+    29: lambda a, b: a * b,     # MULTIPLY
+    31: lambda a, b: a // b,    # FLOOR_DIVIDE
+    33: lambda a, b: a % b,     # MODULO
+}
+
+class RomError(Exception):
+    pass
+
+def get_qstr_index(s):
+    for i, q in enumerate(global_qstrs):
+        if q is not None and q.str == s:
+            return i
+    global_qstrs.append(QStrType(s))
+    return len(global_qstrs) - 1
+
+def next_prime(n):
+    while any(n % d == 0 for d in range(2, int(n ** 0.5) + 1)):
+        n += 1
+    return n
+
+class RomObj:
+    # a value known at build time; rom is its mp_rom_obj_t form and obj its mp_obj_t form
+    def __init__(self, rom, obj):
+        self.rom = rom
+        self.obj = obj
+
+    def deps(self):
+        return ()
+
+    def freeze(self, rom_module):
+        pass
+
+class RomImm(RomObj):
+    def __init__(self, macro, val):
+        self.val = val
+        RomObj.__init__(self, 'MP_ROM_%s(%s)' % (macro, val), 'MP_OBJ_NEW_%s(%s)' % (
+            'SMALL_INT' if macro == 'INT' else macro, val))
+
+class RomPtr(RomObj):
+    def __init__(self, c_name):
+        self.c_name = c_name
+
+    @property
+    def rom(self):
+        return 'MP_ROM_PTR(&%s)' % self.c_name
+
+    @property
+    def obj(self):
+        return '(mp_obj_t)&%s' % self.c_name
+
+class RomConstObj(RomPtr):
+    # an entry of a raw code's constant table, whose name is only known once it's frozen
+    def __init__(self, rc, idx):
+        self.rc = rc
+        self.idx = idx
+
+    @property
+    def c_name(self):
+        return 'const_obj_%s_%u' % (self.rc.escaped_name, self.idx)
+
+class RomTuple(RomPtr):
+    def __init__(self, c_name, items):
+        RomPtr.__init__(self, c_name)
+        self.items = items
+
+    def deps(self):
+        return self.items
+
+    def freeze(self, rom_module):
+        print('STATIC const mp_rom_obj_tuple_t %s = {{&mp_type_tuple}, %u, {%s}};'
+            % (self.c_name, len(self.items), ', '.join(v.rom for v in self.items)))
+
+class RomFunction(RomPtr):
+    def __init__(self, c_name, rc, defaults):
+        RomPtr.__init__(self, c_name)
+        self.rc = rc
+        self.defaults = defaults
+
+    def deps(self):
+        return self.defaults
+
+    def freeze(self, rom_module):
+        rc = self.rc
+        if rc.prelude[2] & MP_SCOPE_FLAG_GENERATOR:
+            fun_type = 'mp_type_gen_wrap'
+        else:
+            fun_type = 'mp_type_fun_bc'
+        print('STATIC const mp_obj_fun_bc_t %s = {' % self.c_name)
+        print('    .base = {&%s},' % fun_type)
+        print('    .globals = (mp_obj_dict_t*)&%s,' % rom_module.globals_name)
+        print('    .bytecode = fun_data_%s,' % rc.escaped_name)
+        if len(rc.qstrs) + len(rc.objs) + len(rc.raw_codes):
+            print('    .const_table = (const mp_uint_t*)const_table_data_%s,' % rc.escaped_name)
+        else:
+            print('    .const_table = NULL,')
+        print('    #if MICROPY_PY_SYS_SETTRACE')
+        print('    .rc = &raw_code_%s,' % rc.escaped_name)
+        print('    #endif')
+        if self.defaults:
+            print('    .extra_args = {%s},' % ', '.join(v.obj for v in self.defaults))
+        print('};')
+
+class RomClass(RomPtr):
+    def __init__(self, c_name, name, parent, ns):
+        RomPtr.__init__(self, c_name)
+        self.name = name
+        self.parent = parent
+        self.ns = ns
+
+    def deps(self):
+        return ([self.parent] if self.parent else []) + list(self.ns.values())
+
+    def freeze(self, rom_module):
+        locals_name = self.c_name + '_locals'
+        rom_module.freeze_dict(locals_name, self.ns)
+        print('STATIC const mp_obj_type_t %s = {' % self.c_name)
+        print('    .base = {&mp_type_type},')
+        print('    .flags = TYPE_FLAG_IS_SUBCLASSED,')
+        print('    .name = %s,' % self.name.qstr_id)
+        print('    MP_OBJ_INSTANCE_TYPE_SLOTS')
+        if self.parent:
+            print('    .parent = &%s,' % self.parent.c_name)
+        print('    .locals_dict = (mp_obj_dict_t*)&%s,' % locals_name)
+        print('};')
+
+class RomMarker:
+    # a stack value that can't be stored, such as the result of LOAD_NULL
+    def __init__(self, what):
+        self.what = what
+
+ROM_NULL = RomMarker('NULL')
+ROM_BUILD_CLASS = RomMarker('__build_class__')
+ROM_MODULE_MICROPYTHON = RomPtr('mp_module_micropython')
+ROM_NONE = RomPtr('mp_const_none_obj')
+
+class RomModule:
+    def __init__(self, rc):
+        self.rc = rc
+        self.prefix = 'rom_' + rc.source_file.str.replace('/', '_')[:-3]
+        self.globals_name = self.prefix + '_globals'
+        self.module_name = self.prefix + '_module'
+        self.n_objs = 0
+
+        if rc.code_kind != MP_CODE_BYTECODE:
+            raise RomError('module is native code')
+        if rc.source_file.str.endswith('__init__.py'):
+            raise RomError('packages are not supported')
+        self.check_globals(rc)
+
+        name = rc.source_file.str[:-3].replace('/', '.')
+        self.ns = {}
+        self.ns_order = []
+        self.store(self.ns, self.ns_order, '__name__', RomImm('QSTR', global_qstrs[get_qstr_index(name)].qstr_id))
+        self.store(self.ns, self.ns_order, '__file__', RomImm('QSTR', rc.source_file.qstr_id))
+        self.execute(rc, self.ns, self.ns_order, None)
+        self.ns = [(k, self.ns[k]) for k in self.ns_order]
+
+    def check_globals(self, rc):
+        # functions that assign globals would write to the ROM dict
+        if rc.code_kind != MP_CODE_BYTECODE:
+            raise RomError('%s is native code' % rc.simple_name.str)
+        ip = rc.ip
+        while ip < len(rc.bytecode):
+            op = rc.bytecode[ip]
+            f, sz = mp_opcode_format(rc.bytecode, ip, True)
+            if op in (MP_BC_STORE_GLOBAL, MP_BC_DELETE_GLOBAL):
+                raise RomError('%s assigns to global %s'
+                    % (rc.simple_name.str, rc._unpack_qstr(ip + 1).str))
+            ip += sz
+        for child in rc.raw_codes:
+            self.check_globals(child)
+
+    def new_name(self, kind):
+        self.n_objs += 1
+        return '%s_%s%u' % (self.prefix, kind, self.n_objs)
+
+    def store(self, ns, order, name, val):
+        if not isinstance(val, RomObj):
+            raise RomError('cannot store %s in %s' % (val.what, name))
+        if name not in ns:
+            order.append(name)
+        ns[name] = val
+
+    def execute(self, rc, ns, order, class_ns):
+        # run the straight-line code of a module or class body, binding names in ns
+        bc = rc.bytecode
+        n_qstrs = len(rc.qstrs)
+        n_objs = len(rc.objs)
+        stack = []
+        ip = rc.ip
+        while True:
+            op = bc[ip]
+            f, sz = mp_opcode_format(bc, ip, True)
+            if f == MP_BC_FORMAT_QSTR:
+                arg = rc._unpack_qstr(ip + 1)
+            elif f == MP_BC_FORMAT_VAR_UINT:
+                arg = 0
+                if op == MP_BC_LOAD_CONST_SMALL_INT and bc[ip + 1] & 0x40:
+                    arg = -1
+                i = ip + 1
+                while True:
+                    arg = (arg << 7) | (bc[i] & 0x7f)
+                    if not bc[i] & 0x80:
+                        break
+                    i += 1
+            ip += sz
+
+            if op == MP_BC_LOAD_CONST_FALSE:
+                stack.append(RomPtr('mp_const_false_obj'))
+            elif op == MP_BC_LOAD_CONST_NONE:
+                stack.append(ROM_NONE)
+            elif op == MP_BC_LOAD_CONST_TRUE:
+                stack.append(RomPtr('mp_const_true_obj'))
+            elif op == MP_BC_LOAD_NULL:
+                stack.append(ROM_NULL)
+            elif (MP_BC_LOAD_CONST_SMALL_INT_MULTI <= op
+                < MP_BC_LOAD_CONST_SMALL_INT_MULTI + MP_BC_LOAD_CONST_SMALL_INT_MULTI_NUM):
+                stack.append(RomImm('INT', op - MP_BC_LOAD_CONST_SMALL_INT_MULTI
+                    - MP_BC_LOAD_CONST_SMALL_INT_MULTI_EXCESS))
+            elif op == MP_BC_LOAD_CONST_SMALL_INT:
+                stack.append(RomImm('INT', arg))
+            elif op == MP_BC_LOAD_CONST_STRING:
+                stack.append(RomImm('QSTR', arg.qstr_id))
+            elif op - MP_BC_UNARY_OP_MULTI in rom_unary_ops:
+                stack.append(self.small_int(rom_unary_ops[op - MP_BC_UNARY_OP_MULTI],
+                    stack.pop()))
+            elif op - MP_BC_BINARY_OP_MULTI in rom_binary_ops:
+                rhs = stack.pop()
+                stack.append(self.small_int(rom_binary_ops[op - MP_BC_BINARY_OP_MULTI],
+                    stack.pop(), rhs))
+            elif op == MP_BC_LOAD_CONST_OBJ:
+                obj = rc.objs[arg - n_qstrs]
+                if not (is_str_type(obj) or is_bytes_type(obj) or is_int_type(obj)):
+                    raise RomError('constant %r' % (obj,))
+                stack.append(RomConstObj(rc, arg - n_qstrs))
+            elif op == MP_BC_BUILD_TUPLE:
+                items = stack[len(stack) - arg:]
+                del stack[len(stack) - arg:]
+                for v in items:
+                    if not isinstance(v, RomObj):
+                        raise RomError('tuple of %s' % v.what)
+                if items:
+                    stack.append(RomTuple(self.new_name('tuple'), items))
+                else:
+                    stack.append(RomPtr('mp_const_empty_tuple_obj'))
+            elif op in (MP_BC_MAKE_FUNCTION, MP_BC_MAKE_FUNCTION_DEFARGS):
+                child = rc.raw_codes[arg - n_qstrs - n_objs]
+                defaults = []
+                if op == MP_BC_MAKE_FUNCTION_DEFARGS:
+                    kw_defaults = stack.pop()
+                    pos_defaults = stack.pop()
+                    if kw_defaults is not ROM_NULL:
+                        raise RomError('keyword-only defaults in %s' % child.simple_name.str)
+                    if isinstance(pos_defaults, RomTuple):
+                        defaults = pos_defaults.items
+                    elif pos_defaults is not ROM_NULL:
+                        raise RomError('defaults of %s' % child.simple_name.str)
+                stack.append(RomFunction(self.new_name('fun'), child, defaults))
+            elif op == MP_BC_LOAD_BUILD_CLASS:
+                stack.append(ROM_BUILD_CLASS)
+            elif op == MP_BC_CALL_FUNCTION:
+                n_args = arg & 0xff
+                if arg >> 8 or n_args < 2 or n_args > 3 or stack[-n_args - 1] is not ROM_BUILD_CLASS:
+                    raise RomError('call at top level')
+                args = stack[len(stack) - n_args:]
+                del stack[len(stack) - n_args - 1:]
+                stack.append(self.build_class(*args))
+            elif op == MP_BC_LOAD_NAME:
+                stack.append(self.load_name(arg.str, ns, class_ns))
+            elif op == MP_BC_STORE_NAME:
+                self.store(ns, order, arg.str, stack.pop())
+            elif op == MP_BC_IMPORT_NAME:
+                fromlist = stack.pop()
+                level = stack.pop()
+                if arg.str != 'micropython' or getattr(level, 'obj', None) != 'MP_OBJ_NEW_SMALL_INT(0)':
+                    raise RomError('import of %s' % arg.str)
+                stack.append(ROM_MODULE_MICROPYTHON)
+            elif op == MP_BC_IMPORT_FROM:
+                if stack[-1] is not ROM_MODULE_MICROPYTHON or arg.str != 'const':
+                    raise RomError('import of %s' % arg.str)
+                stack.append(RomPtr('mp_identity_obj'))
+            elif op == MP_BC_POP_TOP:
+                stack.pop()
+            elif op == MP_BC_RETURN_VALUE:
+                if stack.pop() is not ROM_NONE:
+                    raise RomError('%s returns a value' % rc.simple_name.str)
+                return
+            else:
+                raise RomError('opcode 0x%02x in %s' % (op, rc.simple_name.str))
+
+    def small_int(self, fun, *args):
+        for a in args:
+            if not (isinstance(a, RomImm) and is_int_type(a.val)):
+                raise RomError('operation on a value that is not a small int')
+        try:
+            val = fun(*(a.val for a in args))
+        except ZeroDivisionError:
+            raise RomError('division by zero')
+        if not -(1 << (config.mp_small_int_bits - 1)) <= val < 1 << (config.mp_small_int_bits - 1):
+            raise RomError('result %d is not a small int' % val)
+        return RomImm('INT', val)
+
+    def load_name(self, name, ns, class_ns):
+        if class_ns is not None and name in class_ns:
+            return class_ns[name]
+        if name in self.ns:
+            return self.ns[name]
+        if name in rom_builtin_types:
+            return RomPtr('mp_type_' + name)
+        raise RomError('name %s is not known at build time' % name)
+
+    def build_class(self, body, name, base=None):
+        if not isinstance(body, RomFunction) or body.defaults:
+            raise RomError('class body')
+        cls_name = body.rc.simple_name
+        if base is None or isinstance(base, RomClass):
+            parent = base
+        elif isinstance(base, RomPtr) and base.c_name in ['mp_type_' + t for t in rom_builtin_types]:
+            parent = base
+        else:
+            raise RomError('base of class %s' % cls_name.str)
+
+        ns = {}
+        order = []
+        self.execute(body.rc, ns, order, ns)
+        for attr in order:
+            if attr in rom_class_special_names:
+                raise RomError('class %s defines %s' % (cls_name.str, attr))
+        return RomClass(self.new_name('class'), cls_name, parent,
+            {k: ns[k] for k in order})
+
+    def freeze_dict(self, c_name, items):
+        items = list(items.items()) if isinstance(items, dict) else items
+        used = len(items)
+        alloc = next_prime(used + used // 3 + 1)
+        table = [None] * alloc
+        for key, val in items:
+            qst = global_qstrs[get_qstr_index(key)]
+            pos = qstrutil.compute_hash(bytes_cons(key, 'utf8'), config.MICROPY_QSTR_BYTES_IN_HASH) % alloc
+            while table[pos] is not None:
+                pos = (pos + 1) % alloc
+            table[pos] = (qst, val)
+        print('STATIC const mp_rom_map_elem_t %s_table[%u] = {' % (c_name, alloc))
+        for pos, elem in enumerate(table):
+            if elem is not None:
+                print('    [%u] = { MP_ROM_QSTR(%s), %s },' % (pos, elem[0].qstr_id, elem[1].rom))
+        print('};')
+        print('STATIC const mp_obj_dict_t %s = {' % c_name)
+        print('    .base = {&mp_type_dict},')
+        print('    .map = {')
+        print('        .all_keys_are_qstrs = 1,')
+        print('        .is_fixed = 1,')
+        print('        .is_ordered = 0,')
+        print('        .used = %u,' % used)
+        print('        .alloc = %u,' % alloc)
+        print('        .table = (mp_map_elem_t*)(mp_rom_map_elem_t*)%s_table,' % c_name)
+        print('    },')
+        print('};')
+
+    def freeze(self):
+        print()
+        print('// ROM module for file %s' % self.rc.source_file.str)
+        print('STATIC const mp_obj_dict_t %s;' % self.globals_name)
+        done = set()
+        def freeze_obj(v):
+            if id(v) in done:
+                return
+            done.add(id(v))
+            for d in v.deps():
+                freeze_obj(d)
+            v.freeze(self)
+        for _, v in self.ns:
+            freeze_obj(v)
+        self.freeze_dict(self.globals_name, self.ns)
+        print('STATIC const mp_obj_module_t %s = {' % self.module_name)
+        print('    .base = {&mp_type_module},')
+        print('    .globals = (mp_obj_dict_t*)&%s,' % self.globals_name)
+        print('};')
+
 class BytecodeBuffer:
     def __init__(self, size):
         self.buf = bytearray(size)
@@ -703,7 +1147,18 @@ def dump_mpy(raw_codes):
     for rc in raw_codes:
         rc.dump()
 
-def freeze_mpy(base_qstrs, raw_codes):
+def freeze_mpy(base_qstrs, raw_codes, rom_files=()):
+    # work out the ROM modules first, as they may need new qstrs
+    rom_modules = []
+    for rc in raw_codes:
+        if rc.mpy_source_file in rom_files:
+            try:
+                rom_modules.append(RomModule(rc))
+            except RomError as er:
+                raise FreezeError(rc, 'cannot build module in ROM: %s' % er)
+        else:
+            rom_modules.append(None)
+
     # add to qstrs
     new = {}
     for q in global_qstrs:
@@ -718,6 +1173,11 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('#include "py/objstr.h"')
     print('#include "py/emitglue.h"')
     print('#include "py/nativeglue.h"')
+    if any(rom_modules):
+        print('#include "py/objfun.h"')
+        print('#include "py/objmodule.h"')
+        print('#include "py/objtuple.h"')
+        print('#include "py/objtype.h"')
     print()
 
     print('#if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE != %u' % config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE)
@@ -795,6 +1255,18 @@ def freeze_mpy(base_qstrs, raw_codes):
         print('    &raw_code_%s,' % rc.escaped_name)
     print('};')
 
+    print()
+    print('#if MICROPY_MODULE_FROZEN_ROM')
+    for rom in rom_modules:
+        if rom:
+            rom.freeze()
+    print()
+    print('const mp_obj_module_t *const mp_frozen_mpy_rom_content[] = {')
+    for rom in rom_modules:
+        print('    %s,' % ('&' + rom.module_name if rom else 'NULL'))
+    print('};')
+    print('#endif')
+
 def merge_mpy(raw_codes, output_file):
     assert len(raw_codes) <= 31 # so var-uints all fit in 1 byte
     merged_mpy = bytearray()
@@ -861,6 +1333,8 @@ def main():
         help='mpz digit size used by target (default 16)')
     cmd_parser.add_argument('-o', '--output', default=None,
         help='output file')
+    cmd_parser.add_argument('-r', '--rom', action='append', default=[], metavar='FILE',
+        help='build the top level of this input file in ROM when freezing')
     cmd_parser.add_argument('files', nargs='+',
         help='input .mpy files')
     args = cmd_parser.parse_args()
@@ -890,7 +1364,7 @@ def main():
         dump_mpy(raw_codes)
     elif args.freeze:
         try:
-            freeze_mpy(base_qstrs, raw_codes)
+            freeze_mpy(base_qstrs, raw_codes, args.rom)
         except FreezeError as er:
             print(er, file=sys.stderr)
             sys.exit(1)